@@ -0,0 +1,50 @@
+#include <iostream>
+#include <open62541cpp/clientcoroutine.h>
+using namespace std;
+
+//
+// Workflow reading the server time a few times then calling the TestServer hello method
+//
+Open62541::Task<> workflow(Open62541::ClientExecutor& e, int idx)
+{
+    Open62541::NodeId currentTime(0, UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME);
+    for (int i = 0; i < 5; i++) {
+        auto r = co_await e.read(currentTime);
+        if (r.ok())
+            cout << "Server time " << Open62541::variantToString(r.value) << endl;
+        else
+            cout << "Read failed " << UA_StatusCode_name(r.status) << endl;
+    }
+    //
+    // call() copies the arguments
+    Open62541::Variant arg0(1.25);
+    Open62541::Variant arg1(3.8);
+    Open62541::VariantList in;
+    in.push_back(arg0.get());
+    in.push_back(arg1.get());
+    auto c = co_await e.call(Open62541::NodeId(idx, "ServerMethodItem"), Open62541::NodeId(idx, 12345), in);
+    if (c.ok() && (c.value.get().outputArgumentsSize > 0)) {
+        UA_Double* d = (UA_Double*)(c.value.get().outputArguments[0].data);
+        cout << "Result = " << *d << endl;
+    }
+    else {
+        cout << "Call failed " << UA_StatusCode_name(c.status) << endl;
+    }
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    cout << "Coroutine Client" << endl;
+    Open62541::Client client;
+    if (!client.connect("opc.tcp://localhost:4840")) {
+        cout << "Failed to connect" << endl;
+        return 1;
+    }
+    int idx = client.namespaceGetIndex("urn:test:test");
+    Open62541::ClientExecutor e(client);
+    e.spawn(workflow(e, idx));
+    e.run();
+    cout << "Workflows failed " << e.failed() << endl;
+    client.disconnect();
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <open62541cpp/historybulk.h>
+using namespace std;
+//
+// offline bulk export and import of a file historian directory
+//
+typedef std::chrono::steady_clock Clock;
+
+/*!
+ * \brief usage
+ */
+static int usage()
+{
+    cerr << "usage: HistoryBulkTool export|export-csv <directory> <file> <node id>..." << endl;
+    cerr << "       HistoryBulkTool import|import-csv <directory> <file>" << endl;
+    cerr << "node ids as ns=2;s=Name" << endl;
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 4)
+        return usage();
+    std::string command = argv[1];
+    std::vector<Open62541::NodeId> nodes;
+    for (int i = 4; i < argc; i++) {
+        UA_NodeId n;
+        if (UA_NodeId_parse(&n, UA_STRING(argv[i])) != UA_STATUSCODE_GOOD) {
+            cerr << "bad node id " << argv[i] << endl;
+            return 1;
+        }
+        nodes.push_back(n);
+        UA_NodeId_clear(&n);
+    }
+    //
+    Open62541::FileHistoryBackend store(argv[2]);
+    Open62541::HistoryBulk bulk(store.database());
+    bulk.setThreads(std::max(1U, std::thread::hardware_concurrency()));
+    Clock::time_point t0 = Clock::now();
+    bool ok;
+    if (command == "export")
+        ok = bulk.exportNodes(nodes, argv[3]);
+    else if (command == "export-csv")
+        ok = bulk.exportCsv(nodes, argv[3]);
+    else if (command == "import")
+        ok = bulk.importFile(argv[3]);
+    else if (command == "import-csv")
+        ok = bulk.importCsv(argv[3]);
+    else
+        return usage();
+    store.close();
+    double s = std::chrono::duration<double>(Clock::now() - t0).count();
+    cout << command << (ok ? " done " : " failed ") << bulk.records() << " records " << bulk.skipped() << " skipped in "
+         << s << " s";
+    if (s > 0)
+        cout << " (" << size_t(bulk.records() / s) << " records/s)";
+    cout << endl;
+    if (!ok)
+        cerr << "error " << UA_StatusCode_name(bulk.lastError()) << endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <open62541cpp/historycompression.h>
+using namespace std;
+//
+// compression ratio and decode throughput of the history block encoding for typical process data
+//
+typedef std::chrono::steady_clock Clock;
+
+/*!
+ * \brief makeRecord
+ */
+static Open62541::FileHistoryRecord makeRecord(UA_DateTime t, UA_UInt16 typeIndex, const void* v, size_t size)
+{
+    Open62541::FileHistoryRecord r;
+    memset(&r, 0, sizeof(r));
+    r.timestamp       = t;
+    r.serverTimestamp = t;
+    r.typeIndex       = typeIndex;
+    r.flags = Open62541::FileHistoryRecord::HasValue | Open62541::FileHistoryRecord::HasSourceTimestamp |
+              Open62541::FileHistoryRecord::HasServerTimestamp;
+    memcpy(r.value, v, size);
+    return r;
+}
+
+/*!
+ * \brief generate
+ * One day of one second samples with a little scan jitter
+ */
+static void generate(const std::string& kind, std::vector<Open62541::FileHistoryRecord>& records)
+{
+    std::mt19937 gen(42);
+    std::normal_distribution<double> noise(0.0, 0.05);
+    std::uniform_int_distribution<int> jitter(0, 20);
+    const size_t n = 86400;
+    UA_DateTime t  = UA_DateTime_now();
+    UA_Int32 counter = 0;
+    bool state       = false;
+    records.clear();
+    for (size_t i = 0; i < n; i++) {
+        t += UA_DATETIME_SEC + ((jitter(gen) == 0) ? jitter(gen) * UA_DATETIME_MSEC : 0);
+        if (kind == "analog") {
+            // slow process variable measured to two decimal places
+            double v = std::round((50.0 + 10.0 * sin(double(i) / 3600.0) + noise(gen)) * 100.0) / 100.0;
+            records.push_back(makeRecord(t, UA_TYPES_DOUBLE, &v, sizeof(v)));
+        }
+        else if (kind == "noisy") {
+            // full precision noisy signal - the worst case for XOR encoding
+            double v = 50.0 + 10.0 * sin(double(i) / 3600.0) + noise(gen);
+            records.push_back(makeRecord(t, UA_TYPES_DOUBLE, &v, sizeof(v)));
+        }
+        else if (kind == "counter") {
+            counter += (jitter(gen) < 5) ? 1 : 0;
+            records.push_back(makeRecord(t, UA_TYPES_INT32, &counter, sizeof(counter)));
+        }
+        else {
+            if (jitter(gen) == 0 && jitter(gen) == 0)
+                state = !state;
+            UA_Boolean b = state;
+            records.push_back(makeRecord(t, UA_TYPES_BOOLEAN, &b, sizeof(b)));
+        }
+    }
+}
+
+/*!
+ * \brief main
+ * \return
+ */
+int main(int, char**)
+{
+    const size_t rawSize = sizeof(Open62541::FileHistoryRecord);
+    const size_t dvSize  = sizeof(UA_DataValue) + sizeof(UA_Double);  // in memory value with its scalar
+    for (const char* kind : {"analog", "noisy", "counter", "state"}) {
+        std::vector<Open62541::FileHistoryRecord> records;
+        generate(kind, records);
+        // encode
+        std::string data;
+        std::vector<size_t> offsets;
+        auto start = Clock::now();
+        for (size_t i = 0; i < records.size(); i += Open62541::HISTORY_BLOCK_RECORDS) {
+            offsets.push_back(data.size());
+            Open62541::HistoryBlockEncoder::encode(&records[i],
+                                                   std::min(Open62541::HISTORY_BLOCK_RECORDS, records.size() - i),
+                                                   data);
+        }
+        double encodeTime = std::chrono::duration<double>(Clock::now() - start).count();
+        offsets.push_back(data.size());
+        // decode straight into data values a block at a time
+        std::vector<UA_DataValue> values(Open62541::HISTORY_BLOCK_RECORDS);
+        for (auto& v : values)
+            UA_DataValue_init(&v);
+        size_t decoded = 0;
+        start          = Clock::now();
+        for (size_t b = 0; b + 1 < offsets.size(); b++) {
+            Open62541::HistoryBlockDecoder d(reinterpret_cast<const UA_Byte*>(data.data()) + offsets[b],
+                                             offsets[b + 1] - offsets[b]);
+            size_t n = 0;
+            if (d.decode(0, d.count(), values.data(), nullptr, n) != UA_STATUSCODE_GOOD) {
+                cout << kind << " decode failed" << endl;
+                return 1;
+            }
+            decoded += n;
+        }
+        double decodeTime = std::chrono::duration<double>(Clock::now() - start).count();
+        for (auto& v : values)
+            UA_DataValue_clear(&v);
+        //
+        double perSample = double(data.size()) / double(records.size());
+        cout << kind << ": " << records.size() << " samples " << perSample << " bytes/sample"
+             << " ratio to record " << double(rawSize) / perSample << " ratio to UA_DataValue "
+             << double(dvSize) / perSample << " encode " << double(records.size()) / encodeTime / 1e6 << " M/s"
+             << " decode " << double(decoded) / decodeTime / 1e6 << " M/s" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,431 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef CLIENTCOROUTINE_H
+#define CLIENTCOROUTINE_H
+//
+// Opt in C++20 coroutine support for the client - header only so the library itself stays C++17
+//
+#if (__cplusplus >= 202002L) && defined(__cpp_impl_coroutine)
+#include <open62541cpp/open62541client.h>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace Open62541 {
+
+class ClientExecutor;
+template <typename T = void> class Task;
+
+/*!
+    \brief The TaskPromiseBase struct
+    Tasks start when first awaited and resume the awaiting coroutine when they finish
+*/
+struct TaskPromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename P> std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            std::coroutine_handle<> c = h.promise().continuation;
+            return c ? c : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { error = std::current_exception(); }
+};
+
+/*!
+    \brief The TaskPromise struct
+*/
+template <typename T> struct TaskPromise : TaskPromiseBase {
+    std::optional<T> value;
+    Task<T> get_return_object();
+    void return_value(T v) { value.emplace(std::move(v)); }
+    T result()
+    {
+        if (error)
+            std::rethrow_exception(error);
+        return std::move(*value);
+    }
+};
+
+template <> struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object();
+    void return_void() {}
+    void result()
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
+};
+
+/*!
+    \brief The Task class
+    Coroutine returning T - co_await it from another task or hand it to ClientExecutor::spawn
+*/
+template <typename T> class Task
+{
+public:
+    typedef TaskPromise<T> promise_type;
+    typedef std::coroutine_handle<promise_type> Handle;
+
+private:
+    Handle _h;
+
+public:
+    explicit Task(Handle h = nullptr)
+        : _h(h)
+    {
+    }
+    Task(Task&& t) noexcept
+        : _h(std::exchange(t._h, nullptr))
+    {
+    }
+    Task& operator=(Task&& t) noexcept
+    {
+        if (this != &t) {
+            if (_h)
+                _h.destroy();
+            _h = std::exchange(t._h, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task()
+    {
+        if (_h)
+            _h.destroy();
+    }
+
+    Handle handle() const { return _h; }
+    bool done() const { return !_h || _h.done(); }
+
+    // awaitable
+    bool await_ready() const noexcept { return done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> c) noexcept
+    {
+        _h.promise().continuation = c;
+        return _h;  // start the task
+    }
+    T await_resume() { return _h.promise().result(); }
+};
+
+template <typename T> Task<T> TaskPromise<T>::get_return_object()
+{
+    return Task<T>(Task<T>::Handle::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object()
+{
+    return Task<void>(Task<void>::Handle::from_promise(*this));
+}
+
+/*!
+    \brief The AsyncAwaiter class
+    Awaits the completion of an async client service. The coroutine is resumed by the executor, never from inside
+    the client callback
+*/
+template <typename R> class AsyncAwaiter
+{
+public:
+    typedef std::function<void(R)> Completion;
+    typedef std::function<void(Completion)> Starter;
+
+private:
+    ClientExecutor& _executor;
+    Starter _start;
+    R _result = R();
+
+public:
+    AsyncAwaiter(ClientExecutor& e, Starter s)
+        : _executor(e)
+        , _start(std::move(s))
+    {
+    }
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h);
+    R await_resume() { return std::move(_result); }
+};
+
+/*!
+    \brief The ClientExecutor class
+    Runs many logical workflows on the thread iterating one client. Each workflow is a Task that awaits the async
+    client services - a suspended workflow costs its coroutine frame, not a thread.
+    The executor must be the only thing iterating the client and must outlive the client's outstanding requests.
+
+    \code
+    Task<> poll(ClientExecutor& e, std::vector<NodeId> nodes)
+    {
+        for (;;) {
+            auto values = co_await e.read(nodes);
+            ...
+        }
+    }
+    ClientExecutor e(client);
+    e.spawn(poll(e, nodes));
+    e.run();
+    \endcode
+*/
+class ClientExecutor
+{
+    Client& _client;
+    std::mutex _mutex;
+    std::deque<std::coroutine_handle<>> _ready;  // coroutines to resume
+    std::list<Task<>> _tasks;                   // spawned workflows
+    size_t _failed = 0;
+
+    void sweep()
+    {
+        for (auto i = _tasks.begin(); i != _tasks.end();) {
+            if (i->done()) {
+                if (i->handle().promise().error)
+                    _failed++;
+                i = _tasks.erase(i);
+            }
+            else {
+                ++i;
+            }
+        }
+    }
+
+public:
+    /*!
+        \brief ClientExecutor
+        \param c client driven by the executor
+    */
+    explicit ClientExecutor(Client& c)
+        : _client(c)
+    {
+    }
+    ClientExecutor(const ClientExecutor&) = delete;
+    ClientExecutor& operator=(const ClientExecutor&) = delete;
+
+    /*!
+        \brief client
+        \return the client
+    */
+    Client& client() { return _client; }
+
+    /*!
+        \brief post
+        Queue a coroutine to be resumed on the executor thread - may be called from any thread
+        \param h
+    */
+    void post(std::coroutine_handle<> h)
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        _ready.push_back(h);
+    }
+
+    /*!
+        \brief spawn
+        Start a workflow - it is owned by the executor until it finishes. Exceptions leaving a workflow are counted
+        in failed()
+        \param t
+    */
+    void spawn(Task<> t)
+    {
+        if (t.done())
+            return;
+        post(t.handle());
+        _tasks.push_back(std::move(t));
+    }
+
+    /*!
+        \brief runOnce
+        Resume the coroutines that are ready then iterate the client
+        \param interval longest time to wait for the client in ms - not used if coroutines are ready
+        \return false if the client is not connected
+    */
+    bool runOnce(uint32_t interval = 100)
+    {
+        std::deque<std::coroutine_handle<>> ready;
+        {
+            std::lock_guard<std::mutex> l(_mutex);
+            ready.swap(_ready);
+        }
+        for (auto h : ready)
+            h.resume();
+        if (!ready.empty())
+            sweep();
+        bool idle;
+        {
+            std::lock_guard<std::mutex> l(_mutex);
+            idle = _ready.empty();
+        }
+        return _client.runIterate(idle ? interval : 0);
+    }
+
+    /*!
+        \brief run
+        Run until every spawned workflow has finished or the client disconnects
+        \param interval
+    */
+    void run(uint32_t interval = 100)
+    {
+        while (!_tasks.empty() && runOnce(interval))
+            ;
+    }
+
+    size_t active() const { return _tasks.size(); }  //!< workflows running
+    size_t failed() const { return _failed; }        //!< workflows ended by an exception
+
+    /*!
+        \brief read
+        \param nodeId
+        \return awaitable value of the node
+    */
+    AsyncAwaiter<AsyncResult<Variant>> read(const NodeId& nodeId)
+    {
+        NodeId n = nodeId;
+        return AsyncAwaiter<AsyncResult<Variant>>(*this, [this, n](auto done) {
+            _client.readAsync(n, [done](UA_StatusCode status, const UA_DataValue& v) {
+                AsyncResult<Variant> r;
+                r.status = status;
+                if (v.hasValue)
+                    r.value.assignFrom(v.value);
+                done(r);
+            });
+        });
+    }
+
+    /*!
+        \brief read
+        Read the values of many nodes in one request
+        \param nodes
+        \return awaitable values in the order of the nodes
+    */
+    AsyncAwaiter<std::vector<AsyncResult<Variant>>> read(const std::vector<NodeId>& nodes)
+    {
+        std::vector<NodeId> n = nodes;
+        return AsyncAwaiter<std::vector<AsyncResult<Variant>>>(*this, [this, n](auto done) {
+            UA_ReadRequest* q     = UA_ReadRequest_new();
+            q->timestampsToReturn = UA_TIMESTAMPSTORETURN_BOTH;
+            q->nodesToRead = static_cast<UA_ReadValueId*>(UA_Array_new(n.size(), &UA_TYPES[UA_TYPES_READVALUEID]));
+            q->nodesToReadSize = q->nodesToRead ? n.size() : 0;
+            for (size_t i = 0; i < q->nodesToReadSize; i++) {
+                q->nodesToRead[i].attributeId = UA_ATTRIBUTEID_VALUE;
+                UA_NodeId_copy(n[i].constRef(), &q->nodesToRead[i].nodeId);
+            }
+            size_t k = n.size();
+            _client.asyncRequest(q,
+                                 &UA_TYPES[UA_TYPES_READREQUEST],
+                                 &UA_TYPES[UA_TYPES_READRESPONSE],
+                                 [done, k](UA_StatusCode status, void* response) {
+                                     std::vector<AsyncResult<Variant>> r(k);
+                                     UA_ReadResponse* a = static_cast<UA_ReadResponse*>(response);
+                                     for (size_t i = 0; i < k; i++) {
+                                         if (status != UA_STATUSCODE_GOOD) {
+                                             r[i].status = status;
+                                         }
+                                         else if (i >= a->resultsSize) {
+                                             r[i].status = UA_STATUSCODE_BADUNEXPECTEDERROR;
+                                         }
+                                         else {
+                                             const UA_DataValue& v = a->results[i];
+                                             r[i].status           = v.hasStatus ? v.status : UA_STATUSCODE_GOOD;
+                                             if (v.hasValue)
+                                                 r[i].value.assignFrom(v.value);
+                                         }
+                                     }
+                                     done(r);
+                                 });
+        });
+    }
+
+    /*!
+        \brief write
+        \param nodeId
+        \param value
+        \return awaitable status of the write
+    */
+    AsyncAwaiter<UA_StatusCode> write(const NodeId& nodeId, const Variant& value)
+    {
+        NodeId n  = nodeId;
+        Variant v = value;
+        return AsyncAwaiter<UA_StatusCode>(*this, [this, n, v](auto done) { _client.writeAsync(n, v, done); });
+    }
+
+    /*!
+        \brief call
+        \param objectId
+        \param methodId
+        \param in input arguments - copied
+        \return awaitable method result
+    */
+    AsyncAwaiter<AsyncResult<CallMethodResult>> call(const NodeId& objectId,
+                                                     const NodeId& methodId,
+                                                     const VariantList& in)
+    {
+        NodeId o = objectId;
+        NodeId m = methodId;
+        // a VariantList is shallow - the awaiter holds deep copies so temporaries may be passed
+        std::shared_ptr<VariantList> a(new VariantList(in.size()), [](VariantList* l) {
+            for (auto& v : *l)
+                UA_Variant_clear(&v);
+            delete l;
+        });
+        for (size_t i = 0; i < in.size(); i++)
+            UA_Variant_copy(&in[i], &(*a)[i]);
+        return AsyncAwaiter<AsyncResult<CallMethodResult>>(*this, [this, o, m, a](auto done) {
+            _client.callAsync(o, m, *a, [done](UA_StatusCode status, const UA_CallMethodResult& c) {
+                AsyncResult<CallMethodResult> r;
+                r.status = status;
+                r.value.assignFrom(c);
+                done(r);
+            });
+        });
+    }
+
+    /*!
+        \brief browse
+        \param nodeId
+        \return awaitable browse result
+    */
+    AsyncAwaiter<AsyncResult<BrowseResult>> browse(const NodeId& nodeId)
+    {
+        NodeId n = nodeId;
+        return AsyncAwaiter<AsyncResult<BrowseResult>>(*this, [this, n](auto done) {
+            _client.browseAsync(n, [done](UA_StatusCode status, const UA_BrowseResult& b) {
+                AsyncResult<BrowseResult> r;
+                r.status = status;
+                r.value.assignFrom(b);
+                done(r);
+            });
+        });
+    }
+};
+
+template <typename R> void AsyncAwaiter<R>::await_suspend(std::coroutine_handle<> h)
+{
+    // the request is sent when the coroutine suspends - completion may come at once if it cannot be sent
+    _start([this, h](R r) {
+        _result = std::move(r);
+        _executor.post(h);
+    });
+}
+
+}  // namespace Open62541
+
+#endif
+#endif  // CLIENTCOROUTINE_H
@@ -15,6 +15,8 @@
 #include <open62541cpp/monitoreditem.h>
 namespace Open62541 {
 
+class NotificationDispatcher;
+
 /*!
     \brief The ClientSubscription class
     Encapsulates a client subscription
@@ -26,12 +28,33 @@ typedef std::map<unsigned, MonitoredItemRef> MonitoredItemMap;
 
 class UA_EXPORT ClientSubscription
 {
+public:
+    /*!
+        \brief The Statistics struct
+        Notifications seen in one measuring window - kept only while enabled with setStatistics
+    */
+    struct Statistics {
+        size_t notifications = 0;  // data changes and events
+        size_t overflows     = 0;  // data changes flagged as overflowing the queue of their item
+        size_t statusChanges = 0;  // status change notifications
+        UA_Double latency    = 0;  // summed delay from source timestamp to arrival in ms
+        UA_Double maxLatency = 0;
+        size_t latencyCount  = 0;  // data changes with a timestamp
+        UA_DateTime start    = 0;  // start of the window
+        UA_Double meanLatency() const { return latencyCount ? (latency / latencyCount) : 0; }
+    };
+
+private:
     Client& _client;  // owning client
     CreateSubscriptionRequest _settings;
     CreateSubscriptionResponse _response;
     //
     int _monitorId = 0;     // key monitor items by Id
     MonitoredItemMap _map;  // map of monitor items - these are monitored items owned by this subscription
+    NotificationDispatcher* _dispatcher = nullptr;  // runs item handlers off the client thread
+    bool _statistics                    = false;
+    Statistics _stats;
+    bool _modifying = false;  // modify request in flight
     //
 protected:
     UA_StatusCode _lastError = 0;
@@ -52,6 +75,13 @@ protected:
                                                  void* subscriptionContext,
                                                  UA_StatusChangeNotification* notification);
 
+    /*!
+        \brief recreateCallback
+        \param userdata
+        \param response
+    */
+    static void recreateCallback(UA_Client* client, void* userdata, UA_UInt32 requestId, void* response);
+
 public:
     /*!
         \brief ClientSubscription
@@ -81,6 +111,118 @@ public:
     */
     UA_UInt32 id() { return _response.get().subscriptionId; }
 
+    /*!
+        \brief setDispatcher
+        Run the handlers of this subscription's monitored items on a worker pool
+        \param d dispatcher - not owned, null to run handlers on the thread iterating the client
+    */
+    void setDispatcher(NotificationDispatcher* d) { _dispatcher = d; }
+
+    /*!
+        \brief dispatcher
+        \return the dispatcher or null
+    */
+    NotificationDispatcher* dispatcher() const { return _dispatcher; }
+
+    /*!
+        \brief setStatistics
+        Count notifications, queue overflows and latency - the counters start a new window
+        \param on
+    */
+    void setStatistics(bool on)
+    {
+        _statistics  = on;
+        _stats       = Statistics();
+        _stats.start = UA_DateTime_now();
+    }
+
+    /*!
+        \brief statisticsEnabled
+        \return true if statistics are kept
+    */
+    bool statisticsEnabled() const { return _statistics; }
+
+    /*!
+        \brief statistics
+        \return the counters of the current window
+    */
+    const Statistics& statistics() const { return _stats; }
+
+    /*!
+        \brief takeStatistics
+        Called on the thread iterating the client
+        \return the counters of the current window - a new window is started
+    */
+    Statistics takeStatistics()
+    {
+        Statistics r = _stats;
+        _stats       = Statistics();
+        _stats.start = UA_DateTime_now();
+        return r;
+    }
+
+    /*!
+        \brief noteDataChange
+        Update the statistics for a data change - called on the thread iterating the client
+        \param value
+    */
+    void noteDataChange(const UA_DataValue* value);
+
+    /*!
+        \brief noteEvent
+        Update the statistics for an event - called on the thread iterating the client
+    */
+    void noteEvent()
+    {
+        if (_statistics)
+            _stats.notifications++;
+    }
+
+    /*!
+        \brief modify
+        Change the publishing interval and notification limit of the subscription. The request is sent
+        asynchronously so it may be made from a client callback or timer - the revised values are stored in
+        response() and settings() when the server accepts it, and a new statistics window is started. The keep alive
+        and lifetime periods are kept by rescaling their counts.
+        \param publishingInterval in ms
+        \param maxNotificationsPerPublish 0 for no limit
+        \return false if the subscription has not been created or a modify request is already in flight
+    */
+    bool modify(UA_Double publishingInterval, UA_UInt32 maxNotificationsPerPublish);
+
+    /*!
+        \brief modifying
+        \return true while a modify request is in flight
+    */
+    bool modifying() const { return _modifying; }
+
+    /*!
+        \brief detach
+        Forget the server's subscription and items without deleting them - used when the session holding them has
+        been lost. The settings and monitored item objects are kept so they can be created again.
+    */
+    void detach();
+
+    /*!
+        \brief recreate
+        Create the subscription and its monitored items again on the current session - asynchronously, so it may be
+        called from a client callback. Items are created in bulk requests grouped by kind and timestamps. The item
+        objects and their ids in this subscription are kept, so existing handlers keep working.
+        \param batch most items in one request
+        \param created called when the subscription has been created or has failed - with the service result
+        \param done called when every item request has completed - with the number of items created and failed
+        \return false if the subscription request could not be sent - no callback is made
+    */
+    bool recreate(size_t batch,
+                  std::function<void(UA_StatusCode)> created,
+                  std::function<void(size_t items, size_t failed)> done);
+
+    /*!
+        \brief monitorItems
+        \return the monitored items of the subscription
+    */
+    MonitoredItemMap& monitorItems() { return _map; }
+
     /*!
         \brief deleteSubscriptionCallback
     */
@@ -160,6 +302,59 @@ public:
         return ret;  // returns item id
     }
 
+    /*!
+        \brief Open62541::ClientSubscription::addMonitorNodeId
+        \param f functor to handle item update
+        \param n node id
+        \param p monitoring parameters - sampling, queue and deadband
+    */
+    template <typename T = Open62541::MonitoredItemDataChange>
+    unsigned addMonitorNodeId(monitorItemFunc f, NodeId& n, const MonitoringParameters& p)
+    {
+        unsigned ret = 0;
+        auto pdc     = new T(f, *this);
+        if (pdc->addDataChange(n, p)) {
+            Open62541::MonitoredItemRef mcd(pdc);
+            ret = addMonitorItem(mcd);
+        }
+        else {
+            delete pdc;
+        }
+        return ret;
+    }
+
+    /*!
+        \brief Open62541::ClientSubscription::addMonitorNodeIds
+        Monitor many nodes with one request
+        \param f functor to handle item updates
+        \param nodes node ids
+        \param p monitoring parameters of every item
+        \param ids receives the item id of each node, 0 if the item could not be created
+        \return number of items created
+    */
+    template <typename T = Open62541::MonitoredItemDataChange>
+    size_t addMonitorNodeIds(monitorItemFunc f,
+                             const std::vector<NodeId>& nodes,
+                             const MonitoringParameters& p,
+                             std::vector<unsigned>& ids)
+    {
+        std::vector<std::unique_ptr<T>> items;
+        std::vector<MonitoredItemDataChange*> pointers;
+        for (size_t i = 0; i < nodes.size(); i++) {
+            items.emplace_back(new T(f, *this));
+            pointers.push_back(items.back().get());
+        }
+        size_t ret = MonitoredItemDataChange::addDataChanges(*this, pointers, nodes, p);
+        ids.assign(nodes.size(), 0);
+        for (size_t i = 0; i < items.size(); i++) {
+            if (items[i]->lastError() == UA_STATUSCODE_GOOD) {
+                Open62541::MonitoredItemRef mcd(items[i].release());
+                ids[i] = addMonitorItem(mcd);
+            }
+        }
+        return ret;
+    }
+
     /*!
         \brief Open62541::ClientSubscription::addEventMonitor
         \param f event handler functor
@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef CREDENTIALSTORE_H
+#define CREDENTIALSTORE_H
+#include <open62541cpp/open62541objects.h>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace Open62541 {
+
+class Server;
+
+/*!
+    \brief The Credential struct
+    Salted PBKDF2-HMAC-SHA256 password hash
+*/
+struct Credential {
+    std::string salt;        //!< raw salt bytes
+    std::string hash;        //!< raw derived key
+    UA_UInt32 iterations = 0;
+    UA_UInt64 roles      = 0;  //!< optional role bitmask carried with the identity
+};
+
+/*!
+    \brief The CredentialStore class
+    User name / password store for large numbers of identities. Lookup is by hash table, passwords are stored
+    salted and hashed, and the store can be reloaded from its file while the server runs.
+
+    File format - one identity per line, # starts a comment
+        name:pbkdf2-sha256:iterations:salt-hex:hash-hex[:roles]
+        name:plain:password[:roles]     provisioning entry - hashed when loaded, save() writes it hashed
+
+    Hashing plain entries on load is spread over worker threads and a reload runs on its own thread, so neither
+    holds up the server thread. A successful verification is remembered in a bounded LRU cache as a keyed digest of
+    the password, tied to the salt and hash it was checked against, so a burst of reconnecting devices does not pay
+    the full key derivation on the server thread each time. Misses pay it - unknown users are checked against a
+    dummy credential with the store's iteration count so the time taken does not tell whether an account exists.
+*/
+class UA_EXPORT CredentialStore
+{
+public:
+    typedef std::unordered_map<std::string, Credential> CredentialMap;
+    static const UA_UInt32 DEFAULT_ITERATIONS = 10000;
+    static const size_t DEFAULT_CACHE_SIZE    = 4096;
+
+private:
+    std::shared_ptr<const CredentialMap> _map;  // current map - replaced as a whole on reload or change
+    mutable std::mutex _mutex;                  // guards _map swap and writers
+    std::mutex _fileMutex;  // guards _fileName and _modified - read by the loader thread
+    std::string _fileName;
+    time_t _modified = 0;
+    //
+    struct Verified {
+        std::string salt;    // credential the password was checked against
+        std::string hash;
+        std::string digest;  // keyed digest of the password
+        std::list<std::string>::iterator use;
+    };
+    std::mutex _cacheMutex;
+    std::unordered_map<std::string, Verified> _cache;  // user to last verified password
+    std::list<std::string> _uses;                      // users most recently verified first
+    size_t _cacheSize = DEFAULT_CACHE_SIZE;
+    const std::string _cacheKey;                       // random key of the digests - not derivable from the file
+    std::thread _loader;
+    std::atomic<bool> _loading{false};
+    UA_UInt32 _iterations = DEFAULT_ITERATIONS;
+    unsigned _workers     = 0;  // 0 = hardware concurrency
+    Server* _server       = nullptr;  // server the watch timer is on
+    UA_UInt64 _timerId    = 0;
+
+    std::shared_ptr<const CredentialMap> current() const
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        return _map;
+    }
+    void replace(std::shared_ptr<const CredentialMap> m);
+    bool parse(const std::string& fileName, CredentialMap& m);
+    std::string digest(const std::string& salt, const std::string& password) const;
+
+public:
+    /*!
+        \brief CredentialStore
+        \param iterations key derivation iterations for new passwords
+    */
+    CredentialStore(UA_UInt32 iterations = DEFAULT_ITERATIONS)
+        : _map(std::make_shared<CredentialMap>())
+        , _cacheKey(makeSalt())
+        , _iterations(iterations)
+    {
+    }
+    CredentialStore(const CredentialStore&) = delete;
+    CredentialStore& operator=(const CredentialStore&) = delete;
+
+    /*!
+        \brief ~CredentialStore
+    */
+    virtual ~CredentialStore();
+
+    /*!
+        \brief hashPassword
+        \param password
+        \param salt raw salt
+        \param iterations
+        \return raw PBKDF2-HMAC-SHA256 derived key (32 bytes)
+    */
+    static std::string hashPassword(const std::string& password, const std::string& salt, UA_UInt32 iterations);
+
+    /*!
+        \brief makeSalt
+        \return 16 random bytes
+    */
+    static std::string makeSalt();
+
+    /*!
+        \brief setWorkers
+        \param n number of threads used to hash plain entries on load - 0 uses the hardware concurrency
+    */
+    void setWorkers(unsigned n) { _workers = n; }
+
+    /*!
+        \brief setCacheSize
+        \param n most users whose last verified password is remembered - 0 derives every time
+    */
+    void setCacheSize(size_t n);
+
+    /*!
+        \brief add
+        Add or replace an identity
+        \param user
+        \param password
+        \param roles
+        \return true on success
+    */
+    bool add(const std::string& user, const std::string& password, UA_UInt64 roles = 0);
+
+    /*!
+        \brief remove
+        \param user
+        \return true if removed
+    */
+    bool remove(const std::string& user);
+
+    /*!
+        \brief find
+        \param user
+        \param c credential
+        \return true if found
+    */
+    bool find(const std::string& user, Credential& c) const;
+
+    /*!
+        \brief verify
+        \param user
+        \param password
+        \return true if the password matches
+    */
+    bool verify(const std::string& user, const std::string& password);
+
+    /*!
+        \brief verify
+        \param user
+        \param password
+        \return true if the password matches
+    */
+    bool verify(const UA_String& user, const UA_ByteString& password)
+    {
+        return verify(std::string((const char*)(user.data), user.length),
+                      std::string((const char*)(password.data), password.length));
+    }
+
+    /*!
+        \brief size
+        \return number of identities
+    */
+    size_t size() const { return current()->size(); }
+
+    /*!
+        \brief load
+        Load the file replacing the current identities - plain entries are hashed by the worker threads
+        \param fileName
+        \return true on success
+    */
+    bool load(const std::string& fileName);
+
+    /*!
+        \brief save
+        \param fileName - empty for the file last loaded
+        \return true on success
+    */
+    bool save(const std::string& fileName = "");
+
+    /*!
+        \brief reloadIfChanged
+        Start a background reload if the file has been modified since it was loaded
+        \return true if a reload was started
+    */
+    bool reloadIfChanged();
+
+    /*!
+        \brief loading
+        \return true while a background reload is running
+    */
+    bool loading() const { return _loading; }
+
+    /*!
+        \brief watch
+        Check the file for changes from a server timer
+        \param server
+        \param interval_ms
+        \return true on success
+    */
+    bool watch(Server& server, UA_Double interval_ms = 5000);
+};
+
+}  // namespace Open62541
+
+#endif  // CREDENTIALSTORE_H
@@ -0,0 +1,362 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef FILEHISTORYBACKEND_H
+#define FILEHISTORYBACKEND_H
+#include <open62541cpp/historydatabase.h>
+#include <atomic>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+
+namespace Open62541 {
+
+class Server;
+
+const UA_UInt32 FILE_HISTORY_MAGIC      = 0x48363235;  // "526H"
+const UA_UInt32 FILE_HISTORY_COMPRESSED_MAGIC = 0x43363235;  // "526C"
+const UA_UInt32 FILE_HISTORY_VERSION    = 1;
+const size_t FILE_HISTORY_VALUE_SIZE    = 8;
+const size_t FILE_HISTORY_INDEX_STRIDE  = 256;  // one sparse index entry per this many records
+
+/*!
+    \brief The FileHistorySegmentHeader struct
+    Start of every segment file
+*/
+struct FileHistorySegmentHeader {
+    UA_UInt32 magic;
+    UA_UInt32 version;
+    UA_UInt32 recordSize;
+    UA_UInt32 capacity;  //!< records per segment
+    UA_UInt64 first;     //!< index of the first record in the segment
+    UA_Byte reserved[40];
+};
+
+/*!
+    \brief The FileHistoryCompressedHeader struct
+    Start of every compressed segment file - followed by the block directory and the blocks
+*/
+struct FileHistoryCompressedHeader {
+    UA_UInt32 magic;
+    UA_UInt32 version;
+    UA_UInt32 blockRecords;  //!< records per block - the last block may hold fewer
+    UA_UInt32 blockCount;
+    UA_UInt64 first;         //!< index of the first record in the segment
+    UA_UInt64 count;         //!< records in the segment
+    UA_Byte reserved[32];
+};
+
+/*!
+    \brief The FileHistoryBlockEntry struct
+    Block directory entry of a compressed segment
+*/
+struct FileHistoryBlockEntry {
+    UA_UInt64 offset;  //!< from the start of the file
+    UA_UInt32 size;
+    UA_UInt32 count;
+    UA_DateTime firstTime;
+    UA_DateTime lastTime;
+};
+
+/*!
+    \brief The FileHistoryRecord struct
+    Fixed size record as stored in a segment file. Scalar values of pointer free types up to 8 bytes are stored.
+*/
+struct FileHistoryRecord {
+    enum {
+        HasValue           = 0x01,
+        HasStatus          = 0x02,
+        HasSourceTimestamp = 0x04,
+        HasServerTimestamp = 0x08
+    };
+    UA_DateTime timestamp;        //!< source timestamp or server timestamp if there is no source - the key
+    UA_DateTime serverTimestamp;
+    UA_StatusCode status;
+    UA_UInt16 typeIndex;
+    UA_UInt16 flags;
+    UA_Byte value[FILE_HISTORY_VALUE_SIZE];
+};
+
+/*!
+    \brief The FileHistoryBackend class
+    Persistent history storage. Each node has its own directory of append-only segment files of fixed size records.
+    Appends are buffered per node and written in blocks, segments are read through read only memory maps and a
+    sparse time index per segment makes getDateTimeMatch a binary search.
+    Samples must arrive in time order for a node - earlier samples are rejected.
+*/
+class UA_EXPORT FileHistoryBackend : public HistoryDataBackend
+{
+public:
+    static const size_t DEFAULT_SEGMENT_RECORDS = 1 << 20;
+    static const size_t DEFAULT_BUFFER_RECORDS  = 4096;
+
+protected:
+    struct Segment {
+        UA_UInt64 first  = 0;   // index of the first record
+        size_t capacity  = 0;   // records the segment can hold
+        size_t written   = 0;   // records in the file
+        size_t pending   = 0;   // records in the node buffer
+        int fd           = -1;
+        void* map        = nullptr;
+        size_t mapSize   = 0;
+        bool compressed  = false;   // sealed and held as compressed blocks
+        size_t stride    = FILE_HISTORY_INDEX_STRIDE;  // records per index entry - the block size if compressed
+        const FileHistoryBlockEntry* blocks = nullptr;
+        UA_DateTime firstTime = 0;
+        UA_DateTime lastTime  = 0;
+        std::vector<UA_DateTime> index;  // timestamp of every FILE_HISTORY_INDEX_STRIDE'th record
+        std::string path;
+        size_t count() const { return written + pending; }
+        const FileHistoryRecord* records() const
+        {
+            return reinterpret_cast<const FileHistoryRecord*>(static_cast<const char*>(map) +
+                                                              sizeof(FileHistorySegmentHeader));
+        }
+    };
+    typedef std::unique_ptr<Segment> SegmentPtr;
+
+    struct NodeStore {
+        std::mutex mutex;
+        std::string dir;
+        bool opened = false;                      // directory scanned
+        std::deque<SegmentPtr> segments;          // oldest first
+        std::vector<FileHistoryRecord> buffer;    // pending records of the last segment
+        UA_DateTime lastTime = std::numeric_limits<UA_DateTime>::min();
+        UA_DataValue scratch;                     // value returned by getDataValue
+        const Segment* cacheSegment = nullptr;    // last decoded block
+        size_t cacheBlock           = 0;
+        std::vector<FileHistoryRecord> cache;
+        NodeStore() { UA_DataValue_init(&scratch); }
+        ~NodeStore() { UA_DataValue_clear(&scratch); }
+        UA_UInt64 first() const { return segments.empty() ? 0 : segments.front()->first; }
+        UA_UInt64 end() const { return segments.empty() ? 0 : segments.back()->first + segments.back()->count(); }
+    };
+    typedef std::unique_ptr<NodeStore> NodeStorePtr;
+
+private:
+    std::string _directory;
+    size_t _segmentRecords = DEFAULT_SEGMENT_RECORDS;
+    size_t _bufferRecords  = DEFAULT_BUFFER_RECORDS;
+    ReadWriteMutex _nodesMutex;
+    std::unordered_map<NodeId, NodeStorePtr, NodeIdHash, NodeIdEqual> _nodes;
+    std::atomic<size_t> _samples{0};
+    std::atomic<size_t> _rejected{0};
+    UA_UInt64 _timerId = 0;
+    std::atomic<UA_StatusCode> _lastError{UA_STATUSCODE_GOOD};  // set by concurrent readers
+
+    std::string nodeDirectory(const NodeId& n) const;
+    bool openNode(NodeStore& n);
+    bool openSegment(Segment& s, bool create);
+    bool openCompressed(Segment& s);
+    bool compressSegment(NodeStore& n, size_t i);
+    void closeSegment(Segment& s);
+    bool newSegment(NodeStore& n);
+    bool flushNode(NodeStore& n, bool sync);
+    UA_UInt64 lowerBound(NodeStore& n, UA_DateTime t, bool after);
+
+protected:
+    NodeStore* node(const NodeId& n, bool create = true);
+    Segment* segment(NodeStore& n, UA_UInt64 index) const;
+    const FileHistoryRecord* record(NodeStore& n, UA_UInt64 index);
+    const FileHistoryRecord* decodeBlock(NodeStore& n, const Segment& s, size_t block);
+    UA_StatusCode append(NodeStore& n, const FileHistoryRecord& r);
+
+public:
+    /*!
+        \brief FileHistoryBackend
+        \param directory root directory - created if it does not exist
+        \param segmentRecords records per segment file
+        \param bufferRecords records buffered per node before they are written
+    */
+    FileHistoryBackend(const std::string& directory,
+                       size_t segmentRecords = DEFAULT_SEGMENT_RECORDS,
+                       size_t bufferRecords  = DEFAULT_BUFFER_RECORDS);
+    FileHistoryBackend(const FileHistoryBackend&) = delete;
+    FileHistoryBackend& operator=(const FileHistoryBackend&) = delete;
+
+    /*!
+        \brief ~FileHistoryBackend
+    */
+    virtual ~FileHistoryBackend();
+
+    /*!
+        \brief directory
+        \return root directory
+    */
+    const std::string& directory() const { return _directory; }
+
+    /*!
+        \brief toRecord
+        \param v
+        \param r
+        \return UA_STATUSCODE_GOOD or the reason the value cannot be stored
+    */
+    static UA_StatusCode toRecord(const UA_DataValue& v, FileHistoryRecord& r);
+
+    /*!
+        \brief toDataValue
+        \param r
+        \param v destination - must be initialised or cleared
+        \param range numeric range - not applicable to the stored scalars
+        \return UA_STATUSCODE_GOOD on success
+    */
+    static UA_StatusCode toDataValue(const FileHistoryRecord& r, UA_DataValue& v, const UA_NumericRange* range = nullptr);
+
+    /*!
+        \brief add
+        Append a value to the history of a node
+        \param n
+        \param v
+        \return UA_STATUSCODE_GOOD on success
+    */
+    UA_StatusCode add(const NodeId& n, const UA_DataValue& v);
+
+    /*!
+        \brief flush
+        Write buffered records of every node
+        \param sync if true wait for the data to reach the disk
+        \return true on success
+    */
+    bool flush(bool sync = false);
+
+    /*!
+        \brief setFlushInterval
+        Flush from a server timer so buffered samples reach the files within the interval
+        \param server
+        \param interval_ms
+        \return true on success
+    */
+    bool setFlushInterval(Server& server, UA_Double interval_ms = 1000);
+
+    /*!
+        \brief compact
+        Compress sealed segments into blocks of delta of delta timestamps and XOR encoded values.
+        Each node is locked while one of its segments is compressed - call from a timer or a worker thread.
+        \param maxSegments maximum number of segments to compress
+        \return number of segments compressed
+    */
+    size_t compact(size_t maxSegments = SIZE_MAX);
+
+    /*!
+        \brief close
+        Flush and close every node
+    */
+    void close();
+
+    /*!
+        \brief samples
+        \return number of samples stored since construction
+    */
+    size_t samples() const { return _samples; }
+
+    /*!
+        \brief rejected
+        \return number of samples rejected since construction
+    */
+    size_t rejected() const { return _rejected; }
+
+    /*!
+        \brief lastError
+        \return last file error as a status code
+    */
+    UA_StatusCode lastError() const { return _lastError; }
+
+    /*!
+        \brief lastOK
+        \return true if the last file operation succeeded
+    */
+    bool lastOK() const { return _lastError == UA_STATUSCODE_GOOD; }
+
+    // HistoryDataBackend
+    void deleteMembers() override { close(); }
+    UA_StatusCode serverSetHistoryData(Context& c, bool historizing, const UA_DataValue* value) override;
+    size_t getDateTimeMatch(Context& c, const UA_DateTime timestamp, const MatchStrategy strategy) override;
+    size_t getEnd(Context& c) override;
+    size_t lastIndex(Context& c) override;
+    size_t firstIndex(Context& c) override;
+    size_t resultSize(Context& c, size_t startIndex, size_t endIndex) override;
+    UA_StatusCode copyDataValues(Context& c,
+                                 size_t startIndex,
+                                 size_t endIndex,
+                                 UA_Boolean reverse,
+                                 size_t valueSize,
+                                 UA_NumericRange range,
+                                 UA_Boolean releaseContinuationPoints,
+                                 std::string& in,
+                                 std::string& out,
+                                 size_t* providedValues,
+                                 UA_DataValue* values) override;
+    const UA_DataValue* getDataValue(Context& c, size_t index) override;
+    size_t readSamples(Context& c,
+                       size_t startIndex,
+                       size_t n,
+                       UA_DateTime* times,
+                       UA_Double* values,
+                       UA_Byte* good) override;
+    size_t appendRecords(const NodeId& n, const FileHistoryRecord* r, size_t count) override;
+    bool readRecords(const NodeId& n,
+                     UA_DateTime start,
+                     UA_DateTime end,
+                     const std::function<bool(const FileHistoryRecord*, size_t)>& f) override;
+    UA_Boolean boundSupported(Context& /*c*/) override { return UA_TRUE; }
+    UA_Boolean timestampsToReturnSupported(Context& /*c*/, const UA_TimestampsToReturn /*timestampsToReturn*/) override
+    {
+        return UA_TRUE;
+    }
+    UA_StatusCode insertDataValue(Context& c, const UA_DataValue* value) override;
+    UA_StatusCode replaceDataValue(Context& /*c*/, const UA_DataValue* /*value*/) override
+    {
+        return UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;  // append only
+    }
+    UA_StatusCode updateDataValue(Context& /*c*/, const UA_DataValue* /*value*/) override
+    {
+        return UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+    }
+    UA_StatusCode removeDataValue(Context& c, UA_DateTime startTimestamp, UA_DateTime endTimestamp) override;
+};
+
+/*!
+    \brief The FileHistorian class
+    Historian using the default gathering and database with a FileHistoryBackend
+*/
+class UA_EXPORT FileHistorian : public Historian
+{
+    FileHistoryBackend _store;
+
+public:
+    /*!
+        \brief FileHistorian
+        \param directory
+        \param numberNodes initial number of nodes for the gathering
+    */
+    FileHistorian(const std::string& directory, size_t numberNodes = 100)
+        : _store(directory)
+    {
+        gathering() = UA_HistoryDataGathering_Default(numberNodes);
+        database()  = UA_HistoryDatabase_default(gathering());
+        backend()   = _store.database();
+    }
+    ~FileHistorian()
+    {
+        _backend.context = nullptr;  // not the memory backend - the store cleans up
+    }
+
+    /*!
+        \brief store
+        \return the file backend
+    */
+    FileHistoryBackend& store() { return _store; }
+};
+
+}  // namespace Open62541
+
+#endif  // FILEHISTORYBACKEND_H
@@ -0,0 +1,449 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef HISTORYAGGREGATES_H
+#define HISTORYAGGREGATES_H
+#include <open62541cpp/historydatabase.h>
+#include <mutex>
+#include <unordered_map>
+
+namespace Open62541 {
+
+/*!
+    \brief The HistoryAggregate class
+    Calculates one aggregate over the processing intervals of a ReadProcessed request.
+    Samples are fed in time order as blocks of contiguous time and value arrays. The kernels are plain loops over
+    the arrays with independent accumulators so the compiler can vectorise them.
+*/
+class UA_EXPORT HistoryAggregate
+{
+public:
+    /*!
+        \brief The Type enum
+        The supported standard aggregates
+    */
+    enum Type { Unsupported = 0, Interpolative, Average, TimeAverage, Minimum, Maximum, Range, Count };
+
+    // historian bits of the status of a processed value
+    static const UA_StatusCode Calculated   = 0x00000401;
+    static const UA_StatusCode Interpolated = 0x00000402;
+    static const UA_StatusCode Partial      = 0x00000004;
+
+    struct Sample {
+        UA_DateTime time = 0;
+        UA_Double value  = 0.0;
+    };
+
+    struct Result {
+        UA_DateTime time     = 0;  //!< start of the interval or the requested time
+        UA_Double value      = 0.0;
+        UA_StatusCode status = UA_STATUSCODE_BADNODATA;
+    };
+
+private:
+    Type _type;
+    UA_DateTime _start;
+    UA_DateTime _end;
+    UA_DateTime _interval;
+    size_t _current = 0;
+    std::vector<Result> _results;
+    // the last good sample before the current interval
+    bool _hasPrevious = false;
+    Sample _previous;
+    // good samples of the current interval
+    size_t _count       = 0;
+    UA_Double _sum      = 0.0;
+    UA_Double _minimum  = 0.0;
+    UA_Double _maximum  = 0.0;
+    UA_Double _area     = 0.0;  // value * ticks between the first and last sample
+    Sample _first;
+    Sample _last;
+
+    void accumulate(const UA_DateTime* t, const UA_Double* v, size_t n);
+    void close(const Sample* next);
+
+public:
+    /*!
+        \brief HistoryAggregate
+        \param type
+        \param start start of the first interval - before end
+        \param end end of the last interval
+        \param interval length of each interval - the last may be shorter
+    */
+    HistoryAggregate(Type type, UA_DateTime start, UA_DateTime end, UA_DateTime interval);
+
+    /*!
+        \brief type
+        \param aggregate node id of an aggregate function
+        \return the aggregate type or Unsupported
+    */
+    static Type type(const UA_NodeId& aggregate);
+
+    /*!
+        \brief intervals
+        \return number of intervals in start to end
+    */
+    static size_t intervals(UA_DateTime start, UA_DateTime end, UA_DateTime interval);
+
+    /*!
+        \brief done
+        \return true once every interval is closed - no more samples are needed
+    */
+    bool done() const { return _current >= _results.size(); }
+
+    /*!
+        \brief add
+        \param t sample times - ascending
+        \param v sample values
+        \param n number of samples - all good
+    */
+    void add(const UA_DateTime* t, const UA_Double* v, size_t n);
+
+    /*!
+        \brief finish
+        Close the remaining intervals - there is no more data
+    */
+    void finish();
+
+    /*!
+        \brief results
+        \return one result per interval
+    */
+    const std::vector<Result>& results() const { return _results; }
+
+    // kernels
+    static UA_Double sum(const UA_Double* v, size_t n);
+    static void minMax(const UA_Double* v, size_t n, UA_Double& minimum, UA_Double& maximum);
+    static UA_Double area(const UA_DateTime* t, const UA_Double* v, size_t n);
+    static UA_Double interpolate(const Sample& a, const Sample& b, UA_DateTime t);
+
+    /*!
+        \brief compact
+        Move the good samples to the front of the arrays - can be done in place
+        \return number of good samples
+    */
+    static size_t compact(const UA_DateTime* t,
+                          const UA_Double* v,
+                          const UA_Byte* good,
+                          size_t n,
+                          UA_DateTime* outTimes,
+                          UA_Double* outValues);
+
+    /*!
+        \brief toDouble
+        \param typeIndex index in UA_TYPES
+        \param data scalar
+        \param d
+        \return true if the type is numeric
+    */
+    static bool toDouble(size_t typeIndex, const void* data, UA_Double& d);
+
+    /*!
+        \brief toDouble
+        \param v
+        \param d
+        \return true if v is a numeric scalar
+    */
+    static bool toDouble(const UA_Variant& v, UA_Double& d);
+};
+
+/*!
+    \brief The HistoryAtTime class
+    Values of a node at a set of requested times. The times are sorted once and matched against the raw samples in
+    a single merge pass - each sample is looked at once however many times are requested.
+*/
+class UA_EXPORT HistoryAtTime
+{
+    std::vector<UA_DateTime> _times;  // as requested
+    std::vector<size_t> _order;       // indexes of _times in ascending time
+    size_t _position = 0;             // next entry of _order to resolve
+    bool _stepped;
+    bool _simpleBounds;
+    bool _hasPrevious = false;
+    HistoryAggregate::Sample _previous;
+    bool _previousGood = false;
+    bool _hasGood      = false;  // simple bounds - the last good sample before the requested time
+    HistoryAggregate::Sample _good;
+    std::vector<HistoryAggregate::Result> _results;
+
+    void resolve(const HistoryAggregate::Sample* next, bool nextGood);
+
+public:
+    /*!
+        \brief HistoryAtTime
+        \param times requested times - any order
+        \param n number of times
+        \param stepped hold the earlier value instead of interpolating
+        \param simpleBounds bounds are the nearest samples whatever their status - otherwise the nearest good samples.
+        A value with a bad simple bound comes from the nearest good samples and is Uncertain
+    */
+    HistoryAtTime(const UA_DateTime* times, size_t n, bool stepped, bool simpleBounds);
+
+    /*!
+        \brief done
+        \return true once every requested time has a value
+    */
+    bool done() const { return _position >= _order.size(); }
+
+    /*!
+        \brief next
+        \return the earliest requested time without a value
+    */
+    UA_DateTime next() const { return done() ? 0 : _times[_order[_position]]; }
+
+    /*!
+        \brief add
+        \param t sample times - ascending
+        \param v sample values
+        \param good non zero for good samples
+        \param n
+    */
+    void add(const UA_DateTime* t, const UA_Double* v, const UA_Byte* good, size_t n);
+
+    /*!
+        \brief finish
+        Resolve the remaining times - there is no more data
+    */
+    void finish();
+
+    /*!
+        \brief results
+        \return one result per requested time in request order
+    */
+    const std::vector<HistoryAggregate::Result>& results() const { return _results; }
+};
+
+/*!
+    \brief The HistorySampleReader class
+    Reads the values of a node from a history backend in blocks of times, values and good flags.
+    Backends set up by HistoryDataBackend::initialise() are asked for block reads first, anything else is read
+    through copyDataValues.
+*/
+class UA_EXPORT HistorySampleReader
+{
+    UA_Server* _server;
+    const UA_NodeId* _sessionId;
+    void* _sessionContext;
+    const UA_NodeId* _nodeId;
+    UA_HistoryDataBackend _backend;
+    HistoryDataBackend* _native = nullptr;
+    std::unique_ptr<HistoryDataBackend::Context> _context;
+    bool _block = true;  // native block reads work
+    bool _end   = true;
+    size_t _next = 0;
+    size_t _last = 0;
+    std::string _continuation;  // position of copyDataValues after _next
+    std::vector<UA_DataValue> _values;
+
+public:
+    /*!
+        \brief HistorySampleReader
+        \param server
+        \param sessionId
+        \param sessionContext
+        \param nodeId must outlive the reader
+        \param backend
+    */
+    HistorySampleReader(UA_Server* server,
+                        const UA_NodeId* sessionId,
+                        void* sessionContext,
+                        const UA_NodeId* nodeId,
+                        const UA_HistoryDataBackend& backend);
+    ~HistorySampleReader();
+
+    /*!
+        \brief seek
+        \param t
+        \param strategy
+        \return true if there is a matching value - reads start there
+    */
+    bool seek(UA_DateTime t, MatchStrategy strategy);
+
+    /*!
+        \brief read
+        \param times
+        \param values
+        \param good
+        \param n size of the arrays
+        \return number of values read - 0 at the end
+    */
+    size_t read(UA_DateTime* times, UA_Double* values, UA_Byte* good, size_t n);
+
+    /*!
+        \brief toSample
+        \param v
+        \param t source timestamp or server timestamp
+        \param d
+        \return true if the value is numeric and good
+    */
+    static bool toSample(const UA_DataValue& v, UA_DateTime& t, UA_Double& d);
+};
+
+/*!
+    \brief The AggregateHistoryDatabase class
+    History database with server side ReadProcessed and ReadAtTime. Raw reads, updates and deletes go to the default
+    database on the same gathering. Use in place of the historian's database - for example
+        AggregateHistoryDatabase aggregates(historian.gathering());
+        serverConfig().historyDatabase = aggregates.database();
+        serverConfig().accessHistoryDataCapability = UA_TRUE;
+        serverConfig().readProcessedCapability = UA_TRUE;
+    serverConfig().readAtTimeCapability = UA_TRUE;
+    The object must outlive the server.
+*/
+class UA_EXPORT AggregateHistoryDatabase : public HistoryDatabase
+{
+    UA_HistoryDataGathering _gathering;  // finds the backend of each node
+    UA_HistoryDatabase _default;         // the default database on the same gathering
+    size_t _blockSize    = 4096;
+    size_t _maxIntervals = 100000;
+    std::mutex _steppedMutex;
+    std::unordered_map<NodeId, bool, NodeIdHash, NodeIdEqual> _stepped;
+    bool _defaultStepped = false;
+
+protected:
+    /*!
+        \brief gathering
+        \return the gathering that finds the backend of each node
+    */
+    UA_HistoryDataGathering& gathering() { return _gathering; }
+
+    /*!
+        \brief toHistoryData
+        \param r results
+        \param reverse fill in reverse order
+        \param count values are counts
+        \param timestampsToReturn
+        \param result
+        \return UA_STATUSCODE_GOOD on success
+    */
+    static UA_StatusCode toHistoryData(const std::vector<HistoryAggregate::Result>& r,
+                                       bool reverse,
+                                       bool count,
+                                       UA_TimestampsToReturn timestampsToReturn,
+                                       UA_HistoryData* result);
+
+    /*!
+        \brief processNode
+        ReadProcessed of one node from the raw values
+        \return status of the node result
+    */
+    UA_StatusCode processNode(Context& c,
+                              const UA_NodeId& nodeId,
+                              const UA_NodeId& aggregate,
+                              const UA_ReadProcessedDetails* details,
+                              UA_TimestampsToReturn timestampsToReturn,
+                              UA_HistoryData* result);
+
+    /*!
+        \brief atTimeNode
+        ReadAtTime of one node
+        \return status of the node result
+    */
+    UA_StatusCode atTimeNode(Context& c,
+                             const UA_NodeId& nodeId,
+                             const UA_ReadAtTimeDetails* details,
+                             UA_TimestampsToReturn timestampsToReturn,
+                             UA_HistoryData* result);
+
+public:
+    /*!
+        \brief AggregateHistoryDatabase
+        \param gathering shallow copied - the database clears it with itself
+    */
+    AggregateHistoryDatabase(const UA_HistoryDataGathering& gathering);
+
+    /*!
+        \brief setBlockSize
+        \param n samples read from the backend at a time
+    */
+    void setBlockSize(size_t n) { _blockSize = std::max(n, size_t(16)); }
+    size_t blockSize() const { return _blockSize; }
+
+    /*!
+        \brief setMaxIntervals
+        \param n intervals allowed per node - larger requests fail with BadTooManyOperations
+    */
+    void setMaxIntervals(size_t n) { _maxIntervals = n; }
+    size_t maxIntervals() const { return _maxIntervals; }
+
+    /*!
+        \brief setStepped
+        ReadAtTime holds the earlier value of a stepped node rather than interpolating - for example for states
+        \param nodeId
+        \param stepped
+    */
+    void setStepped(const NodeId& nodeId, bool stepped)
+    {
+        std::lock_guard<std::mutex> l(_steppedMutex);
+        _stepped[nodeId] = stepped;
+    }
+
+    /*!
+        \brief setDefaultStepped
+        \param stepped interpolation of nodes without their own setting
+    */
+    void setDefaultStepped(bool stepped) { _defaultStepped = stepped; }
+
+    /*!
+        \brief stepped
+        \param nodeId
+        \return true if the node is stepped
+    */
+    bool stepped(const NodeId& nodeId)
+    {
+        std::lock_guard<std::mutex> l(_steppedMutex);
+        auto i = _stepped.find(nodeId);
+        return (i != _stepped.end()) ? i->second : _defaultStepped;
+    }
+
+    // HistoryDatabase
+    void deleteMembers() override;
+    void setValue(Context& c, UA_Boolean historizing, const UA_DataValue* value) override;
+    void readRaw(Context& c,
+                 const UA_RequestHeader* requestHeader,
+                 const UA_ReadRawModifiedDetails* historyReadDetails,
+                 UA_TimestampsToReturn timestampsToReturn,
+                 UA_Boolean releaseContinuationPoints,
+                 size_t nodesToReadSize,
+                 const UA_HistoryReadValueId* nodesToRead,
+                 UA_HistoryReadResponse* response,
+                 UA_HistoryData* const* const historyData) override;
+    void updateData(Context& c,
+                    const UA_RequestHeader* requestHeader,
+                    const UA_UpdateDataDetails* details,
+                    UA_HistoryUpdateResult* result) override;
+    void deleteRawModified(Context& c,
+                           const UA_RequestHeader* requestHeader,
+                           const UA_DeleteRawModifiedDetails* details,
+                           UA_HistoryUpdateResult* result) override;
+    void readProcessed(Context& c,
+                       const UA_RequestHeader* requestHeader,
+                       const UA_ReadProcessedDetails* historyReadDetails,
+                       UA_TimestampsToReturn timestampsToReturn,
+                       UA_Boolean releaseContinuationPoints,
+                       size_t nodesToReadSize,
+                       const UA_HistoryReadValueId* nodesToRead,
+                       UA_HistoryReadResponse* response,
+                       UA_HistoryData* const* const historyData) override;
+    void readAtTime(Context& c,
+                    const UA_RequestHeader* requestHeader,
+                    const UA_ReadAtTimeDetails* historyReadDetails,
+                    UA_TimestampsToReturn timestampsToReturn,
+                    UA_Boolean releaseContinuationPoints,
+                    size_t nodesToReadSize,
+                    const UA_HistoryReadValueId* nodesToRead,
+                    UA_HistoryReadResponse* response,
+                    UA_HistoryData* const* const historyData) override;
+};
+
+}  // namespace Open62541
+
+#endif  // HISTORYAGGREGATES_H
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef HISTORYBACKENDWRAPPER_H
+#define HISTORYBACKENDWRAPPER_H
+#include <open62541cpp/historydatabase.h>
+#include <mutex>
+
+namespace Open62541 {
+
+/*!
+    \brief The HistoryBackendWrapper class
+    Base for stages in front of a history backend. Every call is passed on to the wrapped backend - derived classes
+    override what they change. sync() is called before the wrapped backend is searched or modified.
+    Every call into the wrapped backend holds a backend wide mutex, so stages writing from their own thread may use
+    backends that are not thread safe - getDataValue returns a copy as the backend's storage may move once the
+    mutex is released.
+    Register the database() as the historizing backend of the nodes in place of the wrapped backend.
+*/
+class UA_EXPORT HistoryBackendWrapper : public HistoryDataBackend
+{
+protected:
+    UA_HistoryDataBackend _backend;  // the wrapped backend
+    std::mutex _backendMutex;        // held across every call into the wrapped backend
+    UA_DataValue _value;             // copy returned by getDataValue
+
+    /*!
+        \brief sync
+        Make everything written so far for a node visible in the wrapped backend
+        \param n
+    */
+    virtual void sync(const NodeId& /*n*/) {}
+
+public:
+    /*!
+        \brief HistoryBackendWrapper
+        \param backend the backend to pass calls to - shallow copied, its context must outlive the wrapper
+    */
+    HistoryBackendWrapper(const UA_HistoryDataBackend& backend);
+    HistoryBackendWrapper(const HistoryBackendWrapper&) = delete;
+    HistoryBackendWrapper& operator=(const HistoryBackendWrapper&) = delete;
+
+    /*!
+        \brief ~HistoryBackendWrapper
+    */
+    virtual ~HistoryBackendWrapper();
+
+    /*!
+        \brief backend
+        \return the wrapped backend
+    */
+    UA_HistoryDataBackend& backend() { return _backend; }
+
+    // HistoryDataBackend
+    UA_StatusCode serverSetHistoryData(Context& c, bool historizing, const UA_DataValue* value) override;
+    UA_StatusCode getHistoryData(Context& c,
+                                 const UA_DateTime start,
+                                 const UA_DateTime end,
+                                 size_t maxSizePerResponse,
+                                 UA_UInt32 numValuesPerNode,
+                                 UA_Boolean returnBounds,
+                                 UA_TimestampsToReturn timestampsToReturn,
+                                 UA_NumericRange range,
+                                 UA_Boolean releaseContinuationPoints,
+                                 std::string& continuationPoint,
+                                 std::string& outContinuationPoint,
+                                 UA_HistoryData* result) override;
+    size_t getDateTimeMatch(Context& c, const UA_DateTime timestamp, const MatchStrategy strategy) override;
+    size_t getEnd(Context& c) override;
+    size_t lastIndex(Context& c) override;
+    size_t firstIndex(Context& c) override;
+    size_t resultSize(Context& c, size_t startIndex, size_t endIndex) override;
+    UA_StatusCode copyDataValues(Context& c,
+                                 size_t startIndex,
+                                 size_t endIndex,
+                                 UA_Boolean reverse,
+                                 size_t valueSize,
+                                 UA_NumericRange range,
+                                 UA_Boolean releaseContinuationPoints,
+                                 std::string& in,
+                                 std::string& out,
+                                 size_t* providedValues,
+                                 UA_DataValue* values) override;
+    const UA_DataValue* getDataValue(Context& c, size_t index) override;
+    size_t readSamples(Context& c,
+                       size_t startIndex,
+                       size_t n,
+                       UA_DateTime* times,
+                       UA_Double* values,
+                       UA_Byte* good) override;
+    size_t appendRecords(const NodeId& n, const FileHistoryRecord* r, size_t count) override;
+    bool readRecords(const NodeId& n,
+                     UA_DateTime start,
+                     UA_DateTime end,
+                     const std::function<bool(const FileHistoryRecord*, size_t)>& f) override;
+    UA_Boolean boundSupported(Context& c) override;
+    UA_Boolean timestampsToReturnSupported(Context& c, const UA_TimestampsToReturn timestampsToReturn) override;
+    UA_StatusCode insertDataValue(Context& c, const UA_DataValue* value) override;
+    UA_StatusCode replaceDataValue(Context& c, const UA_DataValue* value) override;
+    UA_StatusCode updateDataValue(Context& c, const UA_DataValue* value) override;
+    UA_StatusCode removeDataValue(Context& c, UA_DateTime startTimestamp, UA_DateTime endTimestamp) override;
+};
+
+}  // namespace Open62541
+
+#endif  // HISTORYBACKENDWRAPPER_H
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef HISTORYBULK_H
+#define HISTORYBULK_H
+#include <open62541cpp/filehistorybackend.h>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+
+namespace Open62541 {
+
+const UA_UInt32 HISTORY_BULK_MAGIC   = 0x42363235;  // "526B"
+const UA_UInt32 HISTORY_BULK_VERSION = 1;
+const size_t HISTORY_BULK_SERIES_RECORDS = 64 * 1024;  // most records in one series of a bulk file
+
+/*!
+    \brief The HistoryBulkFileHeader struct
+    Start of a bulk history file - followed by the series
+*/
+struct HistoryBulkFileHeader {
+    UA_UInt32 magic;
+    UA_UInt32 version;
+    UA_Byte reserved[24];
+};
+
+/*!
+    \brief The HistoryBulkSeriesHeader struct
+    Start of a series - a run of records of one node in time order. Followed by the node id as text and the
+    compressed blocks, each a 32 bit size and a block as written by HistoryBlockEncoder.
+    A node with a long history is written as several series.
+*/
+struct HistoryBulkSeriesHeader {
+    UA_UInt32 idSize;  //!< bytes of node id text
+    UA_UInt32 blocks;
+    UA_UInt64 count;   //!< records in the series
+    UA_DateTime firstTime;
+    UA_DateTime lastTime;
+};
+
+/*!
+    \brief The HistoryBulkFile class
+    Compact binary file of node histories. Values are held column wise with delta of delta timestamps and XOR
+    encoded values so the file is a fraction of the size of the records. Series may be written from several threads.
+*/
+class UA_EXPORT HistoryBulkFile
+{
+    FILE* _file = nullptr;
+    std::mutex _mutex;
+    UA_StatusCode _lastError = UA_STATUSCODE_GOOD;
+
+public:
+    HistoryBulkFile() {}
+    HistoryBulkFile(const HistoryBulkFile&) = delete;
+    HistoryBulkFile& operator=(const HistoryBulkFile&) = delete;
+
+    /*!
+        \brief ~HistoryBulkFile
+    */
+    ~HistoryBulkFile() { close(); }
+
+    /*!
+        \brief create
+        \param path file to write - replaced if it exists
+        \return true on success
+    */
+    bool create(const std::string& path);
+
+    /*!
+        \brief open
+        \param path file to read
+        \return true on success
+    */
+    bool open(const std::string& path);
+
+    /*!
+        \brief close
+        \return true if everything written reached the file
+    */
+    bool close();
+
+    /*!
+        \brief isOpen
+        \return true if a file is open
+    */
+    bool isOpen() const { return _file != nullptr; }
+
+    /*!
+        \brief writeSeries
+        Compress and append a series - compression is done before the file is locked
+        \param n node
+        \param r records in time order
+        \param count number of records
+        \return true on success
+    */
+    bool writeSeries(const NodeId& n, const FileHistoryRecord* r, size_t count);
+
+    /*!
+        \brief readSeries
+        Read the next series without decompressing it
+        \param n node
+        \param header
+        \param blocks compressed blocks
+        \return false at the end of the file or on error - check lastOK()
+    */
+    bool readSeries(NodeId& n, HistoryBulkSeriesHeader& header, std::string& blocks);
+
+    /*!
+        \brief decode
+        \param header
+        \param blocks compressed blocks as read by readSeries
+        \param records decoded records are appended
+        \return true on success
+    */
+    static bool decode(const HistoryBulkSeriesHeader& header,
+                       const std::string& blocks,
+                       std::vector<FileHistoryRecord>& records);
+
+    /*!
+        \brief lastError
+        \return last file error as a status code
+    */
+    UA_StatusCode lastError() const { return _lastError; }
+
+    /*!
+        \brief lastOK
+        \return true if the last file operation succeeded
+    */
+    bool lastOK() const { return _lastError == UA_STATUSCODE_GOOD; }
+};
+
+/*!
+    \brief The HistoryBulk class
+    Bulk export and import of node histories directly against a history backend, bypassing the history services.
+    Backends that support record level access - the file and ring buffer backends and wrappers of them - are read
+    and loaded without a server, one worker thread per node at a time. Other backends are read and written through
+    their low level API, which needs the server and runs on the calling thread.
+    A CSV adapter reads and writes node,time,value,status lines with ISO 8601 UTC times. Only numeric values can be
+    imported from CSV and they are stored as doubles.
+    Records can only be appended in time order - importing into a node that already holds later data rejects them.
+*/
+class UA_EXPORT HistoryBulk
+{
+public:
+    typedef std::function<bool(const NodeId&, const FileHistoryRecord*, size_t)> SeriesFunction;
+
+private:
+    UA_HistoryDataBackend _backend;
+    UA_Server* _server  = nullptr;
+    unsigned _threads   = 4;
+    std::atomic<size_t> _records{0};
+    std::atomic<size_t> _skipped{0};
+    std::atomic<UA_StatusCode> _lastError{UA_STATUSCODE_GOOD};  // set by the worker threads
+
+    size_t append(const NodeId& n, const FileHistoryRecord* r, size_t count);
+    bool forEachNode(const std::vector<NodeId>& nodes, UA_DateTime start, UA_DateTime end, const SeriesFunction& f);
+
+public:
+    /*!
+        \brief HistoryBulk
+        \param backend backend to export from and import to - shallow copied
+        \param server needed only for backends without record level access
+    */
+    HistoryBulk(const UA_HistoryDataBackend& backend, UA_Server* server = nullptr)
+        : _backend(backend)
+        , _server(server)
+    {
+    }
+
+    /*!
+        \brief setThreads
+        \param n worker threads for backends with record level access
+    */
+    void setThreads(unsigned n) { _threads = std::max(1U, n); }
+
+    /*!
+        \brief native
+        \return true if the backend supports record level access
+    */
+    bool native() const { return HistoryDataBackend::fromBackend(_backend) != nullptr; }
+
+    /*!
+        \brief readNode
+        Read the records of a node in time order through record level access or the low level API
+        \param n node
+        \param start first time wanted
+        \param end records at or after this are not wanted
+        \param f called with runs of up to HISTORY_BULK_SERIES_RECORDS records - return false to stop
+        \return true if every record was read - false if stopped or on error
+    */
+    bool readNode(const NodeId& n, UA_DateTime start, UA_DateTime end, const SeriesFunction& f);
+
+    /*!
+        \brief exportNodes
+        \param nodes nodes to export
+        \param path bulk file to write
+        \param start first time to export
+        \param end records at or after this are not exported - 0 for all
+        \return true on success
+    */
+    bool exportNodes(const std::vector<NodeId>& nodes,
+                     const std::string& path,
+                     UA_DateTime start = 0,
+                     UA_DateTime end   = 0);
+
+    /*!
+        \brief importFile
+        \param path bulk file to read
+        \return true on success - records the backend rejected are counted by skipped()
+    */
+    bool importFile(const std::string& path);
+
+    /*!
+        \brief exportCsv
+        \param nodes nodes to export
+        \param path CSV file to write
+        \param start first time to export
+        \param end records at or after this are not exported - 0 for all
+        \return true on success
+    */
+    bool exportCsv(const std::vector<NodeId>& nodes,
+                   const std::string& path,
+                   UA_DateTime start = 0,
+                   UA_DateTime end   = 0);
+
+    /*!
+        \brief importCsv
+        Lines must be in time order for each node. A first line that is not a record is taken as a heading.
+        \param path CSV file to read
+        \return true on success - lines that cannot be imported are counted by skipped()
+    */
+    bool importCsv(const std::string& path);
+
+    /*!
+        \brief toIsoTime
+        \param t
+        \return time as yyyy-mm-ddThh:mm:ss.fffffffZ
+    */
+    static std::string toIsoTime(UA_DateTime t);
+
+    /*!
+        \brief fromIsoTime
+        \param s time as yyyy-mm-ddThh:mm:ss[.f]Z
+        \param t
+        \return true on success
+    */
+    static bool fromIsoTime(const std::string& s, UA_DateTime& t);
+
+    size_t records() const { return _records; }  //!< records exported or imported by the last operation
+    size_t skipped() const { return _skipped; }  //!< records or lines that could not be imported
+
+    /*!
+        \brief lastError
+        \return last error as a status code
+    */
+    UA_StatusCode lastError() const { return _lastError; }
+
+    /*!
+        \brief lastOK
+        \return true if the last operation succeeded
+    */
+    bool lastOK() const { return _lastError == UA_STATUSCODE_GOOD; }
+};
+
+}  // namespace Open62541
+
+#endif  // HISTORYBULK_H
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef HISTORYCOMPRESSION_H
+#define HISTORYCOMPRESSION_H
+#include <open62541cpp/filehistorybackend.h>
+
+namespace Open62541 {
+
+const size_t HISTORY_BLOCK_RECORDS = 1024;  // records per compressed block
+
+/*!
+    \brief The HistoryBitWriter class
+    Appends bit fields most significant bit first
+*/
+class UA_EXPORT HistoryBitWriter
+{
+    std::string& _out;
+    UA_UInt64 _acc  = 0;
+    unsigned _bits  = 0;  // bits held in _acc - always less than 8 between calls
+
+    void put(UA_UInt64 v, unsigned n);
+
+public:
+    HistoryBitWriter(std::string& out)
+        : _out(out)
+    {
+    }
+
+    /*!
+        \brief write
+        \param v value - the low n bits are written
+        \param n number of bits 0 - 64
+    */
+    void write(UA_UInt64 v, unsigned n)
+    {
+        if (n > 32) {
+            put(v >> 32, n - 32);
+            n = 32;
+        }
+        put(v, n);
+    }
+
+    /*!
+        \brief flush
+        Pad the last byte with zero bits
+    */
+    void flush();
+};
+
+/*!
+    \brief The HistoryBitReader class
+*/
+class UA_EXPORT HistoryBitReader
+{
+    const UA_Byte* _p   = nullptr;
+    const UA_Byte* _end = nullptr;
+    UA_UInt64 _acc      = 0;
+    unsigned _bits      = 0;
+    bool _overrun       = false;
+
+    UA_UInt64 get(unsigned n);
+
+public:
+    HistoryBitReader(const UA_Byte* p, size_t size)
+        : _p(p)
+        , _end(p + size)
+    {
+    }
+
+    /*!
+        \brief read
+        \param n number of bits 0 - 64
+        \return bits read
+    */
+    UA_UInt64 read(unsigned n)
+    {
+        if (n > 32) {
+            UA_UInt64 h = get(n - 32);
+            return (h << 32) | get(32);
+        }
+        return get(n);
+    }
+
+    /*!
+        \brief overrun
+        \return true if more bits were read than the stream holds
+    */
+    bool overrun() const { return _overrun; }
+};
+
+/*!
+    \brief The HistoryBlockHeader struct
+    A compressed block holds up to HISTORY_BLOCK_RECORDS records as separate column streams following this header
+    - timestamps and server timestamps as delta of delta, values as the XOR with the previous value (Gorilla) and
+    the status, flags and type as run lengths.
+*/
+struct HistoryBlockHeader {
+    UA_UInt32 count;       //!< records in the block
+    UA_UInt32 timeSize;    //!< bytes in the timestamp stream
+    UA_UInt32 serverSize;  //!< bytes in the server timestamp stream
+    UA_UInt32 valueSize;   //!< bytes in the value stream
+    UA_UInt32 metaSize;    //!< bytes in the status / flags / type run stream
+    UA_UInt32 reserved;
+    UA_DateTime firstTime;
+    UA_DateTime lastTime;
+};
+
+/*!
+    \brief The HistoryBlockEncoder class
+*/
+class UA_EXPORT HistoryBlockEncoder
+{
+public:
+    /*!
+        \brief encode
+        \param r records in time order
+        \param n number of records - at most HISTORY_BLOCK_RECORDS
+        \param out encoded block is appended
+        \return true on success
+    */
+    static bool encode(const FileHistoryRecord* r, size_t n, std::string& out);
+};
+
+/*!
+    \brief The HistoryBlockDecoder class
+    Sequential decoder for one block
+*/
+class UA_EXPORT HistoryBlockDecoder
+{
+    HistoryBlockHeader _header;
+    bool _valid = false;
+    HistoryBitReader _time;
+    HistoryBitReader _server;
+    HistoryBitReader _value;
+    const UA_Byte* _meta    = nullptr;
+    const UA_Byte* _metaEnd = nullptr;
+    size_t _position        = 0;
+    // decoder state
+    UA_UInt64 _t = 0, _dt = 0;    // timestamp and delta
+    UA_UInt64 _s = 0, _ds = 0;    // server timestamp and delta
+    UA_UInt64 _v        = 0;
+    unsigned _lead      = 0;
+    unsigned _trail     = 0;
+    size_t _run         = 0;  // records left in the current meta run
+    UA_StatusCode _status = 0;
+    UA_UInt16 _typeIndex = 0;
+    UA_UInt16 _flags     = 0;
+
+    static const UA_Byte* stream(const UA_Byte* data, size_t size, size_t offset, size_t length)
+    {
+        return (offset + length <= size) ? data + offset : nullptr;
+    }
+
+public:
+    /*!
+        \brief HistoryBlockDecoder
+        \param data start of the block
+        \param size bytes available
+    */
+    HistoryBlockDecoder(const UA_Byte* data, size_t size);
+
+    /*!
+        \brief valid
+        \return true if the header is consistent
+    */
+    bool valid() const { return _valid; }
+
+    /*!
+        \brief header
+        \return block header
+    */
+    const HistoryBlockHeader& header() const { return _header; }
+
+    /*!
+        \brief count
+        \return records in the block
+    */
+    size_t count() const { return _valid ? _header.count : 0; }
+
+    /*!
+        \brief position
+        \return index of the next record
+    */
+    size_t position() const { return _position; }
+
+    /*!
+        \brief next
+        \param r next record
+        \return false at the end of the block or if the data is corrupt
+    */
+    bool next(FileHistoryRecord& r);
+
+    /*!
+        \brief decode
+        \param out records
+        \param n maximum to decode
+        \return number decoded
+    */
+    size_t decode(FileHistoryRecord* out, size_t n);
+
+    /*!
+        \brief decode
+        Decode straight into data values
+        \param skip records to pass over first
+        \param n number of values wanted
+        \param values destination - initialised or cleared
+        \param range numeric range applied to each value
+        \param decoded set to the number of values written
+        \return UA_STATUSCODE_GOOD on success
+    */
+    UA_StatusCode decode(size_t skip, size_t n, UA_DataValue* values, const UA_NumericRange* range, size_t& decoded);
+};
+
+}  // namespace Open62541
+
+#endif  // HISTORYCOMPRESSION_H
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef HISTORYCONTINUATION_H
+#define HISTORYCONTINUATION_H
+#include <open62541cpp/historydatabase.h>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace Open62541 {
+
+/*!
+    \brief The HistoryCursor struct
+    Where a paged read of a node carries on from
+*/
+struct HistoryCursor {
+    NodeId nodeId;
+    size_t next  = 0;  //!< index of the next value to return
+    size_t last  = 0;  //!< index of the last value to return
+    bool reverse = false;
+};
+
+/*!
+    \brief The HistoryContinuationPoints class
+    Server side continuation points for paged history reads. Each continuation point handed to a client names a
+    cursor held here for its session, so the next page starts at the stored index without searching again.
+    The number of cursors is capped in total and per session - the oldest cursor gives way to a new one - and
+    cursors expire after a lifetime. Cursors are fixed size so the cap bounds the memory used.
+    Use with HistoryDataBackend::setContinuationPoints for backends with stable indexes such as the file and ring
+    buffer backends.
+*/
+class UA_EXPORT HistoryContinuationPoints
+{
+public:
+    static const size_t TOKEN_SIZE = 2 * sizeof(UA_UInt64);
+
+private:
+    struct Entry {
+        NodeId session;
+        HistoryCursor cursor;
+        UA_UInt64 check = 0;  // random part of the token
+        UA_DateTime expires = 0;
+        std::list<UA_UInt64>::iterator age;         // in _order
+        std::list<UA_UInt64>::iterator sessionAge;  // in the session list
+    };
+    typedef std::unordered_map<NodeId, std::list<UA_UInt64>, NodeIdHash, NodeIdEqual> SessionMap;
+
+    std::mutex _mutex;
+    std::unordered_map<UA_UInt64, Entry> _entries;
+    std::list<UA_UInt64> _order;  // oldest first - also the order of expiry
+    SessionMap _sessions;         // cursor ids of each session, oldest first
+    UA_UInt64 _nextId = 1;
+    UA_UInt64 _seed;
+    size_t _maxPoints     = 10000;
+    size_t _maxPerSession = 100;
+    UA_DateTime _lifetime = 600 * UA_DATETIME_SEC;
+    std::atomic<size_t> _created{0};
+    std::atomic<size_t> _released{0};
+    std::atomic<size_t> _expired{0};
+    std::atomic<size_t> _evicted{0};
+
+    void remove(UA_UInt64 id);
+    void expireLocked(UA_DateTime now);
+    UA_UInt64 random();
+
+public:
+    /*!
+        \brief HistoryContinuationPoints
+        \param maxPoints most cursors held
+        \param maxPerSession most cursors one session holds
+        \param lifetime how long an unused cursor is kept
+    */
+    HistoryContinuationPoints(size_t maxPoints     = 10000,
+                              size_t maxPerSession = 100,
+                              UA_DateTime lifetime = 600 * UA_DATETIME_SEC);
+    HistoryContinuationPoints(const HistoryContinuationPoints&) = delete;
+    HistoryContinuationPoints& operator=(const HistoryContinuationPoints&) = delete;
+
+    /*!
+        \brief setLimits
+        \param maxPoints
+        \param maxPerSession
+        \param lifetime
+    */
+    void setLimits(size_t maxPoints, size_t maxPerSession, UA_DateTime lifetime);
+
+    /*!
+        \brief store
+        \param session
+        \param cursor
+        \return continuation point naming the cursor
+    */
+    std::string store(const NodeId& session, const HistoryCursor& cursor);
+
+    /*!
+        \brief take
+        Remove a cursor - a read that needs more pages stores a new one
+        \param session
+        \param token continuation point from the client
+        \param cursor
+        \return UA_STATUSCODE_GOOD or UA_STATUSCODE_BADCONTINUATIONPOINTINVALID
+    */
+    UA_StatusCode take(const NodeId& session, const std::string& token, HistoryCursor& cursor);
+
+    /*!
+        \brief release
+        \param session
+        \param token
+        \return true if the cursor was held
+    */
+    bool release(const NodeId& session, const std::string& token);
+
+    /*!
+        \brief releaseSession
+        Release every cursor of a session - for example when it closes
+        \param session
+        \return number released
+    */
+    size_t releaseSession(const NodeId& session);
+
+    /*!
+        \brief expire
+        Cursors also expire as new ones are stored
+        \param now
+        \return number expired
+    */
+    size_t expire(UA_DateTime now = UA_DateTime_now());
+
+    /*!
+        \brief size
+        \return cursors held
+    */
+    size_t size();
+
+    size_t created() const { return _created; }    //!< cursors stored
+    size_t released() const { return _released; }  //!< cursors released by clients
+    size_t expired() const { return _expired; }    //!< cursors that timed out
+    size_t evicted() const { return _evicted; }    //!< cursors that gave way to newer ones
+
+    /*!
+        \brief readRaw
+        ReadRaw of one node through the low level API of a backend. The first page finds the range with
+        getDateTimeMatch, later pages carry on from the cursor.
+        Start inclusive, end exclusive - or inclusive if they are equal. Start after end reads in reverse, either may
+        be unspecified (0) if numValuesPerNode is set. Bounds are the values either side of the range if present.
+        \return UA_STATUSCODE_GOOD on success
+    */
+    UA_StatusCode readRaw(HistoryDataBackend& backend,
+                          HistoryDataBackend::Context& c,
+                          UA_DateTime start,
+                          UA_DateTime end,
+                          size_t maxSizePerResponse,
+                          UA_UInt32 numValuesPerNode,
+                          UA_Boolean returnBounds,
+                          UA_TimestampsToReturn timestampsToReturn,
+                          UA_NumericRange range,
+                          UA_Boolean releaseContinuationPoints,
+                          const std::string& continuationPoint,
+                          std::string& outContinuationPoint,
+                          UA_HistoryData* result);
+};
+
+}  // namespace Open62541
+
+#endif  // HISTORYCONTINUATION_H
@@ -16,6 +16,8 @@
 namespace Open62541 {
 
 class Server;
+class HistoryContinuationPoints;
+struct FileHistoryRecord;
 
 // Wrap the Historian classes in C++
 // probably the memory database will be all that is needed most of the time
@@ -277,6 +279,7 @@ public:
 
 private:
     UA_HistoryDataBackend _database;  // the database structure
+    HistoryContinuationPoints* _continuationPoints = nullptr;
     //
     // Define the callbacks
     static void _deleteMembers(UA_HistoryDataBackend* backend)
@@ -287,6 +290,37 @@ private:
         }
     }
 
+    /*!
+        \brief fromContinuationPoint
+        \param b continuation point from the server - may be null
+        \return the continuation point as a string
+    */
+    static std::string fromContinuationPoint(const UA_ByteString* b)
+    {
+        return (b && b->length && b->data) ? std::string((const char*)(b->data), b->length) : std::string();
+    }
+
+    /*!
+        \brief toContinuationPoint
+        The server owns and frees the continuation point returned to it so it must be allocated
+        \param ret result of the call that produced the continuation point
+        \param s
+        \param b set to a copy of s - empty if there is no continuation point
+        \return ret or an allocation failure
+    */
+    static UA_StatusCode toContinuationPoint(UA_StatusCode ret, const std::string& s, UA_ByteString* b)
+    {
+        if (!b)
+            return ret;
+        UA_ByteString_init(b);
+        if ((ret != UA_STATUSCODE_GOOD) || s.empty())
+            return ret;
+        if (UA_ByteString_allocBuffer(b, s.size()) != UA_STATUSCODE_GOOD)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        memcpy(b->data, s.data(), s.size());
+        return ret;
+    }
+
     /*!
         \brief _serverSetHistoryData
         \param server
@@ -335,7 +369,7 @@ private:
         if (backend && backend->context) {
             Context c(server, sessionId, sessionContext, nodeId);
             HistoryDataBackend* p = static_cast<HistoryDataBackend*>(backend->context);
-            std::string in        = fromByteString(*(const_cast<UA_ByteString*>(continuationPoint)));
+            std::string in        = fromContinuationPoint(continuationPoint);
             std::string out;
 
             UA_StatusCode ret     = p->getHistoryData(c,
@@ -350,8 +384,7 @@ private:
                                                   in,
                                                   out,
                                                   result);
-            *outContinuationPoint = UA_BYTESTRING(const_cast<char*>(out.c_str()));
-            return ret;
+            return toContinuationPoint(ret, out, outContinuationPoint);
         }
         return UA_STATUSCODE_GOOD;  // ignore
     }
@@ -517,7 +550,7 @@ private:
         if (hdbContext && sessionId) {
             Context c(server, sessionId, sessionContext, nodeId);
             HistoryDataBackend* p = static_cast<HistoryDataBackend*>(hdbContext);
-            std::string in        = fromByteString(*(const_cast<UA_ByteString*>(continuationPoint)));
+            std::string in        = fromContinuationPoint(continuationPoint);
             std::string out;
             UA_StatusCode ret     = p->copyDataValues(c,
                                                   startIndex,
@@ -530,8 +563,7 @@ private:
                                                   out,
                                                   providedValues,
                                                   values);
-            *outContinuationPoint = UA_BYTESTRING(const_cast<char*>(out.c_str()));
-            return ret;
+            return toContinuationPoint(ret, out, outContinuationPoint);
         }
         return 0;
     }
@@ -700,11 +732,83 @@ public:
 
     UA_HistoryDataBackend& database() { return _database; }
 
+    /*!
+        \brief fromBackend
+        \param b
+        \return the object behind a backend set up by initialise() or null
+    */
+    static HistoryDataBackend* fromBackend(const UA_HistoryDataBackend& b)
+    {
+        return (b.context && (b.copyDataValues == _copyDataValues)) ? static_cast<HistoryDataBackend*>(b.context)
+                                                                     : nullptr;
+    }
+
+    /*!
+        \brief setContinuationPoints
+        Page ReadRaw with cursors held by a continuation point manager in place of the default search per page.
+        Needs the low level API. Set before the backend is registered or wrapped.
+        \param p manager - not owned, may be shared by backends - null to stop using one
+    */
+    void setContinuationPoints(HistoryContinuationPoints* p)
+    {
+        _continuationPoints     = p;
+        _database.getHistoryData = p ? _getHistoryData : nullptr;
+    }
+    HistoryContinuationPoints* continuationPoints() const { return _continuationPoints; }
+
     /*!
         \brief deleteMembers
     */
     virtual void deleteMembers() {}
 
+    /*!
+        \brief readSamples
+        Block read used by aggregate processing - avoids building a data value per sample
+        \param c
+        \param startIndex index of the first value
+        \param n values wanted
+        \param times source timestamp of each value (server timestamp if there is none)
+        \param values value converted to double
+        \param good non zero if the value is numeric and its status is good
+        \return number of values read - 0 if not supported
+    */
+    virtual size_t readSamples(Context& /*c*/,
+                               size_t /*startIndex*/,
+                               size_t /*n*/,
+                               UA_DateTime* /*times*/,
+                               UA_Double* /*values*/,
+                               UA_Byte* /*good*/)
+    {
+        return 0;
+    }
+
+    /*!
+        \brief appendRecords
+        Bulk load of stored records - no server or data values needed
+        \param n node
+        \param r records in time order
+        \param count number of records
+        \return number of records stored - 0 if not supported
+    */
+    virtual size_t appendRecords(const NodeId& /*n*/, const FileHistoryRecord* /*r*/, size_t /*count*/) { return 0; }
+
+    /*!
+        \brief readRecords
+        Bulk dump of stored records - no server or data values needed
+        \param n node
+        \param start first time wanted
+        \param end records at or after this are not wanted
+        \param f called with runs of records in time order while the node is locked - return false to stop
+        \return false if not supported
+    */
+    virtual bool readRecords(const NodeId& /*n*/,
+                             UA_DateTime /*start*/,
+                             UA_DateTime /*end*/,
+                             const std::function<bool(const FileHistoryRecord*, size_t)>& /*f*/)
+    {
+        return false;
+    }
+
     /*  This function sets a DataValue for a node in the historical data storage.
 
         server is the server the node lives in.
@@ -742,22 +846,20 @@ public:
         continuationPoint is the continuation point the client wants to release or start from.
         outContinuationPoint is the continuation point that gets passed to the
                             client by the HistoryRead service.
-        result contains the result histoy data that gets passed to the client. */
-    virtual UA_StatusCode getHistoryData(Context& /*c*/,
-                                         const UA_DateTime /*start*/,
-                                         const UA_DateTime /*end*/,
-                                         size_t /*maxSizePerResponse*/,
-                                         UA_UInt32 /*numValuesPerNode*/,
-                                         UA_Boolean /*returnBounds*/,
-                                         UA_TimestampsToReturn /*timestampsToReturn*/,
-                                         UA_NumericRange /*range*/,
-                                         UA_Boolean /*releaseContinuationPoints*/,
-                                         std::string& /*continuationPoint*/,
-                                         std::string& /*outContinuationPoint*/,
-                                         UA_HistoryData* /*result*/)
-    {
-        return UA_STATUSCODE_GOOD;
-    }
+        result contains the result histoy data that gets passed to the client.
+        The default pages through the low level API if a continuation point manager is set. */
+    virtual UA_StatusCode getHistoryData(Context& c,
+                                         const UA_DateTime start,
+                                         const UA_DateTime end,
+                                         size_t maxSizePerResponse,
+                                         UA_UInt32 numValuesPerNode,
+                                         UA_Boolean returnBounds,
+                                         UA_TimestampsToReturn timestampsToReturn,
+                                         UA_NumericRange range,
+                                         UA_Boolean releaseContinuationPoints,
+                                         std::string& continuationPoint,
+                                         std::string& outContinuationPoint,
+                                         UA_HistoryData* result);
 
     /*  This function is part of the low level HistoryRead API. It returns the
         index of a value in the database which matches certain criteria.
@@ -908,7 +1010,7 @@ public:
 
 class HistoryDatabase
 {
-
+public:
     struct Context {
         Server& server;
         NodeId sessionId;
@@ -917,6 +1019,7 @@ class HistoryDatabase
         Context(UA_Server* s, const UA_NodeId* sId, void* sContext, const UA_NodeId* nId);
     };
 
+private:
     UA_HistoryDatabase _database;
     //
     static void _deleteMembers(UA_HistoryDatabase* hdb)
@@ -947,7 +1050,8 @@ class HistoryDatabase
                           const UA_DataValue* value)
     {
         if (hdbContext) {
-            Context c(server, sessionId, sessionContext, nodeId);
+            // the server sets values without a session
+            Context c(server, sessionId ? sessionId : &UA_NODEID_NULL, sessionContext, nodeId);
             HistoryDatabase* p = static_cast<HistoryDatabase*>(hdbContext);
             p->setValue(c, historizing, value);
         }
@@ -1033,11 +1137,91 @@ class HistoryDatabase
         }
     }
 
+    /*  This function is called if a history read is requested with
+        ReadProcessedDetails. Setting it to NULL will result in a response
+        with statuscode UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED.
+        The parameters are as for _readRaw. */
+    static void _readProcessed(UA_Server* server,
+                               void* hdbContext,
+                               const UA_NodeId* sessionId,
+                               void* sessionContext,
+                               const UA_RequestHeader* requestHeader,
+                               const UA_ReadProcessedDetails* historyReadDetails,
+                               UA_TimestampsToReturn timestampsToReturn,
+                               UA_Boolean releaseContinuationPoints,
+                               size_t nodesToReadSize,
+                               const UA_HistoryReadValueId* nodesToRead,
+                               UA_HistoryReadResponse* response,
+                               UA_HistoryData* const* const historyData)
+    {
+        if (hdbContext) {
+            Context c(server, sessionId, sessionContext, sessionId);
+            HistoryDatabase* p = static_cast<HistoryDatabase*>(hdbContext);
+            p->readProcessed(c,
+                             requestHeader,
+                             historyReadDetails,
+                             timestampsToReturn,
+                             releaseContinuationPoints,
+                             nodesToReadSize,
+                             nodesToRead,
+                             response,
+                             historyData);
+        }
+    }
+
+    /*  This function is called if a history read is requested with
+        ReadAtTimeDetails. Setting it to NULL will result in a response
+        with statuscode UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED.
+        The parameters are as for _readRaw. */
+    static void _readAtTime(UA_Server* server,
+                            void* hdbContext,
+                            const UA_NodeId* sessionId,
+                            void* sessionContext,
+                            const UA_RequestHeader* requestHeader,
+                            const UA_ReadAtTimeDetails* historyReadDetails,
+                            UA_TimestampsToReturn timestampsToReturn,
+                            UA_Boolean releaseContinuationPoints,
+                            size_t nodesToReadSize,
+                            const UA_HistoryReadValueId* nodesToRead,
+                            UA_HistoryReadResponse* response,
+                            UA_HistoryData* const* const historyData)
+    {
+        if (hdbContext) {
+            Context c(server, sessionId, sessionContext, sessionId);
+            HistoryDatabase* p = static_cast<HistoryDatabase*>(hdbContext);
+            p->readAtTime(c,
+                          requestHeader,
+                          historyReadDetails,
+                          timestampsToReturn,
+                          releaseContinuationPoints,
+                          nodesToReadSize,
+                          nodesToRead,
+                          response,
+                          historyData);
+        }
+    }
+
 public:
-    HistoryDatabase() {}
+    HistoryDatabase() { memset(&_database, 0, sizeof(_database)); }
 
     virtual ~HistoryDatabase() {}
 
+    /*!
+        \brief initialise to use class methods
+    */
+    void initialise()
+    {
+        memset(&_database, 0, sizeof(_database));
+        _database.context           = this;
+        _database.clear             = _deleteMembers;
+        _database.setValue          = _setValue;
+        _database.readRaw           = _readRaw;
+        _database.readProcessed     = _readProcessed;
+        _database.readAtTime        = _readAtTime;
+        _database.updateData        = _updateData;
+        _database.deleteRawModified = _deleteRawModified;
+    }
+
     UA_HistoryDatabase& database() { return _database; }
 
     virtual void deleteMembers() {}
@@ -1103,8 +1287,38 @@ public:
     {
     }
 
+    /*  This function is called if a history read is requested with
+        ReadProcessedDetails. The parameters are as for readRaw - there is
+        one aggregate in historyReadDetails for each node to read. */
+    virtual void readProcessed(Context& /*c*/,
+                               const UA_RequestHeader* /*requestHeader*/,
+                               const UA_ReadProcessedDetails* /*historyReadDetails*/,
+                               UA_TimestampsToReturn /*timestampsToReturn*/,
+                               UA_Boolean /*releaseContinuationPoints*/,
+                               size_t /*nodesToReadSize*/,
+                               const UA_HistoryReadValueId* /*nodesToRead*/,
+                               UA_HistoryReadResponse* /*response*/,
+                               UA_HistoryData* const* const /*historyData*/)
+    {
+    }
+
+    /*  This function is called if a history read is requested with
+        ReadAtTimeDetails. The parameters are as for readRaw - one value is
+        returned for each requested time. */
+    virtual void readAtTime(Context& /*c*/,
+                            const UA_RequestHeader* /*requestHeader*/,
+                            const UA_ReadAtTimeDetails* /*historyReadDetails*/,
+                            UA_TimestampsToReturn /*timestampsToReturn*/,
+                            UA_Boolean /*releaseContinuationPoints*/,
+                            size_t /*nodesToReadSize*/,
+                            const UA_HistoryReadValueId* /*nodesToRead*/,
+                            UA_HistoryReadResponse* /*response*/,
+                            UA_HistoryData* const* const /*historyData*/)
+    {
+    }
+
     /*  Add more function pointer here.
-        For example for read_event, read_modified, read_processed, read_at_time */
+        For example for read_event, read_modified */
 };
 
 /*!
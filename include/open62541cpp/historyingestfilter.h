@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef HISTORYINGESTFILTER_H
+#define HISTORYINGESTFILTER_H
+#include <open62541cpp/historybackendwrapper.h>
+#include <atomic>
+#include <mutex>
+
+namespace Open62541 {
+
+/*!
+    \brief The HistoryFilterSettings struct
+    How the values of a node are reduced before they are archived
+*/
+struct HistoryFilterSettings {
+    enum Type {
+        NoFilter,      //!< archive every value
+        Deadband,      //!< archive when the value moves more than the deviation from the last archived value
+        SwingingDoor,  //!< archive the points where a straight line through the archived points breaks the deviation
+        Exception      //!< as Deadband, also archiving the value before each exception so steps keep their shape
+    };
+    Type type           = NoFilter;
+    UA_Double deviation = 0.0;    //!< absolute, or percent of the range
+    bool percent        = false;  //!< the deviation is a percentage of the range
+    UA_Double range     = 0.0;    //!< span of the engineering units - for percent deviations
+    UA_DateTime maxInterval = 0;  //!< archive at least this often while values arrive - 0 for no heartbeat
+
+    /*!
+        \brief absoluteDeviation
+        \return the deviation in engineering units
+    */
+    UA_Double absoluteDeviation() const { return percent ? deviation * range / 100.0 : deviation; }
+};
+
+/*!
+    \brief The HistoryFilterStats struct
+    Values offered and archived for a node
+*/
+struct HistoryFilterStats {
+    size_t received = 0;
+    size_t archived = 0;
+
+    /*!
+        \brief ratio
+        \return values received per value archived - 1 when nothing is filtered
+    */
+    UA_Double ratio() const { return archived ? UA_Double(received) / UA_Double(archived) : 1.0; }
+};
+
+/*!
+    \brief The HistoryIngestFilter class
+    Ingest time compression in front of a history backend. Values of nodes with a filter are reduced with a deadband,
+    swinging door trending or exception reporting, all other calls pass straight through.
+    The filter holds the last value received for each node until it knows whether that value is needed to
+    reproduce the trend - flush() archives the held values, deleteMembers() does so when the server closes.
+    Values that are not numeric, have a bad status, change the status or arrive out of order are always archived.
+    A value with the same timestamp as the last one replaces it if it is held, otherwise it is archived as well.
+    Register the database() as the historizing backend of the nodes - for example historian.backend() =
+    filter.database().
+*/
+class UA_EXPORT HistoryIngestFilter : public HistoryBackendWrapper
+{
+    struct NodeState {
+        HistoryFilterSettings settings;
+        HistoryFilterStats stats;
+        bool hasArchived         = false;
+        UA_DateTime archivedTime = 0;
+        UA_Double archivedValue  = 0.0;
+        UA_StatusCode status     = UA_STATUSCODE_GOOD;
+        UA_DataValue held;  // last value received, not archived yet
+        bool hasHeld         = false;
+        bool heldHistorizing = false;
+        UA_DateTime heldTime = 0;
+        UA_Double heldValue  = 0.0;
+        UA_Double upper      = 0.0;  // swinging door slopes from the archived point
+        UA_Double lower      = 0.0;
+
+        NodeState() { UA_DataValue_init(&held); }
+        NodeState(const NodeState&) = delete;
+        NodeState& operator=(const NodeState&) = delete;
+        ~NodeState() { UA_DataValue_clear(&held); }
+    };
+    typedef std::unique_ptr<NodeState> NodeStatePtr;
+
+    std::mutex _mutex;
+    std::unordered_map<NodeId, NodeStatePtr, NodeIdHash, NodeIdEqual> _nodes;
+    std::atomic<UA_Server*> _server{nullptr};
+
+    UA_StatusCode write(UA_Server* server, const UA_NodeId& nodeId, bool historizing, const UA_DataValue& v);
+    UA_StatusCode archive(UA_Server* server,
+                          const UA_NodeId& nodeId,
+                          NodeState& s,
+                          bool historizing,
+                          const UA_DataValue& v,
+                          UA_DateTime t,
+                          UA_Double d);
+    UA_StatusCode archiveHeld(UA_Server* server, const UA_NodeId& nodeId, NodeState& s);
+    void hold(NodeState& s, bool historizing, const UA_DataValue& v, UA_DateTime t, UA_Double d);
+    void openDoor(NodeState& s, UA_DateTime t, UA_Double d, UA_Double deviation);
+
+public:
+    /*!
+        \brief HistoryIngestFilter
+        \param backend the backend to write to - shallow copied, its context must outlive the filter
+    */
+    HistoryIngestFilter(const UA_HistoryDataBackend& backend);
+
+    /*!
+        \brief ~HistoryIngestFilter
+    */
+    virtual ~HistoryIngestFilter() {}
+
+    /*!
+        \brief setFilter
+        Set the filter of a node - resets its state and statistics, held values are archived first
+        \param nodeId
+        \param settings
+    */
+    void setFilter(const NodeId& nodeId, const HistoryFilterSettings& settings);
+
+    /*!
+        \brief removeFilter
+        \param nodeId
+    */
+    void removeFilter(const NodeId& nodeId);
+
+    /*!
+        \brief stats
+        \param nodeId
+        \return values received and archived for the node
+    */
+    HistoryFilterStats stats(const NodeId& nodeId);
+
+    /*!
+        \brief stats
+        \return values received and archived for all filtered nodes
+    */
+    HistoryFilterStats stats();
+
+    /*!
+        \brief flush
+        Archive the values held by the filters
+        \return number of values archived
+    */
+    size_t flush();
+
+    // HistoryDataBackend
+    void deleteMembers() override { flush(); }
+    UA_StatusCode serverSetHistoryData(Context& c, bool historizing, const UA_DataValue* value) override;
+};
+
+}  // namespace Open62541
+
+#endif  // HISTORYINGESTFILTER_H
@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef HISTORYINGESTQUEUE_H
+#define HISTORYINGESTQUEUE_H
+#include <open62541cpp/historybackendwrapper.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace Open62541 {
+
+/*!
+    \brief The BoundedQueue class
+    Fixed capacity multi producer multi consumer queue. Push and pop are lock free - each cell carries a sequence
+    number that says whether it is free for the producer or full for the consumer of that lap.
+*/
+template <typename T> class BoundedQueue
+{
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+    std::vector<Cell> _cells;
+    size_t _mask = 0;
+    alignas(64) std::atomic<size_t> _head{0};  // next to pop
+    alignas(64) std::atomic<size_t> _tail{0};  // next to push
+
+public:
+    /*!
+        \brief BoundedQueue
+        \param capacity rounded up to a power of two
+    */
+    BoundedQueue(size_t capacity)
+    {
+        size_t n = 2;
+        while (n < capacity)
+            n <<= 1;
+        _cells = std::vector<Cell>(n);
+        _mask  = n - 1;
+        for (size_t i = 0; i < n; i++)
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return _mask + 1; }
+
+    /*!
+        \brief size
+        \return approximate number of items
+    */
+    size_t size() const
+    {
+        size_t t = _tail.load(std::memory_order_relaxed);
+        size_t h = _head.load(std::memory_order_relaxed);
+        return (t >= h) ? t - h : 0;
+    }
+
+    /*!
+        \brief push
+        \param v moved in on success
+        \return false if the queue is full
+    */
+    bool push(T& v)
+    {
+        size_t pos = _tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& c    = _cells[pos & _mask];
+            size_t seq = c.sequence.load(std::memory_order_acquire);
+            intptr_t d = intptr_t(seq) - intptr_t(pos);
+            if (d == 0) {
+                if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    c.data = std::move(v);
+                    c.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (d < 0) {
+                return false;  // full
+            }
+            else {
+                pos = _tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /*!
+        \brief pop
+        \param v
+        \return false if the queue is empty
+    */
+    bool pop(T& v)
+    {
+        size_t pos = _head.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& c    = _cells[pos & _mask];
+            size_t seq = c.sequence.load(std::memory_order_acquire);
+            intptr_t d = intptr_t(seq) - intptr_t(pos + 1);
+            if (d == 0) {
+                if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    v = std::move(c.data);
+                    c.sequence.store(pos + _mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (d < 0) {
+                return false;  // empty
+            }
+            else {
+                pos = _head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+/*!
+    \brief The HistoryIngestItem struct
+    A queued history sample - owns its value
+*/
+struct HistoryIngestItem {
+    NodeId nodeId;
+    NodeId sessionId;
+    UA_Boolean historizing = false;
+    UA_DataValue value;
+
+    HistoryIngestItem() { UA_DataValue_init(&value); }
+    HistoryIngestItem(const HistoryIngestItem&) = delete;
+    HistoryIngestItem& operator=(const HistoryIngestItem&) = delete;
+    HistoryIngestItem(HistoryIngestItem&& o)
+        : nodeId(o.nodeId)
+        , sessionId(o.sessionId)
+        , historizing(o.historizing)
+        , value(o.value)
+    {
+        UA_DataValue_init(&o.value);  // ownership moved
+    }
+    HistoryIngestItem& operator=(HistoryIngestItem&& o)
+    {
+        if (this != &o) {
+            nodeId      = o.nodeId;
+            sessionId   = o.sessionId;
+            historizing = o.historizing;
+            UA_DataValue_clear(&value);
+            value = o.value;
+            UA_DataValue_init(&o.value);
+        }
+        return *this;
+    }
+    ~HistoryIngestItem() { UA_DataValue_clear(&value); }
+};
+
+/*!
+    \brief The HistoryIngestQueue class
+    Write-behind stage in front of a history backend. serverSetHistoryData copies the value into a bounded lock free
+    queue (one per shard of nodes) and returns, a writer thread commits the queues to the backend in batches.
+    Reads of a node first commit its shard so queued values are always visible.
+    Register the database() as the historizing backend of the nodes in place of the wrapped backend - for example
+    historian.backend() = queue.database(). The writer thread commits under the wrapper's backend mutex, which
+    every read through the queue also holds, so the wrapped backend need not be thread safe.
+*/
+class UA_EXPORT HistoryIngestQueue : public HistoryBackendWrapper
+{
+public:
+    /*!
+        \brief The Policy enum
+        What serverSetHistoryData does when the shard queue is full
+    */
+    enum Policy {
+        Block,       //!< the caller commits the shard itself - the write waits for the backend
+        DropOldest,  //!< the oldest queued value of the shard is discarded
+        Spill        //!< values go to an unbounded overflow list until the writer catches up
+    };
+
+private:
+    struct Shard {
+        BoundedQueue<HistoryIngestItem> queue;
+        std::mutex consumer;                 // one committer at a time keeps each node in order
+        std::mutex spillMutex;
+        std::deque<HistoryIngestItem> spill;
+        std::atomic<bool> spilling{false};   // while set new values go to the spill list
+        Shard(size_t capacity)
+            : queue(capacity)
+        {
+        }
+    };
+    typedef std::unique_ptr<Shard> ShardPtr;
+
+    std::vector<ShardPtr> _shards;
+    Policy _policy   = Block;
+    size_t _batch    = 1024;
+    std::atomic<UA_Server*> _server{nullptr};
+    std::function<void()> _commit;  // called after each batch
+    std::thread _thread;
+    std::atomic<bool> _running{false};
+    std::mutex _wakeMutex;
+    std::condition_variable _wake;
+    unsigned _interval_ms = 5;
+    std::atomic<size_t> _queued{0};
+    std::atomic<size_t> _written{0};
+    std::atomic<size_t> _dropped{0};
+    std::atomic<size_t> _spilled{0};
+    std::atomic<size_t> _failed{0};
+
+    Shard& shard(const NodeId& n) { return *_shards[n.hash() % _shards.size()]; }
+    size_t drain(Shard& s, size_t limit);
+    void commit(HistoryIngestItem& i);
+    void run();
+
+protected:
+    void sync(const NodeId& n) override { drain(shard(n), 0); }
+
+public:
+    /*!
+        \brief HistoryIngestQueue
+        \param backend the backend to write to - shallow copied, its context must outlive the queue
+        \param shards number of node shards
+        \param capacity queue capacity per shard
+        \param policy what to do when a shard queue is full
+    */
+    HistoryIngestQueue(const UA_HistoryDataBackend& backend,
+                       size_t shards   = 8,
+                       size_t capacity = 4096,
+                       Policy policy   = Block);
+
+    /*!
+        \brief ~HistoryIngestQueue
+    */
+    virtual ~HistoryIngestQueue();
+
+    /*!
+        \brief setPolicy
+        \param p
+    */
+    void setPolicy(Policy p) { _policy = p; }
+
+    /*!
+        \brief setBatchSize
+        \param n values committed per shard per pass
+    */
+    void setBatchSize(size_t n) { _batch = std::max(n, size_t(1)); }
+
+    /*!
+        \brief setCommit
+        \param f called by the committing thread after each batch - for example to flush a file backend
+    */
+    void setCommit(std::function<void()> f) { _commit = f; }
+
+    /*!
+        \brief start
+        Start the writer thread
+        \param interval_ms idle wait between passes
+        \return true on success
+    */
+    bool start(unsigned interval_ms = 5);
+
+    /*!
+        \brief stop
+        Stop the writer thread and commit everything queued
+    */
+    void stop();
+
+    /*!
+        \brief flush
+        Commit everything queued from the calling thread
+        \return number of values committed
+    */
+    size_t flush();
+
+    size_t queued() const { return _queued; }    //!< values accepted
+    size_t written() const { return _written; }  //!< values committed to the backend
+    size_t dropped() const { return _dropped; }  //!< values discarded by DropOldest
+    size_t spilled() const { return _spilled; }  //!< values sent to the overflow lists
+    size_t failed() const { return _failed; }    //!< values the backend refused
+
+    // HistoryDataBackend
+    void deleteMembers() override { stop(); }
+    UA_StatusCode serverSetHistoryData(Context& c, bool historizing, const UA_DataValue* value) override;
+};
+
+}  // namespace Open62541
+
+#endif  // HISTORYINGESTQUEUE_H
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef HISTORYMULTIREADER_H
+#define HISTORYMULTIREADER_H
+#include <open62541cpp/open62541client.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace Open62541 {
+
+/*!
+    \brief The HistoryMultiReader class
+    Reads the raw history of many nodes over a time range. Many nodes are packed into each HistoryRead request and
+    every node pages through its range with its own continuation point - a node that has finished makes room in the
+    next request for a node that has not started.
+    The work can be spread over a pool of sessions - one thread per session takes nodes from a shared queue.
+    A continuation point belongs to the session that issued it, so once a node has started it stays on its session.
+    Pages and completions are delivered per node as they arrive, from the thread of the session that read them.
+    A session whose service call fails is retired - its nodes not started go back to the queue for the others and
+    the nodes it had started fail with the error.
+    \code
+    HistoryMultiReader r(client);
+    r.addSession(client2);
+    r.setRange(start, end);
+    for (auto& n : nodes)
+        r.add(n);
+    r.read([](size_t node, const UA_HistoryData& page) { ... },
+           [](size_t node, UA_StatusCode status, size_t rows) { ... });
+    \endcode
+*/
+class UA_EXPORT HistoryMultiReader
+{
+public:
+    typedef std::function<void(size_t node, const UA_HistoryData& page)> PageFunc;
+    typedef std::function<void(size_t node, UA_StatusCode status, size_t rows)> DoneFunc;
+
+private:
+    struct Read {
+        size_t node = 0;
+        UA_ByteString continuation;  // empty until the first page
+        size_t rows = 0;
+        Read() { UA_ByteString_init(&continuation); }
+    };
+
+    std::vector<Client*> _sessions;
+    std::vector<NodeId> _nodes;
+    UA_DateTime _start                = 0;
+    UA_DateTime _end                  = 0;
+    size_t _pageSize                  = 1000;
+    size_t _nodesPerRequest           = 100;
+    bool _returnBounds                = false;
+    UA_TimestampsToReturn _timestamps = UA_TIMESTAMPSTORETURN_BOTH;
+    //
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    std::deque<size_t> _waiting;                 // nodes not started
+    size_t _active      = 0;                     // nodes taken by a session and not finished
+    size_t _live        = 0;                     // sessions still reading
+    UA_StatusCode _lost = UA_STATUSCODE_GOOD;    // error of the last session retired
+    std::atomic<bool> _stop{false};
+    std::atomic<size_t> _requests{0};
+    std::atomic<size_t> _failed{0};
+
+    bool take(size_t& node);
+    bool wait();
+    void requeue(std::vector<Read>& reads);
+    void finish(size_t node, UA_StatusCode status, size_t rows, const DoneFunc& done);
+    void run(Client& c, const PageFunc& page, const DoneFunc& done);
+    bool request(Client& c, std::vector<Read>& reads, bool release, UA_HistoryReadResponse& response);
+
+public:
+    /*!
+        \brief HistoryMultiReader
+        \param c first session
+    */
+    explicit HistoryMultiReader(Client& c) { _sessions.push_back(&c); }
+    HistoryMultiReader(const HistoryMultiReader&) = delete;
+    HistoryMultiReader& operator=(const HistoryMultiReader&) = delete;
+    virtual ~HistoryMultiReader() {}
+
+    /*!
+        \brief addSession
+        Read on another connected client as well
+        \param c
+    */
+    void addSession(Client& c) { _sessions.push_back(&c); }
+
+    /*!
+        \brief setRange
+        \param start
+        \param end
+        \param pageSize most values of a node in one response
+        \param returnBounds return the bounding values of the range
+        \param ts timestamps to return
+    */
+    void setRange(UA_DateTime start,
+                  UA_DateTime end,
+                  size_t pageSize          = 1000,
+                  bool returnBounds        = false,
+                  UA_TimestampsToReturn ts = UA_TIMESTAMPSTORETURN_BOTH)
+    {
+        _start        = start;
+        _end          = end;
+        _pageSize     = std::max<size_t>(1, pageSize);
+        _returnBounds = returnBounds;
+        _timestamps   = ts;
+    }
+
+    /*!
+        \brief setNodesPerRequest
+        Halved for the session if the server reports too many operations
+        \param n most nodes in one request
+    */
+    void setNodesPerRequest(size_t n) { _nodesPerRequest = std::max<size_t>(1, n); }
+
+    /*!
+        \brief add
+        \param n node to read
+        \return index of the node passed to the handlers
+    */
+    size_t add(const NodeId& n)
+    {
+        _nodes.push_back(n);
+        return _nodes.size() - 1;
+    }
+
+    /*!
+        \brief nodeId
+        \param node index
+        \return the node
+    */
+    const NodeId& nodeId(size_t node) const { return _nodes[node]; }
+
+    /*!
+        \brief read
+        Read every node - returns when all have completed or the read is stopped. Handlers are called on the calling
+        thread for the first session and on a thread of its own for each other session.
+        \param page called with each page of a node - the values are only valid during the call
+        \param done called once for each node with the status of its read and the number of values
+        \return false if any node failed
+    */
+    bool read(PageFunc page, DoneFunc done);
+
+    /*!
+        \brief stop
+        Stop reading - may be called from a handler or another thread. Continuation points are released and the
+        nodes not finished complete with BADREQUESTCANCELLEDBYCLIENT
+    */
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> l(_mutex);
+            _stop = true;
+        }
+        _changed.notify_all();
+    }
+
+    size_t nodes() const { return _nodes.size(); }        //!< nodes added
+    size_t sessions() const { return _sessions.size(); }  //!< sessions in the pool
+    size_t requests() const { return _requests; }         //!< requests sent by the last read
+    size_t failed() const { return _failed; }             //!< nodes that failed in the last read
+};
+
+}  // namespace Open62541
+
+#endif  // HISTORYMULTIREADER_H
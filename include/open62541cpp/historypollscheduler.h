@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef HISTORYPOLLSCHEDULER_H
+#define HISTORYPOLLSCHEDULER_H
+#include <open62541cpp/historydatabase.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace Open62541 {
+
+/*!
+    \brief The HistoryPollScheduler class
+    History data gathering that polls every node from a single server timer in place of a repeated callback per node.
+    Polled nodes are grouped by interval into buckets that fall due on multiples of their interval, so nodes with the
+    same or related intervals are read together. The timer runs at the greatest common divisor of the intervals.
+    A bucket is read in one pass and the samples are then handed to the backends in one pass.
+    Nodes with the value set strategy are stored as they are written, as the default gathering does.
+*/
+class UA_EXPORT HistoryPollScheduler : public HistoryDataGathering
+{
+    struct NodeEntry {
+        NodeId nodeId;
+        UA_HistorizingNodeIdSettings setting;
+        bool polling       = false;
+        UA_UInt64 interval = 0;  // bucket polled in
+        size_t slot        = 0;  // position in the bucket
+    };
+    typedef std::unique_ptr<NodeEntry> NodeEntryPtr;
+
+    struct Bucket {
+        UA_DateTime due = 0;  // monotonic time of the next poll
+        std::vector<NodeEntry*> entries;
+    };
+
+    std::mutex _mutex;
+    std::unordered_map<NodeId, NodeEntryPtr, NodeIdHash, NodeIdEqual> _nodes;
+    std::map<UA_UInt64, Bucket> _buckets;  // by interval in ms
+    Server* _server    = nullptr;
+    UA_UInt64 _timerId = 0;
+    UA_UInt64 _tick    = 0;  // timer interval in ms
+    std::vector<UA_DataValue> _values;
+    std::atomic<size_t> _polls{0};
+    std::atomic<size_t> _samples{0};
+
+    static UA_UInt64 pollInterval(const UA_HistorizingNodeIdSettings& s)
+    {
+        return std::max<UA_UInt64>(1, s.pollingInterval);
+    }
+    void addToBucket(NodeEntry& e);
+    void removeFromBucket(NodeEntry& e);
+    void updateTimer();
+    void tick();
+    void poll(Bucket& b);
+
+public:
+    /*!
+        \brief HistoryPollScheduler
+    */
+    HistoryPollScheduler() { initialise(); }
+    HistoryPollScheduler(const HistoryPollScheduler&) = delete;
+    HistoryPollScheduler& operator=(const HistoryPollScheduler&) = delete;
+
+    /*!
+        \brief ~HistoryPollScheduler
+    */
+    ~HistoryPollScheduler() { deleteMembers(); }
+
+    /*!
+        \brief nodes
+        \return number of registered nodes
+    */
+    size_t nodes();
+
+    /*!
+        \brief buckets
+        \return number of poll intervals in use
+    */
+    size_t buckets();
+
+    size_t polls() const { return _polls; }      //!< buckets polled
+    size_t samples() const { return _samples; }  //!< values passed to backends
+
+    // HistoryDataGathering
+    void deleteMembers() override;
+    UA_StatusCode registerNodeId(Context& c, const UA_HistorizingNodeIdSettings setting) override;
+    UA_StatusCode stopPoll(Context& c) override;
+    UA_StatusCode startPoll(Context& c) override;
+    UA_Boolean updateNodeIdSetting(Context& c, const UA_HistorizingNodeIdSettings setting) override;
+    const UA_HistorizingNodeIdSettings* getHistorizingSetting(Context& c) override;
+    void setValue(Context& c, UA_Boolean historizing, const UA_DataValue* value) override;
+};
+
+/*!
+    \brief The ScheduledMemoryHistorian class
+    Memory historian whose polled nodes are gathered by a HistoryPollScheduler
+*/
+class UA_EXPORT ScheduledMemoryHistorian : public Historian
+{
+    HistoryPollScheduler _scheduler;
+
+public:
+    /*!
+        \brief ScheduledMemoryHistorian
+        \param numberNodes
+        \param maxValuesPerNode
+    */
+    ScheduledMemoryHistorian(size_t numberNodes = 100, size_t maxValuesPerNode = 100)
+    {
+        gathering() = _scheduler.gathering();
+        database()  = UA_HistoryDatabase_default(gathering());
+        backend()   = UA_HistoryDataBackend_Memory(numberNodes, maxValuesPerNode);
+    }
+
+    /*!
+        \brief scheduler
+        \return the gathering
+    */
+    HistoryPollScheduler& scheduler() { return _scheduler; }
+};
+
+}  // namespace Open62541
+
+#endif  // HISTORYPOLLSCHEDULER_H
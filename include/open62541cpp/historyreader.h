@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef HISTORYREADER_H
+#define HISTORYREADER_H
+#include <open62541cpp/open62541client.h>
+#include <open62541cpp/historyaggregates.h>
+
+namespace Open62541 {
+
+/*!
+    \brief historyValue
+    Convert a history value to a column type - numeric scalars convert to any arithmetic type
+    \param v
+    \param out
+    \return false if v has no value of the type
+*/
+template <typename T> inline bool historyValue(const UA_Variant& v, T& out)
+{
+    UA_Double d = 0;
+    if (!HistoryAggregate::toDouble(v, d))
+        return false;
+    out = static_cast<T>(d);
+    return true;
+}
+
+template <> inline bool historyValue<Variant>(const UA_Variant& v, Variant& out)
+{
+    out.assignFrom(v);
+    return !UA_Variant_isEmpty(&v);
+}
+
+/*!
+    \brief The HistoryColumns struct
+    A page of history values held column wise. The columns are sized for a page once and reused, so reading a range
+    of any length takes constant memory.
+*/
+template <typename T> struct HistoryColumns {
+    std::vector<UA_DateTime> sourceTime;
+    std::vector<UA_DateTime> serverTime;
+    std::vector<T> values;
+    std::vector<UA_StatusCode> status;
+    std::vector<UA_Byte> hasValue;  // 0 if the value is missing or does not convert to T
+    size_t size = 0;                // rows of the current page
+
+    /*!
+        \brief reserve
+        \param n rows
+    */
+    void reserve(size_t n)
+    {
+        if (n > values.size()) {
+            sourceTime.resize(n);
+            serverTime.resize(n);
+            values.resize(n);
+            status.resize(n);
+            hasValue.resize(n);
+        }
+    }
+
+    size_t capacity() const { return values.size(); }  //!< rows that fit without growing
+};
+
+/*!
+    \brief The HistoryReader class
+    Pulls the raw history of a node from a server one page at a time. A page is requested only when next() is
+    called, so the consumer sets the pace and the server holds the position in its continuation point meanwhile.
+    Values are decoded straight into the caller's columns.
+    \code
+    HistoryReader r(client, node, start, end, 10000);
+    HistoryColumns<double> page;
+    while (r.next(page)) {
+        for (size_t i = 0; i < page.size; i++)
+            ...
+    }
+    if (!r.ok()) ...
+    \endcode
+*/
+class UA_EXPORT HistoryReader
+{
+    Client& _client;
+    NodeId _nodeId;
+    UA_DateTime _start;
+    UA_DateTime _end;
+    size_t _pageSize;
+    bool _returnBounds;
+    UA_TimestampsToReturn _timestamps;
+    UA_ByteString _continuation;  // where the server carries on from
+    UA_HistoryReadResponse _response;
+    bool _done               = false;
+    UA_StatusCode _lastError = UA_STATUSCODE_GOOD;
+    size_t _rows             = 0;
+    size_t _pages            = 0;
+
+    const UA_HistoryData* fetch();
+    bool request(bool release);
+
+public:
+    /*!
+        \brief HistoryReader
+        \param c connected client
+        \param n node
+        \param start start of the range
+        \param end end of the range - before start to read backwards
+        \param pageSize most values in one page
+        \param returnBounds return the bounding values of the range
+        \param ts timestamps to return
+    */
+    HistoryReader(Client& c,
+                  const NodeId& n,
+                  UA_DateTime start,
+                  UA_DateTime end,
+                  size_t pageSize          = 1000,
+                  bool returnBounds        = false,
+                  UA_TimestampsToReturn ts = UA_TIMESTAMPSTORETURN_BOTH);
+    HistoryReader(const HistoryReader&) = delete;
+    HistoryReader& operator=(const HistoryReader&) = delete;
+
+    /*!
+        \brief ~HistoryReader
+        Releases the continuation point of an unfinished read - the client must still exist
+    */
+    virtual ~HistoryReader();
+
+    /*!
+        \brief next
+        Read the next page
+        \param c columns - grown if a page does not fit
+        \return rows in the page, 0 at the end of the range or on error
+    */
+    template <typename T> size_t next(HistoryColumns<T>& c)
+    {
+        c.reserve(_pageSize);
+        c.size = 0;
+        while ((c.size == 0) && !_done) {
+            const UA_HistoryData* d = fetch();
+            if (!d)
+                continue;
+            c.reserve(d->dataValuesSize);
+            for (size_t i = 0; i < d->dataValuesSize; i++) {
+                const UA_DataValue& v = d->dataValues[i];
+                c.sourceTime[i]       = v.hasSourceTimestamp ? v.sourceTimestamp : 0;
+                c.serverTime[i]       = v.hasServerTimestamp ? v.serverTimestamp : 0;
+                c.status[i]           = v.hasStatus ? v.status : UA_STATUSCODE_GOOD;
+                c.hasValue[i]         = (v.hasValue && historyValue(v.value, c.values[i])) ? 1 : 0;
+            }
+            c.size = d->dataValuesSize;
+        }
+        UA_HistoryReadResponse_clear(&_response);
+        _rows += c.size;
+        return c.size;
+    }
+
+    /*!
+        \brief close
+        Stop reading - the server is told to release the continuation point
+    */
+    void close();
+
+    /*!
+        \brief setPageSize
+        \param n most values in the following pages
+    */
+    void setPageSize(size_t n) { _pageSize = std::max<size_t>(1, n); }
+
+    bool done() const { return _done; }                           //!< range read or read failed
+    bool ok() const { return !UA_StatusCode_isBad(_lastError); }  //!< no error so far
+    UA_StatusCode lastError() const { return _lastError; }        //!< status of the last page
+    size_t rows() const { return _rows; }                         //!< values read
+    size_t pages() const { return _pages; }                       //!< requests made
+    bool pending() const { return _continuation.length > 0; }     //!< server holds a continuation point
+    const NodeId& nodeId() const { return _nodeId; }              //!< node read
+};
+
+}  // namespace Open62541
+
+#endif  // HISTORYREADER_H
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef HISTORYREPLAYER_H
+#define HISTORYREPLAYER_H
+#include <open62541cpp/historybulk.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <thread>
+
+namespace Open62541 {
+
+class Server;
+
+/*!
+    \brief The HistoryReplayer class
+    Replays a recorded window of history into live nodes - for testing HMI and alarm logic and as a repeatable load
+    for subscription and historian benchmarks.
+    The history of each source node is read a page at a time from a backend and the pages are merged across nodes
+    with a heap on the original timestamps, so values are written in the order they were recorded. The replay thread
+    releases values at real time, a multiple of real time or as fast as possible, and they are written with
+    Server::writeDataValue from the server loop - attach() the replayer to the server before replaying. At most a
+    page of values waits for the server loop, so a fast replay is paced by the server.
+    Source and target nodes may differ so a recording can be replayed into a copy of the address space.
+    A derived class overriding replayed() or finished() must call stop() in its own destructor - the base destructor
+    runs after the derived object has gone.
+*/
+class UA_EXPORT HistoryReplayer
+{
+    struct Channel {
+        NodeId source;
+        NodeId target;
+        std::vector<FileHistoryRecord> page;
+        size_t next      = 0;  // next record of the page
+        UA_DateTime from = 0;  // start of the next page
+        size_t skip      = 0;  // records at from already replayed
+        bool done        = false;
+    };
+
+    /*!
+        \brief The Outbox struct
+        Values released by the replay thread waiting for the server loop. Shared with the process handler so a handler
+        left attached after the replayer has gone does nothing
+    */
+    struct Outbox {
+        std::mutex mutex;
+        std::condition_variable drained;
+        std::vector<std::pair<NodeId, UA_DataValue>> values;  // owns the data values
+        size_t pending         = 0;                           // queued or being written
+        HistoryReplayer* owner = nullptr;                     // null once the replayer has gone
+    };
+    typedef std::shared_ptr<Outbox> OutboxRef;
+
+    Server& _server;
+    HistoryBulk _reader;
+    std::string _name;
+    OutboxRef _outbox;
+    std::vector<Channel> _channels;
+    size_t _pageSize   = 4096;
+    bool _retimestamp  = true;
+    UA_DateTime _start = 0;
+    UA_DateTime _end   = 0;
+    double _speed      = 1.0;
+    std::thread _thread;
+    std::atomic<bool> _running{false};
+    std::mutex _wakeMutex;
+    std::condition_variable _wake;
+    std::atomic<size_t> _written{0};
+    std::atomic<size_t> _failed{0};
+    std::atomic<UA_DateTime> _position{0};
+    std::atomic<UA_StatusCode> _lastError{UA_STATUSCODE_GOOD};
+
+    bool fetch(Channel& c);
+    void replay();
+    bool release(const NodeId& target, UA_DataValue& v);
+    static void apply(Server& server, Outbox& o);
+
+public:
+    /*!
+        \brief HistoryReplayer
+        \param server server holding the live nodes
+        \param backend history to replay - record level access is used if the backend supports it
+        \param name name of the server process handler
+    */
+    HistoryReplayer(Server& server, const UA_HistoryDataBackend& backend, const std::string& name = "HistoryReplayer");
+    HistoryReplayer(const HistoryReplayer&) = delete;
+    HistoryReplayer& operator=(const HistoryReplayer&) = delete;
+
+    /*!
+        \brief ~HistoryReplayer
+        Stops the replay - too late for the callbacks of a derived class, see stop()
+    */
+    virtual ~HistoryReplayer();
+
+    /*!
+        \brief attach
+        Write released values from the server loop - call before the server is started or from the server thread
+    */
+    void attach();
+
+    /*!
+        \brief detach
+        Call before the server is started or from the server thread
+    */
+    void detach();
+
+    /*!
+        \brief addNode
+        Nodes cannot be added while replaying
+        \param source node whose history is replayed
+        \param target node written to - the source if null
+    */
+    void addNode(const NodeId& source, const NodeId& target = NodeId());
+
+    /*!
+        \brief clearNodes
+    */
+    void clearNodes();
+
+    /*!
+        \brief setPageSize
+        \param n records read from the backend for a node at a time and values waiting for the server loop
+    */
+    void setPageSize(size_t n) { _pageSize = std::max<size_t>(1, n); }
+
+    /*!
+        \brief setRetimestamp
+        \param f if true values carry the time they are written, otherwise their recorded timestamps
+    */
+    void setRetimestamp(bool f) { _retimestamp = f; }
+
+    /*!
+        \brief start
+        \param start start of the recorded window
+        \param end end of the window - values at or after it are not replayed, 0 for up to the time the replay starts
+        \param speed 1 for real time, N for N times real time, 0 for as fast as possible
+        \return true if started
+    */
+    bool start(UA_DateTime start, UA_DateTime end = 0, double speed = 1.0);
+
+    /*!
+        \brief stop
+        Stop replaying and wait for the replay thread - values not yet written are dropped and no callback runs once
+        this returns. Derived classes overriding the callbacks call this from their destructor
+    */
+    void stop();
+
+    /*!
+        \brief wait
+        Wait for the replay to finish - every value released has been written by then
+    */
+    void wait();
+
+    /*!
+        \brief running
+        \return true while replaying
+    */
+    bool running() const { return _running; }
+
+    size_t written() const { return _written; }         //!< values written by the last replay
+    size_t failed() const { return _failed; }           //!< values the server did not accept
+    UA_DateTime position() const { return _position; }  //!< recorded time of the last value released
+
+    /*!
+        \brief replayed
+        Called from the server thread after each value is written
+        \param target node written
+        \param value value written
+        \param ok true if the server accepted the value
+    */
+    virtual void replayed(const NodeId& /*target*/, const UA_DataValue& /*value*/, bool /*ok*/) {}
+
+    /*!
+        \brief finished
+        Called from the replay thread when the window has been replayed or the replay is stopped
+    */
+    virtual void finished() {}
+
+    /*!
+        \brief lastError
+        \return reason the last replay ended early
+    */
+    UA_StatusCode lastError() const { return _lastError; }
+
+    /*!
+        \brief lastOK
+        \return true if the last replay ran to the end
+    */
+    bool lastOK() const { return _lastError == UA_STATUSCODE_GOOD; }
+};
+
+}  // namespace Open62541
+
+#endif  // HISTORYREPLAYER_H
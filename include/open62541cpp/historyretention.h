@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef HISTORYRETENTION_H
+#define HISTORYRETENTION_H
+#include <open62541cpp/historyaggregates.h>
+#include <open62541cpp/filehistorybackend.h>
+#include <atomic>
+#include <functional>
+#include <unordered_set>
+
+namespace Open62541 {
+
+/*!
+    \brief The HistoryRollup struct
+    Statistics of the raw values of a node in one interval of a rollup tier
+*/
+struct HistoryRollup {
+    UA_DateTime time  = 0;  //!< start of the interval
+    UA_Double average = 0.0;
+    UA_Double minimum = 0.0;
+    UA_Double maximum = 0.0;
+    UA_Double count   = 0.0;  //!< number of raw values
+};
+
+/*!
+    \brief The HistoryRetentionManager class
+    Tiered retention for the nodes of a historian. Raw values are kept for the raw retention period, rollup tiers of
+    increasing resolution (for example 1 minute for a year, 1 hour forever) are built incrementally as the data ages.
+    Each tier is a FileHistoryBackend holding an average, minimum, maximum and count channel per node.
+    A pass on a server timer rolls up completed intervals, deletes what has expired - never data that is not yet
+    rolled up - and compacts sealed segments. Passes run in the server thread like the rest of the history service.
+    As a history database ReadProcessed is answered from the coarsest tier that satisfies the processing interval
+    and aggregate, and ReadRaw of a managed node is split at the raw retention: times no longer held as raw values
+    are answered with the averages of the finest tier covering them, later times with the raw values. Reads of
+    other nodes go to the raw values unchanged.
+*/
+class UA_EXPORT HistoryRetentionManager : public AggregateHistoryDatabase
+{
+public:
+    enum Channel { AverageChannel = 0, MinimumChannel, MaximumChannel, CountChannel, NumberChannels };
+
+    struct Tier {
+        UA_DateTime resolution = 0;
+        UA_DateTime retention  = 0;  //!< 0 keeps the tier forever
+        std::unique_ptr<FileHistoryBackend> store;
+    };
+    typedef std::unique_ptr<Tier> TierPtr;
+
+private:
+    std::string _directory;
+    UA_DateTime _rawRetention = 0;
+    std::vector<TierPtr> _tiers;  // finest first
+    std::mutex _mutex;            // nodes and watermarks
+    std::vector<NodeId> _nodes;
+    std::unordered_set<NodeId, NodeIdHash, NodeIdEqual> _managed;
+    // per node and tier - everything before this time is rolled up, 0 if unknown
+    std::unordered_map<NodeId, std::vector<UA_DateTime>, NodeIdHash, NodeIdEqual> _watermarks;
+    std::mutex _processMutex;  // one pass at a time
+    Server* _server    = nullptr;
+    UA_UInt64 _timerId = 0;
+    std::atomic<size_t> _rollups{0};
+
+    UA_DateTime watermark(UA_Server* server, const NodeId& n, size_t tier);
+    void setWatermark(const NodeId& n, size_t tier, UA_DateTime t);
+    const UA_HistoryDataBackend* rawBackend(UA_Server* server, const NodeId& n);
+    size_t rollup(UA_Server* server, const NodeId& n, size_t tier);
+    void expire(UA_Server* server, const NodeId& n, UA_DateTime now);
+    int processedTier(UA_Server* server,
+                      const NodeId& n,
+                      HistoryAggregate::Type type,
+                      UA_DateTime start,
+                      UA_DateTime end,
+                      UA_DateTime interval);
+    bool managed(const NodeId& n);
+    UA_DateTime rawCutoff(UA_Server* server, const NodeId& n);
+    size_t readTiers(UA_Server* server,
+                     const NodeId& n,
+                     UA_DateTime from,
+                     UA_DateTime to,
+                     bool reverse,
+                     size_t limit,
+                     std::vector<HistoryAggregate::Result>& r);
+    bool boundValue(UA_Server* server,
+                    const NodeId& n,
+                    UA_DateTime split,
+                    UA_DateTime t,
+                    MatchStrategy strategy,
+                    UA_DataValue& v);
+    void readRawDefault(Context& c,
+                        const UA_RequestHeader* requestHeader,
+                        const UA_ReadRawModifiedDetails& details,
+                        UA_TimestampsToReturn timestampsToReturn,
+                        UA_Boolean releaseContinuationPoints,
+                        const UA_HistoryReadValueId& item,
+                        UA_HistoryReadResult& result,
+                        UA_HistoryData* data);
+    UA_StatusCode readRawTiered(Context& c,
+                                const UA_RequestHeader* requestHeader,
+                                const UA_ReadRawModifiedDetails& details,
+                                UA_TimestampsToReturn timestampsToReturn,
+                                UA_Boolean releaseContinuationPoints,
+                                const UA_HistoryReadValueId& item,
+                                UA_HistoryReadResult& result,
+                                UA_HistoryData* data);
+    UA_StatusCode processTier(Context& c,
+                              const UA_NodeId& nodeId,
+                              HistoryAggregate::Type type,
+                              UA_DateTime start,
+                              UA_DateTime end,
+                              UA_DateTime interval,
+                              bool reverse,
+                              size_t tier,
+                              UA_TimestampsToReturn timestampsToReturn,
+                              UA_HistoryData* result);
+
+public:
+    /*!
+        \brief HistoryRetentionManager
+        \param gathering the gathering of the historian - shallow copied
+        \param directory root of the tier stores - created if it does not exist
+    */
+    HistoryRetentionManager(const UA_HistoryDataGathering& gathering, const std::string& directory);
+
+    /*!
+        \brief ~HistoryRetentionManager
+    */
+    virtual ~HistoryRetentionManager();
+
+    /*!
+        \brief setRawRetention
+        \param retention how long raw values are kept - 0 keeps them forever
+    */
+    void setRawRetention(UA_DateTime retention) { _rawRetention = retention; }
+
+    /*!
+        \brief addTier
+        Tiers are added finest first, each resolution a multiple of the one before. Add tiers before start().
+        \param resolution interval of the rollups
+        \param retention how long the rollups are kept - 0 keeps them forever
+        \return true on success
+    */
+    bool addTier(UA_DateTime resolution, UA_DateTime retention = 0);
+
+    size_t tiers() const { return _tiers.size(); }
+    Tier& tier(size_t i) { return *_tiers[i]; }
+
+    /*!
+        \brief addNode
+        \param n a historized node to manage
+    */
+    void addNode(const NodeId& n);
+
+    /*!
+        \brief channel
+        \param n
+        \param c
+        \return the node id a channel of n is stored under in a tier
+    */
+    static NodeId channel(const NodeId& n, Channel c);
+
+    /*!
+        \brief readRollups
+        \param server
+        \param n
+        \param tier
+        \param start first interval wanted
+        \param end intervals starting at or after this are not wanted
+        \param f called with blocks of rollups - return false to stop
+        \return true if the tier has rollups for the node
+    */
+    bool readRollups(UA_Server* server,
+                     const NodeId& n,
+                     size_t tier,
+                     UA_DateTime start,
+                     UA_DateTime end,
+                     const std::function<bool(const HistoryRollup*, size_t)>& f);
+
+    /*!
+        \brief process
+        One pass - roll up, expire and compact every node
+        \param server
+        \return number of rollups written
+    */
+    size_t process(Server& server);
+
+    /*!
+        \brief start
+        Run process() from a repeated server timer - call before the server is started or from the server thread
+        \param server
+        \param interval_ms time between passes
+        \return true on success
+    */
+    bool start(Server& server, unsigned interval_ms = 60000);
+
+    /*!
+        \brief stop
+        Remove the timer - safe to call more than once
+    */
+    void stop();
+
+    size_t rollups() const { return _rollups; }  //!< rollups written since construction
+
+    // HistoryDatabase
+    void deleteMembers() override;
+    void readRaw(Context& c,
+                 const UA_RequestHeader* requestHeader,
+                 const UA_ReadRawModifiedDetails* historyReadDetails,
+                 UA_TimestampsToReturn timestampsToReturn,
+                 UA_Boolean releaseContinuationPoints,
+                 size_t nodesToReadSize,
+                 const UA_HistoryReadValueId* nodesToRead,
+                 UA_HistoryReadResponse* response,
+                 UA_HistoryData* const* const historyData) override;
+    void readProcessed(Context& c,
+                       const UA_RequestHeader* requestHeader,
+                       const UA_ReadProcessedDetails* historyReadDetails,
+                       UA_TimestampsToReturn timestampsToReturn,
+                       UA_Boolean releaseContinuationPoints,
+                       size_t nodesToReadSize,
+                       const UA_HistoryReadValueId* nodesToRead,
+                       UA_HistoryReadResponse* response,
+                       UA_HistoryData* const* const historyData) override;
+};
+
+}  // namespace Open62541
+
+#endif  // HISTORYRETENTION_H
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef LIVEVALUETABLE_H
+#define LIVEVALUETABLE_H
+#include <open62541cpp/filehistorybackend.h>
+#include <open62541cpp/clientsubscription.h>
+
+namespace Open62541 {
+
+/*!
+    \brief The LiveValueTable class
+    Latest value of each monitored node, shared by any number of reader threads without locks.
+    Values are kept in a dense array of slots allocated once. Each slot is a seqlock - a writer makes the version odd
+    while it stores the value, readers copy the value and retry if the version changed under them. Readers never
+    block the writer or each other.
+    Every update takes the next number of a table wide change sequence and stamps it on its slot, so changedSince()
+    finds what changed after a given point with one pass over the slot stamps.
+    Values are held in the compact scalar form of the file history backend - values that do not fit are stored as
+    their status with no value.
+*/
+class UA_EXPORT LiveValueTable
+{
+public:
+    static const size_t npos = size_t(-1);
+
+private:
+    static const size_t WORDS = (sizeof(FileHistoryRecord) + 7) / 8;
+
+    struct alignas(64) Slot {
+        std::atomic<UA_UInt64> version{0};  // odd while being written
+        std::atomic<UA_UInt64> change{0};   // change sequence of the last update
+        std::atomic<UA_UInt64> words[WORDS];
+    };
+
+    std::unique_ptr<Slot[]> _slots;
+    std::vector<NodeId> _nodes;  // node of each slot - reserved up front so it never moves
+    size_t _capacity = 0;
+    std::atomic<size_t> _size{0};
+    std::atomic<UA_UInt64> _sequence{0};
+    std::atomic<size_t> _unsupported{0};
+    std::mutex _mutex;  // adding slots
+    std::unordered_map<NodeId, size_t, NodeIdHash, NodeIdEqual> _index;
+
+public:
+    /*!
+        \brief LiveValueTable
+        \param capacity maximum number of nodes
+    */
+    explicit LiveValueTable(size_t capacity = 4096);
+    LiveValueTable(const LiveValueTable&) = delete;
+    LiveValueTable& operator=(const LiveValueTable&) = delete;
+    virtual ~LiveValueTable() {}
+
+    /*!
+        \brief add
+        \param n
+        \return slot of the node - an existing slot if already added - or npos if the table is full
+    */
+    size_t add(const NodeId& n);
+
+    /*!
+        \brief find
+        \param n
+        \return slot of the node or npos
+    */
+    size_t find(const NodeId& n);
+
+    /*!
+        \brief monitor
+        Add a node and monitor it on a subscription - its data changes update the node's slot
+        \param s subscription
+        \param n node
+        \param slot receives the slot of the node
+        \return monitored item id or 0 on failure
+    */
+    unsigned monitor(ClientSubscription& s, NodeId& n, size_t* slot = nullptr);
+
+    /*!
+        \brief update
+        Store the latest value of a slot - writers to one slot are serialised
+        \param slot
+        \param v
+    */
+    void update(size_t slot, const UA_DataValue& v);
+
+    /*!
+        \brief snapshot
+        Copy a slot without locking
+        \param slot
+        \param r receives the value
+        \param change receives the change sequence of the value, 0 if never updated
+        \return false if the slot is out of range
+    */
+    bool snapshot(size_t slot, FileHistoryRecord& r, UA_UInt64* change = nullptr) const;
+
+    /*!
+        \brief read
+        \param slot
+        \param v destination - must be initialised or cleared
+        \param change receives the change sequence of the value
+        \return false if the slot is out of range or has never been updated
+    */
+    bool read(size_t slot, UA_DataValue& v, UA_UInt64* change = nullptr) const;
+
+    /*!
+        \brief read
+        \param slot
+        \param v
+        \return false if the slot is out of range or has never been updated
+    */
+    bool read(size_t slot, Variant& v) const;
+
+    /*!
+        \brief changedSince
+        \param n change sequence from an earlier call to sequence()
+        \param slots receives the slots updated after n
+        \return the current change sequence - pass it to the next call
+    */
+    UA_UInt64 changedSince(UA_UInt64 n, std::vector<size_t>& slots) const;
+
+    /*!
+        \brief sequence
+        \return change sequence of the last update
+    */
+    UA_UInt64 sequence() const { return _sequence.load(std::memory_order_acquire); }
+
+    /*!
+        \brief nodeId
+        \param slot
+        \return node of the slot
+    */
+    const NodeId& nodeId(size_t slot) const { return _nodes[slot]; }
+
+    size_t size() const { return _size.load(std::memory_order_acquire); }  //!< slots in use
+    size_t capacity() const { return _capacity; }                         //!< maximum slots
+    size_t unsupported() const { return _unsupported; }                   //!< values too large to store
+};
+
+}  // namespace Open62541
+
+#endif  // LIVEVALUETABLE_H
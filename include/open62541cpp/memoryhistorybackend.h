@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef MEMORYHISTORYBACKEND_H
+#define MEMORYHISTORYBACKEND_H
+#include <open62541cpp/filehistorybackend.h>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+
+namespace Open62541 {
+
+/*!
+    \brief The MemoryHistoryBackend class
+    In memory history storage. Each node has a ring buffer held as separate arrays of timestamps, values, status and
+    types so date matching is a binary search over the timestamps and block reads touch only the arrays they need.
+    Rings start small and double up to a fair share of the global memory budget - the budget divided over the nodes
+    held - and a full ring that cannot grow overwrites its oldest values. A new node that finds the budget spent
+    takes room from the rings above their share, dropping their oldest values. Indexes count values from the first
+    ever stored so continuation points survive overwrites.
+    Nodes are spread over shards, each node has its own reader writer lock - reads of a node run in parallel and
+    only wait for writes to that node. Rings are shared with their readers, so clear() may run during a read.
+    Values are stored as FileHistoryRecords are - scalars of pointer free types up to 8 bytes, in time order.
+*/
+class UA_EXPORT MemoryHistoryBackend : public HistoryDataBackend
+{
+public:
+    static const size_t DEFAULT_BUDGET           = size_t(64) << 20;
+    static const size_t DEFAULT_INITIAL_CAPACITY = 256;
+    static const size_t DEFAULT_MAX_CAPACITY     = size_t(1) << 20;
+    static const size_t SLOT_SIZE = 2 * sizeof(UA_DateTime) + sizeof(UA_UInt64) + sizeof(UA_StatusCode) +
+                                    2 * sizeof(UA_UInt16);  //!< bytes per value
+
+protected:
+    struct Ring {
+        ReadWriteMutex mutex;
+        size_t mask    = 0;  // capacity - 1, the capacity is a power of two
+        UA_UInt64 first = 0;  // index of the oldest value
+        size_t count   = 0;
+        std::vector<UA_DateTime> times;  // source timestamp or server timestamp if there is no source - the key
+        std::vector<UA_DateTime> serverTimes;
+        std::vector<UA_UInt64> values;  // value bytes
+        std::vector<UA_StatusCode> status;
+        std::vector<UA_UInt16> types;
+        std::vector<UA_UInt16> flags;
+        std::atomic<size_t>* used = nullptr;  // budget the slots are counted in - returned when the ring goes
+        size_t capacity() const { return mask + 1; }
+        UA_UInt64 end() const { return first + count; }
+        size_t slot(UA_UInt64 i) const { return size_t(i) & mask; }
+        ~Ring()
+        {
+            if (used && !times.empty())
+                *used -= capacity() * SLOT_SIZE;
+        }
+    };
+    typedef std::shared_ptr<Ring> RingPtr;
+
+    struct Shard {
+        ReadWriteMutex mutex;
+        std::unordered_map<NodeId, RingPtr, NodeIdHash, NodeIdEqual> nodes;
+    };
+    typedef std::unique_ptr<Shard> ShardPtr;
+
+private:
+    std::vector<ShardPtr> _shards;
+    size_t _budget;
+    size_t _initialCapacity;
+    size_t _maxCapacity;
+    std::atomic<size_t> _used{0};
+    std::atomic<size_t> _nodes{0};
+    std::atomic<size_t> _samples{0};
+    std::atomic<size_t> _overwritten{0};
+    std::atomic<size_t> _rejected{0};
+
+    Shard& shard(const NodeId& n) { return *_shards[n.hash() % _shards.size()]; }
+    bool reserve(size_t bytes);
+    bool resize(Ring& r, size_t capacity);
+    size_t share() const;
+    bool reclaim(size_t bytes);
+    UA_UInt64 lowerBound(const Ring& r, UA_DateTime t, bool after) const;
+    void toRecord(const Ring& r, UA_UInt64 i, FileHistoryRecord& record) const;
+    UA_StatusCode push(Ring& r, const FileHistoryRecord& record);
+
+protected:
+    RingPtr ring(const NodeId& n, bool create = false);
+
+public:
+    /*!
+        \brief MemoryHistoryBackend
+        \param budget bytes all rings together may use
+        \param shards number of node shards
+        \param maxCapacity most values one ring holds - rounded up to a power of two
+        \param initialCapacity values a new ring holds - rounded up to a power of two
+    */
+    MemoryHistoryBackend(size_t budget          = DEFAULT_BUDGET,
+                         size_t shards          = 16,
+                         size_t maxCapacity     = DEFAULT_MAX_CAPACITY,
+                         size_t initialCapacity = DEFAULT_INITIAL_CAPACITY);
+    MemoryHistoryBackend(const MemoryHistoryBackend&) = delete;
+    MemoryHistoryBackend& operator=(const MemoryHistoryBackend&) = delete;
+
+    /*!
+        \brief ~MemoryHistoryBackend
+    */
+    virtual ~MemoryHistoryBackend() {}
+
+    /*!
+        \brief add
+        Append a value to the history of a node
+        \param n
+        \param v
+        \return UA_STATUSCODE_GOOD on success
+    */
+    UA_StatusCode add(const NodeId& n, const UA_DataValue& v);
+
+    /*!
+        \brief clear
+        Remove every node - the memory of a ring being read is released when the read ends
+    */
+    void clear();
+
+    /*!
+        \brief size
+        \param n
+        \return number of values held for the node
+    */
+    size_t size(const NodeId& n);
+
+    size_t budget() const { return _budget; }                //!< bytes the rings may use
+    size_t used() const { return _used; }                    //!< bytes the rings use
+    size_t samples() const { return _samples; }              //!< values stored since construction
+    size_t overwritten() const { return _overwritten; }      //!< values lost to full rings
+    size_t rejected() const { return _rejected; }            //!< values refused
+
+    // HistoryDataBackend
+    void deleteMembers() override { clear(); }
+    UA_StatusCode serverSetHistoryData(Context& c, bool historizing, const UA_DataValue* value) override;
+    size_t getDateTimeMatch(Context& c, const UA_DateTime timestamp, const MatchStrategy strategy) override;
+    size_t getEnd(Context& c) override;
+    size_t lastIndex(Context& c) override;
+    size_t firstIndex(Context& c) override;
+    size_t resultSize(Context& c, size_t startIndex, size_t endIndex) override;
+    UA_StatusCode copyDataValues(Context& c,
+                                 size_t startIndex,
+                                 size_t endIndex,
+                                 UA_Boolean reverse,
+                                 size_t valueSize,
+                                 UA_NumericRange range,
+                                 UA_Boolean releaseContinuationPoints,
+                                 std::string& in,
+                                 std::string& out,
+                                 size_t* providedValues,
+                                 UA_DataValue* values) override;
+    const UA_DataValue* getDataValue(Context& c, size_t index) override;
+    size_t readSamples(Context& c,
+                       size_t startIndex,
+                       size_t n,
+                       UA_DateTime* times,
+                       UA_Double* values,
+                       UA_Byte* good) override;
+    size_t appendRecords(const NodeId& n, const FileHistoryRecord* r, size_t count) override;
+    bool readRecords(const NodeId& n,
+                     UA_DateTime start,
+                     UA_DateTime end,
+                     const std::function<bool(const FileHistoryRecord*, size_t)>& f) override;
+    UA_Boolean boundSupported(Context& /*c*/) override { return true; }
+    UA_Boolean timestampsToReturnSupported(Context& /*c*/, const UA_TimestampsToReturn /*t*/) override
+    {
+        return true;
+    }
+    UA_StatusCode insertDataValue(Context& c, const UA_DataValue* value) override;
+    UA_StatusCode removeDataValue(Context& c, UA_DateTime startTimestamp, UA_DateTime endTimestamp) override;
+};
+
+/*!
+    \brief The MemoryRingHistorian class
+    In memory historian using the MemoryHistoryBackend in place of the C memory backend
+*/
+class UA_EXPORT MemoryRingHistorian : public Historian
+{
+    MemoryHistoryBackend _store;
+
+public:
+    /*!
+        \brief MemoryRingHistorian
+        \param numberNodes initial size of the gathering
+        \param budget bytes all nodes together may use
+        \param maxValuesPerNode
+    */
+    MemoryRingHistorian(size_t numberNodes      = 100,
+                        size_t budget           = MemoryHistoryBackend::DEFAULT_BUDGET,
+                        size_t maxValuesPerNode = MemoryHistoryBackend::DEFAULT_MAX_CAPACITY)
+        : _store(budget, 16, maxValuesPerNode)
+    {
+        gathering() = UA_HistoryDataGathering_Default(numberNodes);
+        database()  = UA_HistoryDatabase_default(gathering());
+        backend()   = _store.database();
+    }
+    ~MemoryRingHistorian()
+    {
+        memset(&_backend, 0, sizeof(_backend));  // not a C memory backend
+    }
+
+    MemoryHistoryBackend& store() { return _store; }
+};
+
+}  // namespace Open62541
+
+#endif  // MEMORYHISTORYBACKEND_H
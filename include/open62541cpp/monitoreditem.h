@@ -22,6 +22,142 @@ class MonitoredItemEvent;
 typedef std::function<void(ClientSubscription&, MonitoredItem *,  UA_DataValue*)> monitorItemFunc;
 // call back for an event
 typedef std::function<void(ClientSubscription&, MonitoredItemEvent *, VariantArray&)> monitorEventFunc;
+
+/*!
+    \brief The MonitoringParameters class
+    Builder for the requested parameters of data change monitored items. The defaults match
+    UA_MonitoredItemCreateRequest_default. A data change filter is only sent if a deadband or a trigger other than
+    status and value is set.
+    \code
+    MonitoringParameters p;
+    p.samplingInterval(100).queueSize(10).absoluteDeadband(0.5);
+    \endcode
+*/
+class UA_EXPORT MonitoringParameters
+{
+    UA_Double _samplingInterval   = 250.0;
+    UA_UInt32 _queueSize          = 1;
+    bool _discardOldest           = true;
+    UA_MonitoringMode _mode       = UA_MONITORINGMODE_REPORTING;
+    UA_DataChangeTrigger _trigger = UA_DATACHANGETRIGGER_STATUSVALUE;
+    UA_UInt32 _deadbandType       = UA_DEADBANDTYPE_NONE;
+    UA_Double _deadbandValue      = 0.0;
+
+public:
+    /*!
+        \brief samplingInterval
+        \param ms sampling interval - 0 for the fastest the server supports, -1 for the publishing interval
+        \return this
+    */
+    MonitoringParameters& samplingInterval(UA_Double ms)
+    {
+        _samplingInterval = ms;
+        return *this;
+    }
+
+    /*!
+        \brief queueSize
+        \param n values queued by the server between publishes
+        \return this
+    */
+    MonitoringParameters& queueSize(UA_UInt32 n)
+    {
+        _queueSize = n;
+        return *this;
+    }
+
+    /*!
+        \brief discardOldest
+        \param f if true the oldest queued value is discarded when the queue overflows, otherwise the newest
+        \return this
+    */
+    MonitoringParameters& discardOldest(bool f)
+    {
+        _discardOldest = f;
+        return *this;
+    }
+
+    /*!
+        \brief monitoringMode
+        \param m
+        \return this
+    */
+    MonitoringParameters& monitoringMode(UA_MonitoringMode m)
+    {
+        _mode = m;
+        return *this;
+    }
+
+    /*!
+        \brief trigger
+        \param t change that causes a notification
+        \return this
+    */
+    MonitoringParameters& trigger(UA_DataChangeTrigger t)
+    {
+        _trigger = t;
+        return *this;
+    }
+
+    /*!
+        \brief absoluteDeadband
+        \param v smallest change of value notified
+        \return this
+    */
+    MonitoringParameters& absoluteDeadband(UA_Double v)
+    {
+        _deadbandType  = UA_DEADBANDTYPE_ABSOLUTE;
+        _deadbandValue = v;
+        return *this;
+    }
+
+    /*!
+        \brief percentDeadband
+        The server must know the EURange of the node
+        \param v smallest change notified as a percentage of the EURange
+        \return this
+    */
+    MonitoringParameters& percentDeadband(UA_Double v)
+    {
+        _deadbandType  = UA_DEADBANDTYPE_PERCENT;
+        _deadbandValue = v;
+        return *this;
+    }
+
+    /*!
+        \brief noDeadband
+        \return this
+    */
+    MonitoringParameters& noDeadband()
+    {
+        _deadbandType  = UA_DEADBANDTYPE_NONE;
+        _deadbandValue = 0.0;
+        return *this;
+    }
+
+    /*!
+        \brief hasFilter
+        \return true if a data change filter is needed
+    */
+    bool hasFilter() const
+    {
+        return (_deadbandType != UA_DEADBANDTYPE_NONE) || (_trigger != UA_DATACHANGETRIGGER_STATUSVALUE);
+    }
+
+    /*!
+        \brief apply
+        Set the parameters of a value monitoring request - the node to monitor is not changed
+        \param r request - a filter it already has is replaced
+    */
+    void apply(UA_MonitoredItemCreateRequest& r) const;
+
+    /*!
+        \brief request
+        \param n node to monitor
+        \return request monitoring the value of the node
+    */
+    MonitoredItemCreateRequest request(const NodeId& n) const;
+};
 /*!
     \brief The MonitoredItem class
     This is a single monitored event. Monitored events are associated (owned) by subscriptions
@@ -29,10 +165,11 @@ typedef std::function<void(ClientSubscription&, MonitoredItemEvent *, VariantArr
 class UA_EXPORT MonitoredItem
 {
 private:
-    ClientSubscription& _sub;  // parent subscription
+    ClientSubscription* _sub;  // parent subscription - changed by move
 protected:
     MonitoredItemCreateResult _response;  // response
-    UA_StatusCode _lastError = 0;
+    UA_StatusCode _lastError          = 0;
+    UA_TimestampsToReturn _timestamps = UA_TIMESTAMPSTORETURN_BOTH;  // requested when created
 
     /* Callback for the deletion of a MonitoredItem */
     static void deleteMonitoredItemCallback(UA_Client* client,
@@ -58,6 +195,12 @@ protected:
                                           size_t nEventFields,
                                           UA_Variant* eventFields);
 
+    /* Callback for the response to recreate */
+    static void recreateCallback(UA_Client* client, void* userdata, UA_UInt32 requestId, void* response);
+
+    /* Callback for the deletion of the server items moved items have left */
+    static void moveCallback(UA_Client* client, void* userdata, UA_UInt32 requestId, void* response);
+
 public:
     /*!
         \brief MonitoredItem
@@ -79,7 +222,7 @@ public:
      * \brief subscription
      * \return owning subscription
      */
-    ClientSubscription& subscription() { return _sub; }  // parent subscription
+    ClientSubscription& subscription() { return *_sub; }  // parent subscription
 
     //
     // Notification handlers
@@ -112,6 +255,62 @@ public:
     */
     UA_UInt32 id() { return _response.get().monitoredItemId; }
 
+    /*!
+        \brief detach
+        Forget the server's item without deleting it - used when the session holding it has been lost
+    */
+    void detach() { _response.null(); }
+
+    /*!
+        \brief createRequest
+        The request that created the item, so it can be created again on a new session
+        \param r receives the request
+        \return false if the item cannot be created again
+    */
+    virtual bool createRequest(MonitoredItemCreateRequest& /*r*/) { return false; }
+
+    /*!
+        \brief isEvent
+        \return true if the item delivers events rather than data changes
+    */
+    virtual bool isEvent() const { return false; }
+
+    /*!
+        \brief timestamps
+        \return timestamps requested when the item was created
+    */
+    UA_TimestampsToReturn timestamps() const { return _timestamps; }
+
+    /*!
+        \brief recreate
+        Create items again on their subscription with one asynchronous request. Handles and callbacks are those of
+        the item objects so existing handlers keep working - only the server item ids change.
+        \param s subscription - already created on the current session
+        \param items items of s of one kind (see isEvent) requesting the same timestamps
+        \param done called with the number of items created - always called, from the client thread
+        \return false if the request could not be sent - done has been called
+    */
+    static bool recreate(ClientSubscription& s,
+                         const std::vector<MonitoredItem*>& items,
+                         std::function<void(size_t created)> done);
+
+    /*!
+        \brief move
+        Move items to another subscription of the same session - there is no service for this, so each item is
+        created on the target and the server item it leaves is deleted once that has succeeded. Notifications may
+        arrive from both for a publishing cycle. The item objects move to the target's map and get new ids there;
+        items that could not be created stay where they were.
+        \param from subscription holding the items
+        \param to target subscription
+        \param items items of from of one kind (see isEvent) requesting the same timestamps
+        \param done called with the number of items moved - always called, from the client thread
+        \return false if the request could not be sent - done has been called
+    */
+    static bool move(ClientSubscription& from,
+                     ClientSubscription& to,
+                     const std::vector<MonitoredItem*>& items,
+                     std::function<void(size_t moved)> done);
+
 protected:
     /*!
      * \brief setMonitoringMode
@@ -137,6 +336,8 @@ protected:
 class MonitoredItemDataChange : public MonitoredItem
 {
     monitorItemFunc _func;  // lambda for callback
+    NodeId _nodeId;         // monitored node - kept to create the item again
+    MonitoringParameters _parameters;
 
 public:
     /*!
@@ -172,6 +373,19 @@ public:
             _func(subscription(),this, value);  // invoke functor
     }
 
+    /*!
+        \brief createRequest
+        \param r receives the request
+        \return false if the item has not been added
+    */
+    bool createRequest(MonitoredItemCreateRequest& r) override
+    {
+        if (_nodeId.isNull())
+            return false;
+        r.assignFrom(_parameters.request(_nodeId).get());
+        return true;
+    }
+
     /*!
         \brief addDataChange
         \param n node id
@@ -179,6 +393,31 @@ public:
         \return true on success
     */
     bool addDataChange(NodeId& n, UA_TimestampsToReturn ts = UA_TIMESTAMPSTORETURN_BOTH);
+
+    /*!
+        \brief addDataChange
+        \param n node id
+        \param p monitoring parameters
+        \param ts timestamp specification
+        \return true on success
+    */
+    bool addDataChange(NodeId& n, const MonitoringParameters& p, UA_TimestampsToReturn ts = UA_TIMESTAMPSTORETURN_BOTH);
+
+    /*!
+        \brief addDataChanges
+        Create many data change items in one request. The lastError of each item is its result
+        \param s subscription
+        \param items items to create - one per node
+        \param nodes nodes to monitor
+        \param p monitoring parameters of every item
+        \param ts timestamp specification
+        \return number of items created
+    */
+    static size_t addDataChanges(ClientSubscription& s,
+                                 const std::vector<MonitoredItemDataChange*>& items,
+                                 const std::vector<NodeId>& nodes,
+                                 const MonitoringParameters& p,
+                                 UA_TimestampsToReturn ts = UA_TIMESTAMPSTORETURN_BOTH);
 };
 
 typedef std::unique_ptr<MonitoredItem> MonitoredItemPtr;
@@ -254,6 +493,23 @@ public:
      */
     MonitoredItemCreateRequest& monitorItem() { return _monitorItem; }
 
+    /*!
+        \brief createRequest
+        \param r receives the request
+        \return true
+    */
+    bool createRequest(MonitoredItemCreateRequest& r) override
+    {
+        r.assignFrom(_monitorItem.get());
+        return true;
+    }
+
+    /*!
+        \brief isEvent
+        \return true
+    */
+    bool isEvent() const override { return true; }
+
     /*!
      * \brief setItem
      * \param nodeId
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace Open62541 {
+
+/*!
+    \brief The MpscQueue class
+    Unbounded lock free queue with many producers and one consumer (Vyukov's intrusive queue).
+    A push is one atomic exchange and never waits for the consumer or other producers. The consumer owns the tail so
+    a pop needs no atomic read-modify-write. An item being pushed is not visible until its link is stored, so a pop
+    may briefly miss it - the consumer sees it on its next pass.
+    T must be default constructible and movable.
+*/
+template <typename T> class MpscQueue
+{
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        T value;
+    };
+
+    alignas(64) std::atomic<Node*> _head;  // last pushed - producers
+    alignas(64) Node* _tail;               // stub whose successor is the next item - consumer
+
+public:
+    /*!
+        \brief MpscQueue
+    */
+    MpscQueue()
+    {
+        Node* stub = new Node;
+        _head.store(stub, std::memory_order_relaxed);
+        _tail = stub;
+    }
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    /*!
+        \brief ~MpscQueue
+        There must be no producers left
+    */
+    ~MpscQueue()
+    {
+        T v;
+        while (pop(v))
+            ;
+        delete _tail;
+    }
+
+    /*!
+        \brief push
+        Any thread
+        \param v
+    */
+    void push(T v)
+    {
+        Node* n  = new Node;
+        n->value = std::move(v);
+        Node* p  = _head.exchange(n, std::memory_order_acq_rel);
+        p->next.store(n, std::memory_order_release);
+    }
+
+    /*!
+        \brief pop
+        Consumer thread only
+        \param v receives the item
+        \return true if an item was removed
+    */
+    bool pop(T& v)
+    {
+        Node* t = _tail;
+        Node* n = t->next.load(std::memory_order_acquire);
+        if (!n)
+            return false;
+        v     = std::move(n->value);  // n becomes the stub
+        _tail = n;
+        delete t;
+        return true;
+    }
+
+    /*!
+        \brief empty
+        Consumer thread only
+        \return true if no item is visible
+    */
+    bool empty() const { return _tail->next.load(std::memory_order_acquire) == nullptr; }
+};
+
+/*!
+    \brief The MpscRing class
+    Bounded lock free ring with many producers and one consumer (Vyukov's bounded queue). Slots are allocated once and
+    items are written and read in place, so storage held by a slot's item can be reused from one item to the next.
+    A push fails rather than waits when the ring is full.
+    T must be default constructible.
+*/
+template <typename T> class MpscRing
+{
+    struct Cell {
+        std::atomic<size_t> seq{0};
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> _cells;
+    size_t _mask = 0;
+    alignas(64) std::atomic<size_t> _enqueue{0};
+    alignas(64) std::atomic<size_t> _dequeue{0};
+
+public:
+    /*!
+        \brief MpscRing
+        \param capacity rounded up to a power of two
+    */
+    explicit MpscRing(size_t capacity = 1024)
+    {
+        size_t n = 2;
+        while (n < capacity)
+            n <<= 1;
+        _cells.reset(new Cell[n]);
+        _mask = n - 1;
+        for (size_t i = 0; i < n; i++)
+            _cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    /*!
+        \brief push
+        Any thread
+        \param fill called with the slot to write
+        \return false if the ring is full
+    */
+    template <typename F> bool push(F&& fill)
+    {
+        size_t pos = _enqueue.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& c    = _cells[pos & _mask];
+            size_t seq = c.seq.load(std::memory_order_acquire);
+            if (seq == pos) {
+                if (_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    fill(c.value);
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (seq < pos) {
+                return false;  // full - the slot has not been read since the last lap
+            }
+            else {
+                pos = _enqueue.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /*!
+        \brief pop
+        Consumer thread only
+        \param take called with the slot to read
+        \return false if the ring is empty
+    */
+    template <typename F> bool pop(F&& take)
+    {
+        size_t pos = _dequeue.load(std::memory_order_relaxed);
+        Cell& c    = _cells[pos & _mask];
+        if (c.seq.load(std::memory_order_acquire) != pos + 1)
+            return false;
+        take(c.value);
+        c.seq.store(pos + _mask + 1, std::memory_order_release);
+        _dequeue.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*!
+        \brief size
+        \return approximate number of items
+    */
+    size_t size() const
+    {
+        size_t d = _dequeue.load(std::memory_order_acquire);
+        size_t e = _enqueue.load(std::memory_order_acquire);
+        return (e > d) ? (e - d) : 0;
+    }
+
+    size_t capacity() const { return _mask + 1; }  //!< number of slots
+};
+
+}  // namespace Open62541
+
+#endif  // MPSCQUEUE_H
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef NOTIFICATIONDISPATCHER_H
+#define NOTIFICATIONDISPATCHER_H
+#include <open62541cpp/open62541objects.h>
+#include <open62541cpp/mpscqueue.h>
+#include <condition_variable>
+#include <thread>
+
+namespace Open62541 {
+
+class MonitoredItem;
+
+/*!
+    \brief The NotificationDispatcher class
+    Runs monitored item handlers on a pool of worker threads so a slow handler does not hold up the client's publish
+    loop. A notification is copied into a slot of a worker's lock free ring - the slots are allocated once and reused.
+    Every notification of a monitored item goes to the same worker, so the notifications of an item are handled in
+    the order they arrived. A notification is dropped if its worker's ring is full.
+    Attach to subscriptions with ClientSubscription::setDispatcher. Monitored items must outlive the notifications
+    queued for them - call flush() before deleting them.
+*/
+class UA_EXPORT NotificationDispatcher
+{
+    struct Notification {
+        MonitoredItem* item = nullptr;
+        bool event          = false;
+        UA_DataValue value;            // data change
+        UA_Variant* fields = nullptr;  // event
+        size_t nFields     = 0;
+        Notification() { UA_DataValue_init(&value); }
+        ~Notification() { clear(); }
+        void clear();
+    };
+
+    struct Worker {
+        MpscRing<Notification> ring;
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::atomic<bool> waiting{false};
+        explicit Worker(size_t depth)
+            : ring(depth)
+        {
+        }
+    };
+    typedef std::unique_ptr<Worker> WorkerPtr;
+
+    std::vector<WorkerPtr> _workers;
+    std::atomic<bool> _running{false};
+    std::atomic<size_t> _posted{0};
+    std::atomic<size_t> _done{0};  // slots taken by the workers
+    std::atomic<size_t> _dispatched{0};
+    std::atomic<size_t> _dropped{0};
+    std::atomic<size_t> _maxQueued{0};
+
+    Worker& workerFor(const MonitoredItem* m) const
+    {
+        return *_workers[std::hash<const void*>()(m) % _workers.size()];
+    }
+    bool post(MonitoredItem* m, const std::function<bool(Notification&)>& fill);
+    void run(Worker& w);
+
+public:
+    /*!
+        \brief NotificationDispatcher
+        \param threads number of worker threads
+        \param depth slots in each worker's ring
+    */
+    NotificationDispatcher(size_t threads = 4, size_t depth = 4096);
+    NotificationDispatcher(const NotificationDispatcher&) = delete;
+    NotificationDispatcher& operator=(const NotificationDispatcher&) = delete;
+
+    /*!
+        \brief ~NotificationDispatcher
+    */
+    virtual ~NotificationDispatcher() { stop(); }
+
+    /*!
+        \brief stop
+        Handle the notifications already queued then stop the workers
+    */
+    void stop();
+
+    /*!
+        \brief postDataChange
+        Called on the thread iterating the client
+        \param m
+        \param value copied
+        \return false if the notification was dropped
+    */
+    bool postDataChange(MonitoredItem* m, const UA_DataValue* value);
+
+    /*!
+        \brief postEvent
+        Called on the thread iterating the client
+        \param m
+        \param nFields
+        \param fields copied
+        \return false if the notification was dropped
+    */
+    bool postEvent(MonitoredItem* m, size_t nFields, const UA_Variant* fields);
+
+    /*!
+        \brief flush
+        Wait until every notification posted so far has been handled
+    */
+    void flush();
+
+    /*!
+        \brief queued
+        \return notifications waiting for a worker
+    */
+    size_t queued() const;
+
+    size_t maxQueued() const { return _maxQueued; }    //!< highest queue depth seen on one worker
+    size_t dispatched() const { return _dispatched; }  //!< notifications handled
+    size_t dropped() const { return _dropped; }        //!< notifications lost to a full queue
+    size_t threads() const { return _workers.size(); }
+};
+
+}  // namespace Open62541
+
+#endif  // NOTIFICATIONDISPATCHER_H
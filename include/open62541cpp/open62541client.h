@@ -13,6 +13,10 @@
 #define OPEN62541CLIENT_H
 #include <open62541cpp/open62541objects.h>
 #include <open62541cpp/clientsubscription.h>
+#include <open62541cpp/mpscqueue.h>
+#include <deque>
+#include <future>
+#include <thread>
 
 /*
     OPC nodes are just data objects they do not need to be in a property tree
@@ -41,6 +45,16 @@ typedef std::shared_ptr<ClientSubscription> ClientSubscriptionRef;
 //
 typedef std::map<UA_UInt32, ClientSubscriptionRef> ClientSubscriptionMap;
 //
+/*!
+    \brief The AsyncResult struct
+    Result of an async service passed through a future - the status is the operation status if the service succeeded
+*/
+template <typename T> struct AsyncResult {
+    UA_StatusCode status = UA_STATUSCODE_GOOD;
+    T value;
+    bool ok() const { return status == UA_STATUSCODE_GOOD; }
+};
+//
 /*!
     \brief The Client class
     This class wraps the corresponding C functions. Refer to the C documentation for a full explanation.
@@ -89,7 +103,48 @@ public:
 
     typedef std::unique_ptr<Timer> TimerPtr;
 
+    // completion handlers of the async services - called from the thread iterating the client
+    typedef std::function<void(UA_StatusCode, void* response)> AsyncServiceCallback;
+    typedef std::function<void(UA_StatusCode, const UA_DataValue&)> ReadCallback;
+    typedef std::function<void(UA_StatusCode)> WriteCallback;
+    typedef std::function<void(UA_StatusCode, const UA_CallMethodResult&)> CallCallback;
+    typedef std::function<void(UA_StatusCode, const UA_BrowseResult&)> BrowseCallback;
+
+    // runs a notification handler - e.g. by posting it to a thread pool
+    typedef std::function<void(std::function<void()>)> NotificationExecutor;
+
+    /*!
+        \brief The RecoveryReport struct
+        Outcome of restoring subscriptions after the session was lost
+    */
+    struct RecoveryReport {
+        bool resumed         = false;  // the session was reactivated and kept its subscriptions
+        size_t subscriptions = 0;      // subscriptions restored
+        size_t items         = 0;      // monitored items restored
+        size_t failed        = 0;      // subscriptions and items that could not be created again
+        UA_Double outage     = 0;      // ms from losing the session to every item being restored
+        UA_Double recovery   = 0;      // ms from the new session to every item being restored
+    };
+
 private:
+    /*!
+        \brief The AsyncRequest struct
+        A request waiting to be sent or waiting for its response
+    */
+    struct AsyncRequest {
+        Client* client                  = nullptr;
+        void* request                   = nullptr;
+        const UA_DataType* requestType  = nullptr;
+        const UA_DataType* responseType = nullptr;
+        AsyncServiceCallback done;
+        ~AsyncRequest()
+        {
+            if (request)
+                UA_delete(request, requestType);
+        }
+    };
+    typedef std::unique_ptr<AsyncRequest> AsyncRequestPtr;
+
     UA_Client* _client = nullptr;
     ReadWriteMutex _mutex;
     //
@@ -103,6 +158,29 @@ private:
 
     std::map<UA_UInt64, TimerPtr> _timerMap;  // one map per client
 
+    // async request window
+    std::mutex _asyncMutex;
+    std::deque<AsyncRequestPtr> _asyncQueue;  // requests waiting for a slot in the window
+    size_t _maxOutstanding = 64;
+    size_t _outstanding    = 0;
+
+    // I/O thread
+    MpscQueue<AsyncRequestPtr> _submitted;  // requests from other threads
+    std::mutex _submitMutex;                 // orders hand offs against stopping the I/O thread
+    std::thread _ioThread;
+    std::atomic<bool> _ioRunning{false};
+    uint32_t _ioInterval = 5;
+    NotificationExecutor _notificationExecutor;
+
+    // subscription recovery
+    bool _recoverSubscriptions = false;
+    size_t _recoveryBatch      = 1000;
+    std::vector<ClientSubscriptionRef> _lostSubscriptions;  // detached - created again on the next session
+    UA_DateTime _lostAt      = 0;                           // when the session with subscriptions was lost
+    UA_DateTime _activatedAt = 0;
+    size_t _recovering       = 0;  // subscriptions being created again
+    RecoveryReport _recoveryReport;
+
     // status
     UA_SecureChannelState _channelState = UA_SECURECHANNELSTATE_CLOSED;
     UA_SessionState _sessionState       = UA_SESSIONSTATE_CLOSED;
@@ -117,6 +195,10 @@ private:
                               UA_SecureChannelState channelState,
                               UA_SessionState sessionState,
                               UA_StatusCode connectStatus);
+    // subscription recovery
+    void detachSubscriptions();
+    void recoverSubscriptions();
+    void recoveryTransition(UA_SessionState sessionState);
     /*!
         \brief asyncConnectCallback
         \param client
@@ -164,9 +246,13 @@ public:
     */
     virtual ~Client()
     {
+        stopIoThread();
+        failSubmitted(UA_STATUSCODE_BADSHUTDOWN);  // never leave a hand off without its completion
         if (_client) {
             _timerMap.clear();
+            failQueued(UA_STATUSCODE_BADSHUTDOWN);  // requests in flight are failed by the disconnect
             disconnect();
+            _lostSubscriptions.clear();
             UA_Client_delete(_client);
         }
     }
@@ -307,12 +393,58 @@ public:
         return nullptr;
     }
 
+    /*!
+        \brief setSubscriptionRecovery
+        Restore subscriptions when a lost session is replaced. If the session is reactivated its subscriptions are
+        kept as they are. Otherwise the subscriptions and their monitored items are created again in bulk with their
+        original settings - the subscription objects, item objects and item ids in each subscription are kept so
+        existing handlers keep working. Subscription ids change. subscriptionsRecovered is called when it is done.
+        While recovery is on a disconnect keeps the subscriptions for the next session.
+        \param on false to drop subscriptions waiting for a session
+        \param batch most monitored items in one create request
+    */
+    void setSubscriptionRecovery(bool on, size_t batch = 1000)
+    {
+        _recoverSubscriptions = on;
+        _recoveryBatch        = std::max<size_t>(1, batch);
+        if (!on) {
+            _lostSubscriptions.clear();
+            _lostAt = 0;
+        }
+    }
+
+    /*!
+        \brief subscriptionRecovery
+        \return true if subscriptions are restored
+    */
+    bool subscriptionRecovery() const { return _recoverSubscriptions; }
+
+    /*!
+        \brief recovering
+        \return true while subscriptions are being created again - do not remove subscriptions meanwhile
+    */
+    bool recovering() const { return _recovering > 0; }
+
+    /*!
+        \brief lostSubscriptions
+        \return number of subscriptions waiting for a session
+    */
+    size_t lostSubscriptions() const { return _lostSubscriptions.size(); }
+
+    /*!
+        \brief subscriptionsRecovered
+        Called on the client thread when subscriptions have been restored after the session was lost
+        \param r
+    */
+    virtual void subscriptionsRecovered(const RecoveryReport& /*r*/) {}
+
     //
     // Connection state handlers
     //
     virtual void SecureChannelStateClosed()
     {
-        subscriptions().clear();
+        if (!_recoverSubscriptions)
+            subscriptions().clear();  // otherwise kept in case the session is reactivated
         _timerMap.clear();
         OPEN62541_TRC
     }
@@ -324,7 +456,8 @@ public:
     virtual void SecureChannelStateOpen() { OPEN62541_TRC }
     virtual void SecureChannelStateClosing()
     {
-        subscriptions().clear();
+        if (!_recoverSubscriptions)
+            subscriptions().clear();
         _timerMap.clear();
         OPEN62541_TRC
     }
@@ -617,7 +750,8 @@ public:
     bool disconnect()
     {
         WriteLock l(_mutex);
-        // close subscriptions
+        // close subscriptions - kept to be created again on the next session if recovery is on
+        detachSubscriptions();
         subscriptions().clear();
         _timerMap.clear();  // remove timer objects
         _lastError      = UA_Client_disconnect(client());
@@ -1616,6 +1750,179 @@ public:
                               const UA_DataType* /*responseType*/)
     {
     }
+
+    //
+    // Pipelined async services
+    // Many requests are kept in flight on the session so throughput is not bound by the round trip time.
+    // At most maxOutstanding() requests are sent at once, the rest are queued in order and sent as responses arrive.
+    // Completions are called and futures are satisfied from the thread calling runIterate() - do not wait on a future
+    // from that thread.
+    //
+private:
+    static void asyncRequestCallback(UA_Client* client, void* userdata, UA_UInt32 requestId, void* response);
+    void submit(AsyncRequestPtr r);
+    bool sendRequest(AsyncRequestPtr& r);
+    void releaseSlot();
+    void pumpQueue();
+    void failQueued(UA_StatusCode status);
+    void drainSubmitted();
+    void failSubmitted(UA_StatusCode status);
+    void ioLoop();
+
+public:
+    /*!
+        \brief asyncRequest
+        Queue a service request in the window
+        \param request request - ownership is taken, it is deleted with UA_delete when done
+        \param requestType
+        \param responseType
+        \param done called with the service result and the response, the response is null if it was never sent
+    */
+    void asyncRequest(void* request,
+                      const UA_DataType* requestType,
+                      const UA_DataType* responseType,
+                      AsyncServiceCallback done);
+
+    /*!
+        \brief setMaxOutstanding
+        \param n maximum number of requests in flight
+    */
+    void setMaxOutstanding(size_t n);
+
+    /*!
+        \brief maxOutstanding
+        \return maximum number of requests in flight
+    */
+    size_t maxOutstanding() const { return _maxOutstanding; }
+
+    /*!
+        \brief outstanding
+        \return number of requests in flight
+    */
+    size_t outstanding()
+    {
+        std::lock_guard<std::mutex> l(_asyncMutex);
+        return _outstanding;
+    }
+
+    /*!
+        \brief queued
+        \return number of requests waiting for a slot
+    */
+    size_t queued()
+    {
+        std::lock_guard<std::mutex> l(_asyncMutex);
+        return _asyncQueue.size();
+    }
+
+    //
+    // I/O thread mode
+    // The client owns a thread that iterates it, so any number of application threads can use the async services
+    // at once. Requests from other threads are handed to the I/O thread through a lock free queue and the results
+    // come back through the futures or completion handlers. Each iteration holds the client lock, so synchronous
+    // services still work from other threads but wait for the iteration to end - they must not be called from
+    // completion or notification handlers.
+    //
+    /*!
+        \brief startIoThread
+        \param interval longest wait for network events in ms - also bounds how long a submitted request waits
+        \return true if the thread was started
+    */
+    bool startIoThread(uint32_t interval = 5);
+
+    /*!
+        \brief stopIoThread
+        Stop and join the I/O thread. Requests still in the hand off queue are moved to the window
+    */
+    void stopIoThread();
+
+    /*!
+        \brief ioThreadRunning
+        \return true if the I/O thread is running
+    */
+    bool ioThreadRunning() const { return _ioRunning; }
+
+    /*!
+        \brief setNotificationExecutor
+        Deliver data change and event notifications through an executor instead of on the thread iterating the
+        client. Notifications are copied before they are handed over. Subscriptions and monitored items must outlive
+        the notifications queued for them. Set before creating subscriptions
+        \param e executor - empty to deliver on the iterating thread
+    */
+    void setNotificationExecutor(NotificationExecutor e) { _notificationExecutor = std::move(e); }
+
+    /*!
+        \brief notificationExecutor
+        \return the notification executor
+    */
+    const NotificationExecutor& notificationExecutor() const { return _notificationExecutor; }
+
+    /*!
+        \brief readAsync
+        \param nodeId
+        \param done called with the status and the data value read
+        \param attributeId
+    */
+    void readAsync(const NodeId& nodeId, ReadCallback done, UA_UInt32 attributeId = UA_ATTRIBUTEID_VALUE);
+
+    /*!
+        \brief readAsync
+        \param nodeId
+        \return future holding the value read
+    */
+    std::future<AsyncResult<Variant>> readAsync(const NodeId& nodeId);
+
+    /*!
+        \brief writeAsync
+        \param nodeId
+        \param value
+        \param done called with the status of the write
+    */
+    void writeAsync(const NodeId& nodeId, const Variant& value, WriteCallback done);
+
+    /*!
+        \brief writeAsync
+        \param nodeId
+        \param value
+        \return future holding the status of the write
+    */
+    std::future<UA_StatusCode> writeAsync(const NodeId& nodeId, const Variant& value);
+
+    /*!
+        \brief callAsync
+        \param objectId
+        \param methodId
+        \param in input arguments
+        \param done called with the status and the method result
+    */
+    void callAsync(const NodeId& objectId, const NodeId& methodId, const VariantList& in, CallCallback done);
+
+    /*!
+        \brief callAsync
+        \param objectId
+        \param methodId
+        \param in input arguments
+        \return future holding the method result
+    */
+    std::future<AsyncResult<CallMethodResult>> callAsync(const NodeId& objectId,
+                                                         const NodeId& methodId,
+                                                         const VariantList& in);
+
+    /*!
+        \brief browseAsync
+        Browse the hierarchical references of a node in both directions
+        \param nodeId
+        \param done called with the status and the browse result
+    */
+    void browseAsync(const NodeId& nodeId, BrowseCallback done);
+
+    /*!
+        \brief browseAsync
+        \param nodeId
+        \return future holding the browse result
+    */
+    std::future<AsyncResult<BrowseResult>> browseAsync(const NodeId& nodeId);
+
     /*!
         \brief historicalIterator
         \return
@@ -1680,6 +1987,21 @@ public:
                                                this);
         return lastOK();
     }
+    /*!
+        \brief historyRead
+        HistoryRead service for any details and any number of nodes
+        \param request
+        \param response receives the response - the caller clears it
+        \return true if the service succeeded - check the result of each node
+    */
+    bool historyRead(const UA_HistoryReadRequest& request, UA_HistoryReadResponse& response)
+    {
+        WriteLock l(_mutex);
+        response   = UA_Client_Service_historyRead(client(), request);
+        _lastError = response.responseHeader.serviceResult;
+        return lastOK();
+    }
+
     /*!
         \brief historyUpdateInsert
         \param n
@@ -734,6 +734,22 @@ public:
 */
 UA_EXPORT std::string toString(const UA_NodeId& n);
 
+/*!
+    \brief The NodeIdHash struct
+    Hash functor so NodeId can key unordered containers without converting to a string
+*/
+struct NodeIdHash {
+    size_t operator()(const NodeId& n) const { return n.hash(); }
+};
+
+/*!
+    \brief The NodeIdEqual struct
+    Equality functor to go with NodeIdHash
+*/
+struct NodeIdEqual {
+    bool operator()(const NodeId& a, const NodeId& b) const { return UA_NodeId_equal(a.constRef(), b.constRef()); }
+};
+
 // use for browse lists
 /*!
     \brief The UANodeIdList class
@@ -98,6 +98,7 @@ private:
     static ServerMap _serverMap;                      // Map of servers key by UA_Server pointer
     std::map<UA_UInt64, std::string> _discoveryList;  // set of discovery servers this server has registered with
     std::vector<UA_UsernamePasswordLogin> _logins;    // set of permitted  logins
+    std::map<std::string, std::function<void(Server&)>> _processMap;  // handlers run by the server loop after process()
     //
     static void timerCallback(UA_Server*, void* data)
     {
@@ -661,6 +662,21 @@ public:
     */
     virtual void process() {}  // called between server loop iterations - hook thread event processing
 
+    /*!
+        \brief addProcessHandler
+        Add a named handler that is called from the server loop after process(). Handlers run in the server thread
+        so may access the server directly. Add and remove handlers before start() or from the server thread.
+        \param name handler name - replaces any handler of the same name
+        \param func handler
+    */
+    void addProcessHandler(const std::string& name, std::function<void(Server&)> func) { _processMap[name] = func; }
+
+    /*!
+        \brief removeProcessHandler
+        \param name
+    */
+    void removeProcessHandler(const std::string& name) { _processMap.erase(name); }
+
     /*!
         \brief terminate
     */
@@ -702,8 +718,9 @@ public:
     */
     bool getNodeContext(const NodeId& n, NodeContext*& c)
     {
-        void* p    = (void*)(c);
+        void* p    = nullptr;
         _lastError = UA_Server_getNodeContext(server(), n.get(), &p);
+        c          = static_cast<NodeContext*>(p);
         return lastOK();
     }
 
@@ -1450,6 +1467,19 @@ public:
                (_lastError =
                     __UA_Server_write(server(), nodeId, UA_ATTRIBUTEID_VALUE, &UA_TYPES[UA_TYPES_VARIANT], value));
     }
+    /*!
+        \brief writeDataValue
+        Write the value with its status and source timestamp
+        \param nodeId
+        \param value
+        \return true on success
+    */
+    bool writeDataValue(const NodeId& nodeId, const UA_DataValue& value)
+    {
+        return UA_STATUSCODE_GOOD ==
+               (_lastError =
+                    __UA_Server_write(server(), nodeId, UA_ATTRIBUTEID_VALUE, &UA_TYPES[UA_TYPES_DATAVALUE], &value));
+    }
     /*!
         \brief writeDataType
         \param nodeId
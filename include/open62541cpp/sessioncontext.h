@@ -0,0 +1,412 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef SESSIONCONTEXT_H
+#define SESSIONCONTEXT_H
+#include <open62541cpp/open62541server.h>
+#include <open62541cpp/credentialstore.h>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace Open62541 {
+
+/*!
+    \brief The SessionContext class
+    Created when a session is activated and handed to open62541 as the session context.
+    Holds the roles of the session user evaluated once at activation.
+*/
+class UA_EXPORT SessionContext
+{
+    NodeId _sessionId;
+    std::string _user;
+    UA_UInt64 _serial = 0;                    // unique for the life of the server - session ids can be reused
+    std::atomic<UA_UInt64> _roles{0};         // role bitmask
+    std::atomic<UA_UInt32> _generation{0};    // bumped when the roles change
+
+public:
+    /*!
+        \brief SessionContext
+        \param sessionId
+        \param user user name - empty for anonymous
+        \param roles role bitmask
+        \param serial unique serial number
+    */
+    SessionContext(const NodeId& sessionId, const std::string& user, UA_UInt64 roles, UA_UInt64 serial)
+        : _sessionId(sessionId)
+        , _user(user)
+        , _serial(serial)
+        , _roles(roles)
+    {
+    }
+    virtual ~SessionContext() {}
+
+    const NodeId& sessionId() const { return _sessionId; }
+    const std::string& user() const { return _user; }
+    bool anonymous() const { return _user.empty(); }
+    UA_UInt64 serial() const { return _serial; }
+    UA_UInt32 generation() const { return _generation.load(std::memory_order_acquire); }
+
+    /*!
+        \brief roles
+        \return role bitmask
+    */
+    UA_UInt64 roles() const { return _roles.load(std::memory_order_acquire); }
+
+    /*!
+        \brief hasRole
+        \param mask
+        \return true if any of the roles in mask are held
+    */
+    bool hasRole(UA_UInt64 mask) const { return (roles() & mask) != 0; }
+
+    /*!
+        \brief setRoles
+        Changing the roles makes cached decisions for this session stale
+        \param r
+    */
+    void setRoles(UA_UInt64 r)
+    {
+        _roles.store(r, std::memory_order_release);
+        _generation.fetch_add(1, std::memory_order_acq_rel);
+    }
+};
+
+/*!
+    \brief The AccessDecision struct
+    Cached results of the node access control callbacks for one session and node
+*/
+struct AccessDecision {
+    enum {
+        RightsMask  = 0x01,
+        AccessLevel = 0x02,
+        Browse      = 0x04
+    };
+    UA_Byte valid       = 0;  //!< which of the decisions below have been evaluated
+    UA_UInt32 rightsMask = 0;
+    UA_Byte accessLevel = 0;
+    bool browse         = false;
+};
+
+/*!
+    \brief The AccessDecisionCache class
+    LRU cache of access decisions keyed by (session, node). Lookups do not allocate.
+    Entries are stale when the session roles change (session generation), when invalidateAll() is called (epoch)
+    or are removed when the node ACL changes (invalidateNode).
+*/
+class UA_EXPORT AccessDecisionCache
+{
+    struct Entry {
+        UA_UInt64 key        = 0;
+        UA_UInt64 session    = 0;
+        UA_UInt32 generation = 0;
+        UA_UInt32 epoch      = 0;
+        NodeId node;
+        AccessDecision decision;
+    };
+    typedef std::list<Entry> EntryList;
+    EntryList _list;                                             // most recently used at the front
+    std::unordered_map<UA_UInt64, EntryList::iterator> _map;    // key hash to entry
+    size_t _capacity = 0;
+    UA_UInt32 _epoch = 0;
+    std::atomic<size_t> _hits{0};
+    std::atomic<size_t> _misses{0};
+    mutable std::mutex _mutex;
+
+    void evict();
+
+    static UA_UInt64 makeKey(UA_UInt64 session, const UA_NodeId* node)
+    {
+        return (session * 0x9E3779B97F4A7C15ULL) ^ UA_NodeId_hash(node);
+    }
+
+public:
+    /*!
+        \brief AccessDecisionCache
+        \param capacity maximum number of entries
+    */
+    AccessDecisionCache(size_t capacity = 65536)
+        : _capacity(capacity)
+    {
+    }
+
+    /*!
+        \brief find
+        \param s session
+        \param node
+        \param what AccessDecision flags required
+        \param d decision if found
+        \return true if a current entry holding the required decisions was found
+    */
+    bool find(const SessionContext& s, const UA_NodeId* node, UA_Byte what, AccessDecision& d);
+
+    /*!
+        \brief update
+        Merge evaluated decisions into the entry for (session, node) creating it if needed
+        \param s
+        \param node
+        \param d
+    */
+    void update(const SessionContext& s, const UA_NodeId* node, const AccessDecision& d);
+
+    /*!
+        \brief invalidateNode
+        Drop every entry for the node - call when the node ACL changes
+        \param node
+    */
+    void invalidateNode(const NodeId& node);
+
+    /*!
+        \brief invalidateAll
+        Make every entry stale - call when role definitions change
+    */
+    void invalidateAll()
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        _epoch++;
+    }
+
+    /*!
+        \brief clear
+    */
+    void clear()
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        _map.clear();
+        _list.clear();
+    }
+
+    /*!
+        \brief setCapacity
+        \param n
+    */
+    void setCapacity(size_t n);
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        return _list.size();
+    }
+    size_t hits() const { return _hits; }
+    size_t misses() const { return _misses; }
+};
+
+/*!
+    \brief The SessionAccessServer class
+    Server that creates a SessionContext per session and caches node access decisions.
+    Derived classes supply the policy by overriding userRoles() and the evaluate functions, which are only called
+    on a cache miss. The node access callbacks bypass findServer and the Server virtuals.
+*/
+class UA_EXPORT SessionAccessServer : public Server
+{
+    AccessDecisionCache _cache;
+    std::mutex _sessionMutex;
+    std::unordered_map<NodeId, SessionContext*, NodeIdHash, NodeIdEqual> _sessions;
+    std::atomic<UA_UInt64> _serial{0};
+    bool _allowAnonymous            = true;
+    CredentialStore* _credentials   = nullptr;  // hashed user store - if not set logins() is searched
+
+    static SessionAccessServer* fromAccessControl(UA_AccessControl* ac)
+    {
+        return (ac && ac->context) ? static_cast<SessionAccessServer*>(static_cast<Server*>(ac->context)) : nullptr;
+    }
+
+    static UA_UInt32 getUserRightsMaskCached(UA_Server* server,
+            UA_AccessControl* ac,
+            const UA_NodeId* sessionId,
+            void* sessionContext,
+            const UA_NodeId* nodeId,
+            void* nodeContext);
+
+    static UA_Byte getUserAccessLevelCached(UA_Server* server,
+                                            UA_AccessControl* ac,
+                                            const UA_NodeId* sessionId,
+                                            void* sessionContext,
+                                            const UA_NodeId* nodeId,
+                                            void* nodeContext);
+
+    static UA_Boolean allowBrowseNodeCached(UA_Server* server,
+                                            UA_AccessControl* ac,
+                                            const UA_NodeId* sessionId,
+                                            void* sessionContext,
+                                            const UA_NodeId* nodeId,
+                                            void* nodeContext);
+
+    static void closeSessionCached(UA_Server* server,
+                                   UA_AccessControl* ac,
+                                   const UA_NodeId* sessionId,
+                                   void* sessionContext);
+
+    static UA_StatusCode loginCallback(const UA_String* userName,
+                                       const UA_ByteString* password,
+                                       size_t usernamePasswordLoginSize,
+                                       const UA_UsernamePasswordLogin* usernamePasswordLogin,
+                                       void** sessionContext,
+                                       void* loginContext);
+
+public:
+    /*!
+        \brief SessionAccessServer
+        \param port
+        \param certificate
+        \param cacheSize number of cached decisions
+    */
+    SessionAccessServer(int port = 4840,
+                        const UA_ByteString& certificate = UA_BYTESTRING_NULL,
+                        size_t cacheSize = 65536)
+        : Server(port, certificate)
+        , _cache(cacheSize)
+    {
+    }
+
+    /*!
+        \brief ~SessionAccessServer
+    */
+    virtual ~SessionAccessServer();
+
+    /*!
+        \brief cache
+        \return decision cache
+    */
+    AccessDecisionCache& cache() { return _cache; }
+
+    /*!
+        \brief setCredentialStore
+        Authenticate user names against a hashed credential store instead of logins()
+        \param c store - must outlive the server
+    */
+    void setCredentialStore(CredentialStore* c) { _credentials = c; }
+
+    /*!
+        \brief credentialStore
+        \return credential store or null
+    */
+    CredentialStore* credentialStore() const { return _credentials; }
+
+    /*!
+        \brief enableSessionAccess
+        Install the access control - the permitted logins or credential store should be set up beforehand
+        \param allowAnonymous
+        \return true on success
+    */
+    bool enableSessionAccess(bool allowAnonymous = true);
+
+    /*!
+        \brief setAccessControl
+        \param ac
+    */
+    void setAccessControl(UA_AccessControl* ac) override
+    {
+        Server::setAccessControl(ac);
+        ac->closeSession       = closeSessionCached;
+        ac->getUserRightsMask  = getUserRightsMaskCached;
+        ac->getUserAccessLevel = getUserAccessLevelCached;
+        ac->allowBrowseNode    = allowBrowseNodeCached;
+    }
+
+    /*!
+        \brief activateSession
+        Authenticates the identity token and creates the session context
+        \return error code
+    */
+    UA_StatusCode activateSession(UA_AccessControl* ac,
+                                  const UA_EndpointDescription* endpointDescription,
+                                  const UA_ByteString* secureChannelRemoteCertificate,
+                                  const UA_NodeId* sessionId,
+                                  const UA_ExtensionObject* userIdentityToken,
+                                  void** sessionContext) override;
+
+    /*!
+        \brief authenticate
+        Check the identity token. Default accepts anonymous (if allowed) and the user names in the credential store
+        or logins()
+        \param token identity token
+        \param user set to the user name - empty for anonymous
+        \return error code
+    */
+    virtual UA_StatusCode authenticate(const UA_ExtensionObject* token, std::string& user);
+
+    /*!
+        \brief userRoles
+        Evaluated once per session. Default returns the roles held in the credential store
+        \param user user name - empty for anonymous
+        \return role bitmask
+    */
+    virtual UA_UInt64 userRoles(const std::string& user);
+
+    /*!
+        \brief evaluateUserRightsMask
+        Policy evaluation on a cache miss
+        \return user rights mask
+    */
+    virtual UA_UInt32 evaluateUserRightsMask(const SessionContext& /*session*/,
+                                             const UA_NodeId* /*nodeId*/,
+                                             void* /*nodeContext*/)
+    {
+        return 0xFFFFFFFF;
+    }
+
+    /*!
+        \brief evaluateUserAccessLevel
+        Policy evaluation on a cache miss
+        \return user access level
+    */
+    virtual UA_Byte evaluateUserAccessLevel(const SessionContext& /*session*/,
+                                            const UA_NodeId* /*nodeId*/,
+                                            void* /*nodeContext*/)
+    {
+        return 0xFF;
+    }
+
+    /*!
+        \brief evaluateBrowseNode
+        Policy evaluation on a cache miss
+        \return true if the node may be browsed
+    */
+    virtual bool evaluateBrowseNode(const SessionContext& /*session*/, const UA_NodeId* /*nodeId*/, void* /*nodeContext*/)
+    {
+        return true;
+    }
+
+    /*!
+        \brief setSessionRoles
+        Change the roles of an active session
+        \param sessionId
+        \param roles
+        \return true if the session was found
+    */
+    bool setSessionRoles(const NodeId& sessionId, UA_UInt64 roles);
+
+    /*!
+        \brief rolesChanged
+        Re-evaluate the roles of every active session and drop cached decisions
+    */
+    void rolesChanged();
+
+    /*!
+        \brief nodeAccessChanged
+        Call when the ACL of a node changes
+        \param n
+    */
+    void nodeAccessChanged(const NodeId& n) { _cache.invalidateNode(n); }
+
+    /*!
+        \brief findSession
+        \param sessionId
+        \return session context or null - only valid while the session is open
+    */
+    SessionContext* findSession(const NodeId& sessionId);
+};
+
+}  // namespace Open62541
+
+#endif  // SESSIONCONTEXT_H
@@ -0,0 +1,345 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef SHAREDMEMORYCONTEXT_H
+#define SHAREDMEMORYCONTEXT_H
+#include <open62541cpp/nodecontext.h>
+#include <atomic>
+#include <unordered_map>
+
+namespace Open62541 {
+
+class Server;
+
+// Shared memory tag table - acquisition processes write values straight into a POSIX shared memory segment
+// and the server reads them without an IPC hop. Each record is versioned with a sequence lock so a reader never
+// blocks a writer. Each record must have exactly one writing process. Linux / POSIX only.
+
+constexpr UA_UInt32 SHARED_MEMORY_MAGIC        = 0x4f504354;  // 'OPCT'
+constexpr UA_UInt32 SHARED_MEMORY_VERSION      = 1;
+constexpr size_t SHARED_MEMORY_TAG_NAME_SIZE   = 96;
+constexpr size_t SHARED_MEMORY_VALUE_SIZE      = 8;  // largest scalar held - 64 bit numerics and date times
+
+/*!
+    \brief The SharedMemoryTableHeader struct
+    Fixed layout at the start of the segment
+*/
+struct alignas(64) SharedMemoryTableHeader {
+    UA_UInt32 magic;
+    UA_UInt32 version;
+    UA_UInt32 capacity;             //!< number of records in the segment
+    UA_UInt32 recordSize;           //!< sizeof(SharedMemoryRecord) - layout check
+    std::atomic<UA_UInt32> count;   //!< number of defined records
+};
+
+/*!
+    \brief The SharedMemoryRecord struct
+    Fixed layout tag record. The sequence is odd while a write is in progress
+*/
+struct alignas(64) SharedMemoryRecord {
+    std::atomic<UA_UInt32> sequence;
+    UA_UInt32 typeIndex;  //!< index into UA_TYPES of the scalar held
+    UA_StatusCode status;
+    UA_UInt32 reserved;
+    UA_DateTime sourceTimestamp;
+    UA_Byte value[SHARED_MEMORY_VALUE_SIZE];
+    char name[SHARED_MEMORY_TAG_NAME_SIZE];
+};
+
+static_assert(sizeof(SharedMemoryRecord) == 128, "shared memory record layout changed");
+static_assert(std::atomic<UA_UInt32>::is_always_lock_free, "shared memory sequence must be lock free");
+
+/*!
+    \brief The SharedMemoryValue struct
+    Consistent snapshot of a record taken by a reader
+*/
+struct SharedMemoryValue {
+    UA_UInt32 sequence                      = 0;
+    UA_UInt32 typeIndex                     = 0;
+    UA_StatusCode status                    = UA_STATUSCODE_GOOD;
+    UA_DateTime sourceTimestamp             = 0;
+    UA_Byte value[SHARED_MEMORY_VALUE_SIZE] = {};
+};
+
+/*!
+    \brief The SharedMemoryTagTable class
+    The server side opens the segment, acquisition processes create it or open it and write records
+*/
+class UA_EXPORT SharedMemoryTagTable
+{
+    std::string _name;
+    int _fd                            = -1;
+    void* _base                        = nullptr;
+    size_t _size                       = 0;
+    SharedMemoryTableHeader* _header   = nullptr;
+    SharedMemoryRecord* _records       = nullptr;
+
+    bool map(bool create, UA_UInt32 capacity);
+
+public:
+    SharedMemoryTagTable() {}
+    SharedMemoryTagTable(const SharedMemoryTagTable&) = delete;
+    SharedMemoryTagTable& operator=(const SharedMemoryTagTable&) = delete;
+    /*!
+        \brief ~SharedMemoryTagTable
+    */
+    virtual ~SharedMemoryTagTable() { close(); }
+
+    /*!
+        \brief create
+        Create (or recreate) the named segment
+        \param name shared memory object name - eg "/plant1"
+        \param capacity number of records
+        \return true on success
+    */
+    bool create(const std::string& name, UA_UInt32 capacity);
+
+    /*!
+        \brief open
+        Attach to an existing segment
+        \param name
+        \return true on success
+    */
+    bool open(const std::string& name);
+
+    /*!
+        \brief close
+        Unmap the segment - the segment persists until unlinked
+    */
+    void close();
+
+    /*!
+        \brief unlink
+        \param name
+        \return true on success
+    */
+    static bool unlink(const std::string& name);
+
+    /*!
+        \brief isOpen
+        \return true if mapped
+    */
+    bool isOpen() const { return _header != nullptr; }
+
+    /*!
+        \brief capacity
+        \return number of records in the segment
+    */
+    UA_UInt32 capacity() const { return _header ? _header->capacity : 0; }
+
+    /*!
+        \brief count
+        \return number of defined records
+    */
+    UA_UInt32 count() const { return _header ? _header->count.load(std::memory_order_acquire) : 0; }
+
+    /*!
+        \brief define
+        Define a new tag record - writer side
+        \param name tag name
+        \param typeIndex UA_TYPES index of the value
+        \return record index or -1 on failure
+    */
+    int define(const std::string& name, UA_UInt32 typeIndex);
+
+    /*!
+        \brief find
+        Linear search by tag name - use at configuration time and keep the index
+        \param name
+        \return record index or -1 if not found
+    */
+    int find(const std::string& name) const;
+
+    /*!
+        \brief write
+        Write a record - writer side. Only one process may write a given record
+        \param index record index
+        \param data scalar value
+        \param size size of scalar in bytes
+        \param typeIndex UA_TYPES index
+        \param sourceTimestamp
+        \param status
+        \return true on success
+    */
+    bool write(unsigned index,
+               const void* data,
+               size_t size,
+               UA_UInt32 typeIndex,
+               UA_DateTime sourceTimestamp,
+               UA_StatusCode status = UA_STATUSCODE_GOOD);
+
+    /*!
+        \brief write
+        \param index
+        \param v
+        \param typeIndex
+        \param sourceTimestamp
+        \param status
+        \return true on success
+    */
+    template <typename T>
+    bool write(unsigned index,
+               T v,
+               UA_UInt32 typeIndex,
+               UA_DateTime sourceTimestamp,
+               UA_StatusCode status = UA_STATUSCODE_GOOD)
+    {
+        static_assert(sizeof(T) <= SHARED_MEMORY_VALUE_SIZE, "value too large for a shared memory record");
+        return write(index, &v, sizeof(T), typeIndex, sourceTimestamp, status);
+    }
+
+    /*!
+        \brief read
+        Take a consistent snapshot of a record, retrying while a write is in progress
+        \param index
+        \param v snapshot
+        \return true on success
+    */
+    bool read(unsigned index, SharedMemoryValue& v) const;
+
+    /*!
+        \brief sequence
+        \param index
+        \return current sequence number of the record - changes on every write
+    */
+    UA_UInt32 sequence(unsigned index) const
+    {
+        return (index < capacity()) ? _records[index].sequence.load(std::memory_order_acquire) : 0;
+    }
+
+    /*!
+        \brief toDataValue
+        \param v snapshot
+        \param d data value to fill
+        \return true on success
+    */
+    static bool toDataValue(const SharedMemoryValue& v, UA_DataValue& d);
+};
+
+/*!
+    \brief The SharedMemoryContext class
+    Serves reads of data source nodes directly from the shared memory segment. A node is either bound here as a data
+    source, read on demand, or added to a SharedMemoryPoller as an ordinary variable node - not both.
+*/
+class UA_EXPORT SharedMemoryContext : public NodeContext
+{
+    SharedMemoryTagTable& _table;
+    std::unordered_map<NodeId, unsigned, NodeIdHash, NodeIdEqual> _map;  // node to record index
+
+public:
+    /*!
+        \brief SharedMemoryContext
+        \param t table
+        \param name context name
+    */
+    SharedMemoryContext(SharedMemoryTagTable& t, const std::string& name = "SharedMemory")
+        : NodeContext(name)
+        , _table(t)
+    {
+    }
+
+    /*!
+        \brief table
+        \return
+    */
+    SharedMemoryTagTable& table() { return _table; }
+
+    /*!
+        \brief bind
+        Bind a node to a record and make this context its data source
+        \param server
+        \param node
+        \param index record index
+        \return true on success
+    */
+    bool bind(Server& server, NodeId& node, unsigned index);
+
+    /*!
+        \brief readData
+        \param server
+        \param node
+        \param range
+        \param value
+        \return true on success
+    */
+    bool readData(Server& server, NodeId& node, const UA_NumericRange* range, UA_DataValue& value) override;
+};
+
+/*!
+    \brief The SharedMemoryPoller class
+    Turns changed record sequence numbers into value writes to ordinary variable nodes so subscriptions and
+    historians see the change. Runs in the server thread as a process handler. Nodes bound to a SharedMemoryContext
+    are data sources that read the record themselves - the poller leaves them alone.
+*/
+class UA_EXPORT SharedMemoryPoller
+{
+    struct Binding {
+        NodeId node;
+        unsigned index          = 0;
+        UA_UInt32 lastSequence  = 0;
+        bool checked            = false;  // node context looked at
+        bool dataSource         = false;  // bound to a SharedMemoryContext - not written
+    };
+    SharedMemoryTagTable& _table;
+    std::string _name;
+    std::vector<Binding> _bindings;
+    size_t _updates = 0;
+
+public:
+    /*!
+        \brief SharedMemoryPoller
+        \param t
+        \param name process handler name
+    */
+    SharedMemoryPoller(SharedMemoryTagTable& t, const std::string& name = "SharedMemoryPoller")
+        : _table(t)
+        , _name(name)
+    {
+    }
+
+    /*!
+        \brief add
+        Watch a record and write changes to the node
+        \param node ordinary variable node
+        \param index
+    */
+    void add(const NodeId& node, unsigned index);
+
+    /*!
+        \brief poll
+        \param server
+        \return number of values written
+    */
+    size_t poll(Server& server);
+
+    /*!
+        \brief attach
+        Poll from the server loop
+        \param server
+    */
+    void attach(Server& server);
+
+    /*!
+        \brief detach
+        \param server
+    */
+    void detach(Server& server);
+
+    /*!
+        \brief updates
+        \return total number of values written
+    */
+    size_t updates() const { return _updates; }
+};
+
+}  // namespace Open62541
+
+#endif  // SHAREDMEMORYCONTEXT_H
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#ifndef SUBSCRIPTIONTUNER_H
+#define SUBSCRIPTIONTUNER_H
+#include <open62541cpp/open62541client.h>
+#include <open62541cpp/clientsubscription.h>
+#include <set>
+
+namespace Open62541 {
+
+/*!
+    \brief The SubscriptionTuner class
+    Opt in tuning of client subscriptions from the notifications they deliver. Each period the tuner takes the
+    statistics window of every subscription it manages and adjusts the publishing interval and notification limit:
+    - queue overflows or a mean latency above the target halve the publishing interval
+    - a notification rate above the target, or publishes carrying one or two notifications, double the interval while
+      the latency stays well inside the target - longer intervals batch notifications and coalesce samples of items
+      with small queues
+    - publishes close to the notification limit double the limit
+    Changes are sent with ClientSubscription::modify which keeps the keep alive and lifetime periods.
+    A subscription whose interval the policy wants past the bounds of the target cannot be tuned further, so some of
+    its monitored items are moved to the least loaded subscription with MonitoredItem::move - enough to even out
+    their rates, assuming the items share the notifications evenly. Moved items get new ids in their subscription.
+    Latency is measured from the source (or server) timestamp, so it includes any clock offset between the server
+    and the client.
+    The tuner runs on a client timer - it must be used on the thread iterating the client.
+*/
+class UA_EXPORT SubscriptionTuner
+{
+public:
+    /*!
+        \brief The Target struct
+    */
+    struct Target {
+        UA_Double maxLatency                 = 1000;   // mean ms from timestamp to arrival
+        UA_Double maxRate                    = 0;      // notifications per second of a subscription, 0 for no limit
+        UA_Double minPublishingInterval      = 50;     // ms
+        UA_Double maxPublishingInterval      = 10000;  // ms
+        UA_UInt32 maxNotificationsPerPublish = 10000;  // highest limit the tuner will set
+        size_t maxItemsMoved                 = 100;    // items moved off a subscription in one pass, 0 for none
+    };
+
+    /*!
+        \brief The Load struct
+        Measurements of the last window of a subscription
+    */
+    struct Load {
+        UA_Double rate       = 0;  // notifications per second
+        UA_Double perPublish = 0;  // mean notifications per publishing interval
+        UA_Double latency    = 0;  // mean ms
+        size_t overflows     = 0;
+    };
+
+private:
+    Client& _client;
+    Target _target;
+    std::map<UA_UInt32, Load> _subscriptions;  // by subscription id - looked up each pass as they may be deleted
+    UA_UInt64 _timerId = 0;
+    size_t _changes    = 0;
+    size_t _moved      = 0;
+    //
+    std::shared_ptr<std::set<UA_UInt32>> _moving = std::make_shared<std::set<UA_UInt32>>();  // moves in flight
+
+public:
+    /*!
+        \brief SubscriptionTuner
+        \param c client owning the subscriptions
+    */
+    explicit SubscriptionTuner(Client& c)
+        : _client(c)
+    {
+    }
+
+    /*!
+        \brief SubscriptionTuner
+        \param c client owning the subscriptions
+        \param t target
+    */
+    SubscriptionTuner(Client& c, const Target& t)
+        : _client(c)
+        , _target(t)
+    {
+    }
+    SubscriptionTuner(const SubscriptionTuner&) = delete;
+    SubscriptionTuner& operator=(const SubscriptionTuner&) = delete;
+
+    /*!
+        \brief ~SubscriptionTuner
+    */
+    virtual ~SubscriptionTuner() { stop(); }
+
+    /*!
+        \brief add
+        Manage a subscription - its statistics are enabled
+        \param s created subscription
+        \return false if the subscription has not been created
+    */
+    bool add(ClientSubscription& s);
+
+    /*!
+        \brief remove
+        Stop managing a subscription - its statistics are disabled
+        \param s
+    */
+    void remove(ClientSubscription& s);
+
+    /*!
+        \brief start
+        Tune on a repeated client timer
+        \param period ms between passes - several publishing intervals so each window has enough samples
+        \return true on success
+    */
+    bool start(UA_Double period = 5000);
+
+    /*!
+        \brief stop
+    */
+    void stop();
+
+    /*!
+        \brief tune
+        One pass over the managed subscriptions
+        \return number of subscriptions changed
+    */
+    size_t tune();
+
+    /*!
+        \brief leastLoaded
+        Where to put new monitored items
+        \return the managed subscription with the lowest notification rate in its last window, or null
+    */
+    ClientSubscription* leastLoaded();
+
+    /*!
+        \brief load
+        \param s
+        \return measurements of the last window of a managed subscription
+    */
+    Load load(ClientSubscription& s) const
+    {
+        auto i = _subscriptions.find(s.id());
+        return (i != _subscriptions.end()) ? i->second : Load();
+    }
+
+    const Target& target() const { return _target; }    //!< the target
+    void setTarget(const Target& t) { _target = t; }    //!< change the target
+    size_t changes() const { return _changes; }         //!< modify requests sent
+    size_t moved() const { return _moved; }             //!< monitored items sent to another subscription
+
+    /*!
+        \brief adjust
+        Decide the new settings of a subscription - override to apply a different policy
+        \param s subscription
+        \param l measurements of the last window
+        \param publishingInterval current interval, receives the new one
+        \param maxNotificationsPerPublish current limit, receives the new one
+    */
+    virtual void adjust(ClientSubscription& s,
+                        const Load& l,
+                        UA_Double& publishingInterval,
+                        UA_UInt32& maxNotificationsPerPublish);
+
+    /*!
+        \brief rebalance
+        Move monitored items off a subscription that cannot be tuned further - override to choose them differently.
+        Both subscriptions are left alone by tune() until the move completes and then start a new window.
+        \param s subscription
+        \param l measurements of the last window
+        \return number of items being moved
+    */
+    virtual size_t rebalance(ClientSubscription& s, const Load& l);
+};
+
+}  // namespace Open62541
+
+#endif  // SUBSCRIPTIONTUNER_H
@@ -38,8 +38,11 @@ void Open62541::ClientSubscription::statusChangeNotificationCallback(UA_Client*
     Client* cl = (Client*)UA_Client_getContext(client);
     if (cl) {
         ClientSubscription* c = cl->subscription(subId);
-        if (c)
+        if (c) {
+            if (c->_statistics)
+                c->_stats.statusChanges++;
             c->statusChangeNotification(notification);
+        }
     }
 }
 
@@ -76,3 +79,197 @@ bool Open62541::ClientSubscription::create()
     }
     return false;
 }
+
+/*!
+    \brief Open62541::ClientSubscription::noteDataChange
+    \param value
+*/
+void Open62541::ClientSubscription::noteDataChange(const UA_DataValue* value)
+{
+    // InfoType DataValue with the Overflow bit - the server discarded values from the item's queue
+    static const UA_StatusCode overflowBits = 0x00000480;
+    if (!_statistics || !value)
+        return;
+    _stats.notifications++;
+    if (value->hasStatus && ((value->status & overflowBits) == overflowBits))
+        _stats.overflows++;
+    UA_DateTime t = value->hasSourceTimestamp ? value->sourceTimestamp
+                    : value->hasServerTimestamp ? value->serverTimestamp
+                                                : 0;
+    if (t) {
+        // clocks of client and server may differ - early arrivals count as no delay
+        UA_Double d = std::max<UA_Double>(0, UA_Double(UA_DateTime_now() - t) / UA_DATETIME_MSEC);
+        _stats.latency += d;
+        _stats.maxLatency = std::max(_stats.maxLatency, d);
+        _stats.latencyCount++;
+    }
+}
+
+/*!
+    \brief Open62541::ClientSubscription::modify
+    \param publishingInterval
+    \param maxNotificationsPerPublish
+    \return true if the request was sent
+*/
+bool Open62541::ClientSubscription::modify(UA_Double publishingInterval, UA_UInt32 maxNotificationsPerPublish)
+{
+    if (!_client.client() || !id() || _modifying || (publishingInterval <= 0))
+        return false;
+    const UA_CreateSubscriptionResponse& r = _response.get();
+    UA_Double keepAlive                    = r.revisedPublishingInterval * r.revisedMaxKeepAliveCount;
+    UA_Double lifetime                     = r.revisedPublishingInterval * r.revisedLifetimeCount;
+    //
+    UA_ModifySubscriptionRequest* q = UA_ModifySubscriptionRequest_new();
+    q->subscriptionId               = id();
+    q->requestedPublishingInterval  = publishingInterval;
+    q->requestedMaxKeepAliveCount   = std::max<UA_UInt32>(1, UA_UInt32(keepAlive / publishingInterval + 0.5));
+    q->requestedLifetimeCount       = std::max<UA_UInt32>(3 * q->requestedMaxKeepAliveCount,
+                                                    UA_UInt32(lifetime / publishingInterval + 0.5));
+    q->maxNotificationsPerPublish   = maxNotificationsPerPublish;
+    q->priority                     = _settings.get().priority;
+    //
+    Client* cl   = &_client;
+    UA_UInt32 sid = id();
+    _modifying    = true;
+    _client.asyncRequest(q,
+                         &UA_TYPES[UA_TYPES_MODIFYSUBSCRIPTIONREQUEST],
+                         &UA_TYPES[UA_TYPES_MODIFYSUBSCRIPTIONRESPONSE],
+                         [cl, sid, maxNotificationsPerPublish](UA_StatusCode status, void* response) {
+                             ClientSubscription* c = cl->subscription(sid);  // may have been deleted meanwhile
+                             if (!c)
+                                 return;
+                             c->_modifying = false;
+                             c->_lastError = status;
+                             if (status != UA_STATUSCODE_GOOD)
+                                 return;
+                             const UA_ModifySubscriptionResponse* a =
+                                 static_cast<const UA_ModifySubscriptionResponse*>(response);
+                             UA_CreateSubscriptionResponse& r = c->_response.get();
+                             r.revisedPublishingInterval      = a->revisedPublishingInterval;
+                             r.revisedLifetimeCount           = a->revisedLifetimeCount;
+                             r.revisedMaxKeepAliveCount       = a->revisedMaxKeepAliveCount;
+                             UA_CreateSubscriptionRequest& s  = c->_settings.get();
+                             s.requestedPublishingInterval    = a->revisedPublishingInterval;
+                             s.requestedLifetimeCount         = a->revisedLifetimeCount;
+                             s.requestedMaxKeepAliveCount     = a->revisedMaxKeepAliveCount;
+                             s.maxNotificationsPerPublish     = maxNotificationsPerPublish;
+                             c->takeStatistics();  // the window measured the old settings
+                         });
+    return true;
+}
+
+/*!
+    \brief Open62541::ClientSubscription::detach
+*/
+void Open62541::ClientSubscription::detach()
+{
+    _response.null();
+    _modifying = false;
+    for (auto& i : _map)
+        i.second->detach();
+}
+
+namespace {
+// callbacks of one recreate
+struct Recreate {
+    Open62541::ClientSubscription* subscription = nullptr;
+    size_t batch                                = 0;
+    std::function<void(UA_StatusCode)> created;
+    std::function<void(size_t, size_t)> done;
+};
+}  // namespace
+
+/*!
+    \brief Open62541::ClientSubscription::recreate
+    \param batch
+    \param created
+    \param done
+    \return true if the request was sent
+*/
+bool Open62541::ClientSubscription::recreate(size_t batch,
+                                             std::function<void(UA_StatusCode)> created,
+                                             std::function<void(size_t items, size_t failed)> done)
+{
+    if (!_client.client())
+        return false;
+    std::unique_ptr<Recreate> r(new Recreate);
+    r->subscription = this;
+    r->batch        = std::max<size_t>(1, batch);
+    r->created      = created;
+    r->done         = done;
+    _lastError      = UA_Client_Subscriptions_create_async(_client.client(),
+                                                           _settings,
+                                                           this,
+                                                           statusChangeNotificationCallback,
+                                                           deleteSubscriptionCallback,
+                                                           recreateCallback,
+                                                           r.get(),
+                                                           nullptr);
+    if (_lastError != UA_STATUSCODE_GOOD)
+        return false;
+    r.release();  // owned by the response callback
+    return true;
+}
+
+/*!
+    \brief Open62541::ClientSubscription::recreateCallback
+    \param userdata
+    \param response
+*/
+void Open62541::ClientSubscription::recreateCallback(UA_Client* /*client*/,
+                                                     void* userdata,
+                                                     UA_UInt32 /*requestId*/,
+                                                     void* response)
+{
+    std::unique_ptr<Recreate> r(static_cast<Recreate*>(userdata));
+    ClientSubscription* s            = r->subscription;
+    UA_CreateSubscriptionResponse* a = static_cast<UA_CreateSubscriptionResponse*>(response);
+    s->_lastError                    = a ? a->responseHeader.serviceResult : UA_STATUSCODE_BADUNEXPECTEDERROR;
+    if (s->_lastError == UA_STATUSCODE_GOOD)
+        s->_response.assignFrom(*a);
+    if (r->created)
+        r->created(s->_lastError);
+    if (s->_lastError != UA_STATUSCODE_GOOD) {
+        if (r->done)
+            r->done(0, s->_map.size());
+        return;
+    }
+    //
+    // one request per batch of items of the same kind and timestamps
+    std::map<std::pair<bool, int>, std::vector<MonitoredItem*>> groups;
+    size_t failed = 0;
+    for (auto& i : s->_map) {
+        MonitoredItemCreateRequest q;
+        if (i.second->createRequest(q))
+            groups[std::make_pair(i.second->isEvent(), int(i.second->timestamps()))].push_back(i.second.get());
+        else
+            failed++;  // never created - nothing to recreate
+    }
+    struct Progress {
+        size_t pending = 1;  // released after all batches are sent
+        size_t items   = 0;
+        size_t failed  = 0;
+        std::function<void(size_t, size_t)> done;
+    };
+    auto p      = std::make_shared<Progress>();
+    p->failed   = failed;
+    p->done     = r->done;
+    auto finish = [p]() {
+        if ((--p->pending == 0) && p->done)
+            p->done(p->items, p->failed);
+    };
+    for (auto& g : groups) {
+        for (size_t i = 0; i < g.second.size(); i += r->batch) {
+            std::vector<MonitoredItem*> items(g.second.begin() + i,
+                                              g.second.begin() + std::min(g.second.size(), i + r->batch));
+            size_t n = items.size();
+            p->pending++;
+            MonitoredItem::recreate(*s, items, [p, n, finish](size_t created) {
+                p->items += created;
+                p->failed += n - created;
+                finish();
+            });
+        }
+    }
+    finish();
+}
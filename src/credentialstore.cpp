@@ -0,0 +1,580 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/credentialstore.h>
+#include <open62541cpp/open62541server.h>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <sys/stat.h>
+
+//
+// SHA-256 (FIPS 180-4) and HMAC / PBKDF2 on top of it - kept here so the library needs no crypto dependency
+//
+static const uint32_t sha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static inline uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+/*!
+    \brief The Sha256 class
+*/
+class Sha256
+{
+    uint32_t _h[8];
+    uint8_t _block[64];
+    size_t _used    = 0;
+    uint64_t _total = 0;
+
+    void compress(const uint8_t* p)
+    {
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++) {
+            w[i] = (uint32_t(p[4 * i]) << 24) | (uint32_t(p[4 * i + 1]) << 16) | (uint32_t(p[4 * i + 2]) << 8) |
+                   uint32_t(p[4 * i + 3]);
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i]        = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = _h[0], b = _h[1], c = _h[2], d = _h[3], e = _h[4], f = _h[5], g = _h[6], h = _h[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + sha256K[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h           = g;
+            g           = f;
+            f           = e;
+            e           = d + t1;
+            d           = c;
+            c           = b;
+            b           = a;
+            a           = t1 + t2;
+        }
+        _h[0] += a;
+        _h[1] += b;
+        _h[2] += c;
+        _h[3] += d;
+        _h[4] += e;
+        _h[5] += f;
+        _h[6] += g;
+        _h[7] += h;
+    }
+
+public:
+    Sha256()
+    {
+        static const uint32_t init[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                         0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+        memcpy(_h, init, sizeof(_h));
+    }
+    void update(const void* data, size_t n)
+    {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        _total += n;
+        while (n > 0) {
+            size_t k = std::min(n, size_t(64) - _used);
+            memcpy(_block + _used, p, k);
+            _used += k;
+            p += k;
+            n -= k;
+            if (_used == 64) {
+                compress(_block);
+                _used = 0;
+            }
+        }
+    }
+    void update(const std::string& s) { update(s.data(), s.size()); }
+    std::string final()
+    {
+        uint64_t bits = _total * 8;
+        uint8_t pad   = 0x80;
+        update(&pad, 1);
+        pad = 0;
+        while (_used != 56)
+            update(&pad, 1);
+        uint8_t len[8];
+        for (int i = 0; i < 8; i++)
+            len[i] = uint8_t(bits >> (56 - 8 * i));
+        update(len, 8);
+        std::string out(32, '\0');
+        for (int i = 0; i < 8; i++) {
+            out[4 * i]     = char(_h[i] >> 24);
+            out[4 * i + 1] = char(_h[i] >> 16);
+            out[4 * i + 2] = char(_h[i] >> 8);
+            out[4 * i + 3] = char(_h[i]);
+        }
+        return out;
+    }
+};
+
+/*!
+    \brief hmacSha256
+    \param key
+    \param message
+    \return MAC
+*/
+static std::string hmacSha256(const std::string& key, const std::string& message)
+{
+    std::string k = key;
+    if (k.size() > 64) {
+        Sha256 s;
+        s.update(k);
+        k = s.final();
+    }
+    k.resize(64, '\0');
+    std::string ipad(64, '\0'), opad(64, '\0');
+    for (int i = 0; i < 64; i++) {
+        ipad[i] = char(k[i] ^ 0x36);
+        opad[i] = char(k[i] ^ 0x5c);
+    }
+    Sha256 inner;
+    inner.update(ipad);
+    inner.update(message);
+    Sha256 outer;
+    outer.update(opad);
+    outer.update(inner.final());
+    return outer.final();
+}
+
+/*!
+    \brief toHex
+    \param s
+    \return hex string
+*/
+static std::string toHex(const std::string& s)
+{
+    static const char* digits = "0123456789abcdef";
+    std::string r;
+    r.reserve(s.size() * 2);
+    for (unsigned char c : s) {
+        r += digits[c >> 4];
+        r += digits[c & 0x0F];
+    }
+    return r;
+}
+
+/*!
+    \brief fromHex
+    \param s
+    \param out
+    \return true on success
+*/
+static bool fromHex(const std::string& s, std::string& out)
+{
+    if (s.size() & 1)
+        return false;
+    out.clear();
+    for (size_t i = 0; i < s.size(); i += 2) {
+        char b[3] = {s[i], s[i + 1], 0};
+        char* e   = nullptr;
+        long v    = strtol(b, &e, 16);
+        if (*e)
+            return false;
+        out += char(v);
+    }
+    return true;
+}
+
+/*!
+    \brief equalConstantTime
+    \param a
+    \param b
+    \return true if equal - time does not depend on where they differ
+*/
+static bool equalConstantTime(const std::string& a, const std::string& b)
+{
+    if (a.size() != b.size())
+        return false;
+    unsigned char d = 0;
+    for (size_t i = 0; i < a.size(); i++)
+        d |= (unsigned char)(a[i] ^ b[i]);
+    return d == 0;
+}
+
+/*!
+    \brief Open62541::CredentialStore::~CredentialStore
+*/
+Open62541::CredentialStore::~CredentialStore()
+{
+    if (_server && _timerId)
+        _server->removeTimerEvent(_timerId);  // the timer calls back into this
+    if (_loader.joinable())
+        _loader.join();
+}
+
+/*!
+    \brief Open62541::CredentialStore::hashPassword
+    \param password
+    \param salt
+    \param iterations
+    \return derived key
+*/
+std::string Open62541::CredentialStore::hashPassword(const std::string& password,
+                                                     const std::string& salt,
+                                                     UA_UInt32 iterations)
+{
+    // PBKDF2 with a single output block - the key length equals the hash length
+    std::string u = hmacSha256(password, salt + std::string("\x00\x00\x00\x01", 4));
+    std::string t = u;
+    for (UA_UInt32 i = 1; i < iterations; i++) {
+        u = hmacSha256(password, u);
+        for (size_t j = 0; j < t.size(); j++)
+            t[j] ^= u[j];
+    }
+    return t;
+}
+
+/*!
+    \brief Open62541::CredentialStore::makeSalt
+    \return random salt
+*/
+std::string Open62541::CredentialStore::makeSalt()
+{
+    std::random_device r;
+    std::string s(16, '\0');
+    for (auto& c : s)
+        c = char(r() & 0xFF);
+    return s;
+}
+
+/*!
+    \brief Open62541::CredentialStore::replace
+    \param m
+*/
+void Open62541::CredentialStore::replace(std::shared_ptr<const CredentialMap> m)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    _map = m;
+}
+
+/*!
+    \brief Open62541::CredentialStore::add
+    \param user
+    \param password
+    \param roles
+    \return true on success
+*/
+bool Open62541::CredentialStore::add(const std::string& user, const std::string& password, UA_UInt64 roles)
+{
+    if (user.empty() || (user.find(':') != std::string::npos))
+        return false;
+    Credential c;
+    c.salt       = makeSalt();
+    c.iterations = _iterations;
+    c.hash       = hashPassword(password, c.salt, c.iterations);
+    c.roles      = roles;
+    {
+        // copy on write - readers keep the map they hold
+        std::lock_guard<std::mutex> l(_mutex);
+        auto m   = std::make_shared<CredentialMap>(*_map);
+        (*m)[user] = c;
+        _map     = m;
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::CredentialStore::remove
+    \param user
+    \return true if removed
+*/
+bool Open62541::CredentialStore::remove(const std::string& user)
+{
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        if (_map->find(user) == _map->end())
+            return false;
+        auto m = std::make_shared<CredentialMap>(*_map);
+        m->erase(user);
+        _map = m;
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::CredentialStore::find
+    \param user
+    \param c
+    \return true if found
+*/
+bool Open62541::CredentialStore::find(const std::string& user, Credential& c) const
+{
+    auto m = current();
+    auto i = m->find(user);
+    if (i != m->end()) {
+        c = i->second;
+        return true;
+    }
+    return false;
+}
+
+/*!
+    \brief Open62541::CredentialStore::verify
+    \param user
+    \param password
+    \return true if the password matches
+*/
+bool Open62541::CredentialStore::verify(const std::string& user, const std::string& password)
+{
+    auto m     = current();
+    auto i     = m->find(user);
+    bool known = (i != m->end());
+    Credential dummy;
+    if (!known) {
+        // unknown users are derived against a dummy credential so they take as long as known ones
+        dummy.salt       = std::string(16, '\0');
+        dummy.iterations = _iterations;
+        dummy.hash       = std::string(32, '\0');
+    }
+    const Credential& c = known ? i->second : dummy;
+    std::string d       = digest(c.salt, password);
+    if (known) {
+        std::lock_guard<std::mutex> l(_cacheMutex);
+        auto j = _cache.find(user);
+        if ((j != _cache.end()) && (j->second.salt == c.salt) && (j->second.hash == c.hash) &&
+            equalConstantTime(j->second.digest, d)) {
+            _uses.splice(_uses.begin(), _uses, j->second.use);
+            return true;
+        }
+    }
+    if (!equalConstantTime(hashPassword(password, c.salt, c.iterations), c.hash) || !known)
+        return false;
+    std::lock_guard<std::mutex> l(_cacheMutex);
+    if (_cacheSize == 0)
+        return true;
+    auto j = _cache.find(user);
+    if (j == _cache.end()) {
+        if (_cache.size() >= _cacheSize) {
+            _cache.erase(_uses.back());  // least recently verified
+            _uses.pop_back();
+        }
+        _uses.push_front(user);
+        j             = _cache.emplace(user, Verified()).first;
+        j->second.use = _uses.begin();
+    }
+    else {
+        _uses.splice(_uses.begin(), _uses, j->second.use);
+    }
+    j->second.salt   = c.salt;
+    j->second.hash   = c.hash;
+    j->second.digest = d;
+    return true;
+}
+
+/*!
+    \brief Open62541::CredentialStore::digest
+    \param salt
+    \param password
+    \return digest of a password remembered once verified - keyed by the store so it cannot be checked offline
+*/
+std::string Open62541::CredentialStore::digest(const std::string& salt, const std::string& password) const
+{
+    return hmacSha256(_cacheKey, salt + password);
+}
+
+/*!
+    \brief Open62541::CredentialStore::setCacheSize
+    \param n
+*/
+void Open62541::CredentialStore::setCacheSize(size_t n)
+{
+    std::lock_guard<std::mutex> l(_cacheMutex);
+    _cacheSize = n;
+    while (_cache.size() > _cacheSize) {
+        _cache.erase(_uses.back());
+        _uses.pop_back();
+    }
+}
+
+/*!
+    \brief Open62541::CredentialStore::parse
+    \param fileName
+    \param m
+    \return true on success
+*/
+bool Open62541::CredentialStore::parse(const std::string& fileName, CredentialMap& m)
+{
+    std::ifstream is(fileName);
+    if (!is)
+        return false;
+    std::map<std::string, std::string> plain;  // user to password - later lines replace earlier ones
+    std::string line;
+    while (std::getline(is, line)) {
+        if (line.empty() || (line[0] == '#'))
+            continue;
+        std::vector<std::string> f;
+        std::stringstream ss(line);
+        std::string s;
+        while (std::getline(ss, s, ':'))
+            f.push_back(s);
+        if (f.size() < 3)
+            continue;
+        try {
+            if ((f[1] == "pbkdf2-sha256") && (f.size() >= 5)) {
+                Credential c;
+                c.iterations = UA_UInt32(std::stoul(f[2]));
+                if (!fromHex(f[3], c.salt) || !fromHex(f[4], c.hash) || (c.iterations == 0))
+                    continue;
+                if (f.size() > 5)
+                    c.roles = std::stoull(f[5], nullptr, 0);
+                m[f[0]] = c;
+                plain.erase(f[0]);
+            }
+            else if (f[1] == "plain") {
+                Credential c;
+                if (f.size() > 3)
+                    c.roles = std::stoull(f[3], nullptr, 0);
+                m[f[0]]       = c;
+                plain[f[0]] = f[2];
+            }
+        }
+        catch (...) {
+            // malformed line - skip it
+        }
+    }
+    if (!plain.empty()) {
+        // key derivation is deliberately slow - spread it over the workers
+        unsigned n = _workers ? _workers : std::max(1U, std::thread::hardware_concurrency());
+        n          = std::min<unsigned>(n, unsigned(plain.size()));
+        std::vector<std::pair<Credential*, const std::string*>> targets;
+        for (auto& p : plain)
+            targets.push_back(std::make_pair(&m[p.first], &p.second));
+        std::vector<std::thread> workers;
+        UA_UInt32 iterations = _iterations;
+        for (unsigned w = 0; w < n; w++) {
+            workers.emplace_back([&, w] {
+                for (size_t i = w; i < targets.size(); i += n) {
+                    Credential& c = *targets[i].first;
+                    c.salt        = makeSalt();
+                    c.iterations  = iterations;
+                    c.hash        = hashPassword(*targets[i].second, c.salt, c.iterations);
+                }
+            });
+        }
+        for (auto& t : workers)
+            t.join();
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::CredentialStore::load
+    \param fileName
+    \return true on success
+*/
+bool Open62541::CredentialStore::load(const std::string& fileName)
+{
+    struct stat st;
+    if (::stat(fileName.c_str(), &st) != 0)
+        return false;
+    auto m = std::make_shared<CredentialMap>();
+    if (!parse(fileName, *m))
+        return false;
+    {
+        std::lock_guard<std::mutex> l(_fileMutex);
+        _fileName = fileName;
+        _modified = st.st_mtime;
+    }
+    replace(m);
+    return true;
+}
+
+/*!
+    \brief Open62541::CredentialStore::save
+    \param fileName
+    \return true on success
+*/
+bool Open62541::CredentialStore::save(const std::string& fileName)
+{
+    std::string loaded;
+    {
+        std::lock_guard<std::mutex> l(_fileMutex);
+        loaded = _fileName;
+    }
+    std::string f = fileName.empty() ? loaded : fileName;
+    if (f.empty())
+        return false;
+    std::string tmp = f + ".tmp";
+    {
+        std::ofstream os(tmp);
+        if (!os)
+            return false;
+        os << "# name:pbkdf2-sha256:iterations:salt:hash:roles" << std::endl;
+        auto m = current();
+        for (auto& i : *m) {
+            os << i.first << ":pbkdf2-sha256:" << i.second.iterations << ":" << toHex(i.second.salt) << ":"
+               << toHex(i.second.hash) << ":0x" << std::hex << i.second.roles << std::dec << std::endl;
+        }
+        if (!os)
+            return false;
+    }
+    if (::rename(tmp.c_str(), f.c_str()) != 0)
+        return false;
+    struct stat st;
+    std::lock_guard<std::mutex> l(_fileMutex);
+    if ((f == _fileName) && (::stat(f.c_str(), &st) == 0))
+        _modified = st.st_mtime;  // do not reload our own write
+    return true;
+}
+
+/*!
+    \brief Open62541::CredentialStore::reloadIfChanged
+    \return true if a reload was started
+*/
+bool Open62541::CredentialStore::reloadIfChanged()
+{
+    struct stat st;
+    std::string f;
+    {
+        std::lock_guard<std::mutex> l(_fileMutex);
+        if (_fileName.empty() || _loading || (::stat(_fileName.c_str(), &st) != 0) || (st.st_mtime == _modified))
+            return false;
+        f         = _fileName;
+        _modified = st.st_mtime;
+    }
+    if (_loader.joinable())
+        _loader.join();
+    _loading = true;
+    _loader  = std::thread([this, f] {
+        auto m = std::make_shared<CredentialMap>();
+        if (parse(f, *m))
+            replace(m);
+        _loading = false;
+    });
+    return true;
+}
+
+/*!
+    \brief Open62541::CredentialStore::watch
+    \param server
+    \param interval_ms
+    \return true on success
+*/
+bool Open62541::CredentialStore::watch(Server& server, UA_Double interval_ms)
+{
+    if (_server && _timerId)
+        _server->removeTimerEvent(_timerId);
+    _server  = nullptr;
+    _timerId = 0;
+    if (!server.addRepeatedTimerEvent(interval_ms, _timerId, [this](Server::Timer&) { reloadIfChanged(); }))
+        return false;
+    _server = &server;
+    return true;
+}
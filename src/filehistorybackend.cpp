@@ -0,0 +1,1119 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/filehistorybackend.h>
+#include <open62541cpp/historyaggregates.h>
+#include <open62541cpp/historycompression.h>
+#include <open62541cpp/open62541server.h>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*!
+    \brief Open62541::FileHistoryBackend::FileHistoryBackend
+    \param directory
+    \param segmentRecords
+    \param bufferRecords
+*/
+Open62541::FileHistoryBackend::FileHistoryBackend(const std::string& directory,
+                                                  size_t segmentRecords,
+                                                  size_t bufferRecords)
+    : _directory(directory)
+    , _segmentRecords(std::max(segmentRecords, FILE_HISTORY_INDEX_STRIDE))
+    , _bufferRecords(std::max(bufferRecords, size_t(1)))
+{
+    if ((::mkdir(_directory.c_str(), 0775) != 0) && (errno != EEXIST))
+        _lastError = UA_STATUSCODE_BADINTERNALERROR;
+    initialise();
+    database().getHistoryData = nullptr;  // use the low level API
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::~FileHistoryBackend
+*/
+Open62541::FileHistoryBackend::~FileHistoryBackend()
+{
+    close();
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::toRecord
+    \param v
+    \param r
+    \return UA_STATUSCODE_GOOD or the reason the value cannot be stored
+*/
+UA_StatusCode Open62541::FileHistoryBackend::toRecord(const UA_DataValue& v, FileHistoryRecord& r)
+{
+    memset(&r, 0, sizeof(r));
+    if (v.hasValue && v.value.type) {
+        const UA_DataType* t = v.value.type;
+        if ((t < &UA_TYPES[0]) || (t >= &UA_TYPES[UA_TYPES_COUNT]) || !t->pointerFree ||
+            (t->memSize > FILE_HISTORY_VALUE_SIZE) || !UA_Variant_isScalar(&v.value))
+            return UA_STATUSCODE_BADTYPEMISMATCH;
+        r.typeIndex = UA_UInt16(t - &UA_TYPES[0]);
+        memcpy(r.value, v.value.data, t->memSize);
+        r.flags |= FileHistoryRecord::HasValue;
+    }
+    if (v.hasStatus) {
+        r.status = v.status;
+        r.flags |= FileHistoryRecord::HasStatus;
+    }
+    if (v.hasServerTimestamp) {
+        r.serverTimestamp = v.serverTimestamp;
+        r.flags |= FileHistoryRecord::HasServerTimestamp;
+    }
+    if (v.hasSourceTimestamp) {
+        r.timestamp = v.sourceTimestamp;
+        r.flags |= FileHistoryRecord::HasSourceTimestamp;
+    }
+    else if (v.hasServerTimestamp) {
+        r.timestamp = v.serverTimestamp;
+    }
+    else {
+        r.timestamp = UA_DateTime_now();
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::toDataValue
+    \param r
+    \param v
+    \param range
+    \return UA_STATUSCODE_GOOD on success
+*/
+UA_StatusCode Open62541::FileHistoryBackend::toDataValue(const FileHistoryRecord& r,
+                                                         UA_DataValue& v,
+                                                         const UA_NumericRange* range)
+{
+    UA_DataValue_clear(&v);
+    if (r.flags & FileHistoryRecord::HasValue) {
+        if (r.typeIndex >= UA_TYPES_COUNT)
+            return UA_STATUSCODE_BADDATAENCODINGINVALID;
+        if (range && range->dimensionsSize) {
+            // stored values are scalars
+            v.status    = UA_STATUSCODE_BADINDEXRANGENODATA;
+            v.hasStatus = true;
+        }
+        else {
+            UA_StatusCode ret = UA_Variant_setScalarCopy(&v.value, r.value, &UA_TYPES[r.typeIndex]);
+            if (ret != UA_STATUSCODE_GOOD)
+                return ret;
+            v.hasValue = true;
+        }
+    }
+    if (r.flags & FileHistoryRecord::HasStatus) {
+        v.status    = r.status;
+        v.hasStatus = true;
+    }
+    if (r.flags & FileHistoryRecord::HasServerTimestamp) {
+        v.serverTimestamp    = r.serverTimestamp;
+        v.hasServerTimestamp = true;
+    }
+    if (r.flags & FileHistoryRecord::HasSourceTimestamp) {
+        v.sourceTimestamp    = r.timestamp;
+        v.hasSourceTimestamp = true;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::nodeDirectory
+    \param n
+    \return directory holding the segments of the node
+*/
+std::string Open62541::FileHistoryBackend::nodeDirectory(const NodeId& n) const
+{
+    // readable but file system safe - the hash keeps ids that sanitise to the same name apart
+    std::string s = toString(*n.constRef());
+    for (auto& c : s) {
+        if (!isalnum((unsigned char)c) && (c != '-') && (c != '.'))
+            c = '_';
+    }
+    char h[16];
+    snprintf(h, sizeof(h), "_%08x", n.hash());
+    return _directory + "/" + s + h;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::node
+    \param n
+    \param create create the store if it is not known - otherwise only if the node has history on disk
+    \return node store or null
+*/
+Open62541::FileHistoryBackend::NodeStore* Open62541::FileHistoryBackend::node(const NodeId& n, bool create)
+{
+    {
+        ReadLock l(_nodesMutex);
+        auto i = _nodes.find(n);
+        if (i != _nodes.end())
+            return i->second.get();
+    }
+    struct stat st;
+    if (!create && ((::stat(nodeDirectory(n).c_str(), &st) != 0) || !S_ISDIR(st.st_mode)))
+        return nullptr;  // reads do not register stores for nodes without history
+    WriteLock l(_nodesMutex);
+    NodeStorePtr& p = _nodes[n];
+    if (!p) {
+        p.reset(new NodeStore);
+        p->dir = nodeDirectory(n);
+    }
+    return p.get();
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::openSegment
+    \param s segment with path, first and capacity set when creating
+    \param create
+    \return true on success
+*/
+bool Open62541::FileHistoryBackend::openSegment(Segment& s, bool create)
+{
+    FileHistorySegmentHeader h;
+    s.fd = ::open(s.path.c_str(), create ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0664);
+    if (s.fd < 0)
+        return false;
+    if (create) {
+        memset(&h, 0, sizeof(h));
+        h.magic      = FILE_HISTORY_MAGIC;
+        h.version    = FILE_HISTORY_VERSION;
+        h.recordSize = sizeof(FileHistoryRecord);
+        h.capacity   = UA_UInt32(s.capacity);
+        h.first      = s.first;
+        if (::pwrite(s.fd, &h, sizeof(h), 0) != ssize_t(sizeof(h)))
+            return false;
+        s.written = 0;
+    }
+    else {
+        struct stat st;
+        if ((::pread(s.fd, &h, sizeof(h), 0) != ssize_t(sizeof(h))) || (h.magic != FILE_HISTORY_MAGIC) ||
+            (h.version != FILE_HISTORY_VERSION) || (h.recordSize != sizeof(FileHistoryRecord)) || (h.capacity == 0) ||
+            (::fstat(s.fd, &st) != 0))
+            return false;
+        s.first    = h.first;
+        s.capacity = h.capacity;
+        s.written  = std::min(size_t(st.st_size - sizeof(h)) / sizeof(FileHistoryRecord), s.capacity);
+        off_t size = off_t(sizeof(h) + s.written * sizeof(FileHistoryRecord));
+        if (st.st_size != size && ::ftruncate(s.fd, size) != 0)  // drop a torn record
+            return false;
+    }
+    // map the whole capacity once - only the written part is ever touched
+    s.mapSize = sizeof(FileHistorySegmentHeader) + s.capacity * sizeof(FileHistoryRecord);
+    s.map     = ::mmap(nullptr, s.mapSize, PROT_READ, MAP_SHARED, s.fd, 0);
+    if (s.map == MAP_FAILED) {
+        s.map = nullptr;
+        return false;
+    }
+    // rebuild the sparse index
+    s.index.clear();
+    const FileHistoryRecord* r = s.records();
+    for (size_t i = 0; i < s.written; i += FILE_HISTORY_INDEX_STRIDE) {
+        s.index.push_back(r[i].timestamp);
+    }
+    if (s.written) {
+        s.firstTime = r[0].timestamp;
+        s.lastTime  = r[s.written - 1].timestamp;
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::closeSegment
+    \param s
+*/
+void Open62541::FileHistoryBackend::closeSegment(Segment& s)
+{
+    if (s.map) {
+        ::munmap(s.map, s.mapSize);
+        s.map = nullptr;
+    }
+    s.blocks = nullptr;
+    if (s.fd >= 0) {
+        ::close(s.fd);
+        s.fd = -1;
+    }
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::openCompressed
+    \param s segment with the path set
+    \return true on success
+*/
+bool Open62541::FileHistoryBackend::openCompressed(Segment& s)
+{
+    struct stat st;
+    s.fd = ::open(s.path.c_str(), O_RDONLY);
+    if ((s.fd < 0) || (::fstat(s.fd, &st) != 0) || (size_t(st.st_size) < sizeof(FileHistoryCompressedHeader)))
+        return false;
+    s.mapSize = size_t(st.st_size);
+    s.map     = ::mmap(nullptr, s.mapSize, PROT_READ, MAP_SHARED, s.fd, 0);
+    ::close(s.fd);  // never written
+    s.fd = -1;
+    if (s.map == MAP_FAILED) {
+        s.map = nullptr;
+        return false;
+    }
+    const FileHistoryCompressedHeader* h = static_cast<const FileHistoryCompressedHeader*>(s.map);
+    if ((h->magic != FILE_HISTORY_COMPRESSED_MAGIC) || (h->version != FILE_HISTORY_VERSION) || (h->blockRecords == 0) ||
+        (sizeof(FileHistoryCompressedHeader) + size_t(h->blockCount) * sizeof(FileHistoryBlockEntry) > s.mapSize))
+        return false;
+    s.compressed = true;
+    s.first      = h->first;
+    s.written    = size_t(h->count);
+    s.capacity   = s.written;  // full - appends go to a new segment
+    s.stride     = h->blockRecords;
+    s.blocks     = reinterpret_cast<const FileHistoryBlockEntry*>(static_cast<const char*>(s.map) +
+                                                               sizeof(FileHistoryCompressedHeader));
+    s.index.clear();
+    size_t total = 0;
+    for (size_t i = 0; i < h->blockCount; i++) {
+        const FileHistoryBlockEntry& b = s.blocks[i];
+        if ((b.offset + b.size > s.mapSize) || (b.count != std::min<size_t>(s.stride, s.written - total)))
+            return false;
+        s.index.push_back(b.firstTime);
+        total += b.count;
+    }
+    if (total != s.written)
+        return false;
+    if (s.written) {
+        s.firstTime = s.blocks[0].firstTime;
+        s.lastTime  = s.blocks[h->blockCount - 1].lastTime;
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::openNode
+    Scan the node directory for segments
+    \param n
+    \return true on success
+*/
+bool Open62541::FileHistoryBackend::openNode(NodeStore& n)
+{
+    n.opened = true;
+    DIR* d   = ::opendir(n.dir.c_str());
+    if (!d)
+        return true;  // no history yet
+    auto ends = [](const std::string& f, const char* e) {
+        size_t l = strlen(e);
+        return (f.size() > l) && (f.compare(f.size() - l, l, e) == 0);
+    };
+    std::vector<std::string> names;
+    while (struct dirent* e = ::readdir(d)) {
+        std::string f(e->d_name);
+        if (ends(f, ".seg") || ends(f, ".cseg"))
+            names.push_back(f);
+    }
+    ::closedir(d);
+    std::sort(names.begin(), names.end());  // fixed width hex names sort by first index, .cseg before .seg
+    std::string last;
+    for (const auto& f : names) {
+        std::string stem = f.substr(0, f.find('.'));
+        std::string path = n.dir + "/" + f;
+        if (stem == last) {
+            ::unlink(path.c_str());  // raw segment left behind by a completed compaction
+            continue;
+        }
+        SegmentPtr s(new Segment);
+        s->path = path;
+        bool ok = ends(f, ".cseg") ? openCompressed(*s) : openSegment(*s, false);
+        if (!ok || (!n.segments.empty() && (s->first != n.end()))) {
+            closeSegment(*s);
+            _lastError = UA_STATUSCODE_BADDATALOST;  // damaged or missing segment - skip
+            continue;
+        }
+        last = stem;
+        n.segments.push_back(std::move(s));
+    }
+    for (size_t i = 0; i + 1 < n.segments.size(); i++) {
+        // only the last segment is appended to
+        if (n.segments[i]->fd >= 0) {
+            ::close(n.segments[i]->fd);
+            n.segments[i]->fd = -1;
+        }
+    }
+    for (auto i = n.segments.rbegin(); i != n.segments.rend(); ++i) {
+        if ((*i)->written) {
+            n.lastTime = (*i)->lastTime;
+            break;
+        }
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::newSegment
+    \param n
+    \return true on success
+*/
+bool Open62541::FileHistoryBackend::newSegment(NodeStore& n)
+{
+    if ((::mkdir(n.dir.c_str(), 0775) != 0) && (errno != EEXIST))
+        return false;
+    SegmentPtr s(new Segment);
+    s->first    = n.end();
+    s->capacity = _segmentRecords;
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.seg", (unsigned long long)(s->first));
+    s->path = n.dir + name;
+    if (!openSegment(*s, true)) {
+        closeSegment(*s);
+        ::unlink(s->path.c_str());
+        return false;
+    }
+    if (!n.segments.empty() && (n.segments.back()->fd >= 0)) {
+        ::close(n.segments.back()->fd);  // sealed
+        n.segments.back()->fd = -1;
+    }
+    n.segments.push_back(std::move(s));
+    return true;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::flushNode
+    Write the pending records of the last segment
+    \param n
+    \param sync
+    \return true on success
+*/
+bool Open62541::FileHistoryBackend::flushNode(NodeStore& n, bool sync)
+{
+    if (n.segments.empty())
+        return true;
+    Segment& s = *n.segments.back();
+    if (!n.buffer.empty()) {
+        // positional writes so a failed flush can simply be retried
+        const char* p = reinterpret_cast<const char*>(n.buffer.data());
+        size_t len    = n.buffer.size() * sizeof(FileHistoryRecord);
+        off_t off     = off_t(sizeof(FileHistorySegmentHeader) + s.written * sizeof(FileHistoryRecord));
+        while (len) {
+            ssize_t w = ::pwrite(s.fd, p, len, off);
+            if (w < 0) {
+                if (errno == EINTR)
+                    continue;
+                _lastError = UA_STATUSCODE_BADINTERNALERROR;
+                return false;
+            }
+            p += w;
+            off += w;
+            len -= size_t(w);
+        }
+        s.written += n.buffer.size();
+        s.pending = 0;
+        n.buffer.clear();
+    }
+    if (sync && (s.fd >= 0) && (::fdatasync(s.fd) != 0)) {
+        _lastError = UA_STATUSCODE_BADINTERNALERROR;
+        return false;
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::append
+    \param n node store - locked by the caller
+    \param r
+    \return UA_STATUSCODE_GOOD on success
+*/
+UA_StatusCode Open62541::FileHistoryBackend::append(NodeStore& n, const FileHistoryRecord& r)
+{
+    if (!n.opened)
+        openNode(n);
+    if (r.timestamp < n.lastTime) {
+        _rejected++;
+        return UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;  // out of order - the files are append only
+    }
+    if (n.segments.empty() || (n.segments.back()->count() >= n.segments.back()->capacity)) {
+        if (!flushNode(n, false) || !newSegment(n)) {
+            _rejected++;
+            _lastError = UA_STATUSCODE_BADINTERNALERROR;
+            return _lastError;
+        }
+    }
+    Segment& s = *n.segments.back();
+    size_t pos = s.count();
+    if ((pos % FILE_HISTORY_INDEX_STRIDE) == 0)
+        s.index.push_back(r.timestamp);
+    if (pos == 0)
+        s.firstTime = r.timestamp;
+    s.lastTime = r.timestamp;
+    n.lastTime = r.timestamp;
+    n.buffer.push_back(r);
+    s.pending++;
+    _samples++;
+    if (n.buffer.size() >= _bufferRecords)
+        flushNode(n, false);
+    return UA_STATUSCODE_GOOD;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::segment
+    \param n node store - locked by the caller
+    \param index
+    \return segment holding the record or null
+*/
+Open62541::FileHistoryBackend::Segment* Open62541::FileHistoryBackend::segment(NodeStore& n, UA_UInt64 index) const
+{
+    if ((index < n.first()) || (index >= n.end()))
+        return nullptr;
+    auto i = std::upper_bound(n.segments.begin(),
+                              n.segments.end(),
+                              index,
+                              [](UA_UInt64 v, const SegmentPtr& s) { return v < s->first; });
+    return (--i)->get();
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::decodeBlock
+    \param n node store - locked by the caller
+    \param s compressed segment
+    \param block
+    \return first record of the decoded block or null
+*/
+const Open62541::FileHistoryRecord* Open62541::FileHistoryBackend::decodeBlock(NodeStore& n,
+                                                                               const Segment& s,
+                                                                               size_t block)
+{
+    if ((n.cacheSegment != &s) || (n.cacheBlock != block)) {
+        const FileHistoryBlockEntry& b = s.blocks[block];
+        HistoryBlockDecoder d(static_cast<const UA_Byte*>(s.map) + b.offset, b.size);
+        n.cache.resize(b.count);
+        n.cacheSegment = nullptr;
+        if (d.decode(n.cache.data(), b.count) != b.count) {
+            _lastError = UA_STATUSCODE_BADDATAENCODINGINVALID;
+            return nullptr;
+        }
+        n.cacheSegment = &s;
+        n.cacheBlock   = block;
+    }
+    return n.cache.data();
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::record
+    \param n node store - locked by the caller
+    \param index
+    \return record or null - valid until the node is next accessed
+*/
+const Open62541::FileHistoryRecord* Open62541::FileHistoryBackend::record(NodeStore& n, UA_UInt64 index)
+{
+    Segment* s = segment(n, index);
+    if (!s)
+        return nullptr;
+    size_t pos = size_t(index - s->first);
+    if (s->compressed) {
+        const FileHistoryRecord* r = decodeBlock(n, *s, pos / s->stride);
+        return r ? r + (pos % s->stride) : nullptr;
+    }
+    return (pos < s->written) ? &s->records()[pos] : &n.buffer[pos - s->written];
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::lowerBound
+    \param n node store - locked by the caller
+    \param t
+    \param after if true find the first record later than t otherwise the first not earlier than t
+    \return index of the record or end if there is none
+*/
+UA_UInt64 Open62541::FileHistoryBackend::lowerBound(NodeStore& n, UA_DateTime t, bool after)
+{
+    auto before = [after, t](UA_DateTime v) { return after ? (v <= t) : (v < t); };
+    // the first segment whose last record qualifies
+    auto si = std::partition_point(n.segments.begin(), n.segments.end(), [&](const SegmentPtr& s) {
+        return (s->count() == 0) || before(s->lastTime);
+    });
+    if ((si == n.segments.end()) || ((*si)->count() == 0))
+        return n.end();
+    Segment& s = **si;
+    // sparse index narrows the search to one stride
+    size_t k  = size_t(std::partition_point(s.index.begin(), s.index.end(), before) - s.index.begin());
+    size_t lo = (k == 0) ? 0 : (k - 1) * s.stride;
+    size_t hi = std::min(k * s.stride, s.count());
+    while (lo < hi) {
+        size_t m                   = lo + (hi - lo) / 2;
+        const FileHistoryRecord* r = record(n, s.first + m);
+        if (!r)
+            return n.end();
+        if (before(r->timestamp))
+            lo = m + 1;
+        else
+            hi = m;
+    }
+    return s.first + lo;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::add
+    \param n
+    \param v
+    \return UA_STATUSCODE_GOOD on success
+*/
+UA_StatusCode Open62541::FileHistoryBackend::add(const NodeId& n, const UA_DataValue& v)
+{
+    FileHistoryRecord r;
+    UA_StatusCode ret = toRecord(v, r);
+    if (ret != UA_STATUSCODE_GOOD) {
+        _rejected++;
+        return ret;
+    }
+    NodeStore* p = node(n);
+    std::lock_guard<std::mutex> l(p->mutex);
+    return append(*p, r);
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::flush
+    \param sync
+    \return true on success
+*/
+bool Open62541::FileHistoryBackend::flush(bool sync)
+{
+    bool ret = true;
+    ReadLock l(_nodesMutex);
+    for (auto& i : _nodes) {
+        std::lock_guard<std::mutex> g(i.second->mutex);
+        if (!flushNode(*i.second, sync))
+            ret = false;
+    }
+    return ret;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::setFlushInterval
+    \param server
+    \param interval_ms
+    \return true on success
+*/
+bool Open62541::FileHistoryBackend::setFlushInterval(Server& server, UA_Double interval_ms)
+{
+    if (_timerId)
+        return server.changeRepeatedTimerInterval(_timerId, interval_ms);
+    return server.addRepeatedTimerEvent(interval_ms, _timerId, [this](Server::Timer&) { flush(); });
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::compressSegment
+    \param n node store - locked by the caller
+    \param i position of a sealed raw segment
+    \return true on success
+*/
+bool Open62541::FileHistoryBackend::compressSegment(NodeStore& n, size_t i)
+{
+    Segment& s = *n.segments[i];
+    size_t blockCount = (s.written + HISTORY_BLOCK_RECORDS - 1) / HISTORY_BLOCK_RECORDS;
+    FileHistoryCompressedHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic        = FILE_HISTORY_COMPRESSED_MAGIC;
+    h.version      = FILE_HISTORY_VERSION;
+    h.blockRecords = UA_UInt32(HISTORY_BLOCK_RECORDS);
+    h.blockCount   = UA_UInt32(blockCount);
+    h.first        = s.first;
+    h.count        = s.written;
+    std::vector<FileHistoryBlockEntry> directory(blockCount);
+    std::string data;
+    size_t base = sizeof(h) + blockCount * sizeof(FileHistoryBlockEntry);
+    const FileHistoryRecord* r = s.records();
+    for (size_t b = 0, k = 0; b < blockCount; b++, k += HISTORY_BLOCK_RECORDS) {
+        size_t c                     = std::min(HISTORY_BLOCK_RECORDS, s.written - k);
+        FileHistoryBlockEntry& e     = directory[b];
+        e.offset                     = base + data.size();
+        e.count                      = UA_UInt32(c);
+        e.firstTime                  = r[k].timestamp;
+        e.lastTime                   = r[k + c - 1].timestamp;
+        if (!HistoryBlockEncoder::encode(r + k, c, data))
+            return false;
+        e.size = UA_UInt32(base + data.size() - e.offset);
+    }
+    // write aside then rename so a crash leaves either the raw or the compressed segment
+    std::string path = s.path.substr(0, s.path.rfind('.')) + ".cseg";
+    std::string temp = path + ".tmp";
+    int fd           = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0664);
+    if (fd < 0)
+        return false;
+    bool ok = (::write(fd, &h, sizeof(h)) == ssize_t(sizeof(h))) &&
+              (::write(fd, directory.data(), directory.size() * sizeof(FileHistoryBlockEntry)) ==
+               ssize_t(directory.size() * sizeof(FileHistoryBlockEntry))) &&
+              (::write(fd, data.data(), data.size()) == ssize_t(data.size())) && (::fdatasync(fd) == 0);
+    ::close(fd);
+    if (!ok || (::rename(temp.c_str(), path.c_str()) != 0)) {
+        ::unlink(temp.c_str());
+        return false;
+    }
+    SegmentPtr c(new Segment);
+    c->path = path;
+    if (!openCompressed(*c)) {
+        closeSegment(*c);
+        ::unlink(path.c_str());
+        return false;
+    }
+    if (n.cacheSegment == &s)
+        n.cacheSegment = nullptr;
+    closeSegment(s);
+    ::unlink(s.path.c_str());
+    n.segments[i] = std::move(c);
+    return true;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::compact
+    \param maxSegments
+    \return number of segments compressed
+*/
+size_t Open62541::FileHistoryBackend::compact(size_t maxSegments)
+{
+    std::vector<NodeStore*> nodes;
+    {
+        ReadLock l(_nodesMutex);
+        for (auto& i : _nodes)
+            nodes.push_back(i.second.get());
+    }
+    size_t done = 0;
+    for (auto p : nodes) {
+        // the last segment is still being appended to
+        for (size_t i = 0; done < maxSegments; i++) {
+            std::lock_guard<std::mutex> l(p->mutex);
+            if (i + 1 >= p->segments.size())
+                break;
+            Segment& s = *p->segments[i];
+            if (s.compressed || (s.written == 0) || s.pending)
+                continue;
+            if (!compressSegment(*p, i)) {
+                _lastError = UA_STATUSCODE_BADINTERNALERROR;
+                break;
+            }
+            done++;
+        }
+    }
+    return done;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::close
+*/
+void Open62541::FileHistoryBackend::close()
+{
+    WriteLock l(_nodesMutex);
+    for (auto& i : _nodes) {
+        std::lock_guard<std::mutex> g(i.second->mutex);
+        flushNode(*i.second, true);
+        for (auto& s : i.second->segments)
+            closeSegment(*s);
+    }
+    _nodes.clear();
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::serverSetHistoryData
+    \param c
+    \param value
+    \return UA_STATUSCODE_GOOD on success
+*/
+UA_StatusCode Open62541::FileHistoryBackend::serverSetHistoryData(Context& c,
+                                                                  bool /*historizing*/,
+                                                                  const UA_DataValue* value)
+{
+    return value ? add(c.nodeId, *value) : UA_STATUSCODE_GOOD;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::getDateTimeMatch
+    \param c
+    \param timestamp
+    \param strategy
+    \return index of the match or getEnd() if there is none
+*/
+size_t Open62541::FileHistoryBackend::getDateTimeMatch(Context& c,
+                                                       const UA_DateTime timestamp,
+                                                       const MatchStrategy strategy)
+{
+    NodeStore* p = node(c.nodeId, false);
+    if (!p)
+        return 0;
+    std::lock_guard<std::mutex> l(p->mutex);
+    if (!p->opened)
+        openNode(*p);
+    UA_UInt64 end = p->end();
+    UA_UInt64 i   = end;
+    switch (strategy) {
+        case MATCH_EQUAL: {
+            i                          = lowerBound(*p, timestamp, false);
+            const FileHistoryRecord* r = record(*p, i);
+            if (!r || (r->timestamp != timestamp))
+                i = end;
+        } break;
+        case MATCH_EQUAL_OR_AFTER:
+            i = lowerBound(*p, timestamp, false);
+            break;
+        case MATCH_AFTER:
+            i = lowerBound(*p, timestamp, true);
+            break;
+        case MATCH_EQUAL_OR_BEFORE:
+            i = lowerBound(*p, timestamp, true);
+            i = (i > p->first()) ? i - 1 : end;
+            break;
+        case MATCH_BEFORE:
+            i = lowerBound(*p, timestamp, false);
+            i = (i > p->first()) ? i - 1 : end;
+            break;
+        default:
+            break;
+    }
+    return size_t(i);
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::getEnd
+    \param c
+    \return index past the last record
+*/
+size_t Open62541::FileHistoryBackend::getEnd(Context& c)
+{
+    NodeStore* p = node(c.nodeId, false);
+    if (!p)
+        return 0;
+    std::lock_guard<std::mutex> l(p->mutex);
+    if (!p->opened)
+        openNode(*p);
+    return size_t(p->end());
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::lastIndex
+    \param c
+    \return index of the last record
+*/
+size_t Open62541::FileHistoryBackend::lastIndex(Context& c)
+{
+    size_t e = getEnd(c);
+    return e ? e - 1 : 0;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::firstIndex
+    \param c
+    \return index of the first record
+*/
+size_t Open62541::FileHistoryBackend::firstIndex(Context& c)
+{
+    NodeStore* p = node(c.nodeId, false);
+    if (!p)
+        return 0;
+    std::lock_guard<std::mutex> l(p->mutex);
+    if (!p->opened)
+        openNode(*p);
+    return size_t(p->first());
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::resultSize
+    \param c
+    \param startIndex
+    \param endIndex
+    \return number of records between the indexes inclusive
+*/
+size_t Open62541::FileHistoryBackend::resultSize(Context& c, size_t startIndex, size_t endIndex)
+{
+    size_t e = getEnd(c);
+    if ((e == 0) || (startIndex >= e) || (endIndex >= e))
+        return 0;
+    return (startIndex <= endIndex) ? endIndex - startIndex + 1 : startIndex - endIndex + 1;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::copyDataValues
+    The continuation point is the number of values already returned
+    \return UA_STATUSCODE_GOOD on success
+*/
+UA_StatusCode Open62541::FileHistoryBackend::copyDataValues(Context& c,
+                                                            size_t startIndex,
+                                                            size_t endIndex,
+                                                            UA_Boolean reverse,
+                                                            size_t valueSize,
+                                                            UA_NumericRange range,
+                                                            UA_Boolean releaseContinuationPoints,
+                                                            std::string& in,
+                                                            std::string& out,
+                                                            size_t* providedValues,
+                                                            UA_DataValue* values)
+{
+    size_t skip = 0;
+    if (!in.empty()) {
+        if (in.size() != sizeof(size_t))
+            return UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+        memcpy(&skip, in.data(), sizeof(size_t));
+    }
+    if (releaseContinuationPoints)
+        return UA_STATUSCODE_GOOD;
+
+    NodeStore* p = node(c.nodeId, false);
+    if (!p)
+        return UA_STATUSCODE_BADNODATA;
+    std::lock_guard<std::mutex> l(p->mutex);
+    if (!p->opened)
+        openNode(*p);
+    UA_UInt64 first = p->first();
+    UA_UInt64 end   = p->end();
+    size_t total    = reverse ? startIndex - endIndex + 1 : endIndex - startIndex + 1;
+    size_t counter  = 0;
+    for (size_t n = skip; (n < total) && (counter < valueSize);) {
+        UA_UInt64 i = reverse ? UA_UInt64(startIndex - n) : UA_UInt64(startIndex + n);
+        if ((i < first) || (i >= end))
+            break;
+        Segment* s = segment(*p, i);
+        size_t pos = size_t(i - s->first);
+        size_t block = pos / s->stride;
+        if (s->compressed && !reverse && ((p->cacheSegment != s) || (p->cacheBlock != block))) {
+            // forward reads decode a block at a time straight into the values
+            const FileHistoryBlockEntry& b = s->blocks[block];
+            HistoryBlockDecoder d(static_cast<const UA_Byte*>(s->map) + b.offset, b.size);
+            size_t want = std::min({size_t(b.count) - pos % s->stride, total - n, valueSize - counter});
+            size_t done = 0;
+            UA_StatusCode ret = d.decode(pos % s->stride, want, values + counter, &range, done);
+            if (ret != UA_STATUSCODE_GOOD)
+                return ret;
+            counter += done;
+            n += done;
+            if (done < want)
+                break;
+            continue;
+        }
+        const FileHistoryRecord* r = record(*p, i);
+        if (!r)
+            return UA_STATUSCODE_BADDATAENCODINGINVALID;
+        UA_StatusCode ret = toDataValue(*r, values[counter], &range);
+        if (ret != UA_STATUSCODE_GOOD)
+            return ret;
+        counter++;
+        n++;
+    }
+    if (providedValues)
+        *providedValues = counter;
+    out.clear();
+    if (skip + counter < total) {
+        size_t next = skip + counter;
+        out.assign(reinterpret_cast<const char*>(&next), sizeof(next));
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::getDataValue
+    \param c
+    \param index
+    \return value valid until the next call for the node or null
+*/
+const UA_DataValue* Open62541::FileHistoryBackend::getDataValue(Context& c, size_t index)
+{
+    NodeStore* p = node(c.nodeId, false);
+    if (!p)
+        return nullptr;
+    std::lock_guard<std::mutex> l(p->mutex);
+    if (!p->opened)
+        openNode(*p);
+    const FileHistoryRecord* r = record(*p, index);
+    if (!r || (toDataValue(*r, p->scratch) != UA_STATUSCODE_GOOD))
+        return nullptr;
+    return &p->scratch;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::readSamples
+    Copies straight from the mapped records or the decoded block - no data values are built
+    \param c
+    \param startIndex
+    \param n
+    \param times
+    \param values
+    \param good
+    \return values read
+*/
+size_t Open62541::FileHistoryBackend::readSamples(Context& c,
+                                                  size_t startIndex,
+                                                  size_t n,
+                                                  UA_DateTime* times,
+                                                  UA_Double* values,
+                                                  UA_Byte* good)
+{
+    NodeStore* p = node(c.nodeId, false);
+    if (!p)
+        return 0;
+    std::lock_guard<std::mutex> l(p->mutex);
+    if (!p->opened)
+        openNode(*p);
+    size_t done = 0;
+    while (done < n) {
+        UA_UInt64 i = UA_UInt64(startIndex + done);
+        Segment* s  = segment(*p, i);
+        if (!s)
+            break;
+        // the longest run of contiguous records from i
+        size_t pos = size_t(i - s->first);
+        const FileHistoryRecord* r;
+        size_t available;
+        if (s->compressed) {
+            size_t block = pos / s->stride;
+            r            = decodeBlock(*p, *s, block);
+            if (!r)
+                break;
+            r += pos % s->stride;
+            available = s->blocks[block].count - pos % s->stride;
+        }
+        else if (pos < s->written) {
+            r         = s->records() + pos;
+            available = s->written - pos;
+        }
+        else {
+            r         = &p->buffer[pos - s->written];
+            available = s->count() - pos;
+        }
+        size_t k = std::min(available, n - done);
+        for (size_t j = 0; j < k; j++, r++) {
+            times[done + j]  = r->timestamp;
+            values[done + j] = 0.0;
+            good[done + j]   = ((r->flags & FileHistoryRecord::HasValue) &&
+                              !((r->flags & FileHistoryRecord::HasStatus) && (r->status & 0xC0000000)) &&
+                              HistoryAggregate::toDouble(r->typeIndex, r->value, values[done + j]))
+                                 ? 1
+                                 : 0;
+        }
+        done += k;
+    }
+    return done;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::appendRecords
+    \param n
+    \param r
+    \param count
+    \return records stored
+*/
+size_t Open62541::FileHistoryBackend::appendRecords(const NodeId& n, const FileHistoryRecord* r, size_t count)
+{
+    NodeStore* p = node(n);
+    std::lock_guard<std::mutex> l(p->mutex);
+    size_t done = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (append(*p, r[i]) == UA_STATUSCODE_GOOD)
+            done++;
+    }
+    return done;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::readRecords
+    Records are passed straight from the maps, the buffer or the decoded block
+    \param n
+    \param start
+    \param end
+    \param f
+    \return true on success
+*/
+bool Open62541::FileHistoryBackend::readRecords(const NodeId& n,
+                                                UA_DateTime start,
+                                                UA_DateTime end,
+                                                const std::function<bool(const FileHistoryRecord*, size_t)>& f)
+{
+    NodeStore* p = node(n, false);
+    if (!p)
+        return true;  // no history
+    std::lock_guard<std::mutex> l(p->mutex);
+    if (!p->opened && !openNode(*p))
+        return false;
+    for (UA_UInt64 i = lowerBound(*p, start, false); i < p->end();) {
+        Segment* s = segment(*p, i);
+        if (!s)
+            break;
+        size_t pos = size_t(i - s->first);
+        const FileHistoryRecord* r;
+        size_t available;
+        if (s->compressed) {
+            size_t block = pos / s->stride;
+            r            = decodeBlock(*p, *s, block);
+            if (!r)
+                return false;
+            r += pos % s->stride;
+            available = s->blocks[block].count - pos % s->stride;
+        }
+        else if (pos < s->written) {
+            r         = s->records() + pos;
+            available = s->written - pos;
+        }
+        else {
+            r         = &p->buffer[pos - s->written];
+            available = s->count() - pos;
+        }
+        // trim the run at the end time
+        size_t k = size_t(std::partition_point(r, r + available, [end](const FileHistoryRecord& v) {
+                              return v.timestamp < end;
+                          }) -
+                          r);
+        if ((k > 0) && !f(r, k))
+            break;
+        if (k < available)
+            break;
+        i += k;
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::insertDataValue
+    Only appending is supported
+    \param c
+    \param value
+    \return UA_STATUSCODE_GOOD on success
+*/
+UA_StatusCode Open62541::FileHistoryBackend::insertDataValue(Context& c, const UA_DataValue* value)
+{
+    return value ? add(c.nodeId, *value) : UA_STATUSCODE_BADINVALIDARGUMENT;
+}
+
+/*!
+    \brief Open62541::FileHistoryBackend::removeDataValue
+    Removal is segment granular - the oldest segments lying wholly inside the range are deleted. Segments are append
+    only, so values in a segment the range only partly covers cannot be removed.
+    \param c
+    \param startTimestamp
+    \param endTimestamp
+    \return UA_STATUSCODE_GOOD if every value in the range was removed, UA_STATUSCODE_BADNODATA if there were none
+    and UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED if some remain
+*/
+UA_StatusCode Open62541::FileHistoryBackend::removeDataValue(Context& c,
+                                                             UA_DateTime startTimestamp,
+                                                             UA_DateTime endTimestamp)
+{
+    NodeStore* p = node(c.nodeId, false);
+    if (!p)
+        return UA_STATUSCODE_BADNODATA;
+    std::lock_guard<std::mutex> l(p->mutex);
+    if (!p->opened)
+        openNode(*p);
+    if (lowerBound(*p, startTimestamp, false) >= lowerBound(*p, endTimestamp, true))
+        return UA_STATUSCODE_BADNODATA;
+    // keep the last segment so indexes stay continuous
+    while (p->segments.size() > 1) {
+        Segment& s = *p->segments.front();
+        if ((s.firstTime < startTimestamp) || (s.lastTime > endTimestamp))
+            break;
+        if (p->cacheSegment == &s)
+            p->cacheSegment = nullptr;
+        closeSegment(s);
+        ::unlink(s.path.c_str());
+        p->segments.pop_front();
+    }
+    if (lowerBound(*p, startTimestamp, false) < lowerBound(*p, endTimestamp, true))
+        return UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;  // values left in partly covered segments
+    return UA_STATUSCODE_GOOD;
+}
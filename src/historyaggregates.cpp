@@ -0,0 +1,1060 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/historyaggregates.h>
+#include <open62541cpp/open62541server.h>
+
+/*!
+    \brief trapezoid
+    \return area under the straight line from a to b
+*/
+static inline UA_Double trapezoid(const Open62541::HistoryAggregate::Sample& a,
+                                  const Open62541::HistoryAggregate::Sample& b)
+{
+    return (a.value + b.value) * 0.5 * UA_Double(b.time - a.time);
+}
+
+/*!
+    \brief isGood
+    \param s
+    \return true if the severity is good
+*/
+static inline bool isGood(UA_StatusCode s)
+{
+    return (s & 0xC0000000) == 0;
+}
+
+/*!
+    \brief Open62541::HistoryAggregate::HistoryAggregate
+    \param type
+    \param start
+    \param end
+    \param interval
+*/
+Open62541::HistoryAggregate::HistoryAggregate(Type type, UA_DateTime start, UA_DateTime end, UA_DateTime interval)
+    : _type(type)
+    , _start(start)
+    , _end(end)
+    , _interval((interval > 0) ? interval : (end - start))
+{
+    _results.resize(intervals(_start, _end, _interval));
+    for (size_t i = 0; i < _results.size(); i++)
+        _results[i].time = _start + UA_DateTime(i) * _interval;
+}
+
+/*!
+    \brief Open62541::HistoryAggregate::type
+    \param aggregate
+    \return aggregate type
+*/
+Open62541::HistoryAggregate::Type Open62541::HistoryAggregate::type(const UA_NodeId& aggregate)
+{
+    if ((aggregate.namespaceIndex != 0) || (aggregate.identifierType != UA_NODEIDTYPE_NUMERIC))
+        return Unsupported;
+    switch (aggregate.identifier.numeric) {
+        case UA_NS0ID_AGGREGATEFUNCTION_INTERPOLATIVE:
+            return Interpolative;
+        case UA_NS0ID_AGGREGATEFUNCTION_AVERAGE:
+            return Average;
+        case UA_NS0ID_AGGREGATEFUNCTION_TIMEAVERAGE:
+            return TimeAverage;
+        case UA_NS0ID_AGGREGATEFUNCTION_MINIMUM:
+            return Minimum;
+        case UA_NS0ID_AGGREGATEFUNCTION_MAXIMUM:
+            return Maximum;
+        case UA_NS0ID_AGGREGATEFUNCTION_RANGE:
+            return Range;
+        case UA_NS0ID_AGGREGATEFUNCTION_COUNT:
+            return Count;
+        default:
+            break;
+    }
+    return Unsupported;
+}
+
+/*!
+    \brief Open62541::HistoryAggregate::intervals
+    \param start
+    \param end
+    \param interval
+    \return number of intervals
+*/
+size_t Open62541::HistoryAggregate::intervals(UA_DateTime start, UA_DateTime end, UA_DateTime interval)
+{
+    if (end <= start)
+        return 0;
+    if (interval <= 0)
+        return 1;
+    return size_t((end - start + interval - 1) / interval);
+}
+
+/*!
+    \brief Open62541::HistoryAggregate::sum
+    \param v
+    \param n
+    \return sum of the values
+*/
+UA_Double Open62541::HistoryAggregate::sum(const UA_Double* v, size_t n)
+{
+    // independent accumulators break the dependency chain and map onto vector lanes
+    UA_Double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += v[i];
+        s1 += v[i + 1];
+        s2 += v[i + 2];
+        s3 += v[i + 3];
+    }
+    for (; i < n; i++)
+        s0 += v[i];
+    return (s0 + s1) + (s2 + s3);
+}
+
+/*!
+    \brief Open62541::HistoryAggregate::minMax
+    \param v
+    \param n
+    \param minimum updated
+    \param maximum updated
+*/
+void Open62541::HistoryAggregate::minMax(const UA_Double* v, size_t n, UA_Double& minimum, UA_Double& maximum)
+{
+    UA_Double mn[4] = {minimum, minimum, minimum, minimum};
+    UA_Double mx[4] = {maximum, maximum, maximum, maximum};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (size_t k = 0; k < 4; k++) {
+            mn[k] = (v[i + k] < mn[k]) ? v[i + k] : mn[k];
+            mx[k] = (v[i + k] > mx[k]) ? v[i + k] : mx[k];
+        }
+    }
+    for (; i < n; i++) {
+        mn[0] = (v[i] < mn[0]) ? v[i] : mn[0];
+        mx[0] = (v[i] > mx[0]) ? v[i] : mx[0];
+    }
+    minimum = std::min(std::min(mn[0], mn[1]), std::min(mn[2], mn[3]));
+    maximum = std::max(std::max(mx[0], mx[1]), std::max(mx[2], mx[3]));
+}
+
+/*!
+    \brief Open62541::HistoryAggregate::area
+    Trapezoid integral of the samples
+    \param t
+    \param v
+    \param n
+    \return value * ticks from the first to the last sample
+*/
+UA_Double Open62541::HistoryAggregate::area(const UA_DateTime* t, const UA_Double* v, size_t n)
+{
+    UA_Double a0 = 0.0, a1 = 0.0;
+    size_t i = 0;
+    for (; i + 2 < n; i += 2) {
+        a0 += (v[i] + v[i + 1]) * UA_Double(t[i + 1] - t[i]);
+        a1 += (v[i + 1] + v[i + 2]) * UA_Double(t[i + 2] - t[i + 1]);
+    }
+    for (; i + 1 < n; i++)
+        a0 += (v[i] + v[i + 1]) * UA_Double(t[i + 1] - t[i]);
+    return (a0 + a1) * 0.5;
+}
+
+/*!
+    \brief Open62541::HistoryAggregate::interpolate
+    \param a earlier sample
+    \param b later sample
+    \param t
+    \return value on the line from a to b at t
+*/
+UA_Double Open62541::HistoryAggregate::interpolate(const Sample& a, const Sample& b, UA_DateTime t)
+{
+    if (b.time == a.time)
+        return b.value;
+    return a.value + (b.value - a.value) * (UA_Double(t - a.time) / UA_Double(b.time - a.time));
+}
+
+/*!
+    \brief Open62541::HistoryAggregate::compact
+    \param t
+    \param v
+    \param good
+    \param n
+    \param outTimes
+    \param outValues
+    \return number of good samples
+*/
+size_t Open62541::HistoryAggregate::compact(const UA_DateTime* t,
+                                            const UA_Double* v,
+                                            const UA_Byte* good,
+                                            size_t n,
+                                            UA_DateTime* outTimes,
+                                            UA_Double* outValues)
+{
+    // branch free - every sample is written, only good ones advance the output
+    size_t k = 0;
+    for (size_t i = 0; i < n; i++) {
+        outTimes[k]  = t[i];
+        outValues[k] = v[i];
+        k += (good[i] != 0);
+    }
+    return k;
+}
+
+/*!
+    \brief Open62541::HistoryAggregate::toDouble
+    \param typeIndex
+    \param data
+    \param d
+    \return true if numeric
+*/
+bool Open62541::HistoryAggregate::toDouble(size_t typeIndex, const void* data, UA_Double& d)
+{
+    switch (typeIndex) {
+        case UA_TYPES_BOOLEAN:
+            d = *static_cast<const UA_Boolean*>(data) ? 1.0 : 0.0;
+            break;
+        case UA_TYPES_SBYTE:
+            d = *static_cast<const UA_SByte*>(data);
+            break;
+        case UA_TYPES_BYTE:
+            d = *static_cast<const UA_Byte*>(data);
+            break;
+        case UA_TYPES_INT16:
+            d = *static_cast<const UA_Int16*>(data);
+            break;
+        case UA_TYPES_UINT16:
+            d = *static_cast<const UA_UInt16*>(data);
+            break;
+        case UA_TYPES_INT32:
+            d = *static_cast<const UA_Int32*>(data);
+            break;
+        case UA_TYPES_UINT32:
+            d = *static_cast<const UA_UInt32*>(data);
+            break;
+        case UA_TYPES_INT64:
+            d = UA_Double(*static_cast<const UA_Int64*>(data));
+            break;
+        case UA_TYPES_UINT64:
+            d = UA_Double(*static_cast<const UA_UInt64*>(data));
+            break;
+        case UA_TYPES_FLOAT:
+            d = *static_cast<const UA_Float*>(data);
+            break;
+        case UA_TYPES_DOUBLE:
+            d = *static_cast<const UA_Double*>(data);
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::HistoryAggregate::toDouble
+    \param v
+    \param d
+    \return true if numeric
+*/
+bool Open62541::HistoryAggregate::toDouble(const UA_Variant& v, UA_Double& d)
+{
+    if (!v.type || !v.data || (v.type < &UA_TYPES[0]) || (v.type >= &UA_TYPES[UA_TYPES_COUNT]) ||
+        !UA_Variant_isScalar(&v))
+        return false;
+    return toDouble(size_t(v.type - &UA_TYPES[0]), v.data, d);
+}
+
+/*!
+    \brief Open62541::HistoryAggregate::accumulate
+    Add good samples that all fall in the current interval
+    \param t
+    \param v
+    \param n
+*/
+void Open62541::HistoryAggregate::accumulate(const UA_DateTime* t, const UA_Double* v, size_t n)
+{
+    Sample s;
+    s.time  = t[0];
+    s.value = v[0];
+    if (!_count) {
+        _first   = s;
+        _minimum = s.value;
+        _maximum = s.value;
+    }
+    else if (_type == TimeAverage) {
+        _area += trapezoid(_last, s);
+    }
+    // only run the kernels the aggregate needs
+    switch (_type) {
+        case Average:
+            _sum += sum(v, n);
+            break;
+        case Minimum:
+        case Maximum:
+        case Range:
+            minMax(v, n, _minimum, _maximum);
+            break;
+        case TimeAverage:
+            _area += area(t, v, n);
+            break;
+        default:
+            break;
+    }
+    _last.time  = t[n - 1];
+    _last.value = v[n - 1];
+    _count += n;
+}
+
+/*!
+    \brief Open62541::HistoryAggregate::add
+    \param t
+    \param v
+    \param n
+*/
+void Open62541::HistoryAggregate::add(const UA_DateTime* t, const UA_Double* v, size_t n)
+{
+    size_t i = 0;
+    while ((i < n) && !done()) {
+        UA_DateTime start = _results[_current].time;
+        if (t[i] < start) {
+            // before the first interval - only the bound is wanted
+            size_t j        = size_t(std::lower_bound(t + i, t + n, start) - t);
+            _previous.time  = t[j - 1];
+            _previous.value = v[j - 1];
+            _hasPrevious    = true;
+            i               = j;
+            continue;
+        }
+        UA_DateTime end = std::min(start + _interval, _end);
+        size_t j        = size_t(std::lower_bound(t + i, t + n, end) - t);
+        if (j > i) {
+            accumulate(t + i, v + i, j - i);
+            i = j;
+        }
+        if (i < n) {
+            Sample next;  // first good sample at or after the end of the interval
+            next.time  = t[i];
+            next.value = v[i];
+            close(&next);
+        }
+    }
+}
+
+/*!
+    \brief Open62541::HistoryAggregate::finish
+*/
+void Open62541::HistoryAggregate::finish()
+{
+    while (!done())
+        close(nullptr);
+}
+
+/*!
+    \brief Open62541::HistoryAggregate::close
+    Calculate the current interval and move to the next
+    \param next first good sample after the interval - null if there is none
+*/
+void Open62541::HistoryAggregate::close(const Sample* next)
+{
+    Result& r         = _results[_current];
+    UA_DateTime start = r.time;
+    UA_DateTime end   = std::min(start + _interval, _end);
+    UA_StatusCode partial = ((end - start) < _interval) ? Partial : UA_STATUSCODE_GOOD;
+    //
+    // value at the start of the interval - interpolated from the bounding samples
+    bool hasStart = false;
+    Sample atStart;
+    UA_StatusCode startStatus = UA_STATUSCODE_GOOD;
+    const Sample* after       = _count ? &_first : next;
+    atStart.time              = start;
+    if (_count && (_first.time == start)) {
+        atStart.value = _first.value;
+        hasStart      = true;
+    }
+    else if (_hasPrevious && after) {
+        atStart.value = interpolate(_previous, *after, start);
+        hasStart      = true;
+    }
+    else if (_hasPrevious) {
+        atStart.value = _previous.value;  // no later data - hold the last value
+        hasStart      = true;
+        startStatus   = UA_STATUSCODE_UNCERTAIN;
+    }
+    //
+    switch (_type) {
+        case Count:
+            r.value  = UA_Double(_count);
+            r.status = Calculated | partial;
+            break;
+        case Average:
+            if (_count) {
+                r.value  = _sum / UA_Double(_count);
+                r.status = Calculated | partial;
+            }
+            break;
+        case Minimum:
+            if (_count) {
+                r.value  = _minimum;
+                r.status = Calculated | partial;
+            }
+            break;
+        case Maximum:
+            if (_count) {
+                r.value  = _maximum;
+                r.status = Calculated | partial;
+            }
+            break;
+        case Range:
+            if (_count) {
+                r.value  = _maximum - _minimum;
+                r.status = Calculated | partial;
+            }
+            break;
+        case Interpolative:
+            if (hasStart) {
+                r.value  = atStart.value;
+                r.status = ((_count && (_first.time == start)) ? UA_STATUSCODE_GOOD : Interpolated) | startStatus;
+            }
+            break;
+        case TimeAverage: {
+            Sample from = atStart;
+            if (!hasStart) {
+                if (!_count)
+                    break;  // no data in or before the interval
+                from    = _first;  // the average covers the part of the interval with data
+                partial = Partial;
+            }
+            // value at the end of the interval
+            Sample left = _count ? _last : from;
+            Sample atEnd;
+            atEnd.time = end;
+            if (next) {
+                atEnd.value = interpolate(left, *next, end);
+            }
+            else {
+                atEnd.value = left.value;
+                startStatus = UA_STATUSCODE_UNCERTAIN;
+            }
+            UA_Double a = _count ? (trapezoid(from, _first) + _area + trapezoid(_last, atEnd)) : trapezoid(from, atEnd);
+            if (end > from.time) {
+                r.value  = a / UA_Double(end - from.time);
+                r.status = Calculated | partial | startStatus;
+            }
+        } break;
+        default:
+            break;
+    }
+    //
+    if (_count) {
+        _previous    = _last;
+        _hasPrevious = true;
+    }
+    _count = 0;
+    _sum   = 0.0;
+    _area  = 0.0;
+    _current++;
+}
+
+/*!
+    \brief Open62541::HistoryAtTime::HistoryAtTime
+    \param times
+    \param n
+    \param stepped
+    \param simpleBounds
+*/
+Open62541::HistoryAtTime::HistoryAtTime(const UA_DateTime* times, size_t n, bool stepped, bool simpleBounds)
+    : _times(times, times + n)
+    , _order(n)
+    , _stepped(stepped)
+    , _simpleBounds(simpleBounds)
+    , _results(n)
+{
+    for (size_t i = 0; i < n; i++) {
+        _order[i]        = i;
+        _results[i].time = times[i];
+    }
+    std::stable_sort(_order.begin(), _order.end(), [this](size_t a, size_t b) { return _times[a] < _times[b]; });
+}
+
+/*!
+    \brief Open62541::HistoryAtTime::add
+    \param t
+    \param v
+    \param good
+    \param n
+*/
+void Open62541::HistoryAtTime::add(const UA_DateTime* t, const UA_Double* v, const UA_Byte* good, size_t n)
+{
+    size_t i = 0;
+    while ((i < n) && !done()) {
+        UA_DateTime want = next();
+        if (t[i] < want) {
+            // samples before the requested time - only the last usable one is a bound
+            size_t j = size_t(std::lower_bound(t + i, t + n, want) - t);
+            for (size_t k = j; k > i; k--) {
+                if (_simpleBounds || good[k - 1]) {
+                    _previous.time  = t[k - 1];
+                    _previous.value = v[k - 1];
+                    _previousGood   = good[k - 1] != 0;
+                    _hasPrevious    = true;
+                    break;
+                }
+            }
+            for (size_t k = j; _simpleBounds && (k > i); k--) {
+                if (good[k - 1]) {
+                    _good.time  = t[k - 1];
+                    _good.value = v[k - 1];
+                    _hasGood    = true;
+                    break;
+                }
+            }
+            i = j;
+            continue;
+        }
+        if (!_simpleBounds && !good[i]) {
+            i++;  // bad samples are not bounds
+            continue;
+        }
+        // the first usable sample at or after the requested time - it may bound several requested times
+        HistoryAggregate::Sample s;
+        s.time  = t[i];
+        s.value = v[i];
+        resolve(&s, good[i] != 0);
+    }
+}
+
+/*!
+    \brief Open62541::HistoryAtTime::finish
+*/
+void Open62541::HistoryAtTime::finish()
+{
+    while (!done())
+        resolve(nullptr, false);
+}
+
+/*!
+    \brief Open62541::HistoryAtTime::resolve
+    Value of the next requested time
+    \param next first usable sample at or after the time or null if there is none
+    \param nextGood
+*/
+void Open62541::HistoryAtTime::resolve(const HistoryAggregate::Sample* next, bool nextGood)
+{
+    HistoryAggregate::Result& r = _results[_order[_position++]];
+    if (next && (next->time == r.time)) {
+        r.value  = next->value;  // raw value
+        r.status = nextGood ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADNODATA;
+        return;
+    }
+    if (!_hasPrevious)
+        return;  // no earlier bound - no data
+    if (!_previousGood || (next && !nextGood)) {
+        // simple bounds with a bad bound - use the nearest good samples either side
+        const UA_StatusCode uncertain = UA_STATUSCODE_UNCERTAINDATASUBNORMAL | HistoryAggregate::Interpolated;
+        const HistoryAggregate::Sample* before = _previousGood ? &_previous : (_hasGood ? &_good : nullptr);
+        const HistoryAggregate::Sample* after  = (next && nextGood) ? next : nullptr;
+        if (before && after)
+            r.value = _stepped ? before->value : HistoryAggregate::interpolate(*before, *after, r.time);
+        else if (before || after)
+            r.value = (before ? before : after)->value;  // good values on one side only - hold the nearest
+        else {
+            r.status = UA_STATUSCODE_BADNODATA;
+            return;
+        }
+        r.status = uncertain;
+        return;
+    }
+    if (!next) {
+        r.value  = _previous.value;  // after the last sample - hold the value
+        r.status = UA_STATUSCODE_UNCERTAIN | HistoryAggregate::Interpolated;
+        return;
+    }
+    r.value  = _stepped ? _previous.value : HistoryAggregate::interpolate(_previous, *next, r.time);
+    r.status = HistoryAggregate::Interpolated;
+}
+
+/*!
+    \brief Open62541::HistorySampleReader::HistorySampleReader
+    \param server
+    \param sessionId
+    \param sessionContext
+    \param nodeId
+    \param backend
+*/
+Open62541::HistorySampleReader::HistorySampleReader(UA_Server* server,
+                                                    const UA_NodeId* sessionId,
+                                                    void* sessionContext,
+                                                    const UA_NodeId* nodeId,
+                                                    const UA_HistoryDataBackend& backend)
+    : _server(server)
+    , _sessionId(sessionId)
+    , _sessionContext(sessionContext)
+    , _nodeId(nodeId)
+    , _backend(backend)
+{
+    _native = HistoryDataBackend::fromBackend(_backend);
+    if (_native)
+        _context.reset(new HistoryDataBackend::Context(server, sessionId, sessionContext, nodeId));
+}
+
+/*!
+    \brief Open62541::HistorySampleReader::~HistorySampleReader
+*/
+Open62541::HistorySampleReader::~HistorySampleReader()
+{
+    for (auto& v : _values)
+        UA_DataValue_clear(&v);
+}
+
+/*!
+    \brief Open62541::HistorySampleReader::seek
+    \param t
+    \param strategy
+    \return true if a value matches
+*/
+bool Open62541::HistorySampleReader::seek(UA_DateTime t, MatchStrategy strategy)
+{
+    _end = true;
+    _continuation.clear();
+    if (!_backend.getDateTimeMatch || !_backend.getEnd || !_backend.lastIndex || !_backend.copyDataValues)
+        return false;
+    size_t end = _backend.getEnd(_server, _backend.context, _sessionId, _sessionContext, _nodeId);
+    size_t i =
+        _backend.getDateTimeMatch(_server, _backend.context, _sessionId, _sessionContext, _nodeId, t, strategy);
+    if (i == end)
+        return false;
+    _next = i;
+    _last = _backend.lastIndex(_server, _backend.context, _sessionId, _sessionContext, _nodeId);
+    _end  = false;
+    return true;
+}
+
+/*!
+    \brief Open62541::HistorySampleReader::read
+    \param times
+    \param values
+    \param good
+    \param n
+    \return values read
+*/
+size_t Open62541::HistorySampleReader::read(UA_DateTime* times, UA_Double* values, UA_Byte* good, size_t n)
+{
+    if (_end || !n)
+        return 0;
+    if (_native && _block && _continuation.empty()) {
+        size_t got = _native->readSamples(*_context, _next, std::min(n, _last - _next + 1), times, values, good);
+        if (got) {
+            _next += got;
+            _end = (_next > _last);
+            return got;
+        }
+        _block = false;  // not supported - use copyDataValues
+    }
+    //
+    if (_values.size() < n) {
+        size_t i = _values.size();
+        _values.resize(n);
+        for (; i < n; i++)
+            UA_DataValue_init(&_values[i]);
+    }
+    UA_NumericRange range;
+    range.dimensionsSize = 0;
+    range.dimensions     = nullptr;
+    size_t provided      = 0;
+    std::string out;
+    UA_StatusCode ret;
+    if (_native) {
+        ret = _native->copyDataValues(*_context,
+                                      _next,
+                                      _last,
+                                      false,
+                                      n,
+                                      range,
+                                      false,
+                                      _continuation,
+                                      out,
+                                      &provided,
+                                      _values.data());
+    }
+    else {
+        UA_ByteString in;
+        in.length = _continuation.size();
+        in.data   = _continuation.empty() ? nullptr : (UA_Byte*)(_continuation.data());
+        UA_ByteString o;
+        UA_ByteString_init(&o);
+        ret = _backend.copyDataValues(_server,
+                                      _backend.context,
+                                      _sessionId,
+                                      _sessionContext,
+                                      _nodeId,
+                                      _next,
+                                      _last,
+                                      false,
+                                      n,
+                                      range,
+                                      false,
+                                      &in,
+                                      &o,
+                                      &provided,
+                                      _values.data());
+        if (o.length && o.data)
+            out.assign((const char*)(o.data), o.length);
+        UA_ByteString_clear(&o);
+    }
+    provided = std::min(provided, n);
+    for (size_t i = 0; i < provided; i++) {
+        good[i] = toSample(_values[i], times[i], values[i]) ? 1 : 0;
+        UA_DataValue_clear(&_values[i]);
+    }
+    _continuation = out;
+    if ((ret != UA_STATUSCODE_GOOD) || out.empty() || !provided)
+        _end = true;
+    return (ret == UA_STATUSCODE_GOOD) ? provided : 0;
+}
+
+/*!
+    \brief Open62541::HistorySampleReader::toSample
+    \param v
+    \param t
+    \param d
+    \return true if good
+*/
+bool Open62541::HistorySampleReader::toSample(const UA_DataValue& v, UA_DateTime& t, UA_Double& d)
+{
+    t = v.hasSourceTimestamp ? v.sourceTimestamp : v.serverTimestamp;
+    d = 0.0;
+    if (!v.hasValue || (v.hasStatus && !isGood(v.status)))
+        return false;
+    return HistoryAggregate::toDouble(v.value, d);
+}
+
+/*!
+    \brief Open62541::AggregateHistoryDatabase::toHistoryData
+    \param r results
+    \param reverse fill in reverse order
+    \param count values are counts
+    \param timestampsToReturn
+    \param result
+    \return UA_STATUSCODE_GOOD on success
+*/
+UA_StatusCode Open62541::AggregateHistoryDatabase::toHistoryData(const std::vector<HistoryAggregate::Result>& r,
+                                                                 bool reverse,
+                                                                 bool count,
+                                                                 UA_TimestampsToReturn timestampsToReturn,
+                                                                 UA_HistoryData* result)
+{
+    result->dataValues = static_cast<UA_DataValue*>(UA_Array_new(r.size(), &UA_TYPES[UA_TYPES_DATAVALUE]));
+    if (!result->dataValues)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    result->dataValuesSize = r.size();
+    for (size_t i = 0; i < r.size(); i++) {
+        const HistoryAggregate::Result& s = r[reverse ? r.size() - 1 - i : i];
+        UA_DataValue& d                    = result->dataValues[i];
+        if ((s.status & 0x80000000) == 0) {  // not bad
+            UA_StatusCode ret;
+            if (count) {
+                UA_Int32 n = UA_Int32(s.value);
+                ret        = UA_Variant_setScalarCopy(&d.value, &n, &UA_TYPES[UA_TYPES_INT32]);
+            }
+            else {
+                ret = UA_Variant_setScalarCopy(&d.value, &s.value, &UA_TYPES[UA_TYPES_DOUBLE]);
+            }
+            if (ret != UA_STATUSCODE_GOOD)
+                return ret;  // freed with the response
+            d.hasValue = true;
+        }
+        d.status    = s.status;
+        d.hasStatus = true;
+        if (timestampsToReturn != UA_TIMESTAMPSTORETURN_SERVER && timestampsToReturn != UA_TIMESTAMPSTORETURN_NEITHER) {
+            d.sourceTimestamp    = s.time;
+            d.hasSourceTimestamp = true;
+        }
+        if (timestampsToReturn == UA_TIMESTAMPSTORETURN_SERVER || timestampsToReturn == UA_TIMESTAMPSTORETURN_BOTH) {
+            d.serverTimestamp    = s.time;
+            d.hasServerTimestamp = true;
+        }
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/*!
+    \brief Open62541::AggregateHistoryDatabase::AggregateHistoryDatabase
+    \param gathering
+*/
+Open62541::AggregateHistoryDatabase::AggregateHistoryDatabase(const UA_HistoryDataGathering& gathering)
+    : _gathering(gathering)
+{
+    _default = UA_HistoryDatabase_default(_gathering);
+    initialise();
+}
+
+/*!
+    \brief Open62541::AggregateHistoryDatabase::deleteMembers
+*/
+void Open62541::AggregateHistoryDatabase::deleteMembers()
+{
+    if (_default.clear) {
+        _default.clear(&_default);  // clears the gathering too
+        _default.clear = nullptr;
+    }
+}
+
+/*!
+    \brief Open62541::AggregateHistoryDatabase::setValue
+    \param c
+    \param historizing
+    \param value
+*/
+void Open62541::AggregateHistoryDatabase::setValue(Context& c, UA_Boolean historizing, const UA_DataValue* value)
+{
+    if (_default.setValue)
+        _default.setValue(c.server.server(),
+                          _default.context,
+                          c.sessionId.constRef(),
+                          c.sessionContext,
+                          c.nodeId.constRef(),
+                          historizing,
+                          value);
+}
+
+/*!
+    \brief Open62541::AggregateHistoryDatabase::readRaw
+*/
+void Open62541::AggregateHistoryDatabase::readRaw(Context& c,
+                                                  const UA_RequestHeader* requestHeader,
+                                                  const UA_ReadRawModifiedDetails* historyReadDetails,
+                                                  UA_TimestampsToReturn timestampsToReturn,
+                                                  UA_Boolean releaseContinuationPoints,
+                                                  size_t nodesToReadSize,
+                                                  const UA_HistoryReadValueId* nodesToRead,
+                                                  UA_HistoryReadResponse* response,
+                                                  UA_HistoryData* const* const historyData)
+{
+    if (_default.readRaw)
+        _default.readRaw(c.server.server(),
+                         _default.context,
+                         c.sessionId.constRef(),
+                         c.sessionContext,
+                         requestHeader,
+                         historyReadDetails,
+                         timestampsToReturn,
+                         releaseContinuationPoints,
+                         nodesToReadSize,
+                         nodesToRead,
+                         response,
+                         historyData);
+}
+
+/*!
+    \brief Open62541::AggregateHistoryDatabase::updateData
+*/
+void Open62541::AggregateHistoryDatabase::updateData(Context& c,
+                                                     const UA_RequestHeader* requestHeader,
+                                                     const UA_UpdateDataDetails* details,
+                                                     UA_HistoryUpdateResult* result)
+{
+    if (_default.updateData)
+        _default.updateData(c.server.server(),
+                            _default.context,
+                            c.sessionId.constRef(),
+                            c.sessionContext,
+                            requestHeader,
+                            details,
+                            result);
+}
+
+/*!
+    \brief Open62541::AggregateHistoryDatabase::deleteRawModified
+*/
+void Open62541::AggregateHistoryDatabase::deleteRawModified(Context& c,
+                                                            const UA_RequestHeader* requestHeader,
+                                                            const UA_DeleteRawModifiedDetails* details,
+                                                            UA_HistoryUpdateResult* result)
+{
+    if (_default.deleteRawModified)
+        _default.deleteRawModified(c.server.server(),
+                                   _default.context,
+                                   c.sessionId.constRef(),
+                                   c.sessionContext,
+                                   requestHeader,
+                                   details,
+                                   result);
+}
+
+/*!
+    \brief Open62541::AggregateHistoryDatabase::readProcessed
+*/
+void Open62541::AggregateHistoryDatabase::readProcessed(Context& c,
+                                                        const UA_RequestHeader* /*requestHeader*/,
+                                                        const UA_ReadProcessedDetails* historyReadDetails,
+                                                        UA_TimestampsToReturn timestampsToReturn,
+                                                        UA_Boolean releaseContinuationPoints,
+                                                        size_t nodesToReadSize,
+                                                        const UA_HistoryReadValueId* nodesToRead,
+                                                        UA_HistoryReadResponse* response,
+                                                        UA_HistoryData* const* const historyData)
+{
+    // each node is processed in one pass - no continuation points are handed out
+    if (releaseContinuationPoints || !historyReadDetails)
+        return;
+    for (size_t i = 0; (i < nodesToReadSize) && (i < response->resultsSize); i++) {
+        if (historyReadDetails->aggregateTypeSize != nodesToReadSize) {
+            response->results[i].statusCode = UA_STATUSCODE_BADAGGREGATELISTMISMATCH;
+            continue;
+        }
+        response->results[i].statusCode = processNode(c,
+                                                      nodesToRead[i].nodeId,
+                                                      historyReadDetails->aggregateType[i],
+                                                      historyReadDetails,
+                                                      timestampsToReturn,
+                                                      historyData[i]);
+    }
+}
+
+/*!
+    \brief Open62541::AggregateHistoryDatabase::processNode
+    \param c
+    \param nodeId
+    \param aggregate
+    \param details
+    \param timestampsToReturn
+    \param result
+    \return status of the node result
+*/
+UA_StatusCode Open62541::AggregateHistoryDatabase::processNode(Context& c,
+                                                               const UA_NodeId& nodeId,
+                                                               const UA_NodeId& aggregate,
+                                                               const UA_ReadProcessedDetails* details,
+                                                               UA_TimestampsToReturn timestampsToReturn,
+                                                               UA_HistoryData* result)
+{
+    HistoryAggregate::Type type = HistoryAggregate::type(aggregate);
+    if (type == HistoryAggregate::Unsupported)
+        return UA_STATUSCODE_BADAGGREGATENOTSUPPORTED;
+    if (!_gathering.getHistorizingSetting)
+        return UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+    const UA_HistorizingNodeIdSettings* setting =
+        _gathering.getHistorizingSetting(c.server.server(), _gathering.context, &nodeId);
+    if (!setting)
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    //
+    // intervals run forward from the earlier time - results are reversed afterwards if the request runs backwards
+    UA_DateTime start = details->startTime;
+    UA_DateTime end   = details->endTime;
+    bool reverse      = start > end;
+    if (reverse)
+        std::swap(start, end);
+    if (start == end)
+        return UA_STATUSCODE_BADHISTORYOPERATIONINVALID;
+    UA_DateTime interval = UA_DateTime(details->processingInterval * UA_DATETIME_MSEC);
+    if (interval <= 0)
+        interval = end - start;
+    size_t count = HistoryAggregate::intervals(start, end, interval);
+    if (count > _maxIntervals)
+        return UA_STATUSCODE_BADTOOMANYOPERATIONS;
+    //
+    HistoryAggregate a(type, start, end, interval);
+    HistorySampleReader reader(c.server.server(),
+                               c.sessionId.constRef(),
+                               c.sessionContext,
+                               &nodeId,
+                               setting->historizingBackend);
+    // start at the sample before the first interval so the first interval has its bound
+    if (reader.seek(start, MATCH_BEFORE) || reader.seek(start, MATCH_EQUAL_OR_AFTER)) {
+        std::vector<UA_DateTime> t(_blockSize);
+        std::vector<UA_Double> v(_blockSize);
+        std::vector<UA_Byte> g(_blockSize);
+        while (!a.done()) {
+            size_t n = reader.read(t.data(), v.data(), g.data(), _blockSize);
+            if (!n)
+                break;
+            n = HistoryAggregate::compact(t.data(), v.data(), g.data(), n, t.data(), v.data());
+            if (n)
+                a.add(t.data(), v.data(), n);
+        }
+    }
+    a.finish();
+    //
+    return toHistoryData(a.results(), reverse, type == HistoryAggregate::Count, timestampsToReturn, result);
+}
+
+/*!
+    \brief Open62541::AggregateHistoryDatabase::readAtTime
+*/
+void Open62541::AggregateHistoryDatabase::readAtTime(Context& c,
+                                                     const UA_RequestHeader* /*requestHeader*/,
+                                                     const UA_ReadAtTimeDetails* historyReadDetails,
+                                                     UA_TimestampsToReturn timestampsToReturn,
+                                                     UA_Boolean releaseContinuationPoints,
+                                                     size_t nodesToReadSize,
+                                                     const UA_HistoryReadValueId* nodesToRead,
+                                                     UA_HistoryReadResponse* response,
+                                                     UA_HistoryData* const* const historyData)
+{
+    if (releaseContinuationPoints || !historyReadDetails)
+        return;
+    for (size_t i = 0; (i < nodesToReadSize) && (i < response->resultsSize); i++) {
+        response->results[i].statusCode =
+            atTimeNode(c, nodesToRead[i].nodeId, historyReadDetails, timestampsToReturn, historyData[i]);
+    }
+}
+
+/*!
+    \brief Open62541::AggregateHistoryDatabase::atTimeNode
+    \param c
+    \param nodeId
+    \param details
+    \param timestampsToReturn
+    \param result
+    \return status of the node result
+*/
+UA_StatusCode Open62541::AggregateHistoryDatabase::atTimeNode(Context& c,
+                                                              const UA_NodeId& nodeId,
+                                                              const UA_ReadAtTimeDetails* details,
+                                                              UA_TimestampsToReturn timestampsToReturn,
+                                                              UA_HistoryData* result)
+{
+    if (!_gathering.getHistorizingSetting)
+        return UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+    const UA_HistorizingNodeIdSettings* setting =
+        _gathering.getHistorizingSetting(c.server.server(), _gathering.context, &nodeId);
+    if (!setting)
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    if (!details->reqTimesSize)
+        return UA_STATUSCODE_BADHISTORYOPERATIONINVALID;
+    if (details->reqTimesSize > _maxIntervals)
+        return UA_STATUSCODE_BADTOOMANYOPERATIONS;
+    //
+    HistoryAtTime a(details->reqTimes, details->reqTimesSize, stepped(NodeId(nodeId)), details->useSimpleBounds);
+    HistorySampleReader reader(c.server.server(),
+                               c.sessionId.constRef(),
+                               c.sessionContext,
+                               &nodeId,
+                               setting->historizingBackend);
+    if (reader.seek(a.next(), MATCH_BEFORE) || reader.seek(a.next(), MATCH_EQUAL_OR_AFTER)) {
+        std::vector<UA_DateTime> t(_blockSize);
+        std::vector<UA_Double> v(_blockSize);
+        std::vector<UA_Byte> g(_blockSize);
+        while (!a.done()) {
+            size_t n = reader.read(t.data(), v.data(), g.data(), _blockSize);
+            if (!n)
+                break;
+            a.add(t.data(), v.data(), g.data(), n);
+            if (a.done() || (n < 2) || (t[n - 1] <= t[0]))
+                continue;
+            // far from the next requested time - search for it rather than read everything in between
+            UA_DateTime ahead = a.next() - t[n - 1];
+            if ((ahead > 0) && (UA_Double(ahead) > 4.0 * UA_Double(t[n - 1] - t[0]))) {
+                if (!reader.seek(a.next(), MATCH_BEFORE) && !reader.seek(a.next(), MATCH_EQUAL_OR_AFTER))
+                    break;
+            }
+        }
+    }
+    a.finish();
+    return toHistoryData(a.results(), false, false, timestampsToReturn, result);
+}
@@ -0,0 +1,428 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/historybackendwrapper.h>
+#include <open62541cpp/open62541server.h>
+
+/*!
+    \brief toByteString
+    \param s
+    \return byte string referring to the string data - not to be freed
+*/
+static UA_ByteString toByteString(const std::string& s)
+{
+    UA_ByteString b;
+    b.length = s.size();
+    b.data   = s.empty() ? nullptr : (UA_Byte*)(s.data());
+    return b;
+}
+
+/*!
+    \brief fromByteString
+    Move a byte string allocated by the backend into a string
+    \param b
+    \param s
+*/
+static void takeByteString(UA_ByteString& b, std::string& s)
+{
+    s.clear();
+    if (b.length && b.data)
+        s.assign((const char*)(b.data), b.length);
+    UA_ByteString_clear(&b);
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::HistoryBackendWrapper
+    \param backend
+*/
+Open62541::HistoryBackendWrapper::HistoryBackendWrapper(const UA_HistoryDataBackend& backend)
+    : _backend(backend)
+{
+    UA_DataValue_init(&_value);
+    initialise();
+    if (!_backend.getHistoryData)
+        database().getHistoryData = nullptr;  // wrapped backend uses the low level API
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::~HistoryBackendWrapper
+*/
+Open62541::HistoryBackendWrapper::~HistoryBackendWrapper()
+{
+    UA_DataValue_clear(&_value);
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::serverSetHistoryData
+    \param c
+    \param historizing
+    \param value
+    \return error code
+*/
+UA_StatusCode Open62541::HistoryBackendWrapper::serverSetHistoryData(Context& c,
+                                                                     bool historizing,
+                                                                     const UA_DataValue* value)
+{
+    if (!_backend.serverSetHistoryData)
+        return UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+    std::lock_guard<std::mutex> l(_backendMutex);
+    return _backend.serverSetHistoryData(c.server.server(),
+                                         _backend.context,
+                                         c.sessionId.constRef(),
+                                         c.sessionContext,
+                                         c.nodeId.constRef(),
+                                         historizing,
+                                         value);
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::getHistoryData
+    \return error code
+*/
+UA_StatusCode Open62541::HistoryBackendWrapper::getHistoryData(Context& c,
+                                                            const UA_DateTime start,
+                                                            const UA_DateTime end,
+                                                            size_t maxSizePerResponse,
+                                                            UA_UInt32 numValuesPerNode,
+                                                            UA_Boolean returnBounds,
+                                                            UA_TimestampsToReturn timestampsToReturn,
+                                                            UA_NumericRange range,
+                                                            UA_Boolean releaseContinuationPoints,
+                                                            std::string& continuationPoint,
+                                                            std::string& outContinuationPoint,
+                                                            UA_HistoryData* result)
+{
+    if (!_backend.getHistoryData)
+        return UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+    sync(c.nodeId);
+    std::lock_guard<std::mutex> l(_backendMutex);
+    UA_ByteString in = toByteString(continuationPoint);
+    UA_ByteString out;
+    UA_ByteString_init(&out);
+    UA_StatusCode ret = _backend.getHistoryData(c.server.server(),
+                                                c.sessionId.constRef(),
+                                                c.sessionContext,
+                                                &_backend,
+                                                start,
+                                                end,
+                                                c.nodeId.constRef(),
+                                                maxSizePerResponse,
+                                                numValuesPerNode,
+                                                returnBounds,
+                                                timestampsToReturn,
+                                                range,
+                                                releaseContinuationPoints,
+                                                &in,
+                                                &out,
+                                                result);
+    takeByteString(out, outContinuationPoint);
+    return ret;
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::getDateTimeMatch
+    \return index
+*/
+size_t Open62541::HistoryBackendWrapper::getDateTimeMatch(Context& c,
+                                                       const UA_DateTime timestamp,
+                                                       const MatchStrategy strategy)
+{
+    sync(c.nodeId);
+    std::lock_guard<std::mutex> l(_backendMutex);
+    return _backend.getDateTimeMatch ? _backend.getDateTimeMatch(c.server.server(),
+                                                                 _backend.context,
+                                                                 c.sessionId.constRef(),
+                                                                 c.sessionContext,
+                                                                 c.nodeId.constRef(),
+                                                                 timestamp,
+                                                                 strategy)
+                                     : 0;
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::getEnd
+    \return index past the last value
+*/
+size_t Open62541::HistoryBackendWrapper::getEnd(Context& c)
+{
+    sync(c.nodeId);
+    std::lock_guard<std::mutex> l(_backendMutex);
+    return _backend.getEnd ? _backend.getEnd(c.server.server(),
+                                             _backend.context,
+                                             c.sessionId.constRef(),
+                                             c.sessionContext,
+                                             c.nodeId.constRef())
+                           : 0;
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::lastIndex
+    \return index of the last value
+*/
+size_t Open62541::HistoryBackendWrapper::lastIndex(Context& c)
+{
+    sync(c.nodeId);
+    std::lock_guard<std::mutex> l(_backendMutex);
+    return _backend.lastIndex ? _backend.lastIndex(c.server.server(),
+                                                   _backend.context,
+                                                   c.sessionId.constRef(),
+                                                   c.sessionContext,
+                                                   c.nodeId.constRef())
+                              : 0;
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::firstIndex
+    \return index of the first value
+*/
+size_t Open62541::HistoryBackendWrapper::firstIndex(Context& c)
+{
+    sync(c.nodeId);
+    std::lock_guard<std::mutex> l(_backendMutex);
+    return _backend.firstIndex ? _backend.firstIndex(c.server.server(),
+                                                     _backend.context,
+                                                     c.sessionId.constRef(),
+                                                     c.sessionContext,
+                                                     c.nodeId.constRef())
+                               : 0;
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::resultSize
+    \return number of values in the range
+*/
+size_t Open62541::HistoryBackendWrapper::resultSize(Context& c, size_t startIndex, size_t endIndex)
+{
+    sync(c.nodeId);
+    std::lock_guard<std::mutex> l(_backendMutex);
+    return _backend.resultSize ? _backend.resultSize(c.server.server(),
+                                                     _backend.context,
+                                                     c.sessionId.constRef(),
+                                                     c.sessionContext,
+                                                     c.nodeId.constRef(),
+                                                     startIndex,
+                                                     endIndex)
+                               : 0;
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::copyDataValues
+    \return error code
+*/
+UA_StatusCode Open62541::HistoryBackendWrapper::copyDataValues(Context& c,
+                                                            size_t startIndex,
+                                                            size_t endIndex,
+                                                            UA_Boolean reverse,
+                                                            size_t valueSize,
+                                                            UA_NumericRange range,
+                                                            UA_Boolean releaseContinuationPoints,
+                                                            std::string& in,
+                                                            std::string& out,
+                                                            size_t* providedValues,
+                                                            UA_DataValue* values)
+{
+    if (!_backend.copyDataValues)
+        return UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+    sync(c.nodeId);
+    std::lock_guard<std::mutex> l(_backendMutex);
+    UA_ByteString cp = toByteString(in);
+    UA_ByteString outCp;
+    UA_ByteString_init(&outCp);
+    UA_StatusCode ret = _backend.copyDataValues(c.server.server(),
+                                                _backend.context,
+                                                c.sessionId.constRef(),
+                                                c.sessionContext,
+                                                c.nodeId.constRef(),
+                                                startIndex,
+                                                endIndex,
+                                                reverse,
+                                                valueSize,
+                                                range,
+                                                releaseContinuationPoints,
+                                                &cp,
+                                                &outCp,
+                                                providedValues,
+                                                values);
+    takeByteString(outCp, out);
+    return ret;
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::readSamples
+    \return values read - block reads are passed on if the backend is a HistoryDataBackend
+*/
+size_t Open62541::HistoryBackendWrapper::readSamples(Context& c,
+                                                  size_t startIndex,
+                                                  size_t n,
+                                                  UA_DateTime* times,
+                                                  UA_Double* values,
+                                                  UA_Byte* good)
+{
+    sync(c.nodeId);
+    std::lock_guard<std::mutex> l(_backendMutex);
+    HistoryDataBackend* b = fromBackend(_backend);
+    return b ? b->readSamples(c, startIndex, n, times, values, good) : 0;
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::appendRecords
+    \return records stored - bulk loads go straight to the backend if it is a HistoryDataBackend
+*/
+size_t Open62541::HistoryBackendWrapper::appendRecords(const NodeId& n, const FileHistoryRecord* r, size_t count)
+{
+    sync(n);  // queued values come first
+    std::lock_guard<std::mutex> l(_backendMutex);
+    HistoryDataBackend* b = fromBackend(_backend);
+    return b ? b->appendRecords(n, r, count) : 0;
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::readRecords
+    \return false if the backend does not support bulk reads
+*/
+bool Open62541::HistoryBackendWrapper::readRecords(const NodeId& n,
+                                                   UA_DateTime start,
+                                                   UA_DateTime end,
+                                                   const std::function<bool(const FileHistoryRecord*, size_t)>& f)
+{
+    sync(n);
+    std::lock_guard<std::mutex> l(_backendMutex);
+    HistoryDataBackend* b = fromBackend(_backend);
+    return b && b->readRecords(n, start, end, f);
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::getDataValue
+    The value is copied while the backend is locked - the backend's own storage may move once it is released
+    \return value valid until the next call or null
+*/
+const UA_DataValue* Open62541::HistoryBackendWrapper::getDataValue(Context& c, size_t index)
+{
+    if (!_backend.getDataValue)
+        return nullptr;
+    sync(c.nodeId);
+    std::lock_guard<std::mutex> l(_backendMutex);
+    const UA_DataValue* v = _backend.getDataValue(c.server.server(),
+                                                  _backend.context,
+                                                  c.sessionId.constRef(),
+                                                  c.sessionContext,
+                                                  c.nodeId.constRef(),
+                                                  index);
+    UA_DataValue_clear(&_value);
+    if (!v || (UA_DataValue_copy(v, &_value) != UA_STATUSCODE_GOOD))
+        return nullptr;
+    return &_value;
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::boundSupported
+    \return true if the backend supports bounds
+*/
+UA_Boolean Open62541::HistoryBackendWrapper::boundSupported(Context& c)
+{
+    return _backend.boundSupported ? _backend.boundSupported(c.server.server(),
+                                                             _backend.context,
+                                                             c.sessionId.constRef(),
+                                                             c.sessionContext,
+                                                             c.nodeId.constRef())
+                                   : UA_FALSE;
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::timestampsToReturnSupported
+    \return true if the backend supports the timestamps
+*/
+UA_Boolean Open62541::HistoryBackendWrapper::timestampsToReturnSupported(Context& c,
+                                                                      const UA_TimestampsToReturn timestampsToReturn)
+{
+    return _backend.timestampsToReturnSupported ? _backend.timestampsToReturnSupported(c.server.server(),
+                                                                                       _backend.context,
+                                                                                       c.sessionId.constRef(),
+                                                                                       c.sessionContext,
+                                                                                       c.nodeId.constRef(),
+                                                                                       timestampsToReturn)
+                                                : UA_FALSE;
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::insertDataValue
+    \return error code
+*/
+UA_StatusCode Open62541::HistoryBackendWrapper::insertDataValue(Context& c, const UA_DataValue* value)
+{
+    if (!_backend.insertDataValue)
+        return UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+    sync(c.nodeId);
+    std::lock_guard<std::mutex> l(_backendMutex);
+    return _backend.insertDataValue(c.server.server(),
+                                    _backend.context,
+                                    c.sessionId.constRef(),
+                                    c.sessionContext,
+                                    c.nodeId.constRef(),
+                                    value);
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::replaceDataValue
+    \return error code
+*/
+UA_StatusCode Open62541::HistoryBackendWrapper::replaceDataValue(Context& c, const UA_DataValue* value)
+{
+    if (!_backend.replaceDataValue)
+        return UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+    sync(c.nodeId);
+    std::lock_guard<std::mutex> l(_backendMutex);
+    return _backend.replaceDataValue(c.server.server(),
+                                     _backend.context,
+                                     c.sessionId.constRef(),
+                                     c.sessionContext,
+                                     c.nodeId.constRef(),
+                                     value);
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::updateDataValue
+    \return error code
+*/
+UA_StatusCode Open62541::HistoryBackendWrapper::updateDataValue(Context& c, const UA_DataValue* value)
+{
+    if (!_backend.updateDataValue)
+        return UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+    sync(c.nodeId);
+    std::lock_guard<std::mutex> l(_backendMutex);
+    return _backend.updateDataValue(c.server.server(),
+                                    _backend.context,
+                                    c.sessionId.constRef(),
+                                    c.sessionContext,
+                                    c.nodeId.constRef(),
+                                    value);
+}
+
+/*!
+    \brief Open62541::HistoryBackendWrapper::removeDataValue
+    \return error code
+*/
+UA_StatusCode Open62541::HistoryBackendWrapper::removeDataValue(Context& c,
+                                                             UA_DateTime startTimestamp,
+                                                             UA_DateTime endTimestamp)
+{
+    if (!_backend.removeDataValue)
+        return UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+    sync(c.nodeId);
+    std::lock_guard<std::mutex> l(_backendMutex);
+    return _backend.removeDataValue(c.server.server(),
+                                    _backend.context,
+                                    c.sessionId.constRef(),
+                                    c.sessionContext,
+                                    c.nodeId.constRef(),
+                                    startTimestamp,
+                                    endTimestamp);
+}
@@ -0,0 +1,689 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/historybulk.h>
+#include <open62541cpp/historyaggregates.h>
+#include <open62541cpp/historycompression.h>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <thread>
+
+namespace {
+// the generic path goes through the C API of a backend that may not be thread safe
+std::mutex genericMutex;
+
+const UA_DateTime END_OF_TIME = std::numeric_limits<UA_DateTime>::max();
+
+/*!
+    \brief csvField
+    Split the next field off a CSV line
+    \param line
+    \param pos start of the field - moved past the separator
+    \param field
+    \return false if there are no more fields
+*/
+bool csvField(const std::string& line, size_t& pos, std::string& field)
+{
+    field.clear();
+    if (pos > line.size())
+        return false;
+    if ((pos < line.size()) && (line[pos] == '"')) {
+        for (pos++; pos < line.size(); pos++) {
+            if (line[pos] == '"') {
+                if ((pos + 1 < line.size()) && (line[pos + 1] == '"'))
+                    pos++;  // escaped quote
+                else
+                    break;
+            }
+            field += line[pos];
+        }
+        pos = line.find(',', pos);
+    }
+    else {
+        size_t e = line.find(',', pos);
+        field    = line.substr(pos, (e == std::string::npos) ? std::string::npos : e - pos);
+        pos      = e;
+    }
+    pos = (pos == std::string::npos) ? line.size() + 1 : pos + 1;
+    return true;
+}
+}  // namespace
+
+/*!
+    \brief Open62541::HistoryBulkFile::create
+    \param path
+    \return true on success
+*/
+bool Open62541::HistoryBulkFile::create(const std::string& path)
+{
+    close();
+    _file = fopen(path.c_str(), "wb");
+    if (!_file) {
+        _lastError = UA_STATUSCODE_BADRESOURCEUNAVAILABLE;
+        return false;
+    }
+    HistoryBulkFileHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic    = HISTORY_BULK_MAGIC;
+    h.version  = HISTORY_BULK_VERSION;
+    _lastError = (fwrite(&h, sizeof(h), 1, _file) == 1) ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADINTERNALERROR;
+    return lastOK();
+}
+
+/*!
+    \brief Open62541::HistoryBulkFile::open
+    \param path
+    \return true on success
+*/
+bool Open62541::HistoryBulkFile::open(const std::string& path)
+{
+    close();
+    _file = fopen(path.c_str(), "rb");
+    if (!_file) {
+        _lastError = UA_STATUSCODE_BADRESOURCEUNAVAILABLE;
+        return false;
+    }
+    HistoryBulkFileHeader h;
+    if ((fread(&h, sizeof(h), 1, _file) != 1) || (h.magic != HISTORY_BULK_MAGIC) ||
+        (h.version != HISTORY_BULK_VERSION)) {
+        close();
+        _lastError = UA_STATUSCODE_BADDATAENCODINGINVALID;
+        return false;
+    }
+    _lastError = UA_STATUSCODE_GOOD;
+    return true;
+}
+
+/*!
+    \brief Open62541::HistoryBulkFile::close
+    \return true on success
+*/
+bool Open62541::HistoryBulkFile::close()
+{
+    if (!_file)
+        return true;
+    bool ret = fclose(_file) == 0;
+    _file    = nullptr;
+    if (!ret)
+        _lastError = UA_STATUSCODE_BADINTERNALERROR;
+    return ret;
+}
+
+/*!
+    \brief Open62541::HistoryBulkFile::writeSeries
+    \param n
+    \param r
+    \param count
+    \return true on success
+*/
+bool Open62541::HistoryBulkFile::writeSeries(const NodeId& n, const FileHistoryRecord* r, size_t count)
+{
+    std::string id = toString(*n.constRef());
+    for (size_t i = 0; i < count; i += HISTORY_BULK_SERIES_RECORDS) {
+        size_t k = std::min(count - i, HISTORY_BULK_SERIES_RECORDS);
+        HistoryBulkSeriesHeader h;
+        memset(&h, 0, sizeof(h));
+        h.idSize    = UA_UInt32(id.size());
+        h.count     = k;
+        h.firstTime = r[i].timestamp;
+        h.lastTime  = r[i + k - 1].timestamp;
+        std::string data;
+        std::string block;
+        for (size_t j = 0; j < k; j += HISTORY_BLOCK_RECORDS, h.blocks++) {
+            block.clear();
+            if (!HistoryBlockEncoder::encode(r + i + j, std::min(k - j, HISTORY_BLOCK_RECORDS), block)) {
+                _lastError = UA_STATUSCODE_BADENCODINGERROR;
+                return false;
+            }
+            UA_UInt32 size = UA_UInt32(block.size());
+            data.append(reinterpret_cast<const char*>(&size), sizeof(size));
+            data += block;
+        }
+        std::lock_guard<std::mutex> l(_mutex);
+        if (!_file || (fwrite(&h, sizeof(h), 1, _file) != 1) || (fwrite(id.data(), 1, id.size(), _file) != id.size()) ||
+            (fwrite(data.data(), 1, data.size(), _file) != data.size())) {
+            _lastError = UA_STATUSCODE_BADINTERNALERROR;
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::HistoryBulkFile::readSeries
+    \param n
+    \param header
+    \param blocks
+    \return false at the end of the file or on error
+*/
+bool Open62541::HistoryBulkFile::readSeries(NodeId& n, HistoryBulkSeriesHeader& header, std::string& blocks)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    _lastError = UA_STATUSCODE_GOOD;
+    if (!_file || (fread(&header, sizeof(header), 1, _file) != 1)) {
+        if (!_file || !feof(_file))
+            _lastError = UA_STATUSCODE_BADINTERNALERROR;
+        return false;
+    }
+    _lastError = UA_STATUSCODE_BADDATAENCODINGINVALID;
+    if ((header.idSize == 0) || (header.idSize > 4096))
+        return false;
+    std::string id(header.idSize, '\0');
+    if (fread(&id[0], 1, id.size(), _file) != id.size())
+        return false;
+    UA_NodeId nodeId;
+    UA_String s;
+    s.length = id.size();
+    s.data   = reinterpret_cast<UA_Byte*>(&id[0]);
+    if (UA_NodeId_parse(&nodeId, s) != UA_STATUSCODE_GOOD)
+        return false;
+    n = nodeId;
+    UA_NodeId_clear(&nodeId);
+    blocks.clear();
+    for (UA_UInt32 i = 0; i < header.blocks; i++) {
+        UA_UInt32 size;
+        if (fread(&size, sizeof(size), 1, _file) != 1)
+            return false;
+        size_t at = blocks.size();
+        blocks.resize(at + sizeof(size) + size);
+        memcpy(&blocks[at], &size, sizeof(size));
+        if (fread(&blocks[at + sizeof(size)], 1, size, _file) != size)
+            return false;
+    }
+    _lastError = UA_STATUSCODE_GOOD;
+    return true;
+}
+
+/*!
+    \brief Open62541::HistoryBulkFile::decode
+    \param header
+    \param blocks
+    \param records
+    \return true on success
+*/
+bool Open62541::HistoryBulkFile::decode(const HistoryBulkSeriesHeader& header,
+                                        const std::string& blocks,
+                                        std::vector<FileHistoryRecord>& records)
+{
+    const UA_Byte* p   = reinterpret_cast<const UA_Byte*>(blocks.data());
+    const UA_Byte* end = p + blocks.size();
+    size_t first       = records.size();
+    for (UA_UInt32 i = 0; i < header.blocks; i++) {
+        UA_UInt32 size;
+        if (size_t(end - p) < sizeof(size))
+            return false;
+        memcpy(&size, p, sizeof(size));
+        p += sizeof(size);
+        if (size_t(end - p) < size)
+            return false;
+        HistoryBlockDecoder d(p, size);
+        size_t at = records.size();
+        records.resize(at + d.count());
+        if (d.decode(records.data() + at, d.count()) != d.count())
+            return false;
+        p += size;
+    }
+    return (records.size() - first) == header.count;
+}
+
+/*!
+    \brief Open62541::HistoryBulk::readNode
+    Pass the records of a node in the range to a function in runs of up to HISTORY_BULK_SERIES_RECORDS
+    \param n
+    \param start
+    \param end
+    \param f
+    \return true on success
+*/
+bool Open62541::HistoryBulk::readNode(const NodeId& n, UA_DateTime start, UA_DateTime end, const SeriesFunction& f)
+{
+    std::vector<FileHistoryRecord> series;
+    series.reserve(HISTORY_BULK_SERIES_RECORDS);
+    bool ok  = true;
+    auto add = [&](const FileHistoryRecord* r, size_t count) {
+        while (ok && (count > 0)) {
+            size_t k = std::min(count, HISTORY_BULK_SERIES_RECORDS - series.size());
+            series.insert(series.end(), r, r + k);
+            r += k;
+            count -= k;
+            if (series.size() == HISTORY_BULK_SERIES_RECORDS) {
+                ok = f(n, series.data(), series.size());
+                series.clear();
+            }
+        }
+        return ok;
+    };
+    HistoryDataBackend* b = HistoryDataBackend::fromBackend(_backend);
+    if (b && b->readRecords(n, start, end, add))
+        return ok && (series.empty() || f(n, series.data(), series.size()));
+    //
+    // through the low level API
+    if (!_server || !_backend.getDateTimeMatch || !_backend.getEnd || !_backend.lastIndex || !_backend.getDataValue) {
+        _lastError = UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+        return false;
+    }
+    std::lock_guard<std::mutex> l(genericMutex);
+    const UA_NodeId* id = n.constRef();
+    void* context       = _backend.context;
+    size_t e            = _backend.getEnd(_server, context, &UA_NODEID_NULL, nullptr, id);
+    auto match          = [&](UA_DateTime t) {
+        return _backend.getDateTimeMatch(_server, context, &UA_NODEID_NULL, nullptr, id, t, MATCH_EQUAL_OR_AFTER);
+    };
+    size_t i = match(start);
+    if (i == e)
+        return true;  // nothing in range
+    size_t last = (end == END_OF_TIME) ? e : match(end);
+    if (last == e)
+        last = _backend.lastIndex(_server, context, &UA_NODEID_NULL, nullptr, id) + 1;
+    FileHistoryRecord r;
+    for (; ok && (i < last); i++) {
+        const UA_DataValue* v = _backend.getDataValue(_server, context, &UA_NODEID_NULL, nullptr, id, i);
+        if (!v || (FileHistoryBackend::toRecord(*v, r) != UA_STATUSCODE_GOOD)) {
+            _skipped++;  // not representable as a record
+            continue;
+        }
+        add(&r, 1);
+    }
+    return ok && (series.empty() || f(n, series.data(), series.size()));
+}
+
+/*!
+    \brief Open62541::HistoryBulk::append
+    \param n
+    \param r
+    \param count
+    \return records stored
+*/
+size_t Open62541::HistoryBulk::append(const NodeId& n, const FileHistoryRecord* r, size_t count)
+{
+    size_t done           = 0;
+    HistoryDataBackend* b = HistoryDataBackend::fromBackend(_backend);
+    if (b)
+        done = b->appendRecords(n, r, count);
+    if ((done == 0) && (count > 0) && _server && _backend.serverSetHistoryData) {
+        // no record level access - through the low level API
+        std::lock_guard<std::mutex> l(genericMutex);
+        const UA_NodeId* id = n.constRef();
+        UA_DataValue v;
+        UA_DataValue_init(&v);
+        for (size_t i = 0; i < count; i++) {
+            if ((FileHistoryBackend::toDataValue(r[i], v) == UA_STATUSCODE_GOOD) &&
+                (_backend.serverSetHistoryData(_server, _backend.context, &UA_NODEID_NULL, nullptr, id, true, &v) ==
+                 UA_STATUSCODE_GOOD))
+                done++;
+            UA_DataValue_clear(&v);
+        }
+    }
+    _records += done;
+    _skipped += count - done;
+    return done;
+}
+
+/*!
+    \brief Open62541::HistoryBulk::forEachNode
+    Read nodes in parallel if the backend supports record level access
+    \param nodes
+    \param start
+    \param end
+    \param f
+    \return true on success
+*/
+bool Open62541::HistoryBulk::forEachNode(const std::vector<NodeId>& nodes,
+                                         UA_DateTime start,
+                                         UA_DateTime end,
+                                         const SeriesFunction& f)
+{
+    std::atomic<size_t> next{0};
+    std::atomic<bool> ok{true};
+    auto worker = [&]() {
+        for (size_t i = next++; ok && (i < nodes.size()); i = next++) {
+            if (!readNode(nodes[i], start, end, f))
+                ok = false;
+        }
+    };
+    size_t threads = native() ? std::min<size_t>(_threads, nodes.size()) : 1;
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; i++)
+        workers.emplace_back(worker);
+    worker();
+    for (auto& t : workers)
+        t.join();
+    return ok;
+}
+
+/*!
+    \brief Open62541::HistoryBulk::exportNodes
+    \param nodes
+    \param path
+    \param start
+    \param end
+    \return true on success
+*/
+bool Open62541::HistoryBulk::exportNodes(const std::vector<NodeId>& nodes,
+                                         const std::string& path,
+                                         UA_DateTime start,
+                                         UA_DateTime end)
+{
+    _records   = 0;
+    _skipped   = 0;
+    _lastError = UA_STATUSCODE_GOOD;
+    HistoryBulkFile file;
+    if (!file.create(path)) {
+        _lastError = file.lastError();
+        return false;
+    }
+    auto write = [&](const NodeId& n, const FileHistoryRecord* r, size_t k) {
+        if (!file.writeSeries(n, r, k))
+            return false;
+        _records += k;
+        return true;
+    };
+    bool ok = forEachNode(nodes, start, end ? end : END_OF_TIME, write);
+    if (!file.close() || !file.lastOK())
+        _lastError = file.lastError();
+    else if (!ok && lastOK())
+        _lastError = UA_STATUSCODE_BADINTERNALERROR;
+    return ok && lastOK();
+}
+
+/*!
+    \brief Open62541::HistoryBulk::importFile
+    Series are read on the calling thread and loaded by workers - every series of a node goes to the same worker so
+    they are appended in order
+    \param path
+    \return true on success
+*/
+bool Open62541::HistoryBulk::importFile(const std::string& path)
+{
+    _records   = 0;
+    _skipped   = 0;
+    _lastError = UA_STATUSCODE_GOOD;
+    HistoryBulkFile file;
+    if (!file.open(path)) {
+        _lastError = file.lastError();
+        return false;
+    }
+    struct Series {
+        NodeId node;
+        HistoryBulkSeriesHeader header;
+        std::string blocks;
+    };
+    std::mutex mutex;
+    std::condition_variable wake;
+    size_t threads = native() ? _threads : 1;
+    std::vector<std::deque<Series>> queues(threads);
+    size_t queued = 0;
+    bool done     = false;
+    std::atomic<bool> ok{true};
+    //
+    auto load = [&](Series& s, std::vector<FileHistoryRecord>& records) {
+        records.clear();
+        if (HistoryBulkFile::decode(s.header, s.blocks, records))
+            append(s.node, records.data(), records.size());
+        else
+            ok = false;
+    };
+    auto worker = [&](size_t w) {
+        std::vector<FileHistoryRecord> records;
+        for (;;) {
+            Series s;
+            {
+                std::unique_lock<std::mutex> l(mutex);
+                wake.wait(l, [&] { return done || !queues[w].empty(); });
+                if (queues[w].empty())
+                    return;
+                s = std::move(queues[w].front());
+                queues[w].pop_front();
+                queued--;
+            }
+            wake.notify_all();
+            load(s, records);
+        }
+    };
+    std::vector<std::thread> workers;
+    if (threads > 1) {
+        for (size_t i = 0; i < threads; i++)
+            workers.emplace_back(worker, i);
+    }
+    //
+    std::vector<FileHistoryRecord> records;
+    for (;;) {
+        Series s;
+        if (!file.readSeries(s.node, s.header, s.blocks)) {
+            if (!file.lastOK())
+                _lastError = file.lastError();
+            break;
+        }
+        if (threads == 1) {
+            load(s, records);
+            continue;
+        }
+        std::unique_lock<std::mutex> l(mutex);
+        wake.wait(l, [&] { return queued < 4 * threads; });  // bound the memory held in queues
+        queues[s.node.hash() % threads].push_back(std::move(s));
+        queued++;
+        wake.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> l(mutex);
+        done = true;
+    }
+    wake.notify_all();
+    for (auto& t : workers)
+        t.join();
+    if (!ok && lastOK())
+        _lastError = UA_STATUSCODE_BADDATAENCODINGINVALID;
+    return lastOK();
+}
+
+/*!
+    \brief Open62541::HistoryBulk::toIsoTime
+    \param t
+    \return ISO 8601 UTC time
+*/
+std::string Open62541::HistoryBulk::toIsoTime(UA_DateTime t)
+{
+    UA_DateTimeStruct s = UA_DateTime_toStruct(t);
+    char b[40];
+    snprintf(b,
+             sizeof(b),
+             "%04d-%02u-%02uT%02u:%02u:%02u.%03u%03u%01uZ",
+             int(s.year),
+             unsigned(s.month),
+             unsigned(s.day),
+             unsigned(s.hour),
+             unsigned(s.min),
+             unsigned(s.sec),
+             unsigned(s.milliSec),
+             unsigned(s.microSec),
+             unsigned(s.nanoSec / 100));
+    return b;
+}
+
+/*!
+    \brief Open62541::HistoryBulk::fromIsoTime
+    \param s
+    \param t
+    \return true on success
+*/
+bool Open62541::HistoryBulk::fromIsoTime(const std::string& s, UA_DateTime& t)
+{
+    int year, month, day, hour, min, sec, used = 0;
+    if ((sscanf(s.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d%n", &year, &month, &day, &hour, &min, &sec, &used) != 6) ||
+        (month < 1) || (month > 12) || (day < 1) || (day > 31) || (hour > 23) || (min > 59) || (sec > 60))
+        return false;
+    UA_DateTime fraction = 0;
+    size_t i             = size_t(used);
+    if ((i < s.size()) && (s[i] == '.')) {
+        UA_DateTime scale = UA_DATETIME_SEC;
+        for (i++; (i < s.size()) && isdigit((unsigned char)s[i]); i++) {
+            scale /= 10;
+            fraction += (s[i] - '0') * scale;  // digits beyond 100ns add nothing
+        }
+    }
+    if ((i < s.size()) && (s[i] == 'Z'))
+        i++;
+    if (i != s.size())
+        return false;  // only UTC
+    UA_DateTimeStruct d;
+    memset(&d, 0, sizeof(d));
+    d.year  = UA_Int16(year);
+    d.month = UA_UInt16(month);
+    d.day   = UA_UInt16(day);
+    d.hour  = UA_UInt16(hour);
+    d.min   = UA_UInt16(min);
+    d.sec   = UA_UInt16(sec);
+    t       = UA_DateTime_fromStruct(d) + fraction;
+    return true;
+}
+
+/*!
+    \brief Open62541::HistoryBulk::exportCsv
+    \param nodes
+    \param path
+    \param start
+    \param end
+    \return true on success
+*/
+bool Open62541::HistoryBulk::exportCsv(const std::vector<NodeId>& nodes,
+                                       const std::string& path,
+                                       UA_DateTime start,
+                                       UA_DateTime end)
+{
+    _records   = 0;
+    _skipped   = 0;
+    _lastError = UA_STATUSCODE_GOOD;
+    std::ofstream os(path, std::ios::out | std::ios::trunc);
+    if (!os) {
+        _lastError = UA_STATUSCODE_BADRESOURCEUNAVAILABLE;
+        return false;
+    }
+    os << "node,time,value,status\n";
+    std::mutex mutex;
+    auto write = [&](const NodeId& n, const FileHistoryRecord* r, size_t k) {
+        // format outside the lock - lines of a series stay together
+        std::string id = "\"";
+        for (char c : toString(*n.constRef())) {
+            if (c == '"')
+                id += '"';
+            id += c;
+        }
+        id += "\",";
+        std::string lines;
+        char b[64];
+        for (const FileHistoryRecord* e = r + k; r < e; r++) {
+            lines += id;
+            lines += toIsoTime(r->timestamp);
+            lines += ',';
+            UA_Double d;
+            if ((r->flags & FileHistoryRecord::HasValue) && HistoryAggregate::toDouble(r->typeIndex, r->value, d)) {
+                snprintf(b, sizeof(b), "%.17g", d);
+                lines += b;
+            }
+            snprintf(b, sizeof(b), ",0x%08X\n", unsigned((r->flags & FileHistoryRecord::HasStatus) ? r->status : 0));
+            lines += b;
+        }
+        std::lock_guard<std::mutex> l(mutex);
+        os << lines;
+        _records += k;
+        return bool(os);
+    };
+    bool ok = forEachNode(nodes, start, end ? end : END_OF_TIME, write);
+    os.close();
+    if (!ok || !os) {
+        if (lastOK())
+            _lastError = UA_STATUSCODE_BADINTERNALERROR;
+        return false;
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::HistoryBulk::importCsv
+    \param path
+    \return true on success
+*/
+bool Open62541::HistoryBulk::importCsv(const std::string& path)
+{
+    _records   = 0;
+    _skipped   = 0;
+    _lastError = UA_STATUSCODE_GOOD;
+    std::ifstream is(path);
+    if (!is) {
+        _lastError = UA_STATUSCODE_BADRESOURCEUNAVAILABLE;
+        return false;
+    }
+    std::string line;
+    std::string id;
+    std::string field;
+    NodeId node;
+    std::vector<FileHistoryRecord> series;
+    auto flush = [&]() {
+        if (!series.empty())
+            append(node, series.data(), series.size());
+        series.clear();
+    };
+    for (size_t number = 1; std::getline(is, line); number++) {
+        if (!line.empty() && (line.back() == '\r'))
+            line.pop_back();
+        if (line.empty())
+            continue;
+        size_t pos = 0;
+        FileHistoryRecord r;
+        memset(&r, 0, sizeof(r));
+        UA_Double d = 0.0;
+        bool good   = csvField(line, pos, field) && !field.empty();
+        if (good && (field != id)) {
+            UA_NodeId nodeId;
+            UA_String s;
+            s.length = field.size();
+            s.data   = reinterpret_cast<UA_Byte*>(&field[0]);
+            good     = UA_NodeId_parse(&nodeId, s) == UA_STATUSCODE_GOOD;
+            if (good) {
+                flush();
+                node = nodeId;
+                id   = field;
+                UA_NodeId_clear(&nodeId);
+            }
+        }
+        good = good && csvField(line, pos, field) && fromIsoTime(field, r.timestamp);
+        if (good && csvField(line, pos, field) && !field.empty()) {
+            char* e = nullptr;
+            d       = strtod(field.c_str(), &e);
+            good    = e && (*e == '\0');
+            r.flags |= FileHistoryRecord::HasValue;
+        }
+        if (good && csvField(line, pos, field) && !field.empty()) {
+            char* e  = nullptr;
+            r.status = UA_StatusCode(strtoul(field.c_str(), &e, 0));
+            good     = e && (*e == '\0');
+            r.flags |= FileHistoryRecord::HasStatus;
+        }
+        if (!good) {
+            if (number > 1)
+                _skipped++;  // the first line may be a heading
+            continue;
+        }
+        r.typeIndex = UA_TYPES_DOUBLE;
+        r.flags |= FileHistoryRecord::HasSourceTimestamp;
+        memcpy(r.value, &d, sizeof(d));
+        series.push_back(r);
+        if (series.size() >= HISTORY_BULK_SERIES_RECORDS)
+            flush();
+    }
+    flush();
+    if (is.bad()) {
+        _lastError = UA_STATUSCODE_BADINTERNALERROR;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,418 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/historycompression.h>
+
+// delta of delta buckets - the prefix selects the width of the zig zag encoded value
+// 100ns ticks so a few ms of jitter needs more bits than the Gorilla paper's seconds
+static const unsigned DOD_BITS_1 = 12;
+static const unsigned DOD_BITS_2 = 20;
+static const unsigned DOD_BITS_3 = 32;
+
+static inline UA_UInt64 zigZag(UA_UInt64 v)
+{
+    return (v << 1) ^ UA_UInt64(UA_Int64(v) >> 63);
+}
+
+static inline UA_UInt64 unZigZag(UA_UInt64 v)
+{
+    return (v >> 1) ^ (~(v & 1) + 1);
+}
+
+static inline unsigned leadingZeros(UA_UInt64 v)
+{
+    return v ? unsigned(__builtin_clzll(v)) : 64;
+}
+
+static inline unsigned trailingZeros(UA_UInt64 v)
+{
+    return v ? unsigned(__builtin_ctzll(v)) : 64;
+}
+
+/*!
+    \brief Open62541::HistoryBitWriter::put
+    \param v
+    \param n at most 32
+*/
+void Open62541::HistoryBitWriter::put(UA_UInt64 v, unsigned n)
+{
+    if (n == 0)
+        return;
+    v &= (n == 64) ? ~UA_UInt64(0) : ((UA_UInt64(1) << n) - 1);
+    _acc = (_acc << n) | v;
+    _bits += n;
+    while (_bits >= 8) {
+        _bits -= 8;
+        _out.push_back(char(_acc >> _bits));
+    }
+    _acc &= (UA_UInt64(1) << _bits) - 1;
+}
+
+/*!
+    \brief Open62541::HistoryBitWriter::flush
+*/
+void Open62541::HistoryBitWriter::flush()
+{
+    if (_bits) {
+        _out.push_back(char(_acc << (8 - _bits)));
+        _acc  = 0;
+        _bits = 0;
+    }
+}
+
+/*!
+    \brief Open62541::HistoryBitReader::get
+    \param n at most 32
+    \return bits
+*/
+UA_UInt64 Open62541::HistoryBitReader::get(unsigned n)
+{
+    if (n == 0)
+        return 0;
+    while (_bits < n) {
+        if (_p < _end) {
+            _acc = (_acc << 8) | *_p++;
+        }
+        else {
+            _acc = _acc << 8;
+            _overrun = true;
+        }
+        _bits += 8;
+    }
+    _bits -= n;
+    UA_UInt64 r = (_acc >> _bits) & ((UA_UInt64(1) << n) - 1);
+    _acc &= (UA_UInt64(1) << _bits) - 1;
+    return r;
+}
+
+namespace {
+
+// delta of delta column
+struct DeltaColumn {
+    UA_UInt64 last  = 0;
+    UA_UInt64 delta = 0;
+
+    void encode(Open62541::HistoryBitWriter& w, UA_UInt64 v, bool first)
+    {
+        if (first) {
+            w.write(v, 64);
+            last  = v;
+            delta = 0;
+            return;
+        }
+        UA_UInt64 d  = v - last;  // unsigned arithmetic wraps the same way when decoding
+        UA_UInt64 zz = zigZag(d - delta);
+        if (zz == 0) {
+            w.write(0, 1);
+        }
+        else if (zz < (UA_UInt64(1) << DOD_BITS_1)) {
+            w.write(0x2, 2);
+            w.write(zz, DOD_BITS_1);
+        }
+        else if (zz < (UA_UInt64(1) << DOD_BITS_2)) {
+            w.write(0x6, 3);
+            w.write(zz, DOD_BITS_2);
+        }
+        else if (zz < (UA_UInt64(1) << DOD_BITS_3)) {
+            w.write(0xE, 4);
+            w.write(zz, DOD_BITS_3);
+        }
+        else {
+            w.write(0xF, 4);
+            w.write(zz, 64);
+        }
+        delta = d;
+        last  = v;
+    }
+};
+
+// XOR column
+struct XorColumn {
+    UA_UInt64 last  = 0;
+    unsigned lead   = 0;
+    unsigned trail  = 0;
+    bool window     = false;
+
+    void encode(Open62541::HistoryBitWriter& w, UA_UInt64 v, bool first)
+    {
+        if (first) {
+            w.write(v, 64);
+            last   = v;
+            window = false;
+            return;
+        }
+        UA_UInt64 x = v ^ last;
+        last        = v;
+        if (x == 0) {
+            w.write(0, 1);
+            return;
+        }
+        unsigned l = leadingZeros(x);
+        unsigned t = trailingZeros(x);
+        if (window && (l >= lead) && (t >= trail)) {
+            // meaningful bits fit the previous window
+            w.write(0x2, 2);
+            w.write(x >> trail, 64 - lead - trail);
+        }
+        else {
+            unsigned len = 64 - l - t;
+            w.write(0x3, 2);
+            w.write(l, 6);
+            w.write(len - 1, 6);
+            w.write(x >> t, len);
+            lead   = l;
+            trail  = t;
+            window = true;
+        }
+    }
+};
+
+void putVarint(std::string& out, UA_UInt64 v)
+{
+    while (v >= 0x80) {
+        out.push_back(char(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(char(v));
+}
+
+bool getVarint(const UA_Byte*& p, const UA_Byte* end, UA_UInt64& v)
+{
+    v = 0;
+    for (unsigned shift = 0; (p < end) && (shift < 64); shift += 7) {
+        UA_Byte b = *p++;
+        v |= UA_UInt64(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+void putMeta(std::string& out, size_t run, const Open62541::FileHistoryRecord& r)
+{
+    putVarint(out, run);
+    out.append(reinterpret_cast<const char*>(&r.status), sizeof(r.status));
+    out.append(reinterpret_cast<const char*>(&r.typeIndex), sizeof(r.typeIndex));
+    out.append(reinterpret_cast<const char*>(&r.flags), sizeof(r.flags));
+}
+
+const size_t META_FIXED_SIZE = sizeof(UA_StatusCode) + 2 * sizeof(UA_UInt16);
+
+}  // namespace
+
+/*!
+    \brief Open62541::HistoryBlockEncoder::encode
+    \param r
+    \param n
+    \param out
+    \return true on success
+*/
+bool Open62541::HistoryBlockEncoder::encode(const FileHistoryRecord* r, size_t n, std::string& out)
+{
+    if (!r || (n == 0) || (n > HISTORY_BLOCK_RECORDS))
+        return false;
+    std::string time, server, value, meta;
+    {
+        HistoryBitWriter wt(time), ws(server), wv(value);
+        DeltaColumn ct, cs;
+        XorColumn cv;
+        size_t run = 0;
+        for (size_t i = 0; i < n; i++) {
+            UA_UInt64 v;
+            memcpy(&v, r[i].value, sizeof(v));
+            ct.encode(wt, UA_UInt64(r[i].timestamp), i == 0);
+            cs.encode(ws, UA_UInt64(r[i].serverTimestamp), i == 0);
+            cv.encode(wv, v, i == 0);
+            if ((i > 0) && ((r[i].status != r[i - 1].status) || (r[i].typeIndex != r[i - 1].typeIndex) ||
+                            (r[i].flags != r[i - 1].flags))) {
+                putMeta(meta, run, r[i - 1]);
+                run = 0;
+            }
+            run++;
+        }
+        putMeta(meta, run, r[n - 1]);
+        wt.flush();
+        ws.flush();
+        wv.flush();
+    }
+    HistoryBlockHeader h;
+    memset(&h, 0, sizeof(h));
+    h.count      = UA_UInt32(n);
+    h.timeSize   = UA_UInt32(time.size());
+    h.serverSize = UA_UInt32(server.size());
+    h.valueSize  = UA_UInt32(value.size());
+    h.metaSize   = UA_UInt32(meta.size());
+    h.firstTime  = r[0].timestamp;
+    h.lastTime   = r[n - 1].timestamp;
+    out.reserve(out.size() + sizeof(h) + time.size() + server.size() + value.size() + meta.size());
+    out.append(reinterpret_cast<const char*>(&h), sizeof(h));
+    out.append(time);
+    out.append(server);
+    out.append(value);
+    out.append(meta);
+    return true;
+}
+
+/*!
+    \brief Open62541::HistoryBlockDecoder::HistoryBlockDecoder
+    \param data
+    \param size
+*/
+Open62541::HistoryBlockDecoder::HistoryBlockDecoder(const UA_Byte* data, size_t size)
+    : _time(nullptr, 0)
+    , _server(nullptr, 0)
+    , _value(nullptr, 0)
+{
+    memset(&_header, 0, sizeof(_header));
+    if (!data || (size < sizeof(HistoryBlockHeader)))
+        return;
+    memcpy(&_header, data, sizeof(_header));
+    size_t o = sizeof(HistoryBlockHeader);
+    const UA_Byte* t = stream(data, size, o, _header.timeSize);
+    o += _header.timeSize;
+    const UA_Byte* s = stream(data, size, o, _header.serverSize);
+    o += _header.serverSize;
+    const UA_Byte* v = stream(data, size, o, _header.valueSize);
+    o += _header.valueSize;
+    _meta = stream(data, size, o, _header.metaSize);
+    if (!t || !s || !v || !_meta || (_header.count == 0) || (_header.count > HISTORY_BLOCK_RECORDS))
+        return;
+    _metaEnd = _meta + _header.metaSize;
+    _time    = HistoryBitReader(t, _header.timeSize);
+    _server  = HistoryBitReader(s, _header.serverSize);
+    _value   = HistoryBitReader(v, _header.valueSize);
+    _valid   = true;
+}
+
+namespace {
+
+UA_UInt64 decodeDelta(Open62541::HistoryBitReader& r, UA_UInt64& last, UA_UInt64& delta, bool first)
+{
+    if (first) {
+        last  = r.read(64);
+        delta = 0;
+        return last;
+    }
+    UA_UInt64 zz = 0;
+    if (r.read(1)) {
+        if (!r.read(1))
+            zz = r.read(DOD_BITS_1);
+        else if (!r.read(1))
+            zz = r.read(DOD_BITS_2);
+        else if (!r.read(1))
+            zz = r.read(DOD_BITS_3);
+        else
+            zz = r.read(64);
+    }
+    delta += unZigZag(zz);
+    last += delta;
+    return last;
+}
+
+}  // namespace
+
+/*!
+    \brief Open62541::HistoryBlockDecoder::next
+    \param r
+    \return true if a record was decoded
+*/
+bool Open62541::HistoryBlockDecoder::next(FileHistoryRecord& r)
+{
+    if (!_valid || (_position >= _header.count))
+        return false;
+    bool first = (_position == 0);
+    r.timestamp       = UA_DateTime(decodeDelta(_time, _t, _dt, first));
+    r.serverTimestamp = UA_DateTime(decodeDelta(_server, _s, _ds, first));
+    if (first) {
+        _v = _value.read(64);
+    }
+    else if (_value.read(1)) {
+        if (_value.read(1)) {
+            _lead          = unsigned(_value.read(6));
+            unsigned len   = unsigned(_value.read(6)) + 1;
+            if (_lead + len > 64) {
+                _valid = false;
+                return false;
+            }
+            _trail = 64 - _lead - len;
+        }
+        _v ^= _value.read(64 - _lead - _trail) << _trail;
+    }
+    memcpy(r.value, &_v, sizeof(_v));
+    if (_run == 0) {
+        UA_UInt64 run = 0;
+        if (!getVarint(_meta, _metaEnd, run) || (run == 0) || (size_t(_metaEnd - _meta) < META_FIXED_SIZE)) {
+            _valid = false;
+            return false;
+        }
+        memcpy(&_status, _meta, sizeof(_status));
+        _meta += sizeof(_status);
+        memcpy(&_typeIndex, _meta, sizeof(_typeIndex));
+        _meta += sizeof(_typeIndex);
+        memcpy(&_flags, _meta, sizeof(_flags));
+        _meta += sizeof(_flags);
+        _run = size_t(run);
+    }
+    _run--;
+    r.status    = _status;
+    r.typeIndex = _typeIndex;
+    r.flags     = _flags;
+    if (_time.overrun() || _server.overrun() || _value.overrun()) {
+        _valid = false;
+        return false;
+    }
+    _position++;
+    return true;
+}
+
+/*!
+    \brief Open62541::HistoryBlockDecoder::decode
+    \param out
+    \param n
+    \return number decoded
+*/
+size_t Open62541::HistoryBlockDecoder::decode(FileHistoryRecord* out, size_t n)
+{
+    size_t i = 0;
+    while ((i < n) && next(out[i]))
+        i++;
+    return i;
+}
+
+/*!
+    \brief Open62541::HistoryBlockDecoder::decode
+    \param skip
+    \param n
+    \param values
+    \param range
+    \param decoded
+    \return UA_STATUSCODE_GOOD on success
+*/
+UA_StatusCode Open62541::HistoryBlockDecoder::decode(size_t skip,
+                                                     size_t n,
+                                                     UA_DataValue* values,
+                                                     const UA_NumericRange* range,
+                                                     size_t& decoded)
+{
+    decoded = 0;
+    FileHistoryRecord r;
+    while (_position < skip) {
+        if (!next(r))
+            return UA_STATUSCODE_BADDATAENCODINGINVALID;
+    }
+    while ((decoded < n) && next(r)) {
+        UA_StatusCode ret = FileHistoryBackend::toDataValue(r, values[decoded], range);
+        if (ret != UA_STATUSCODE_GOOD)
+            return ret;
+        decoded++;
+    }
+    return _valid ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADDATAENCODINGINVALID;
+}
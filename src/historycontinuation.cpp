@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/historycontinuation.h>
+#include <open62541cpp/open62541server.h>
+#include <limits>
+
+/*!
+    \brief Open62541::HistoryContinuationPoints::HistoryContinuationPoints
+    \param maxPoints
+    \param maxPerSession
+    \param lifetime
+*/
+Open62541::HistoryContinuationPoints::HistoryContinuationPoints(size_t maxPoints,
+                                                                size_t maxPerSession,
+                                                                UA_DateTime lifetime)
+    : _seed(UA_UInt64(UA_DateTime_now()) ^ UA_UInt64(reinterpret_cast<uintptr_t>(this)))
+{
+    setLimits(maxPoints, maxPerSession, lifetime);
+}
+
+/*!
+    \brief Open62541::HistoryContinuationPoints::setLimits
+    \param maxPoints
+    \param maxPerSession
+    \param lifetime
+*/
+void Open62541::HistoryContinuationPoints::setLimits(size_t maxPoints, size_t maxPerSession, UA_DateTime lifetime)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    _maxPoints     = std::max(maxPoints, size_t(1));
+    _maxPerSession = std::max(maxPerSession, size_t(1));
+    _lifetime      = lifetime;
+}
+
+/*!
+    \brief Open62541::HistoryContinuationPoints::random
+    \return next value of a splitmix64 sequence - tokens are not guessable from each other
+*/
+UA_UInt64 Open62541::HistoryContinuationPoints::random()
+{
+    UA_UInt64 z = (_seed += 0x9E3779B97F4A7C15ULL);
+    z           = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z           = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/*!
+    \brief Open62541::HistoryContinuationPoints::remove
+    \param id - locked by the caller
+*/
+void Open62541::HistoryContinuationPoints::remove(UA_UInt64 id)
+{
+    auto i = _entries.find(id);
+    if (i == _entries.end())
+        return;
+    _order.erase(i->second.age);
+    auto s = _sessions.find(i->second.session);
+    if (s != _sessions.end()) {
+        s->second.erase(i->second.sessionAge);
+        if (s->second.empty())
+            _sessions.erase(s);
+    }
+    _entries.erase(i);
+}
+
+/*!
+    \brief Open62541::HistoryContinuationPoints::expireLocked
+    \param now
+*/
+void Open62541::HistoryContinuationPoints::expireLocked(UA_DateTime now)
+{
+    while (!_order.empty()) {
+        auto i = _entries.find(_order.front());
+        if ((i != _entries.end()) && (i->second.expires > now))
+            break;
+        remove(_order.front());
+        _expired++;
+    }
+}
+
+/*!
+    \brief Open62541::HistoryContinuationPoints::store
+    \param session
+    \param cursor
+    \return continuation point
+*/
+std::string Open62541::HistoryContinuationPoints::store(const NodeId& session, const HistoryCursor& cursor)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    UA_DateTime now = UA_DateTime_now();
+    expireLocked(now);
+    auto s = _sessions.find(session);
+    if ((s != _sessions.end()) && (s->second.size() >= _maxPerSession)) {
+        remove(s->second.front());
+        _evicted++;
+    }
+    if (_entries.size() >= _maxPoints) {
+        remove(_order.front());
+        _evicted++;
+    }
+    UA_UInt64 id = _nextId++;
+    Entry& e     = _entries[id];
+    e.session    = session;
+    e.cursor     = cursor;
+    e.check      = random();
+    e.expires    = now + _lifetime;
+    e.age        = _order.insert(_order.end(), id);
+    std::list<UA_UInt64>& sl = _sessions[session];
+    e.sessionAge             = sl.insert(sl.end(), id);
+    _created++;
+    //
+    std::string token(TOKEN_SIZE, '\0');
+    memcpy(&token[0], &id, sizeof(id));
+    memcpy(&token[sizeof(id)], &e.check, sizeof(e.check));
+    return token;
+}
+
+/*!
+    \brief Open62541::HistoryContinuationPoints::take
+    \param session
+    \param token
+    \param cursor
+    \return UA_STATUSCODE_GOOD or UA_STATUSCODE_BADCONTINUATIONPOINTINVALID
+*/
+UA_StatusCode Open62541::HistoryContinuationPoints::take(const NodeId& session,
+                                                         const std::string& token,
+                                                         HistoryCursor& cursor)
+{
+    if (token.size() != TOKEN_SIZE)
+        return UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+    UA_UInt64 id;
+    UA_UInt64 check;
+    memcpy(&id, token.data(), sizeof(id));
+    memcpy(&check, token.data() + sizeof(id), sizeof(check));
+    std::lock_guard<std::mutex> l(_mutex);
+    expireLocked(UA_DateTime_now());
+    auto i = _entries.find(id);
+    // a session can only use its own continuation points
+    if ((i == _entries.end()) || (i->second.check != check) || !(i->second.session == session))
+        return UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+    cursor = i->second.cursor;
+    remove(id);
+    return UA_STATUSCODE_GOOD;
+}
+
+/*!
+    \brief Open62541::HistoryContinuationPoints::release
+    \param session
+    \param token
+    \return true if released
+*/
+bool Open62541::HistoryContinuationPoints::release(const NodeId& session, const std::string& token)
+{
+    HistoryCursor c;
+    if (take(session, token, c) != UA_STATUSCODE_GOOD)
+        return false;
+    _released++;
+    return true;
+}
+
+/*!
+    \brief Open62541::HistoryContinuationPoints::releaseSession
+    \param session
+    \return number released
+*/
+size_t Open62541::HistoryContinuationPoints::releaseSession(const NodeId& session)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    auto s = _sessions.find(session);
+    if (s == _sessions.end())
+        return 0;
+    std::list<UA_UInt64> ids = s->second;
+    for (auto id : ids)
+        remove(id);
+    _released += ids.size();
+    return ids.size();
+}
+
+/*!
+    \brief Open62541::HistoryContinuationPoints::expire
+    \param now
+    \return number expired
+*/
+size_t Open62541::HistoryContinuationPoints::expire(UA_DateTime now)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    size_t n = _expired;
+    expireLocked(now);
+    return _expired - n;
+}
+
+/*!
+    \brief Open62541::HistoryContinuationPoints::size
+    \return cursors held
+*/
+size_t Open62541::HistoryContinuationPoints::size()
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    return _entries.size();
+}
+
+/*!
+    \brief Open62541::HistoryContinuationPoints::readRaw
+    \return UA_STATUSCODE_GOOD on success
+*/
+UA_StatusCode Open62541::HistoryContinuationPoints::readRaw(HistoryDataBackend& backend,
+                                                            HistoryDataBackend::Context& c,
+                                                            UA_DateTime start,
+                                                            UA_DateTime end,
+                                                            size_t maxSizePerResponse,
+                                                            UA_UInt32 numValuesPerNode,
+                                                            UA_Boolean returnBounds,
+                                                            UA_TimestampsToReturn timestampsToReturn,
+                                                            UA_NumericRange range,
+                                                            UA_Boolean releaseContinuationPoints,
+                                                            const std::string& continuationPoint,
+                                                            std::string& outContinuationPoint,
+                                                            UA_HistoryData* result)
+{
+    outContinuationPoint.clear();
+    if (releaseContinuationPoints) {
+        if (!continuationPoint.empty())
+            release(c.sessionId, continuationPoint);
+        return UA_STATUSCODE_GOOD;
+    }
+    HistoryCursor cursor;
+    if (!continuationPoint.empty()) {
+        UA_StatusCode ret = take(c.sessionId, continuationPoint, cursor);
+        if (ret != UA_STATUSCODE_GOOD)
+            return ret;
+        if (!(cursor.nodeId == c.nodeId))
+            return UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+    }
+    else {
+        // first page - find the range once
+        bool startSet = (start != 0) && (start != std::numeric_limits<UA_DateTime>::min());
+        bool endSet   = (end != 0) && (end != std::numeric_limits<UA_DateTime>::min());
+        if ((!startSet && !endSet) || ((!startSet || !endSet) && !numValuesPerNode))
+            return UA_STATUSCODE_BADHISTORYOPERATIONINVALID;
+        size_t e = backend.getEnd(c);
+        if (e == backend.firstIndex(c))
+            return UA_STATUSCODE_GOOD;  // no values
+        auto match = [&](UA_DateTime t, MatchStrategy bound, MatchStrategy plain) {
+            size_t i = returnBounds ? backend.getDateTimeMatch(c, t, bound) : e;
+            return (i == e) ? backend.getDateTimeMatch(c, t, plain) : i;
+        };
+        // a is the inclusive end the read starts from, b the exclusive end it stops at
+        cursor.reverse = !startSet || (endSet && (start > end));
+        UA_DateTime a  = startSet ? start : end;
+        bool bSet      = startSet && endSet;
+        size_t lo;
+        size_t hi;
+        if (!cursor.reverse) {
+            lo = match(a, MATCH_EQUAL_OR_BEFORE, MATCH_EQUAL_OR_AFTER);
+            hi = !bSet ? backend.lastIndex(c)
+                       : match(end, MATCH_EQUAL_OR_AFTER, (start == end) ? MATCH_EQUAL_OR_BEFORE : MATCH_BEFORE);
+            cursor.next = lo;
+            cursor.last = hi;
+        }
+        else {
+            hi          = match(a, MATCH_EQUAL_OR_AFTER, MATCH_EQUAL_OR_BEFORE);
+            lo          = !bSet ? backend.firstIndex(c) : match(end, MATCH_EQUAL_OR_BEFORE, MATCH_AFTER);
+            cursor.next = hi;
+            cursor.last = lo;
+        }
+        if ((lo == e) || (hi == e) || (lo > hi))
+            return UA_STATUSCODE_GOOD;  // nothing in the range
+        cursor.nodeId = c.nodeId;
+    }
+    //
+    size_t remaining = cursor.reverse ? cursor.next - cursor.last + 1 : cursor.last - cursor.next + 1;
+    size_t n         = remaining;
+    if (numValuesPerNode)
+        n = std::min(n, size_t(numValuesPerNode));
+    if (maxSizePerResponse)
+        n = std::min(n, maxSizePerResponse);
+    result->dataValues = static_cast<UA_DataValue*>(UA_Array_new(n, &UA_TYPES[UA_TYPES_DATAVALUE]));
+    if (!result->dataValues)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    std::string in;
+    std::string out;
+    size_t provided   = 0;
+    UA_StatusCode ret = backend.copyDataValues(c,
+                                               cursor.next,
+                                               cursor.last,
+                                               cursor.reverse,
+                                               n,
+                                               range,
+                                               false,
+                                               in,
+                                               out,
+                                               &provided,
+                                               result->dataValues);
+    result->dataValuesSize = n;  // cleared with the result
+    if (ret != UA_STATUSCODE_GOOD)
+        return ret;
+    provided               = std::min(provided, n);
+    result->dataValuesSize = provided;
+    for (size_t i = 0; i < provided; i++) {
+        UA_DataValue& v = result->dataValues[i];
+        if ((timestampsToReturn == UA_TIMESTAMPSTORETURN_SOURCE) ||
+            (timestampsToReturn == UA_TIMESTAMPSTORETURN_NEITHER))
+            v.hasServerTimestamp = false;
+        if ((timestampsToReturn == UA_TIMESTAMPSTORETURN_SERVER) ||
+            (timestampsToReturn == UA_TIMESTAMPSTORETURN_NEITHER))
+            v.hasSourceTimestamp = false;
+    }
+    // the values past the returned ones may have gone - a page short of what was asked for is the last
+    if ((provided == n) && (provided < remaining)) {
+        cursor.next = cursor.reverse ? cursor.next - provided : cursor.next + provided;
+        outContinuationPoint = store(c.sessionId, cursor);
+    }
+    return UA_STATUSCODE_GOOD;
+}
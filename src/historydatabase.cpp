@@ -1,5 +1,6 @@
 #include <open62541cpp/historydatabase.h>
 #include <open62541cpp/open62541server.h>
+#include <open62541cpp/historycontinuation.h>
 /*
     Copyright (C) 2017 -  B. J. Hill
 
@@ -57,6 +58,40 @@ Open62541::HistoryDatabase::Context::Context(UA_Server* s, const UA_NodeId* sId,
 {
 }
 
+/*!
+ * \brief Open62541::HistoryDataBackend::getHistoryData
+ * \return UA_STATUSCODE_GOOD on success
+ */
+UA_StatusCode Open62541::HistoryDataBackend::getHistoryData(Context& c,
+                                                            const UA_DateTime start,
+                                                            const UA_DateTime end,
+                                                            size_t maxSizePerResponse,
+                                                            UA_UInt32 numValuesPerNode,
+                                                            UA_Boolean returnBounds,
+                                                            UA_TimestampsToReturn timestampsToReturn,
+                                                            UA_NumericRange range,
+                                                            UA_Boolean releaseContinuationPoints,
+                                                            std::string& continuationPoint,
+                                                            std::string& outContinuationPoint,
+                                                            UA_HistoryData* result)
+{
+    if (!_continuationPoints)
+        return UA_STATUSCODE_GOOD;
+    return _continuationPoints->readRaw(*this,
+                                        c,
+                                        start,
+                                        end,
+                                        maxSizePerResponse,
+                                        numValuesPerNode,
+                                        returnBounds,
+                                        timestampsToReturn,
+                                        range,
+                                        releaseContinuationPoints,
+                                        continuationPoint,
+                                        outContinuationPoint,
+                                        result);
+}
+
 /*!
  * \brief Open62541::Historian::setUpdateNode
  * \param nodeId
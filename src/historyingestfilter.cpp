@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/historyingestfilter.h>
+#include <open62541cpp/historyaggregates.h>
+#include <open62541cpp/open62541server.h>
+#include <cmath>
+
+/*!
+    \brief Open62541::HistoryIngestFilter::HistoryIngestFilter
+    \param backend
+*/
+Open62541::HistoryIngestFilter::HistoryIngestFilter(const UA_HistoryDataBackend& backend)
+    : HistoryBackendWrapper(backend)
+{
+}
+
+/*!
+    \brief Open62541::HistoryIngestFilter::write
+    \param server
+    \param nodeId
+    \param historizing
+    \param v
+    \return error code
+*/
+UA_StatusCode Open62541::HistoryIngestFilter::write(UA_Server* server,
+                                                    const UA_NodeId& nodeId,
+                                                    bool historizing,
+                                                    const UA_DataValue& v)
+{
+    std::lock_guard<std::mutex> l(_backendMutex);
+    if (!server || !_backend.serverSetHistoryData)
+        return UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+    // held values may outlive the session that wrote them
+    return _backend.serverSetHistoryData(server, _backend.context, &UA_NODEID_NULL, nullptr, &nodeId, historizing, &v);
+}
+
+/*!
+    \brief Open62541::HistoryIngestFilter::archive
+    Write a value and make it the archived point of the node
+    \return error code
+*/
+UA_StatusCode Open62541::HistoryIngestFilter::archive(UA_Server* server,
+                                                      const UA_NodeId& nodeId,
+                                                      NodeState& s,
+                                                      bool historizing,
+                                                      const UA_DataValue& v,
+                                                      UA_DateTime t,
+                                                      UA_Double d)
+{
+    s.stats.archived++;
+    s.hasArchived   = true;
+    s.archivedTime  = t;
+    s.archivedValue = d;
+    return write(server, nodeId, historizing, v);
+}
+
+/*!
+    \brief Open62541::HistoryIngestFilter::archiveHeld
+    \return error code
+*/
+UA_StatusCode Open62541::HistoryIngestFilter::archiveHeld(UA_Server* server, const UA_NodeId& nodeId, NodeState& s)
+{
+    if (!s.hasHeld)
+        return UA_STATUSCODE_GOOD;
+    s.hasHeld         = false;
+    UA_StatusCode ret = archive(server, nodeId, s, s.heldHistorizing, s.held, s.heldTime, s.heldValue);
+    UA_DataValue_clear(&s.held);
+    return ret;
+}
+
+/*!
+    \brief Open62541::HistoryIngestFilter::hold
+    Keep the last value received in case it is needed to end the trend
+*/
+void Open62541::HistoryIngestFilter::hold(NodeState& s,
+                                          bool historizing,
+                                          const UA_DataValue& v,
+                                          UA_DateTime t,
+                                          UA_Double d)
+{
+    UA_DataValue_clear(&s.held);
+    s.hasHeld         = UA_DataValue_copy(&v, &s.held) == UA_STATUSCODE_GOOD;
+    s.heldHistorizing = historizing;
+    s.heldTime        = t;
+    s.heldValue       = d;
+}
+
+/*!
+    \brief Open62541::HistoryIngestFilter::openDoor
+    Set the swinging door slopes from the archived point to the deviation either side of a value
+    \param s
+    \param t
+    \param d
+    \param deviation
+*/
+void Open62541::HistoryIngestFilter::openDoor(NodeState& s, UA_DateTime t, UA_Double d, UA_Double deviation)
+{
+    UA_Double dt = UA_Double(t - s.archivedTime);
+    s.upper      = (d + deviation - s.archivedValue) / dt;
+    s.lower      = (d - deviation - s.archivedValue) / dt;
+}
+
+/*!
+    \brief Open62541::HistoryIngestFilter::setFilter
+    \param nodeId
+    \param settings
+*/
+void Open62541::HistoryIngestFilter::setFilter(const NodeId& nodeId, const HistoryFilterSettings& settings)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    NodeStatePtr& p = _nodes[nodeId];
+    if (p)
+        archiveHeld(_server, nodeId, *p);
+    p.reset(new NodeState);
+    p->settings = settings;
+}
+
+/*!
+    \brief Open62541::HistoryIngestFilter::removeFilter
+    \param nodeId
+*/
+void Open62541::HistoryIngestFilter::removeFilter(const NodeId& nodeId)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    auto i = _nodes.find(nodeId);
+    if (i != _nodes.end()) {
+        archiveHeld(_server, nodeId, *i->second);
+        _nodes.erase(i);
+    }
+}
+
+/*!
+    \brief Open62541::HistoryIngestFilter::stats
+    \param nodeId
+    \return statistics of the node
+*/
+Open62541::HistoryFilterStats Open62541::HistoryIngestFilter::stats(const NodeId& nodeId)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    auto i = _nodes.find(nodeId);
+    return (i != _nodes.end()) ? i->second->stats : HistoryFilterStats();
+}
+
+/*!
+    \brief Open62541::HistoryIngestFilter::stats
+    \return statistics of all filtered nodes
+*/
+Open62541::HistoryFilterStats Open62541::HistoryIngestFilter::stats()
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    HistoryFilterStats r;
+    for (auto& i : _nodes) {
+        r.received += i.second->stats.received;
+        r.archived += i.second->stats.archived;
+    }
+    return r;
+}
+
+/*!
+    \brief Open62541::HistoryIngestFilter::flush
+    \return number of values archived
+*/
+size_t Open62541::HistoryIngestFilter::flush()
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    size_t n = 0;
+    for (auto& i : _nodes) {
+        if (i.second->hasHeld) {
+            archiveHeld(_server, i.first, *i.second);
+            n++;
+        }
+    }
+    return n;
+}
+
+/*!
+    \brief Open62541::HistoryIngestFilter::serverSetHistoryData
+    \param c
+    \param historizing
+    \param value
+    \return error code
+*/
+UA_StatusCode Open62541::HistoryIngestFilter::serverSetHistoryData(Context& c,
+                                                                   bool historizing,
+                                                                   const UA_DataValue* value)
+{
+    if (!value)
+        return UA_STATUSCODE_GOOD;
+    UA_Server* server = c.server.server();
+    _server           = server;
+    std::lock_guard<std::mutex> l(_mutex);
+    auto i = _nodes.find(c.nodeId);
+    if ((i == _nodes.end()) || (i->second->settings.type == HistoryFilterSettings::NoFilter)) {
+        if (i != _nodes.end()) {
+            i->second->stats.received++;
+            i->second->stats.archived++;
+        }
+        return HistoryBackendWrapper::serverSetHistoryData(c, historizing, value);
+    }
+    NodeState& s            = *i->second;
+    const UA_NodeId& nodeId = *c.nodeId.constRef();
+    s.stats.received++;
+    //
+    UA_DateTime t;
+    UA_Double d;
+    bool good            = HistorySampleReader::toSample(*value, t, d);
+    UA_StatusCode status = value->hasStatus ? value->status : UA_STATUSCODE_GOOD;
+    UA_DateTime last     = s.hasHeld ? s.heldTime : s.archivedTime;
+    if (s.hasArchived && (t < last)) {
+        // out of order - archived as it is, the trend carries on
+        s.stats.archived++;
+        return write(server, nodeId, historizing, *value);
+    }
+    if (s.hasArchived && (t == last) && good && (status == s.status)) {
+        // the same instant again - the later value replaces the held one, or is archived after the archived one
+        if (s.hasHeld) {
+            hold(s, historizing, *value, t, d);
+            return UA_STATUSCODE_GOOD;
+        }
+        return archive(server, nodeId, s, historizing, *value, t, d);
+    }
+    if (!good || (status != s.status) || !s.hasArchived) {
+        // the trend is broken - end it at the held value and start again from this one
+        s.status = status;
+        archiveHeld(server, nodeId, s);
+        UA_StatusCode ret = archive(server, nodeId, s, historizing, *value, t, d);
+        s.hasArchived     = good;
+        return ret;
+    }
+    //
+    const HistoryFilterSettings& f = s.settings;
+    UA_Double deviation            = f.absoluteDeviation();
+    bool heartbeat                 = (f.maxInterval > 0) && ((t - s.archivedTime) >= f.maxInterval);
+    switch (f.type) {
+        case HistoryFilterSettings::Deadband:
+            if (heartbeat || (std::fabs(d - s.archivedValue) > deviation))
+                return archive(server, nodeId, s, historizing, *value, t, d);
+            break;
+        case HistoryFilterSettings::Exception:
+            if (std::fabs(d - s.archivedValue) > deviation) {
+                archiveHeld(server, nodeId, s);  // the value before the exception
+                return archive(server, nodeId, s, historizing, *value, t, d);
+            }
+            if (heartbeat) {
+                s.hasHeld = false;
+                UA_DataValue_clear(&s.held);
+                return archive(server, nodeId, s, historizing, *value, t, d);
+            }
+            hold(s, historizing, *value, t, d);
+            break;
+        case HistoryFilterSettings::SwingingDoor: {
+            if (!s.hasHeld) {
+                hold(s, historizing, *value, t, d);
+                openDoor(s, t, d, deviation);
+                break;
+            }
+            UA_Double dt = UA_Double(t - s.archivedTime);
+            s.upper      = std::min(s.upper, (d + deviation - s.archivedValue) / dt);
+            s.lower      = std::max(s.lower, (d - deviation - s.archivedValue) / dt);
+            if (heartbeat || (s.lower > s.upper)) {
+                // no line from the archived point stays within the deviation of every value - the held value ends
+                // the segment and is where the next one starts
+                UA_StatusCode ret = archiveHeld(server, nodeId, s);
+                hold(s, historizing, *value, t, d);
+                openDoor(s, t, d, deviation);
+                return ret;
+            }
+            hold(s, historizing, *value, t, d);
+        } break;
+        default:
+            break;
+    }
+    return UA_STATUSCODE_GOOD;
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/historyingestqueue.h>
+#include <open62541cpp/open62541server.h>
+
+/*!
+    \brief Open62541::HistoryIngestQueue::HistoryIngestQueue
+    \param backend
+    \param shards
+    \param capacity
+    \param policy
+*/
+Open62541::HistoryIngestQueue::HistoryIngestQueue(const UA_HistoryDataBackend& backend,
+                                                  size_t shards,
+                                                  size_t capacity,
+                                                  Policy policy)
+    : HistoryBackendWrapper(backend)
+    , _policy(policy)
+{
+    for (size_t i = 0; i < std::max(shards, size_t(1)); i++)
+        _shards.push_back(ShardPtr(new Shard(capacity)));
+}
+
+/*!
+    \brief Open62541::HistoryIngestQueue::~HistoryIngestQueue
+*/
+Open62541::HistoryIngestQueue::~HistoryIngestQueue()
+{
+    stop();
+}
+
+/*!
+    \brief Open62541::HistoryIngestQueue::commit
+    \param i
+*/
+void Open62541::HistoryIngestQueue::commit(HistoryIngestItem& i)
+{
+    UA_Server* server = _server.load();
+    // the session context is not kept - the session may have closed by now
+    if (server && _backend.serverSetHistoryData &&
+        (_backend.serverSetHistoryData(server,
+                                       _backend.context,
+                                       i.sessionId.constRef(),
+                                       nullptr,
+                                       i.nodeId.constRef(),
+                                       i.historizing,
+                                       &i.value) == UA_STATUSCODE_GOOD)) {
+        _written++;
+    }
+    else {
+        _failed++;
+    }
+}
+
+/*!
+    \brief Open62541::HistoryIngestQueue::drain
+    Commit queued values of a shard - the queue first then anything spilled after it
+    \param s
+    \param limit maximum to take from the queue - 0 for all
+    \return number committed
+*/
+size_t Open62541::HistoryIngestQueue::drain(Shard& s, size_t limit)
+{
+    std::lock_guard<std::mutex> l(s.consumer);
+    size_t n = 0;
+    {
+        std::lock_guard<std::mutex> b(_backendMutex);  // the server thread may be reading the backend
+        HistoryIngestItem i;
+        while (((limit == 0) || (n < limit)) && s.queue.pop(i)) {
+            commit(i);
+            n++;
+        }
+        if (((limit == 0) || (n < limit)) && s.spilling) {
+            std::deque<HistoryIngestItem> spill;
+            {
+                std::lock_guard<std::mutex> g(s.spillMutex);
+                spill.swap(s.spill);
+                s.spilling = false;  // later values are newer than the spill list so may use the queue again
+            }
+            for (auto& v : spill) {
+                commit(v);
+                n++;
+            }
+        }
+    }
+    if (n && _commit)
+        _commit();
+    return n;
+}
+
+/*!
+    \brief Open62541::HistoryIngestQueue::run
+*/
+void Open62541::HistoryIngestQueue::run()
+{
+    while (_running) {
+        size_t n = 0;
+        for (auto& s : _shards)
+            n += drain(*s, _batch);
+        if (n == 0) {
+            std::unique_lock<std::mutex> l(_wakeMutex);
+            _wake.wait_for(l, std::chrono::milliseconds(_interval_ms));
+        }
+    }
+}
+
+/*!
+    \brief Open62541::HistoryIngestQueue::start
+    \param interval_ms
+    \return true on success
+*/
+bool Open62541::HistoryIngestQueue::start(unsigned interval_ms)
+{
+    if (_running)
+        return true;
+    _interval_ms = interval_ms;
+    try {
+        _running = true;
+        _thread  = std::thread([this] { run(); });
+    }
+    catch (...) {
+        _running = false;
+        return false;
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::HistoryIngestQueue::stop
+*/
+void Open62541::HistoryIngestQueue::stop()
+{
+    if (_running) {
+        _running = false;
+        _wake.notify_all();
+    }
+    if (_thread.joinable())
+        _thread.join();
+    flush();
+}
+
+/*!
+    \brief Open62541::HistoryIngestQueue::flush
+    \return number committed
+*/
+size_t Open62541::HistoryIngestQueue::flush()
+{
+    size_t n = 0;
+    for (auto& s : _shards)
+        n += drain(*s, 0);
+    return n;
+}
+
+/*!
+    \brief Open62541::HistoryIngestQueue::serverSetHistoryData
+    \param c
+    \param historizing
+    \param value
+    \return UA_STATUSCODE_GOOD if the value was queued
+*/
+UA_StatusCode Open62541::HistoryIngestQueue::serverSetHistoryData(Context& c,
+                                                                  bool historizing,
+                                                                  const UA_DataValue* value)
+{
+    if (!value)
+        return UA_STATUSCODE_GOOD;
+    _server = c.server.server();
+    HistoryIngestItem i;
+    i.nodeId      = c.nodeId;
+    i.sessionId   = c.sessionId;
+    i.historizing = historizing;
+    UA_StatusCode ret = UA_DataValue_copy(value, &i.value);
+    if (ret != UA_STATUSCODE_GOOD)
+        return ret;
+    Shard& s = shard(c.nodeId);
+    if (s.spilling) {
+        std::lock_guard<std::mutex> l(s.spillMutex);
+        if (s.spilling) {
+            // keep order behind values already spilled
+            s.spill.push_back(std::move(i));
+            _spilled++;
+            _queued++;
+            return UA_STATUSCODE_GOOD;
+        }
+    }
+    while (!s.queue.push(i)) {
+        switch (_policy) {
+            case DropOldest: {
+                HistoryIngestItem old;
+                if (s.queue.pop(old))
+                    _dropped++;
+            } break;
+            case Spill: {
+                std::lock_guard<std::mutex> l(s.spillMutex);
+                s.spilling = true;
+                s.spill.push_back(std::move(i));
+                _spilled++;
+                _queued++;
+                return UA_STATUSCODE_GOOD;
+            }
+            default:
+                drain(s, _batch);  // block - do the writer's job
+                break;
+        }
+    }
+    _queued++;
+    return UA_STATUSCODE_GOOD;
+}
@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/historymultireader.h>
+#include <thread>
+
+/*!
+    \brief Open62541::HistoryMultiReader::read
+    \param page
+    \param done
+    \return true if every node was read
+*/
+bool Open62541::HistoryMultiReader::read(PageFunc page, DoneFunc done)
+{
+    _stop     = false;
+    _requests = 0;
+    _failed   = 0;
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        _waiting.clear();
+        for (size_t i = 0; i < _nodes.size(); i++)
+            _waiting.push_back(i);
+        _active = 0;
+        _live   = _sessions.size();
+        _lost   = UA_STATUSCODE_GOOD;
+    }
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < _sessions.size(); i++)
+        threads.emplace_back([this, i, &page, &done] { run(*_sessions[i], page, done); });
+    run(*_sessions[0], page, done);
+    for (auto& t : threads)
+        t.join();
+    return _failed == 0;
+}
+
+/*!
+    \brief Open62541::HistoryMultiReader::take
+    \param node receives a node not started
+    \return false if none are left
+*/
+bool Open62541::HistoryMultiReader::take(size_t& node)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    if (_waiting.empty() || _stop)
+        return false;
+    node = _waiting.front();
+    _waiting.pop_front();
+    _active++;
+    return true;
+}
+
+/*!
+    \brief Open62541::HistoryMultiReader::wait
+    Wait while other sessions hold nodes that may yet come back to the queue
+    \return true if there are nodes to take
+*/
+bool Open62541::HistoryMultiReader::wait()
+{
+    std::unique_lock<std::mutex> l(_mutex);
+    _changed.wait(l, [this] { return _stop || !_waiting.empty() || (_active == 0); });
+    return !_stop && !_waiting.empty();
+}
+
+/*!
+    \brief Open62541::HistoryMultiReader::requeue
+    Return the nodes not started to the queue for any session
+    \param reads keeps the nodes started
+*/
+void Open62541::HistoryMultiReader::requeue(std::vector<Read>& reads)
+{
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        for (size_t i = reads.size(); i-- > 0;) {
+            if (reads[i].continuation.length == 0) {
+                _waiting.push_front(reads[i].node);
+                reads.erase(reads.begin() + i);
+                _active--;
+            }
+        }
+    }
+    _changed.notify_all();
+}
+
+/*!
+    \brief Open62541::HistoryMultiReader::finish
+    Complete a node taken by a session
+    \param node
+    \param status
+    \param rows
+    \param done
+*/
+void Open62541::HistoryMultiReader::finish(size_t node, UA_StatusCode status, size_t rows, const DoneFunc& done)
+{
+    if (UA_StatusCode_isBad(status))
+        _failed++;
+    if (done)
+        done(node, status, rows);
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        _active--;
+    }
+    _changed.notify_all();
+}
+
+/*!
+    \brief Open62541::HistoryMultiReader::request
+    Read the next page of each node - or release their continuation points
+    \param c session
+    \param reads nodes in the request
+    \param release
+    \param response receives the response
+    \return true if the service succeeded
+*/
+bool Open62541::HistoryMultiReader::request(Client& c,
+                                            std::vector<Read>& reads,
+                                            bool release,
+                                            UA_HistoryReadResponse& response)
+{
+    UA_ReadRawModifiedDetails details;
+    UA_ReadRawModifiedDetails_init(&details);
+    details.startTime        = _start;
+    details.endTime          = _end;
+    details.numValuesPerNode = UA_UInt32(_pageSize);
+    details.returnBounds     = _returnBounds;
+    // the items borrow the node ids and continuation points - they are not cleared
+    std::vector<UA_HistoryReadValueId> items(reads.size());
+    for (size_t i = 0; i < reads.size(); i++) {
+        UA_HistoryReadValueId_init(&items[i]);
+        items[i].nodeId            = *_nodes[reads[i].node].constRef();
+        items[i].continuationPoint = reads[i].continuation;
+    }
+    UA_HistoryReadRequest q;
+    UA_HistoryReadRequest_init(&q);
+    q.historyReadDetails.encoding             = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+    q.historyReadDetails.content.decoded.type = &UA_TYPES[UA_TYPES_READRAWMODIFIEDDETAILS];
+    q.historyReadDetails.content.decoded.data = &details;
+    q.timestampsToReturn                      = _timestamps;
+    q.releaseContinuationPoints               = release;
+    q.nodesToRead                             = items.data();
+    q.nodesToReadSize                         = items.size();
+    _requests++;
+    return c.historyRead(q, response);
+}
+
+/*!
+    \brief Open62541::HistoryMultiReader::run
+    Read nodes on one session until none are left
+    \param c session
+    \param page
+    \param done
+*/
+void Open62541::HistoryMultiReader::run(Client& c, const PageFunc& page, const DoneFunc& done)
+{
+    size_t batch       = _nodesPerRequest;
+    UA_StatusCode lost = UA_STATUSCODE_GOOD;  // set if the session failed
+    std::vector<Read> reads;                  // nodes of the next request - those with continuation points first
+    for (;;) {
+        size_t node = 0;
+        while ((reads.size() < batch) && take(node)) {
+            reads.emplace_back();
+            reads.back().node = node;
+        }
+        if (_stop)
+            break;
+        if (reads.empty()) {
+            if (wait())
+                continue;
+            break;  // nothing left that can come back
+        }
+        //
+        UA_HistoryReadResponse response;
+        UA_HistoryReadResponse_init(&response);
+        bool ok = request(c, reads, false, response);
+        if (!ok) {
+            UA_StatusCode e = c.lastError();
+            size_t n        = reads.size();
+            if (e != UA_STATUSCODE_BADTOOMANYOPERATIONS) {
+                // the session is lost - nodes not started go to the other sessions, those started end here
+                UA_HistoryReadResponse_clear(&response);
+                lost = e;
+                requeue(reads);
+                break;
+            }
+            if (n > 1) {
+                // the server takes fewer nodes per request - nodes not started go back for any session
+                batch = std::max<size_t>(1, n / 2);
+                requeue(reads);
+                if (reads.size() < n) {
+                    UA_HistoryReadResponse_clear(&response);
+                    continue;
+                }
+            }
+        }
+        std::vector<Read> next;
+        for (size_t i = 0; i < reads.size(); i++) {
+            Read& r = reads[i];
+            UA_ByteString_clear(&r.continuation);  // used up by this request
+            UA_StatusCode status = ok ? UA_STATUSCODE_BADUNEXPECTEDERROR : c.lastError();
+            if (ok && (i < response.resultsSize)) {
+                UA_HistoryReadResult& a = response.results[i];
+                status                  = a.statusCode;
+                if (!UA_StatusCode_isBad(status) && (a.historyData.encoding >= UA_EXTENSIONOBJECT_DECODED) &&
+                    (a.historyData.content.decoded.type == &UA_TYPES[UA_TYPES_HISTORYDATA])) {
+                    const UA_HistoryData* d = static_cast<const UA_HistoryData*>(a.historyData.content.decoded.data);
+                    r.rows += d->dataValuesSize;
+                    if (page && (d->dataValuesSize > 0))
+                        page(r.node, *d);
+                }
+                if (!UA_StatusCode_isBad(status) && (a.continuationPoint.length > 0)) {
+                    r.continuation             = a.continuationPoint;  // take it over
+                    a.continuationPoint.data   = nullptr;
+                    a.continuationPoint.length = 0;
+                    next.push_back(r);
+                    continue;
+                }
+            }
+            finish(r.node, status, r.rows, done);
+        }
+        UA_HistoryReadResponse_clear(&response);
+        reads.swap(next);
+    }
+    //
+    // stopped or lost - release the continuation points held on this session
+    if (!reads.empty()) {
+        std::vector<Read> held;
+        for (auto& r : reads) {
+            if (r.continuation.length > 0)
+                held.push_back(r);
+        }
+        if (!held.empty() && (lost == UA_STATUSCODE_GOOD)) {
+            UA_HistoryReadResponse response;
+            UA_HistoryReadResponse_init(&response);
+            request(c, held, true, response);
+            UA_HistoryReadResponse_clear(&response);
+        }
+        UA_StatusCode status = (lost != UA_STATUSCODE_GOOD) ? lost : UA_STATUSCODE_BADREQUESTCANCELLEDBYCLIENT;
+        for (auto& r : reads) {
+            UA_ByteString_clear(&r.continuation);
+            finish(r.node, status, r.rows, done);
+        }
+    }
+    //
+    // retire the session - nodes never started are only reported once the read is stopped or no session is left
+    std::deque<size_t> left;
+    UA_StatusCode status = UA_STATUSCODE_BADREQUESTCANCELLEDBYCLIENT;
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        _live--;
+        if (lost != UA_STATUSCODE_GOOD)
+            _lost = lost;
+        if (_stop || (_live == 0)) {
+            left.swap(_waiting);
+            if (!_stop && (_lost != UA_STATUSCODE_GOOD))
+                status = _lost;
+        }
+    }
+    _changed.notify_all();
+    for (size_t n : left) {
+        _failed++;
+        if (done)
+            done(n, status, 0);
+    }
+}
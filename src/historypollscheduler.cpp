@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/historypollscheduler.h>
+#include <open62541cpp/open62541server.h>
+
+/*!
+    \brief Open62541::HistoryPollScheduler::addToBucket
+    \param e node entry - the mutex is held by the caller
+*/
+void Open62541::HistoryPollScheduler::addToBucket(NodeEntry& e)
+{
+    e.interval = pollInterval(e.setting);
+    auto i     = _buckets.find(e.interval);
+    if (i == _buckets.end()) {
+        // falls due on the next multiple of the interval
+        UA_DateTime period = UA_DateTime(e.interval) * UA_DATETIME_MSEC;
+        i                  = _buckets.emplace(e.interval, Bucket()).first;
+        i->second.due      = (UA_DateTime_nowMonotonic() / period + 1) * period;
+    }
+    e.slot    = i->second.entries.size();
+    e.polling = true;
+    i->second.entries.push_back(&e);
+}
+
+/*!
+    \brief Open62541::HistoryPollScheduler::removeFromBucket
+    \param e node entry - the mutex is held by the caller
+*/
+void Open62541::HistoryPollScheduler::removeFromBucket(NodeEntry& e)
+{
+    if (!e.polling)
+        return;
+    e.polling = false;
+    auto i    = _buckets.find(e.interval);
+    if (i == _buckets.end())
+        return;
+    std::vector<NodeEntry*>& v = i->second.entries;
+    v[e.slot]                  = v.back();  // swap with the last
+    v[e.slot]->slot            = e.slot;
+    v.pop_back();
+    if (v.empty())
+        _buckets.erase(i);
+}
+
+/*!
+    \brief Open62541::HistoryPollScheduler::updateTimer
+    Run the timer at the greatest common divisor of the bucket intervals - the mutex is held by the caller
+*/
+void Open62541::HistoryPollScheduler::updateTimer()
+{
+    UA_UInt64 t = 0;
+    for (auto& b : _buckets) {
+        UA_UInt64 a = b.first;
+        while (a) {
+            UA_UInt64 r = t % a;
+            t           = a;
+            a           = r;
+        }
+    }
+    if (!_server || (t == _tick))
+        return;
+    if (t == 0) {
+        _server->removeTimerEvent(_timerId);
+        _timerId = 0;
+    }
+    else if (_timerId) {
+        _server->changeRepeatedTimerInterval(_timerId, UA_Double(t));
+    }
+    else {
+        _server->addRepeatedTimerEvent(UA_Double(t), _timerId, [this](Server::Timer&) { tick(); });
+    }
+    _tick = _timerId ? t : 0;
+}
+
+/*!
+    \brief Open62541::HistoryPollScheduler::tick
+    Poll the buckets that are due - the timer is not aligned so half a tick early counts as due
+*/
+void Open62541::HistoryPollScheduler::tick()
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    UA_DateTime now = UA_DateTime_nowMonotonic() + UA_DateTime(_tick) * UA_DATETIME_MSEC / 2;
+    for (auto& b : _buckets) {
+        if (now >= b.second.due) {
+            poll(b.second);
+            UA_DateTime period = UA_DateTime(b.first) * UA_DATETIME_MSEC;
+            b.second.due       = (now / period + 1) * period;  // missed polls are skipped
+        }
+    }
+}
+
+/*!
+    \brief Open62541::HistoryPollScheduler::poll
+    Read every node of a bucket then store the values - the mutex is held by the caller
+    \param b
+*/
+void Open62541::HistoryPollScheduler::poll(Bucket& b)
+{
+    UA_Server* server = _server->server();
+    size_t n          = b.entries.size();
+    _values.resize(n);
+    UA_ReadValueId r;
+    UA_ReadValueId_init(&r);
+    r.attributeId = UA_ATTRIBUTEID_VALUE;
+    for (size_t i = 0; i < n; i++) {
+        r.nodeId   = *b.entries[i]->nodeId.constRef();  // shallow - not cleared
+        _values[i] = UA_Server_read(server, &r, UA_TIMESTAMPSTORETURN_BOTH);
+    }
+    for (size_t i = 0; i < n; i++) {
+        const UA_HistoryDataBackend& backend = b.entries[i]->setting.historizingBackend;
+        if (backend.serverSetHistoryData) {
+            backend.serverSetHistoryData(server,
+                                         backend.context,
+                                         &UA_NODEID_NULL,
+                                         nullptr,
+                                         b.entries[i]->nodeId.constRef(),
+                                         UA_TRUE,
+                                         &_values[i]);
+            _samples++;
+        }
+        UA_DataValue_clear(&_values[i]);
+    }
+    _polls++;
+}
+
+/*!
+    \brief Open62541::HistoryPollScheduler::nodes
+    \return number of registered nodes
+*/
+size_t Open62541::HistoryPollScheduler::nodes()
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    return _nodes.size();
+}
+
+/*!
+    \brief Open62541::HistoryPollScheduler::buckets
+    \return number of buckets
+*/
+size_t Open62541::HistoryPollScheduler::buckets()
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    return _buckets.size();
+}
+
+/*!
+    \brief Open62541::HistoryPollScheduler::deleteMembers
+    Called when the server deletes the gathering and again from the destructor - only the first call reaches the
+    server, which may be gone by the second
+*/
+void Open62541::HistoryPollScheduler::deleteMembers()
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    _buckets.clear();
+    _nodes.clear();
+    if (_server && _timerId)
+        _server->removeTimerEvent(_timerId);
+    _server  = nullptr;
+    _timerId = 0;
+    _tick    = 0;
+}
+
+/*!
+    \brief Open62541::HistoryPollScheduler::registerNodeId
+    \param c
+    \param setting
+    \return UA_STATUSCODE_GOOD on success
+*/
+UA_StatusCode Open62541::HistoryPollScheduler::registerNodeId(Context& c, const UA_HistorizingNodeIdSettings setting)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    _server         = &c.server;
+    NodeEntryPtr& p = _nodes[c.nodeId];
+    if (p)
+        return UA_STATUSCODE_BADNODEIDEXISTS;
+    p.reset(new NodeEntry);
+    p->nodeId  = c.nodeId;
+    p->setting = setting;
+    return UA_STATUSCODE_GOOD;
+}
+
+/*!
+    \brief Open62541::HistoryPollScheduler::stopPoll
+    \param c
+    \return UA_STATUSCODE_GOOD on success
+*/
+UA_StatusCode Open62541::HistoryPollScheduler::stopPoll(Context& c)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    auto i = _nodes.find(c.nodeId);
+    if (i == _nodes.end())
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    if (!i->second->polling)
+        return UA_STATUSCODE_BADNODEIDINVALID;
+    removeFromBucket(*i->second);
+    updateTimer();
+    return UA_STATUSCODE_GOOD;
+}
+
+/*!
+    \brief Open62541::HistoryPollScheduler::startPoll
+    \param c
+    \return UA_STATUSCODE_GOOD on success
+*/
+UA_StatusCode Open62541::HistoryPollScheduler::startPoll(Context& c)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    _server = &c.server;
+    auto i  = _nodes.find(c.nodeId);
+    if (i == _nodes.end())
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    NodeEntry& e = *i->second;
+    if (e.setting.historizingUpdateStrategy != UA_HISTORIZINGUPDATESTRATEGY_POLL)
+        return UA_STATUSCODE_BADNODEIDINVALID;
+    if (e.polling)
+        return UA_STATUSCODE_BADNODEIDEXISTS;
+    addToBucket(e);
+    updateTimer();
+    return UA_STATUSCODE_GOOD;
+}
+
+/*!
+    \brief Open62541::HistoryPollScheduler::updateNodeIdSetting
+    A polled node moves to the bucket of its new interval
+    \param c
+    \param setting
+    \return true on success
+*/
+UA_Boolean Open62541::HistoryPollScheduler::updateNodeIdSetting(Context& c,
+                                                                const UA_HistorizingNodeIdSettings setting)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    auto i = _nodes.find(c.nodeId);
+    if (i == _nodes.end())
+        return UA_FALSE;
+    NodeEntry& e = *i->second;
+    bool polling = e.polling;
+    removeFromBucket(e);
+    e.setting = setting;
+    if (polling && (setting.historizingUpdateStrategy == UA_HISTORIZINGUPDATESTRATEGY_POLL))
+        addToBucket(e);
+    updateTimer();
+    return UA_TRUE;
+}
+
+/*!
+    \brief Open62541::HistoryPollScheduler::getHistorizingSetting
+    \param c
+    \return settings of the node or null
+*/
+const UA_HistorizingNodeIdSettings* Open62541::HistoryPollScheduler::getHistorizingSetting(Context& c)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    auto i = _nodes.find(c.nodeId);
+    return (i != _nodes.end()) ? &i->second->setting : nullptr;
+}
+
+/*!
+    \brief Open62541::HistoryPollScheduler::setValue
+    \param c
+    \param historizing
+    \param value
+*/
+void Open62541::HistoryPollScheduler::setValue(Context& c, UA_Boolean historizing, const UA_DataValue* value)
+{
+    UA_HistoryDataBackend backend;
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        auto i = _nodes.find(c.nodeId);
+        if ((i == _nodes.end()) ||
+            (i->second->setting.historizingUpdateStrategy != UA_HISTORIZINGUPDATESTRATEGY_VALUESET))
+            return;
+        backend = i->second->setting.historizingBackend;
+    }
+    if (backend.serverSetHistoryData)
+        backend.serverSetHistoryData(c.server.server(),
+                                     backend.context,
+                                     c.sessionId.constRef(),
+                                     c.sessionContext,
+                                     c.nodeId.constRef(),
+                                     historizing,
+                                     value);
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/historyreader.h>
+
+/*!
+    \brief Open62541::HistoryReader::HistoryReader
+    \param c
+    \param n
+    \param start
+    \param end
+    \param pageSize
+    \param returnBounds
+    \param ts
+*/
+Open62541::HistoryReader::HistoryReader(Client& c,
+                                        const NodeId& n,
+                                        UA_DateTime start,
+                                        UA_DateTime end,
+                                        size_t pageSize,
+                                        bool returnBounds,
+                                        UA_TimestampsToReturn ts)
+    : _client(c)
+    , _nodeId(n)
+    , _start(start)
+    , _end(end)
+    , _pageSize(std::max<size_t>(1, pageSize))
+    , _returnBounds(returnBounds)
+    , _timestamps(ts)
+{
+    UA_ByteString_init(&_continuation);
+    UA_HistoryReadResponse_init(&_response);
+}
+
+/*!
+    \brief Open62541::HistoryReader::~HistoryReader
+*/
+Open62541::HistoryReader::~HistoryReader()
+{
+    close();
+    UA_HistoryReadResponse_clear(&_response);
+}
+
+/*!
+    \brief Open62541::HistoryReader::request
+    Send a raw read of the node from the continuation point - the response is left in _response
+    \param release release the continuation point instead of reading
+    \return true if the service succeeded
+*/
+bool Open62541::HistoryReader::request(bool release)
+{
+    UA_HistoryReadResponse_clear(&_response);
+    UA_ReadRawModifiedDetails details;
+    UA_ReadRawModifiedDetails_init(&details);
+    details.startTime        = _start;
+    details.endTime          = _end;
+    details.numValuesPerNode = UA_UInt32(_pageSize);
+    details.returnBounds     = _returnBounds;
+    //
+    UA_HistoryReadValueId item;  // borrows the node and continuation point - not cleared
+    UA_HistoryReadValueId_init(&item);
+    item.nodeId            = *_nodeId.constRef();
+    item.continuationPoint = _continuation;
+    //
+    UA_HistoryReadRequest request;
+    UA_HistoryReadRequest_init(&request);
+    request.historyReadDetails.encoding             = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+    request.historyReadDetails.content.decoded.type = &UA_TYPES[UA_TYPES_READRAWMODIFIEDDETAILS];
+    request.historyReadDetails.content.decoded.data = &details;
+    request.timestampsToReturn                      = _timestamps;
+    request.releaseContinuationPoints               = release;
+    request.nodesToRead                             = &item;
+    request.nodesToReadSize                         = 1;
+    return _client.historyRead(request, _response);
+}
+
+/*!
+    \brief Open62541::HistoryReader::fetch
+    Read the next page
+    \return values of the page or null if it has none
+*/
+const UA_HistoryData* Open62541::HistoryReader::fetch()
+{
+    bool ok = request(false);
+    _pages++;
+    UA_ByteString_clear(&_continuation);
+    _done = true;
+    if (!ok) {
+        _lastError = _client.lastError();
+        return nullptr;
+    }
+    if (_response.resultsSize != 1) {
+        _lastError = UA_STATUSCODE_BADUNEXPECTEDERROR;
+        return nullptr;
+    }
+    UA_HistoryReadResult& r = _response.results[0];
+    _lastError              = r.statusCode;
+    if (UA_StatusCode_isBad(r.statusCode))
+        return nullptr;
+    if (r.continuationPoint.length > 0) {
+        _continuation              = r.continuationPoint;  // take it over
+        r.continuationPoint.data   = nullptr;
+        r.continuationPoint.length = 0;
+        _done                      = false;
+    }
+    if ((r.historyData.encoding < UA_EXTENSIONOBJECT_DECODED) ||
+        (r.historyData.content.decoded.type != &UA_TYPES[UA_TYPES_HISTORYDATA]))
+        return nullptr;
+    return static_cast<const UA_HistoryData*>(r.historyData.content.decoded.data);
+}
+
+/*!
+    \brief Open62541::HistoryReader::close
+*/
+void Open62541::HistoryReader::close()
+{
+    if (_continuation.length > 0) {
+        request(true);
+        UA_HistoryReadResponse_clear(&_response);
+        UA_ByteString_clear(&_continuation);
+    }
+    _done = true;
+}
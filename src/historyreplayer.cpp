@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/historyreplayer.h>
+#include <open62541cpp/open62541server.h>
+#include <chrono>
+#include <queue>
+
+/*!
+    \brief Open62541::HistoryReplayer::HistoryReplayer
+    \param server
+    \param backend
+    \param name
+*/
+Open62541::HistoryReplayer::HistoryReplayer(Server& server,
+                                            const UA_HistoryDataBackend& backend,
+                                            const std::string& name)
+    : _server(server)
+    , _reader(backend, server.server())
+    , _name(name)
+    , _outbox(std::make_shared<Outbox>())
+{
+    _outbox->owner = this;
+}
+
+/*!
+    \brief Open62541::HistoryReplayer::~HistoryReplayer
+*/
+Open62541::HistoryReplayer::~HistoryReplayer()
+{
+    stop();
+    std::lock_guard<std::mutex> l(_outbox->mutex);
+    _outbox->owner = nullptr;
+}
+
+/*!
+    \brief Open62541::HistoryReplayer::attach
+*/
+void Open62541::HistoryReplayer::attach()
+{
+    OutboxRef o = _outbox;
+    _server.addProcessHandler(_name, [o](Server& s) { apply(s, *o); });
+}
+
+/*!
+    \brief Open62541::HistoryReplayer::detach
+*/
+void Open62541::HistoryReplayer::detach()
+{
+    _server.removeProcessHandler(_name);
+}
+
+/*!
+    \brief Open62541::HistoryReplayer::apply
+    Write the released values - runs in the server thread
+    \param server
+    \param o
+*/
+void Open62541::HistoryReplayer::apply(Server& server, Outbox& o)
+{
+    std::lock_guard<std::mutex> l(o.mutex);
+    if (o.values.empty())
+        return;
+    for (auto& i : o.values) {
+        if (o.owner) {
+            bool ok = server.writeDataValue(i.first, i.second);
+            if (ok)
+                o.owner->_written++;
+            else
+                o.owner->_failed++;
+            o.owner->replayed(i.first, i.second, ok);
+        }
+        UA_DataValue_clear(&i.second);
+    }
+    o.pending -= std::min(o.pending, o.values.size());
+    o.values.clear();
+    o.drained.notify_all();
+}
+
+/*!
+    \brief Open62541::HistoryReplayer::release
+    Hand a value to the server loop - waits while a page of values is already waiting
+    \param target
+    \param v value - taken over
+    \return false if the replay was stopped
+*/
+bool Open62541::HistoryReplayer::release(const NodeId& target, UA_DataValue& v)
+{
+    std::unique_lock<std::mutex> l(_outbox->mutex);
+    _outbox->drained.wait(l, [this] { return (_outbox->pending < _pageSize) || !_running; });
+    if (!_running)
+        return false;
+    _outbox->values.emplace_back(target, v);
+    UA_DataValue_init(&v);  // owned by the outbox
+    _outbox->pending++;
+    return true;
+}
+
+/*!
+    \brief Open62541::HistoryReplayer::addNode
+    \param source
+    \param target
+*/
+void Open62541::HistoryReplayer::addNode(const NodeId& source, const NodeId& target)
+{
+    if (_running)
+        return;
+    Channel c;
+    c.source = source;
+    c.target = target.isNull() ? source : target;
+    _channels.push_back(std::move(c));
+}
+
+/*!
+    \brief Open62541::HistoryReplayer::clearNodes
+*/
+void Open62541::HistoryReplayer::clearNodes()
+{
+    if (!_running)
+        _channels.clear();
+}
+
+/*!
+    \brief Open62541::HistoryReplayer::fetch
+    Read the next page of a node. Pages carry on from the time of the last record read - records at that time that
+    were in the previous page are skipped
+    \param c
+    \return true if the page holds records
+*/
+bool Open62541::HistoryReplayer::fetch(Channel& c)
+{
+    c.page.clear();
+    c.next      = 0;
+    size_t skip = c.skip;
+    _reader.readNode(c.source, c.from, _end, [&](const NodeId&, const FileHistoryRecord* r, size_t k) {
+        for (; (k > 0) && (skip > 0) && (r->timestamp == c.from); r++, k--)
+            skip--;
+        k = std::min(k, _pageSize - c.page.size());  // runs can be longer than a page
+        c.page.insert(c.page.end(), r, r + k);
+        return c.page.size() < _pageSize;
+    });
+    if (c.page.empty()) {
+        c.done = true;
+        if (!_reader.lastOK())
+            _lastError = _reader.lastError();
+        return false;
+    }
+    UA_DateTime last = c.page.back().timestamp;
+    size_t same      = 0;
+    for (auto i = c.page.rbegin(); (i != c.page.rend()) && (i->timestamp == last); i++)
+        same++;
+    c.skip = same + ((last == c.from) ? c.skip : 0);
+    c.from = last;
+    return true;
+}
+
+/*!
+    \brief Open62541::HistoryReplayer::replay
+    Merge the channels on their timestamps and write each value when it falls due
+*/
+void Open62541::HistoryReplayer::replay()
+{
+    typedef std::pair<UA_DateTime, size_t> Due;  // recorded time, channel - equal times go in channel order
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> heap;
+    for (size_t i = 0; i < _channels.size(); i++) {
+        Channel& c = _channels[i];
+        c.from     = _start;
+        c.skip     = 0;
+        c.done     = false;
+        if (fetch(c))
+            heap.push(Due(c.page.front().timestamp, i));
+    }
+    //
+    auto begin = std::chrono::steady_clock::now();
+    UA_DataValue v;
+    UA_DataValue_init(&v);
+    while (_running && !heap.empty()) {
+        Due d = heap.top();
+        heap.pop();
+        if (_speed > 0) {
+            // the time the value falls due relative to the start of the replay
+            auto due = begin + std::chrono::nanoseconds(UA_Int64(double(d.first - _start) * 100.0 / _speed));
+            std::unique_lock<std::mutex> l(_wakeMutex);
+            if (_wake.wait_until(l, due, [this] { return !_running; }))
+                break;
+        }
+        Channel& c                 = _channels[d.second];
+        const FileHistoryRecord& r = c.page[c.next++];
+        if (FileHistoryBackend::toDataValue(r, v) == UA_STATUSCODE_GOOD) {
+            if (_retimestamp) {
+                v.sourceTimestamp    = UA_DateTime_now();
+                v.hasSourceTimestamp = true;
+            }
+            v.hasServerTimestamp = false;  // stamped by the server
+            if (!release(c.target, v))
+                break;
+        }
+        else {
+            _failed++;
+        }
+        UA_DataValue_clear(&v);
+        _position = d.first;
+        if ((c.next < c.page.size()) || fetch(c))
+            heap.push(Due(c.page[c.next].timestamp, d.second));
+    }
+    UA_DataValue_clear(&v);
+    {
+        // the replay ends once the server loop has written what was released
+        std::unique_lock<std::mutex> l(_outbox->mutex);
+        _outbox->drained.wait(l, [this] { return (_outbox->pending == 0) || !_running; });
+    }
+    _running = false;
+    finished();
+}
+
+/*!
+    \brief Open62541::HistoryReplayer::start
+    \param start
+    \param end
+    \param speed
+    \return true on success
+*/
+bool Open62541::HistoryReplayer::start(UA_DateTime start, UA_DateTime end, double speed)
+{
+    if (_running)
+        return false;
+    if (_thread.joinable())
+        _thread.join();  // the last replay
+    _start     = start;
+    _end       = end ? end : UA_DateTime_now();  // not the values the replay writes itself
+    _speed     = std::max(0.0, speed);
+    _written   = 0;
+    _failed    = 0;
+    _position  = start;
+    _lastError = UA_STATUSCODE_GOOD;
+    try {
+        _running = true;
+        _thread  = std::thread([this] { replay(); });
+    }
+    catch (...) {
+        _running = false;
+        return false;
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::HistoryReplayer::stop
+    Values released but not yet written are dropped, so no callback runs once this returns
+*/
+void Open62541::HistoryReplayer::stop()
+{
+    if (_running) {
+        {
+            std::lock_guard<std::mutex> l(_wakeMutex);
+            _running = false;
+        }
+        _wake.notify_all();
+        {
+            std::lock_guard<std::mutex> l(_outbox->mutex);  // a thread about to wait on the outbox sees the stop
+        }
+        _outbox->drained.notify_all();
+    }
+    if (_thread.joinable())
+        _thread.join();
+    std::lock_guard<std::mutex> l(_outbox->mutex);  // waits for a write pass in progress
+    for (auto& i : _outbox->values)
+        UA_DataValue_clear(&i.second);
+    _outbox->values.clear();
+    _outbox->pending = 0;
+}
+
+/*!
+    \brief Open62541::HistoryReplayer::wait
+*/
+void Open62541::HistoryReplayer::wait()
+{
+    if (_thread.joinable())
+        _thread.join();
+}
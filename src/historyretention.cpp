@@ -0,0 +1,1096 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/historyretention.h>
+#include <open62541cpp/open62541server.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+/*!
+    \brief floorTime
+    \param t
+    \param resolution
+    \return start of the interval holding t
+*/
+static inline UA_DateTime floorTime(UA_DateTime t, UA_DateTime resolution)
+{
+    return t - (((t % resolution) + resolution) % resolution);
+}
+
+static const UA_DateTime TIME_MIN = std::numeric_limits<UA_DateTime>::min();
+static const UA_DateTime TIME_MAX = std::numeric_limits<UA_DateTime>::max();
+
+/*!
+    \brief Open62541::HistoryRetentionManager::HistoryRetentionManager
+    \param gathering
+    \param directory
+*/
+Open62541::HistoryRetentionManager::HistoryRetentionManager(const UA_HistoryDataGathering& gathering,
+                                                            const std::string& directory)
+    : AggregateHistoryDatabase(gathering)
+    , _directory(directory)
+{
+    ::mkdir(_directory.c_str(), 0775);  // the tier stores report failures
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::~HistoryRetentionManager
+*/
+Open62541::HistoryRetentionManager::~HistoryRetentionManager()
+{
+    stop();
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::addTier
+    \param resolution
+    \param retention
+    \return true on success
+*/
+bool Open62541::HistoryRetentionManager::addTier(UA_DateTime resolution, UA_DateTime retention)
+{
+    if (_timerId || (resolution <= 0))
+        return false;
+    if (!_tiers.empty() &&
+        ((resolution <= _tiers.back()->resolution) || (resolution % _tiers.back()->resolution) != 0))
+        return false;
+    TierPtr t(new Tier);
+    t->resolution = resolution;
+    t->retention  = retention;
+    char name[64];
+    snprintf(name, sizeof(name), "/tier_%lldms", (long long)(resolution / UA_DATETIME_MSEC));
+    t->store.reset(new FileHistoryBackend(_directory + name, 1 << 16));  // rollups are sparse - smaller segments
+    if (!t->store->lastOK())
+        return false;
+    _tiers.push_back(std::move(t));
+    return true;
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::addNode
+    \param n
+*/
+void Open62541::HistoryRetentionManager::addNode(const NodeId& n)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    if (_managed.insert(n).second)
+        _nodes.push_back(n);
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::managed
+    \param n
+    \return true if the node was added
+*/
+bool Open62541::HistoryRetentionManager::managed(const NodeId& n)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    return _managed.find(n) != _managed.end();
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::channel
+    \param n
+    \param c
+    \return channel node id
+*/
+Open62541::NodeId Open62541::HistoryRetentionManager::channel(const NodeId& n, Channel c)
+{
+    static const char* names[NumberChannels] = {"#avg", "#min", "#max", "#count"};
+    return NodeId(n.constRef()->namespaceIndex, toString(*n.constRef()) + names[c]);
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::setWatermark
+    \param n
+    \param tier
+    \param t
+*/
+void Open62541::HistoryRetentionManager::setWatermark(const NodeId& n, size_t tier, UA_DateTime t)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    auto& w = _watermarks[n];
+    if (w.size() < _tiers.size())
+        w.resize(_tiers.size(), 0);
+    w[tier] = std::max(w[tier], t);
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::watermark
+    \param server
+    \param n
+    \param tier
+    \return end of the rolled up data of the node in the tier - 0 if there is none
+*/
+UA_DateTime Open62541::HistoryRetentionManager::watermark(UA_Server* server, const NodeId& n, size_t tier)
+{
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        auto i = _watermarks.find(n);
+        if ((i != _watermarks.end()) && (tier < i->second.size()) && i->second[tier])
+            return i->second[tier];
+    }
+    // not known yet - the end of the last rollup in the store
+    NodeId ch                      = channel(n, AverageChannel);
+    const UA_HistoryDataBackend& b = _tiers[tier]->store->database();
+    size_t end                     = b.getEnd(server, b.context, &UA_NODEID_NULL, nullptr, ch.constRef());
+    size_t last                    = b.getDateTimeMatch(
+        server, b.context, &UA_NODEID_NULL, nullptr, ch.constRef(), TIME_MAX, MATCH_EQUAL_OR_BEFORE);
+    if (last == end)
+        return 0;
+    const UA_DataValue* v = b.getDataValue(server, b.context, &UA_NODEID_NULL, nullptr, ch.constRef(), last);
+    if (!v)
+        return 0;
+    UA_DateTime t = v->sourceTimestamp + _tiers[tier]->resolution;
+    setWatermark(n, tier, t);
+    return t;
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::rawBackend
+    \param server
+    \param n
+    \return the backend holding the raw values of the node or null
+*/
+const UA_HistoryDataBackend* Open62541::HistoryRetentionManager::rawBackend(UA_Server* server, const NodeId& n)
+{
+    if (!gathering().getHistorizingSetting)
+        return nullptr;
+    const UA_HistorizingNodeIdSettings* s =
+        gathering().getHistorizingSetting(server, gathering().context, n.constRef());
+    return s ? &s->historizingBackend : nullptr;
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::readRollups
+    \param server
+    \param n
+    \param tier
+    \param start
+    \param end
+    \param f
+    \return true if there are rollups
+*/
+bool Open62541::HistoryRetentionManager::readRollups(UA_Server* server,
+                                                     const NodeId& n,
+                                                     size_t tier,
+                                                     UA_DateTime start,
+                                                     UA_DateTime end,
+                                                     const std::function<bool(const HistoryRollup*, size_t)>& f)
+{
+    if (tier >= _tiers.size())
+        return false;
+    const UA_HistoryDataBackend& b = _tiers[tier]->store->database();
+    // the channels are written together so are read in step
+    NodeId ch[NumberChannels];
+    std::vector<std::unique_ptr<HistorySampleReader>> readers;
+    for (int c = 0; c < NumberChannels; c++) {
+        ch[c] = channel(n, Channel(c));
+        readers.emplace_back(new HistorySampleReader(server, &UA_NODEID_NULL, nullptr, ch[c].constRef(), b));
+        if (!readers.back()->seek(start, MATCH_EQUAL_OR_AFTER))
+            return false;
+    }
+    size_t block = blockSize();
+    std::vector<UA_DateTime> t(NumberChannels * block);
+    std::vector<UA_Double> v(NumberChannels * block);
+    std::vector<UA_Byte> g(NumberChannels * block);
+    std::vector<HistoryRollup> rows(block);
+    for (bool done = false; !done;) {
+        size_t m = block;
+        for (int c = 0; c < NumberChannels; c++) {
+            size_t got = readers[c]->read(&t[c * block], &v[c * block], &g[c * block], block);
+            if (got != m)
+                done = true;
+            m = std::min(m, got);
+        }
+        for (size_t j = 0; j < m; j++) {
+            UA_DateTime time = t[j];
+            if ((time >= end) || (t[block + j] != time) || (t[2 * block + j] != time) || (t[3 * block + j] != time)) {
+                m    = j;
+                done = true;
+                break;
+            }
+            rows[j].time    = time;
+            rows[j].average = v[j];
+            rows[j].minimum = v[block + j];
+            rows[j].maximum = v[2 * block + j];
+            rows[j].count   = v[3 * block + j];
+        }
+        if (m && !f(rows.data(), m))
+            break;
+        if (!m)
+            done = true;
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::rollup
+    Roll up the completed intervals of a node into a tier - from the raw values for the first tier, from the tier
+    below for the others. An interval is complete once a value at or after its end has been seen.
+    \param server
+    \param n
+    \param tier
+    \return number of rollups written
+*/
+size_t Open62541::HistoryRetentionManager::rollup(UA_Server* server, const NodeId& n, size_t tier)
+{
+    UA_DateTime resolution    = _tiers[tier]->resolution;
+    UA_DateTime from          = watermark(server, n, tier);
+    FileHistoryBackend& store = *_tiers[tier]->store;
+    NodeId ch[NumberChannels];
+    for (int c = 0; c < NumberChannels; c++)
+        ch[c] = channel(n, Channel(c));
+    //
+    size_t written = 0;
+    bool open      = false;
+    HistoryRollup current;
+    UA_Double sum = 0.0;
+    auto emit     = [&]() {
+        current.average = sum / current.count;
+        UA_Double values[NumberChannels] = {current.average, current.minimum, current.maximum, current.count};
+        for (int c = 0; c < NumberChannels; c++) {
+            UA_DataValue dv;
+            UA_DataValue_init(&dv);
+            UA_Variant_setScalar(&dv.value, &values[c], &UA_TYPES[UA_TYPES_DOUBLE]);  // copied by add
+            dv.hasValue           = true;
+            dv.sourceTimestamp    = current.time;
+            dv.hasSourceTimestamp = true;
+            store.add(ch[c], dv);
+        }
+        setWatermark(n, tier, current.time + resolution);
+        written++;
+    };
+    auto add = [&](UA_DateTime t, UA_Double average, UA_Double minimum, UA_Double maximum, UA_Double count) {
+        if (t < from)
+            return;
+        if (open && (t >= current.time + resolution)) {
+            emit();
+            open = false;
+        }
+        if (!open) {
+            current.time    = floorTime(t, resolution);
+            current.minimum = minimum;
+            current.maximum = maximum;
+            current.count   = 0.0;
+            sum             = 0.0;
+            open            = true;
+        }
+        sum += average * count;
+        current.count += count;
+        current.minimum = std::min(current.minimum, minimum);
+        current.maximum = std::max(current.maximum, maximum);
+    };
+    //
+    if (tier == 0) {
+        const UA_HistoryDataBackend* raw = rawBackend(server, n);
+        if (!raw)
+            return 0;
+        HistorySampleReader reader(server, &UA_NODEID_NULL, nullptr, n.constRef(), *raw);
+        if (reader.seek(from, MATCH_EQUAL_OR_AFTER)) {
+            size_t block = blockSize();
+            std::vector<UA_DateTime> t(block);
+            std::vector<UA_Double> v(block);
+            std::vector<UA_Byte> g(block);
+            for (size_t m; (m = reader.read(t.data(), v.data(), g.data(), block)) > 0;) {
+                for (size_t j = 0; j < m; j++) {
+                    if (g[j])
+                        add(t[j], v[j], v[j], v[j], 1.0);
+                }
+            }
+        }
+    }
+    else {
+        readRollups(server, n, tier - 1, from, TIME_MAX, [&](const HistoryRollup* r, size_t m) {
+            for (size_t j = 0; j < m; j++)
+                add(r[j].time, r[j].average, r[j].minimum, r[j].maximum, r[j].count);
+            return true;
+        });
+    }
+    return written;  // the open interval is rolled up by a later pass
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::expire
+    Delete expired raw values and rollups - only data already rolled up into the next tier
+    \param server
+    \param n
+    \param now
+*/
+void Open62541::HistoryRetentionManager::expire(UA_Server* server, const NodeId& n, UA_DateTime now)
+{
+    auto remove = [&](const UA_HistoryDataBackend& b, const UA_NodeId* id, UA_DateTime cutoff) {
+        if (b.removeDataValue && (cutoff > 0))
+            b.removeDataValue(server, b.context, &UA_NODEID_NULL, nullptr, id, TIME_MIN, cutoff);
+    };
+    if (_rawRetention > 0) {
+        UA_DateTime cutoff = now - _rawRetention;
+        if (!_tiers.empty())
+            cutoff = std::min(cutoff, watermark(server, n, 0));
+        const UA_HistoryDataBackend* raw = rawBackend(server, n);
+        if (raw)
+            remove(*raw, n.constRef(), cutoff);
+    }
+    for (size_t k = 0; k < _tiers.size(); k++) {
+        if (_tiers[k]->retention <= 0)
+            continue;
+        UA_DateTime cutoff = now - _tiers[k]->retention;
+        if (k + 1 < _tiers.size())
+            cutoff = std::min(cutoff, watermark(server, n, k + 1));
+        for (int c = 0; c < NumberChannels; c++) {
+            NodeId ch = channel(n, Channel(c));
+            remove(_tiers[k]->store->database(), ch.constRef(), cutoff);
+        }
+    }
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::process
+    \param server
+    \return number of rollups written
+*/
+size_t Open62541::HistoryRetentionManager::process(Server& server)
+{
+    std::lock_guard<std::mutex> pl(_processMutex);
+    std::vector<NodeId> nodes;
+    {
+        std::lock_guard<std::mutex> l(_mutex);
+        nodes = _nodes;
+    }
+    UA_Server* s    = server.server();
+    UA_DateTime now = UA_DateTime_now();
+    size_t n        = 0;
+    std::vector<FileHistoryBackend*> rawStores;
+    for (auto& node : nodes) {
+        for (size_t k = 0; k < _tiers.size(); k++)
+            n += rollup(s, node, k);
+        expire(s, node, now);
+        const UA_HistoryDataBackend* raw = rawBackend(s, node);
+        if (raw) {
+            FileHistoryBackend* f = dynamic_cast<FileHistoryBackend*>(HistoryDataBackend::fromBackend(*raw));
+            if (f && (std::find(rawStores.begin(), rawStores.end(), f) == rawStores.end()))
+                rawStores.push_back(f);
+        }
+    }
+    for (auto& t : _tiers) {
+        t->store->flush(false);
+        t->store->compact();
+    }
+    for (auto f : rawStores)
+        f->compact();
+    _rollups += n;
+    return n;
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::start
+    \param server
+    \param interval_ms
+    \return true on success
+*/
+bool Open62541::HistoryRetentionManager::start(Server& server, unsigned interval_ms)
+{
+    if (_timerId)
+        return true;
+    _server = &server;
+    return server.addRepeatedTimerEvent(UA_Double(interval_ms), _timerId, [this](Server::Timer&) {
+        if (_server)
+            process(*_server);
+    });
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::stop
+*/
+void Open62541::HistoryRetentionManager::stop()
+{
+    if (_server && _timerId)
+        _server->removeTimerEvent(_timerId);
+    _timerId = 0;
+    _server  = nullptr;
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::deleteMembers
+*/
+void Open62541::HistoryRetentionManager::deleteMembers()
+{
+    stop();
+    AggregateHistoryDatabase::deleteMembers();
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::rawCutoff
+    \param server
+    \param n
+    \return raw values are held from this time - earlier times are answered from the tiers
+*/
+UA_DateTime Open62541::HistoryRetentionManager::rawCutoff(UA_Server* server, const NodeId& n)
+{
+    if (_tiers.empty() || (_rawRetention <= 0))
+        return TIME_MIN;
+    // the cutoff expire() uses - nothing is deleted that is not rolled up into the first tier
+    return std::min(UA_DateTime_now() - _rawRetention, watermark(server, n, 0));
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::readTiers
+    Averages of the rollups starting in [from, to) - each time from the finest tier holding it
+    \param server
+    \param n
+    \param from
+    \param to
+    \param reverse latest first
+    \param limit most results
+    \param r receives the results
+    \return number of results
+*/
+size_t Open62541::HistoryRetentionManager::readTiers(UA_Server* server,
+                                                     const NodeId& n,
+                                                     UA_DateTime from,
+                                                     UA_DateTime to,
+                                                     bool reverse,
+                                                     size_t limit,
+                                                     std::vector<HistoryAggregate::Result>& r)
+{
+    r.clear();
+    // tier k holds [first[k], last[k]) - what expire() has left and rollup() has written
+    UA_DateTime now = UA_DateTime_now();
+    size_t tiers    = _tiers.size();
+    std::vector<UA_DateTime> first(tiers, TIME_MIN), last(tiers, 0);
+    for (size_t k = 0; k < tiers; k++) {
+        last[k] = watermark(server, n, k);
+        if (_tiers[k]->retention > 0)
+            first[k] = std::min(now - _tiers[k]->retention, (k + 1 < tiers) ? watermark(server, n, k + 1) : TIME_MAX);
+    }
+    struct Segment {
+        size_t tier;
+        UA_DateTime from;
+        UA_DateTime to;
+    };
+    std::vector<Segment> segments;
+    for (UA_DateTime t = from; t < to;) {
+        size_t k = 0;
+        while ((k < tiers) && !((first[k] <= t) && (t < last[k])))
+            k++;
+        UA_DateTime next = to;
+        for (size_t j = 0; j < std::min(k, tiers); j++) {
+            if ((first[j] > t) && (first[j] < last[j]))
+                next = std::min(next, first[j]);  // a finer tier takes over
+        }
+        if (k < tiers) {
+            next = std::min(next, last[k]);
+            segments.push_back(Segment{k, t, next});
+        }
+        else {
+            for (size_t j = 0; j < tiers; j++) {
+                if ((first[j] > t) && (first[j] < last[j]))
+                    next = std::min(next, first[j]);  // no tier holds t - skip to the next that starts
+            }
+        }
+        t = next;
+    }
+    //
+    std::vector<HistoryAggregate::Result> block;
+    for (size_t i = 0; (i < segments.size()) && (r.size() < limit); i++) {
+        const Segment& g = segments[reverse ? segments.size() - 1 - i : i];
+        block.clear();
+        readRollups(server, n, g.tier, g.from, g.to, [&](const HistoryRollup* rows, size_t m) {
+            for (size_t j = 0; j < m; j++) {
+                HistoryAggregate::Result v;
+                v.time   = rows[j].time;
+                v.value  = rows[j].average;
+                v.status = HistoryAggregate::Calculated;
+                block.push_back(v);
+            }
+            return reverse || (r.size() + block.size() < limit);
+        });
+        if (reverse)
+            std::reverse(block.begin(), block.end());
+        block.resize(std::min(block.size(), limit - r.size()));
+        r.insert(r.end(), block.begin(), block.end());
+    }
+    return r.size();
+}
+
+/*!
+    \brief filterTimestamps
+    \param d
+    \param ts timestamps to return
+*/
+static void filterTimestamps(UA_DataValue& d, UA_TimestampsToReturn ts)
+{
+    if ((ts == UA_TIMESTAMPSTORETURN_SERVER) || (ts == UA_TIMESTAMPSTORETURN_NEITHER)) {
+        d.hasSourceTimestamp = false;
+        d.sourceTimestamp    = 0;
+    }
+    if ((ts == UA_TIMESTAMPSTORETURN_SOURCE) || (ts == UA_TIMESTAMPSTORETURN_NEITHER)) {
+        d.hasServerTimestamp = false;
+        d.serverTimestamp    = 0;
+    }
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::boundValue
+    The value of a node nearest a bound - from the raw values at or after the raw cutoff, otherwise from the tiers
+    \param server
+    \param n
+    \param split raw cutoff of the read
+    \param t bound
+    \param strategy
+    \param v receives a copy of the value
+    \return true if there is one
+*/
+bool Open62541::HistoryRetentionManager::boundValue(UA_Server* server,
+                                                    const NodeId& n,
+                                                    UA_DateTime split,
+                                                    UA_DateTime t,
+                                                    MatchStrategy strategy,
+                                                    UA_DataValue& v)
+{
+    auto find = [&](const UA_HistoryDataBackend& b, const UA_NodeId* id) {
+        if (!b.getDateTimeMatch || !b.getEnd || !b.getDataValue)
+            return false;
+        size_t end = b.getEnd(server, b.context, &UA_NODEID_NULL, nullptr, id);
+        size_t i   = b.getDateTimeMatch(server, b.context, &UA_NODEID_NULL, nullptr, id, t, strategy);
+        if (i == end)
+            return false;
+        const UA_DataValue* d = b.getDataValue(server, b.context, &UA_NODEID_NULL, nullptr, id, i);
+        return d && (UA_DataValue_copy(d, &v) == UA_STATUSCODE_GOOD);
+    };
+    auto raw = [&]() {
+        const UA_HistoryDataBackend* b = rawBackend(server, n);
+        return b && find(*b, n.constRef());
+    };
+    auto tiers = [&]() {
+        NodeId ch = channel(n, AverageChannel);
+        for (auto& k : _tiers) {
+            if (find(k->store->database(), ch.constRef())) {
+                v.status    = HistoryAggregate::Calculated;
+                v.hasStatus = true;
+                return true;
+            }
+        }
+        return false;
+    };
+    return (t >= split) ? (raw() || tiers()) : (tiers() || raw());
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::processedTier
+    \param server
+    \param n
+    \param type
+    \param start
+    \param end
+    \param interval
+    \return the coarsest tier that can answer the request, -1 for the raw values
+*/
+int Open62541::HistoryRetentionManager::processedTier(UA_Server* server,
+                                                      const NodeId& n,
+                                                      HistoryAggregate::Type type,
+                                                      UA_DateTime start,
+                                                      UA_DateTime end,
+                                                      UA_DateTime interval)
+{
+    switch (type) {
+        case HistoryAggregate::Interpolative:
+        case HistoryAggregate::Average:
+        case HistoryAggregate::TimeAverage:
+        case HistoryAggregate::Minimum:
+        case HistoryAggregate::Maximum:
+        case HistoryAggregate::Range:
+        case HistoryAggregate::Count:
+            break;
+        default:
+            return -1;  // not computable from rollups - calculated from the raw values
+    }
+    UA_DateTime now = UA_DateTime_now();
+    for (int k = int(_tiers.size()) - 1; k >= 0; k--) {
+        const Tier& t = *_tiers[k];
+        // intervals must be whole numbers of aligned rollups - the last rollup must not reach past the end
+        if ((t.resolution > interval) || (interval % t.resolution) || (floorTime(start, t.resolution) != start) ||
+            (floorTime(end, t.resolution) != end))
+            continue;
+        if ((t.retention > 0) && (start < now - t.retention))
+            continue;
+        if (end > watermark(server, n, size_t(k)))
+            continue;  // not rolled up yet
+        return k;
+    }
+    return -1;
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::processTier
+    Aggregates from rollups. Average, Minimum, Maximum, Range and Count are exact. Interpolative and TimeAverage are
+    calculated from the interval averages placed at the middle of each rollup.
+    \return status of the node result
+*/
+UA_StatusCode Open62541::HistoryRetentionManager::processTier(Context& c,
+                                                              const UA_NodeId& nodeId,
+                                                              HistoryAggregate::Type type,
+                                                              UA_DateTime start,
+                                                              UA_DateTime end,
+                                                              UA_DateTime interval,
+                                                              bool reverse,
+                                                              size_t tier,
+                                                              UA_TimestampsToReturn timestampsToReturn,
+                                                              UA_HistoryData* result)
+{
+    size_t count = HistoryAggregate::intervals(start, end, interval);
+    if (count > maxIntervals())
+        return UA_STATUSCODE_BADTOOMANYOPERATIONS;
+    UA_Server* server      = c.server.server();
+    UA_DateTime resolution = _tiers[tier]->resolution;
+    NodeId n(nodeId);
+    std::vector<HistoryAggregate::Result> results;
+    if ((type == HistoryAggregate::Interpolative) || (type == HistoryAggregate::TimeAverage)) {
+        HistoryAggregate a(type, start, end, interval);
+        std::vector<UA_DateTime> t;
+        std::vector<UA_Double> v;
+        readRollups(server, n, tier, start - resolution, TIME_MAX, [&](const HistoryRollup* r, size_t m) {
+            t.resize(m);
+            v.resize(m);
+            for (size_t j = 0; j < m; j++) {
+                t[j] = r[j].time + resolution / 2;
+                v[j] = r[j].average;
+            }
+            a.add(t.data(), v.data(), m);
+            return !a.done();
+        });
+        a.finish();
+        results = a.results();
+    }
+    else {
+        results.resize(count);
+        std::vector<UA_Double> sum(count, 0.0), number(count, 0.0), minimum(count, 0.0), maximum(count, 0.0);
+        readRollups(server, n, tier, start, end, [&](const HistoryRollup* r, size_t m) {
+            for (size_t j = 0; j < m; j++) {
+                size_t k = size_t((r[j].time - start) / interval);
+                if (k >= count)
+                    return false;
+                minimum[k] = number[k] ? std::min(minimum[k], r[j].minimum) : r[j].minimum;
+                maximum[k] = number[k] ? std::max(maximum[k], r[j].maximum) : r[j].maximum;
+                sum[k] += r[j].average * r[j].count;
+                number[k] += r[j].count;
+            }
+            return true;
+        });
+        for (size_t k = 0; k < count; k++) {
+            HistoryAggregate::Result& r = results[k];
+            r.time                       = start + UA_DateTime(k) * interval;
+            UA_StatusCode status         = HistoryAggregate::Calculated;
+            if (std::min(r.time + interval, end) - r.time < interval)
+                status |= HistoryAggregate::Partial;
+            if ((type != HistoryAggregate::Count) && !number[k])
+                continue;  // no data
+            r.status = status;
+            switch (type) {
+                case HistoryAggregate::Count:
+                    r.value = number[k];
+                    break;
+                case HistoryAggregate::Average:
+                    r.value = sum[k] / number[k];
+                    break;
+                case HistoryAggregate::Minimum:
+                    r.value = minimum[k];
+                    break;
+                case HistoryAggregate::Maximum:
+                    r.value = maximum[k];
+                    break;
+                case HistoryAggregate::Range:
+                    r.value = maximum[k] - minimum[k];
+                    break;
+                default:
+                    r.status = UA_STATUSCODE_BADAGGREGATENOTSUPPORTED;
+                    break;
+            }
+        }
+    }
+    return toHistoryData(results, reverse, type == HistoryAggregate::Count, timestampsToReturn, result);
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::readProcessed
+*/
+void Open62541::HistoryRetentionManager::readProcessed(Context& c,
+                                                       const UA_RequestHeader* requestHeader,
+                                                       const UA_ReadProcessedDetails* historyReadDetails,
+                                                       UA_TimestampsToReturn timestampsToReturn,
+                                                       UA_Boolean releaseContinuationPoints,
+                                                       size_t nodesToReadSize,
+                                                       const UA_HistoryReadValueId* nodesToRead,
+                                                       UA_HistoryReadResponse* response,
+                                                       UA_HistoryData* const* const historyData)
+{
+    if (releaseContinuationPoints || !historyReadDetails || _tiers.empty() ||
+        (historyReadDetails->aggregateTypeSize != nodesToReadSize)) {
+        AggregateHistoryDatabase::readProcessed(c,
+                                                requestHeader,
+                                                historyReadDetails,
+                                                timestampsToReturn,
+                                                releaseContinuationPoints,
+                                                nodesToReadSize,
+                                                nodesToRead,
+                                                response,
+                                                historyData);
+        return;
+    }
+    UA_DateTime start = historyReadDetails->startTime;
+    UA_DateTime end   = historyReadDetails->endTime;
+    bool reverse      = start > end;
+    if (reverse)
+        std::swap(start, end);
+    UA_DateTime interval = UA_DateTime(historyReadDetails->processingInterval * UA_DATETIME_MSEC);
+    if (interval <= 0)
+        interval = end - start;
+    for (size_t i = 0; (i < nodesToReadSize) && (i < response->resultsSize); i++) {
+        HistoryAggregate::Type type = HistoryAggregate::type(historyReadDetails->aggregateType[i]);
+        int k = -1;
+        if ((type != HistoryAggregate::Unsupported) && (start < end))
+            k = processedTier(c.server.server(), NodeId(nodesToRead[i].nodeId), type, start, end, interval);
+        if (k < 0) {
+            response->results[i].statusCode = processNode(c,
+                                                          nodesToRead[i].nodeId,
+                                                          historyReadDetails->aggregateType[i],
+                                                          historyReadDetails,
+                                                          timestampsToReturn,
+                                                          historyData[i]);
+        }
+        else {
+            response->results[i].statusCode = processTier(c,
+                                                          nodesToRead[i].nodeId,
+                                                          type,
+                                                          start,
+                                                          end,
+                                                          interval,
+                                                          reverse,
+                                                          size_t(k),
+                                                          timestampsToReturn,
+                                                          historyData[i]);
+        }
+    }
+}
+
+
+/*!
+    \brief Open62541::HistoryRetentionManager::readRawDefault
+    ReadRaw of one node from the raw values
+    \param c
+    \param requestHeader
+    \param details
+    \param timestampsToReturn
+    \param releaseContinuationPoints
+    \param item
+    \param result
+    \param data
+*/
+void Open62541::HistoryRetentionManager::readRawDefault(Context& c,
+                                                        const UA_RequestHeader* requestHeader,
+                                                        const UA_ReadRawModifiedDetails& details,
+                                                        UA_TimestampsToReturn timestampsToReturn,
+                                                        UA_Boolean releaseContinuationPoints,
+                                                        const UA_HistoryReadValueId& item,
+                                                        UA_HistoryReadResult& result,
+                                                        UA_HistoryData* data)
+{
+    UA_HistoryReadResponse r;  // borrows the result - not cleared
+    UA_HistoryReadResponse_init(&r);
+    r.results            = &result;
+    r.resultsSize        = 1;
+    UA_HistoryData* d[1] = {data};
+    AggregateHistoryDatabase::readRaw(
+        c, requestHeader, &details, timestampsToReturn, releaseContinuationPoints, 1, &item, &r, d);
+    if (!UA_StatusCode_isBad(result.statusCode) && UA_StatusCode_isBad(r.responseHeader.serviceResult))
+        result.statusCode = r.responseHeader.serviceResult;
+    r.results     = nullptr;
+    r.resultsSize = 0;
+    UA_HistoryReadResponse_clear(&r);
+}
+
+namespace {
+/*!
+    \brief The RetentionPosition struct
+    Continuation point of a managed node - the raw cutoff is fixed for the whole read
+*/
+struct RetentionPosition {
+    enum { RollupPhase = 0, RawPhase = 1 };
+    UA_Byte phase        = RollupPhase;
+    UA_DateTime split    = 0;  // raw cutoff
+    UA_DateTime position = 0;  // next rollup time - the first time forward, the time after the next reverse
+    std::string inner;         // continuation point of the raw values
+
+    static const char magic = 'R';
+
+    std::string encode() const
+    {
+        std::string s(1, magic);
+        s += char(phase);
+        s.append(reinterpret_cast<const char*>(&split), sizeof(split));
+        s.append(reinterpret_cast<const char*>(&position), sizeof(position));
+        return s + inner;
+    }
+
+    bool decode(const UA_ByteString& b)
+    {
+        const size_t header = 2 + sizeof(split) + sizeof(position);
+        if ((b.length < header) || (b.data[0] != magic) || (b.data[1] > RawPhase))
+            return false;
+        phase = b.data[1];
+        memcpy(&split, b.data + 2, sizeof(split));
+        memcpy(&position, b.data + 2 + sizeof(split), sizeof(position));
+        inner.assign(reinterpret_cast<const char*>(b.data + header), b.length - header);
+        return true;
+    }
+};
+}  // namespace
+
+/*!
+    \brief Open62541::HistoryRetentionManager::readRawTiered
+    ReadRaw of a managed node. The range is split at the raw cutoff - rollup averages before it and raw values from
+    it, in the direction of the read. Bounds are found in whichever holds them
+    \return status of the node result
+*/
+UA_StatusCode Open62541::HistoryRetentionManager::readRawTiered(Context& c,
+                                                                const UA_RequestHeader* requestHeader,
+                                                                const UA_ReadRawModifiedDetails& details,
+                                                                UA_TimestampsToReturn timestampsToReturn,
+                                                                UA_Boolean releaseContinuationPoints,
+                                                                const UA_HistoryReadValueId& item,
+                                                                UA_HistoryReadResult& result,
+                                                                UA_HistoryData* data)
+{
+    UA_Server* server = c.server.server();
+    NodeId n(item.nodeId);
+    UA_DateTime start = details.startTime;
+    UA_DateTime end   = details.endTime ? details.endTime : UA_DateTime_now();
+    bool reverse      = start > end;
+    bool first        = (item.continuationPoint.length == 0);
+    RetentionPosition p;
+    if (!first && !p.decode(item.continuationPoint))
+        return UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+    //
+    // the raw values - forward [max(start, split), end), reverse [max(end + 1, split), start]
+    UA_HistoryReadValueId rawItem = item;  // borrows
+    UA_ReadRawModifiedDetails raw = details;
+    raw.returnBounds              = false;  // bounds are added here
+    raw.endTime                   = end;
+    auto readRawValues = [&](UA_UInt32 limit, UA_HistoryReadResult& r, UA_HistoryData* d) {
+        if (reverse)
+            raw.endTime = std::max(end, (p.split > TIME_MIN) ? p.split - 1 : TIME_MIN);
+        else
+            raw.startTime = std::max(start, p.split);
+        raw.numValuesPerNode             = limit;
+        rawItem.continuationPoint.data   = p.inner.empty() ? nullptr : (UA_Byte*)(p.inner.data());
+        rawItem.continuationPoint.length = p.inner.size();
+        readRawDefault(c, requestHeader, raw, timestampsToReturn, releaseContinuationPoints, rawItem, r, d);
+    };
+    if (first) {
+        p.split = rawCutoff(server, n);
+        if (reverse) {
+            p.phase    = (start >= p.split) ? RetentionPosition::RawPhase : RetentionPosition::RollupPhase;
+            p.position = std::min(start + 1, p.split);
+        }
+        else {
+            p.phase    = (start < p.split) ? RetentionPosition::RollupPhase : RetentionPosition::RawPhase;
+            p.position = start;
+        }
+    }
+    if (releaseContinuationPoints) {
+        if ((p.phase == RetentionPosition::RawPhase) && !p.inner.empty()) {
+            UA_HistoryReadResult r;
+            UA_HistoryReadResult_init(&r);
+            UA_HistoryData d;
+            UA_HistoryData_init(&d);
+            readRawValues(0, r, &d);
+            UA_HistoryData_clear(&d);
+            UA_HistoryReadResult_clear(&r);
+        }
+        return UA_STATUSCODE_GOOD;
+    }
+    //
+    bool rawPart    = reverse ? (start >= p.split) : (end > std::max(start, p.split));
+    bool rollupPart = reverse ? (end + 1 < std::min(start + 1, p.split)) : (start < std::min(end, p.split));
+    size_t limit    = details.numValuesPerNode ? details.numValuesPerNode : maxIntervals();
+    size_t want     = limit;
+    bool more       = false;
+    std::vector<UA_DataValue> out;
+    auto take = [&](UA_HistoryData& d) {
+        for (size_t i = 0; i < d.dataValuesSize; i++)
+            out.push_back(d.dataValues[i]);  // moved
+        UA_Array_delete(d.dataValues, 0, &UA_TYPES[UA_TYPES_DATAVALUE]);  // frees the array only
+        d.dataValues     = nullptr;
+        d.dataValuesSize = 0;
+    };
+    auto discard = [&]() {
+        for (auto& v : out)
+            UA_DataValue_clear(&v);
+    };
+    std::vector<HistoryAggregate::Result> rollups;
+    for (;;) {
+        if (p.phase == RetentionPosition::RollupPhase) {
+            UA_DateTime from = reverse ? end + 1 : p.position;
+            UA_DateTime to   = reverse ? p.position : std::min(end, p.split);
+            readTiers(server, n, from, to, reverse, want + 1, rollups);
+            if (rollups.size() > want) {
+                rollups.resize(want);
+                more = true;
+            }
+            if (!rollups.empty())
+                p.position = reverse ? rollups.back().time : rollups.back().time + 1;
+            want -= rollups.size();
+            UA_HistoryData d;
+            UA_HistoryData_init(&d);
+            UA_StatusCode ret = toHistoryData(rollups, false, false, timestampsToReturn, &d);
+            take(d);
+            if (ret != UA_STATUSCODE_GOOD) {
+                discard();
+                return ret;
+            }
+            if (more || reverse || !rawPart)
+                break;
+            p.phase = RetentionPosition::RawPhase;
+            p.inner.clear();
+        }
+        else {
+            if (!want) {
+                more = true;
+                break;
+            }
+            UA_HistoryReadResult r;
+            UA_HistoryReadResult_init(&r);
+            UA_HistoryData d;
+            UA_HistoryData_init(&d);
+            readRawValues(details.numValuesPerNode ? UA_UInt32(want) : 0, r, &d);
+            UA_StatusCode ret = r.statusCode;
+            want -= std::min(want, d.dataValuesSize);
+            take(d);
+            p.inner.clear();
+            if (r.continuationPoint.length > 0) {
+                p.inner.assign(reinterpret_cast<const char*>(r.continuationPoint.data), r.continuationPoint.length);
+                more = true;
+            }
+            UA_HistoryReadResult_clear(&r);
+            if (UA_StatusCode_isBad(ret)) {
+                discard();
+                return ret;
+            }
+            if (more || !reverse || !rollupPart)
+                break;
+            p.phase = RetentionPosition::RollupPhase;
+            if (!want) {
+                more = true;
+                break;
+            }
+        }
+    }
+    //
+    if (details.returnBounds) {
+        auto bound = [&](UA_DateTime t, MatchStrategy s, bool inclusive) {
+            UA_DataValue v;
+            UA_DataValue_init(&v);
+            if (!boundValue(server, n, p.split, t, s, v)) {
+                v.status             = UA_STATUSCODE_BADBOUNDNOTFOUND;
+                v.hasStatus          = true;
+                v.sourceTimestamp    = t;
+                v.hasSourceTimestamp = true;
+                v.serverTimestamp    = t;
+                v.hasServerTimestamp = true;
+            }
+            else if (inclusive && ((v.hasSourceTimestamp ? v.sourceTimestamp : v.serverTimestamp) == t)) {
+                UA_DataValue_clear(&v);  // the value at the start time is read already
+                return v;
+            }
+            filterTimestamps(v, timestampsToReturn);
+            return v;
+        };
+        if (first) {
+            UA_DataValue v = bound(start, reverse ? MATCH_EQUAL_OR_AFTER : MATCH_EQUAL_OR_BEFORE, true);
+            if (v.hasValue || v.hasStatus)
+                out.insert(out.begin(), v);
+        }
+        if (!more) {
+            UA_DataValue v = bound(end, reverse ? MATCH_EQUAL_OR_BEFORE : MATCH_EQUAL_OR_AFTER, false);
+            out.push_back(v);
+        }
+    }
+    //
+    data->dataValues = static_cast<UA_DataValue*>(UA_Array_new(out.size(), &UA_TYPES[UA_TYPES_DATAVALUE]));
+    if (!data->dataValues && !out.empty()) {
+        discard();
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    for (size_t i = 0; i < out.size(); i++)
+        data->dataValues[i] = out[i];  // moved
+    data->dataValuesSize = out.size();
+    if (more) {
+        // the server owns and frees the continuation point
+        std::string s = p.encode();
+        if (UA_ByteString_allocBuffer(&result.continuationPoint, s.size()) != UA_STATUSCODE_GOOD)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        memcpy(result.continuationPoint.data, s.data(), s.size());
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/*!
+    \brief Open62541::HistoryRetentionManager::readRaw
+    Managed nodes are read across the raw cutoff, others from the raw values
+*/
+void Open62541::HistoryRetentionManager::readRaw(Context& c,
+                                                 const UA_RequestHeader* requestHeader,
+                                                 const UA_ReadRawModifiedDetails* historyReadDetails,
+                                                 UA_TimestampsToReturn timestampsToReturn,
+                                                 UA_Boolean releaseContinuationPoints,
+                                                 size_t nodesToReadSize,
+                                                 const UA_HistoryReadValueId* nodesToRead,
+                                                 UA_HistoryReadResponse* response,
+                                                 UA_HistoryData* const* const historyData)
+{
+    if (!historyReadDetails || historyReadDetails->isReadModified || !historyReadDetails->startTime ||
+        _tiers.empty() || (_rawRetention <= 0)) {
+        AggregateHistoryDatabase::readRaw(c,
+                                          requestHeader,
+                                          historyReadDetails,
+                                          timestampsToReturn,
+                                          releaseContinuationPoints,
+                                          nodesToReadSize,
+                                          nodesToRead,
+                                          response,
+                                          historyData);
+        return;
+    }
+    for (size_t i = 0; (i < nodesToReadSize) && (i < response->resultsSize); i++) {
+        if (managed(NodeId(nodesToRead[i].nodeId))) {
+            response->results[i].statusCode = readRawTiered(c,
+                                                            requestHeader,
+                                                            *historyReadDetails,
+                                                            timestampsToReturn,
+                                                            releaseContinuationPoints,
+                                                            nodesToRead[i],
+                                                            response->results[i],
+                                                            historyData[i]);
+        }
+        else {
+            readRawDefault(c,
+                           requestHeader,
+                           *historyReadDetails,
+                           timestampsToReturn,
+                           releaseContinuationPoints,
+                           nodesToRead[i],
+                           response->results[i],
+                           historyData[i]);
+        }
+    }
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/livevaluetable.h>
+#include <cstring>
+
+/*!
+    \brief Open62541::LiveValueTable::LiveValueTable
+    \param capacity
+*/
+Open62541::LiveValueTable::LiveValueTable(size_t capacity)
+    : _slots(new Slot[std::max<size_t>(1, capacity)])
+    , _capacity(std::max<size_t>(1, capacity))
+{
+    _nodes.reserve(_capacity);
+    for (size_t i = 0; i < _capacity; i++) {
+        for (auto& w : _slots[i].words)
+            w.store(0, std::memory_order_relaxed);
+    }
+}
+
+/*!
+    \brief Open62541::LiveValueTable::add
+    \param n
+    \return slot or npos
+*/
+size_t Open62541::LiveValueTable::add(const NodeId& n)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    auto i = _index.find(n);
+    if (i != _index.end())
+        return i->second;
+    size_t slot = _nodes.size();
+    if (slot >= _capacity)
+        return npos;
+    _nodes.push_back(n);  // within the reserve so readers of other slots are not disturbed
+    _index[n] = slot;
+    _size.store(slot + 1, std::memory_order_release);
+    return slot;
+}
+
+/*!
+    \brief Open62541::LiveValueTable::find
+    \param n
+    \return slot or npos
+*/
+size_t Open62541::LiveValueTable::find(const NodeId& n)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    auto i = _index.find(n);
+    return (i != _index.end()) ? i->second : npos;
+}
+
+/*!
+    \brief Open62541::LiveValueTable::monitor
+    \param s
+    \param n
+    \param slot
+    \return monitored item id or 0
+*/
+unsigned Open62541::LiveValueTable::monitor(ClientSubscription& s, NodeId& n, size_t* slot)
+{
+    size_t k = add(n);
+    if (slot)
+        *slot = k;
+    if (k == npos)
+        return 0;
+    return s.addMonitorNodeId(
+        [this, k](ClientSubscription&, MonitoredItem*, UA_DataValue* v) {
+            if (v)
+                update(k, *v);
+        },
+        n);
+}
+
+/*!
+    \brief Open62541::LiveValueTable::update
+    \param slot
+    \param v
+*/
+void Open62541::LiveValueTable::update(size_t slot, const UA_DataValue& v)
+{
+    if (slot >= size())
+        return;
+    FileHistoryRecord r;
+    if (FileHistoryBackend::toRecord(v, r) != UA_STATUSCODE_GOOD) {
+        // keep the status and timestamps
+        UA_DataValue d = v;  // shallow
+        d.hasValue     = false;
+        FileHistoryBackend::toRecord(d, r);
+        if (!v.hasStatus || (v.status == UA_STATUSCODE_GOOD))
+            r.status = UA_STATUSCODE_BADNOTSUPPORTED;
+        r.flags |= FileHistoryRecord::HasStatus;
+        _unsupported++;
+    }
+    UA_UInt64 words[WORDS] = {};
+    memcpy(words, &r, sizeof(r));
+    //
+    Slot& s     = _slots[slot];
+    UA_UInt64 n = s.version.load(std::memory_order_relaxed);
+    for (;;) {
+        // an even version is unlocked - make it odd to take the slot
+        if (!(n & 1) && s.version.compare_exchange_weak(n, n + 1, std::memory_order_acquire))
+            break;
+        n = s.version.load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < WORDS; i++)
+        s.words[i].store(words[i], std::memory_order_relaxed);
+    s.change.store(_sequence.fetch_add(1, std::memory_order_acq_rel) + 1, std::memory_order_relaxed);
+    s.version.store(n + 2, std::memory_order_release);
+}
+
+/*!
+    \brief Open62541::LiveValueTable::snapshot
+    \param slot
+    \param r
+    \param change
+    \return true on success
+*/
+bool Open62541::LiveValueTable::snapshot(size_t slot, FileHistoryRecord& r, UA_UInt64* change) const
+{
+    if (slot >= size())
+        return false;
+    const Slot& s = _slots[slot];
+    UA_UInt64 words[WORDS];
+    UA_UInt64 c = 0;
+    for (;;) {
+        UA_UInt64 v = s.version.load(std::memory_order_acquire);
+        if (v & 1)
+            continue;  // being written
+        for (size_t i = 0; i < WORDS; i++)
+            words[i] = s.words[i].load(std::memory_order_relaxed);
+        c = s.change.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.version.load(std::memory_order_relaxed) == v)
+            break;
+    }
+    memcpy(&r, words, sizeof(r));
+    if (change)
+        *change = c;
+    return true;
+}
+
+/*!
+    \brief Open62541::LiveValueTable::read
+    \param slot
+    \param v
+    \param change
+    \return true on success
+*/
+bool Open62541::LiveValueTable::read(size_t slot, UA_DataValue& v, UA_UInt64* change) const
+{
+    FileHistoryRecord r;
+    UA_UInt64 c = 0;
+    if (!snapshot(slot, r, &c) || (c == 0))
+        return false;
+    if (change)
+        *change = c;
+    return FileHistoryBackend::toDataValue(r, v) == UA_STATUSCODE_GOOD;
+}
+
+/*!
+    \brief Open62541::LiveValueTable::read
+    \param slot
+    \param v
+    \return true on success
+*/
+bool Open62541::LiveValueTable::read(size_t slot, Variant& v) const
+{
+    UA_DataValue d;
+    UA_DataValue_init(&d);
+    bool ret = read(slot, d) && d.hasValue;
+    if (ret)
+        v.assignFrom(d.value);
+    UA_DataValue_clear(&d);
+    return ret;
+}
+
+/*!
+    \brief Open62541::LiveValueTable::changedSince
+    \param n
+    \param slots
+    \return current change sequence
+*/
+UA_UInt64 Open62541::LiveValueTable::changedSince(UA_UInt64 n, std::vector<size_t>& slots) const
+{
+    slots.clear();
+    UA_UInt64 current = sequence();  // read first so a change during the scan is seen again next time
+    size_t k          = size();
+    for (size_t i = 0; i < k; i++) {
+        // a slot being written may hold a change numbered at or below current that is not stored yet
+        const Slot& s = _slots[i];
+        if ((s.version.load(std::memory_order_acquire) & 1) || (s.change.load(std::memory_order_relaxed) > n))
+            slots.push_back(i);
+    }
+    return current;
+}
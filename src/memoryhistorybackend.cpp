@@ -0,0 +1,626 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/memoryhistorybackend.h>
+#include <open62541cpp/historyaggregates.h>
+#include <open62541cpp/open62541server.h>
+
+/*!
+    \brief powerOfTwo
+    \param n
+    \return smallest power of two not less than n
+*/
+static size_t powerOfTwo(size_t n)
+{
+    size_t p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::MemoryHistoryBackend
+    \param budget
+    \param shards
+    \param maxCapacity
+    \param initialCapacity
+*/
+Open62541::MemoryHistoryBackend::MemoryHistoryBackend(size_t budget,
+                                                      size_t shards,
+                                                      size_t maxCapacity,
+                                                      size_t initialCapacity)
+    : _budget(budget)
+    , _initialCapacity(powerOfTwo(std::max(initialCapacity, size_t(2))))
+    , _maxCapacity(powerOfTwo(std::max(maxCapacity, size_t(2))))
+{
+    _initialCapacity = std::min(_initialCapacity, _maxCapacity);
+    for (size_t i = 0; i < std::max(shards, size_t(1)); i++)
+        _shards.push_back(ShardPtr(new Shard));
+    initialise();
+    database().getHistoryData = nullptr;  // use the low level API
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::reserve
+    \param bytes
+    \return true if the budget has room - the bytes are then counted as used
+*/
+bool Open62541::MemoryHistoryBackend::reserve(size_t bytes)
+{
+    size_t u = _used.load();
+    do {
+        if (u + bytes > _budget)
+            return false;
+    } while (!_used.compare_exchange_weak(u, u + bytes));
+    return true;
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::resize
+    \param r ring - write locked by the caller
+    \param capacity power of two not less than the count
+    \return true on success
+*/
+bool Open62541::MemoryHistoryBackend::resize(Ring& r, size_t capacity)
+{
+    size_t old = r.times.empty() ? 0 : r.capacity();
+    if ((capacity > old) && !reserve((capacity - old) * SLOT_SIZE))
+        return false;
+    Ring n;
+    n.mask = capacity - 1;
+    n.times.resize(capacity);
+    n.serverTimes.resize(capacity);
+    n.values.resize(capacity);
+    n.status.resize(capacity);
+    n.types.resize(capacity);
+    n.flags.resize(capacity);
+    for (UA_UInt64 i = r.first; i < r.end(); i++) {
+        size_t s = r.slot(i);
+        size_t d = n.slot(i);
+        n.times[d]       = r.times[s];
+        n.serverTimes[d] = r.serverTimes[s];
+        n.values[d]      = r.values[s];
+        n.status[d]      = r.status[s];
+        n.types[d]       = r.types[s];
+        n.flags[d]       = r.flags[s];
+    }
+    r.mask = n.mask;
+    r.times.swap(n.times);
+    r.serverTimes.swap(n.serverTimes);
+    r.values.swap(n.values);
+    r.status.swap(n.status);
+    r.types.swap(n.types);
+    r.flags.swap(n.flags);
+    if (capacity < old)
+        _used -= (old - capacity) * SLOT_SIZE;
+    return true;
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::share
+    \return values a ring may grow to - the budget spread over the nodes held
+*/
+size_t Open62541::MemoryHistoryBackend::share() const
+{
+    return std::max(_budget / (SLOT_SIZE * std::max<size_t>(_nodes, 1)), _initialCapacity);
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::reclaim
+    Halve the largest rings above their share, dropping their oldest values, until the budget has room
+    \param bytes room wanted
+    \return true if there is room
+*/
+bool Open62541::MemoryHistoryBackend::reclaim(size_t bytes)
+{
+    size_t limit = share();
+    while (_used + bytes > _budget) {
+        RingPtr largest;
+        size_t most = limit;
+        for (auto& s : _shards) {
+            ReadLock l(s->mutex);
+            for (auto& i : s->nodes) {
+                ReadLock rl(i.second->mutex);
+                if (i.second->capacity() > most) {
+                    most    = i.second->capacity();
+                    largest = i.second;
+                }
+            }
+        }
+        if (!largest)
+            return false;  // every ring is within its share
+        WriteLock l(largest->mutex);
+        size_t capacity = largest->capacity() / 2;
+        if (largest->count > capacity) {
+            _overwritten += largest->count - capacity;
+            largest->first += largest->count - capacity;
+            largest->count = capacity;
+        }
+        if (!resize(*largest, capacity))
+            return false;
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::ring
+    \param n
+    \param create create the ring if the node is not known
+    \return ring or null - holding it keeps the ring alive through clear()
+*/
+Open62541::MemoryHistoryBackend::RingPtr Open62541::MemoryHistoryBackend::ring(const NodeId& n, bool create)
+{
+    Shard& s = shard(n);
+    {
+        ReadLock l(s.mutex);
+        auto i = s.nodes.find(n);
+        if (i != s.nodes.end())
+            return i->second;
+    }
+    if (!create)
+        return RingPtr();
+    // sized outside the shard lock - taking room from other rings locks their shards
+    RingPtr r = std::make_shared<Ring>();
+    _nodes++;
+    if (!resize(*r, _initialCapacity) && !(reclaim(_initialCapacity * SLOT_SIZE) && resize(*r, _initialCapacity))) {
+        _nodes--;
+        return RingPtr();  // the budget is spent
+    }
+    r->used = &_used;
+    WriteLock l(s.mutex);
+    RingPtr& p = s.nodes[n];
+    if (p) {
+        _nodes--;  // created by another thread meanwhile - r gives its room back as it goes
+        return p;
+    }
+    p = r;
+    return p;
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::lowerBound
+    \param r ring - locked by the caller
+    \param t
+    \param after if true find the first value later than t otherwise the first not earlier than t
+    \return index of the value or end if there is none
+*/
+UA_UInt64 Open62541::MemoryHistoryBackend::lowerBound(const Ring& r, UA_DateTime t, bool after) const
+{
+    UA_UInt64 lo = r.first;
+    UA_UInt64 hi = r.end();
+    while (lo < hi) {
+        UA_UInt64 m   = lo + (hi - lo) / 2;
+        UA_DateTime v = r.times[r.slot(m)];
+        if (after ? (v <= t) : (v < t))
+            lo = m + 1;
+        else
+            hi = m;
+    }
+    return lo;
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::toRecord
+    \param r ring - locked by the caller
+    \param i index of the value
+    \param record
+*/
+void Open62541::MemoryHistoryBackend::toRecord(const Ring& r, UA_UInt64 i, FileHistoryRecord& record) const
+{
+    size_t s               = r.slot(i);
+    record.timestamp       = r.times[s];
+    record.serverTimestamp = r.serverTimes[s];
+    record.status          = r.status[s];
+    record.typeIndex       = r.types[s];
+    record.flags           = r.flags[s];
+    memcpy(record.value, &r.values[s], sizeof(record.value));
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::push
+    \param r ring - write locked by the caller
+    \param record
+    \return UA_STATUSCODE_GOOD on success
+*/
+UA_StatusCode Open62541::MemoryHistoryBackend::push(Ring& r, const FileHistoryRecord& record)
+{
+    if (r.count && (record.timestamp < r.times[r.slot(r.end() - 1)])) {
+        _rejected++;
+        return UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;  // out of order - append only
+    }
+    if (r.count == r.capacity()) {
+        if ((r.capacity() >= _maxCapacity) || (r.capacity() * 2 > share()) || !resize(r, r.capacity() * 2)) {
+            r.first++;  // full - lose the oldest
+            r.count--;
+            _overwritten++;
+        }
+    }
+    size_t s         = r.slot(r.end());
+    r.times[s]       = record.timestamp;
+    r.serverTimes[s] = record.serverTimestamp;
+    r.status[s]      = record.status;
+    r.types[s]       = record.typeIndex;
+    r.flags[s]       = record.flags;
+    memcpy(&r.values[s], record.value, sizeof(record.value));
+    r.count++;
+    _samples++;
+    return UA_STATUSCODE_GOOD;
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::add
+    \param n
+    \param v
+    \return UA_STATUSCODE_GOOD on success
+*/
+UA_StatusCode Open62541::MemoryHistoryBackend::add(const NodeId& n, const UA_DataValue& v)
+{
+    FileHistoryRecord record;
+    UA_StatusCode ret = FileHistoryBackend::toRecord(v, record);
+    if (ret != UA_STATUSCODE_GOOD) {
+        _rejected++;
+        return ret;
+    }
+    RingPtr r = ring(n, true);
+    if (!r) {
+        _rejected++;
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    WriteLock l(r->mutex);
+    return push(*r, record);
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::clear
+*/
+void Open62541::MemoryHistoryBackend::clear()
+{
+    for (auto& s : _shards) {
+        WriteLock l(s->mutex);
+        s->nodes.clear();  // each ring gives its room back as the last holder lets go
+    }
+    _nodes = 0;
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::size
+    \param n
+    \return number of values held
+*/
+size_t Open62541::MemoryHistoryBackend::size(const NodeId& n)
+{
+    RingPtr r = ring(n);
+    if (!r)
+        return 0;
+    ReadLock l(r->mutex);
+    return r->count;
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::serverSetHistoryData
+    \param c
+    \param value
+    \return UA_STATUSCODE_GOOD on success
+*/
+UA_StatusCode Open62541::MemoryHistoryBackend::serverSetHistoryData(Context& c,
+                                                                    bool /*historizing*/,
+                                                                    const UA_DataValue* value)
+{
+    return value ? add(c.nodeId, *value) : UA_STATUSCODE_GOOD;
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::getDateTimeMatch
+    \param c
+    \param timestamp
+    \param strategy
+    \return index of the match or getEnd() if there is none
+*/
+size_t Open62541::MemoryHistoryBackend::getDateTimeMatch(Context& c,
+                                                         const UA_DateTime timestamp,
+                                                         const MatchStrategy strategy)
+{
+    RingPtr r = ring(c.nodeId);
+    if (!r)
+        return 0;
+    ReadLock l(r->mutex);
+    UA_UInt64 end = r->end();
+    UA_UInt64 i   = end;
+    switch (strategy) {
+        case MATCH_EQUAL:
+            i = lowerBound(*r, timestamp, false);
+            if ((i == end) || (r->times[r->slot(i)] != timestamp))
+                i = end;
+            break;
+        case MATCH_EQUAL_OR_AFTER:
+            i = lowerBound(*r, timestamp, false);
+            break;
+        case MATCH_AFTER:
+            i = lowerBound(*r, timestamp, true);
+            break;
+        case MATCH_EQUAL_OR_BEFORE:
+            i = lowerBound(*r, timestamp, true);
+            i = (i > r->first) ? i - 1 : end;
+            break;
+        case MATCH_BEFORE:
+            i = lowerBound(*r, timestamp, false);
+            i = (i > r->first) ? i - 1 : end;
+            break;
+        default:
+            break;
+    }
+    return size_t(i);
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::getEnd
+    \param c
+    \return index past the last value
+*/
+size_t Open62541::MemoryHistoryBackend::getEnd(Context& c)
+{
+    RingPtr r = ring(c.nodeId);
+    if (!r)
+        return 0;
+    ReadLock l(r->mutex);
+    return size_t(r->end());
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::lastIndex
+    \param c
+    \return index of the last value
+*/
+size_t Open62541::MemoryHistoryBackend::lastIndex(Context& c)
+{
+    size_t e = getEnd(c);
+    return e ? e - 1 : 0;
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::firstIndex
+    \param c
+    \return index of the first value
+*/
+size_t Open62541::MemoryHistoryBackend::firstIndex(Context& c)
+{
+    RingPtr r = ring(c.nodeId);
+    if (!r)
+        return 0;
+    ReadLock l(r->mutex);
+    return size_t(r->first);
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::resultSize
+    \param c
+    \param startIndex
+    \param endIndex
+    \return number of values between the indexes inclusive
+*/
+size_t Open62541::MemoryHistoryBackend::resultSize(Context& c, size_t startIndex, size_t endIndex)
+{
+    size_t e = getEnd(c);
+    if ((e == 0) || (startIndex >= e) || (endIndex >= e))
+        return 0;
+    return (startIndex <= endIndex) ? endIndex - startIndex + 1 : startIndex - endIndex + 1;
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::copyDataValues
+    The continuation point is the number of values already returned
+    \return UA_STATUSCODE_GOOD on success
+*/
+UA_StatusCode Open62541::MemoryHistoryBackend::copyDataValues(Context& c,
+                                                              size_t startIndex,
+                                                              size_t endIndex,
+                                                              UA_Boolean reverse,
+                                                              size_t valueSize,
+                                                              UA_NumericRange range,
+                                                              UA_Boolean releaseContinuationPoints,
+                                                              std::string& in,
+                                                              std::string& out,
+                                                              size_t* providedValues,
+                                                              UA_DataValue* values)
+{
+    size_t skip = 0;
+    if (!in.empty()) {
+        if (in.size() != sizeof(size_t))
+            return UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+        memcpy(&skip, in.data(), sizeof(size_t));
+    }
+    if (releaseContinuationPoints)
+        return UA_STATUSCODE_GOOD;
+    RingPtr r = ring(c.nodeId);
+    if (!r)
+        return UA_STATUSCODE_BADNODATA;
+    ReadLock l(r->mutex);
+    size_t total   = reverse ? startIndex - endIndex + 1 : endIndex - startIndex + 1;
+    size_t counter = 0;
+    FileHistoryRecord record;
+    for (size_t n = skip; (n < total) && (counter < valueSize); n++) {
+        UA_UInt64 i = reverse ? UA_UInt64(startIndex - n) : UA_UInt64(startIndex + n);
+        if ((i < r->first) || (i >= r->end()))
+            break;  // overwritten since the read started
+        toRecord(*r, i, record);
+        UA_StatusCode ret = FileHistoryBackend::toDataValue(record, values[counter], &range);
+        if (ret != UA_STATUSCODE_GOOD)
+            return ret;
+        counter++;
+    }
+    if (providedValues)
+        *providedValues = counter;
+    out.clear();
+    if (skip + counter < total) {
+        size_t next = skip + counter;
+        out.assign(reinterpret_cast<const char*>(&next), sizeof(next));
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::getDataValue
+    \param c
+    \param index
+    \return value valid until the next call from the same thread or null
+*/
+const UA_DataValue* Open62541::MemoryHistoryBackend::getDataValue(Context& c, size_t index)
+{
+    struct Scratch {
+        UA_DataValue v;
+        Scratch() { UA_DataValue_init(&v); }
+        ~Scratch() { UA_DataValue_clear(&v); }
+    };
+    static thread_local Scratch scratch;  // readers of a node do not share the returned value
+    RingPtr r = ring(c.nodeId);
+    if (!r)
+        return nullptr;
+    ReadLock l(r->mutex);
+    if ((index < r->first) || (index >= r->end()))
+        return nullptr;
+    FileHistoryRecord record;
+    toRecord(*r, index, record);
+    return (FileHistoryBackend::toDataValue(record, scratch.v) == UA_STATUSCODE_GOOD) ? &scratch.v : nullptr;
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::readSamples
+    Reads the timestamp, value and status arrays only - no data values are built
+    \param c
+    \param startIndex
+    \param n
+    \param times
+    \param values
+    \param good
+    \return values read
+*/
+size_t Open62541::MemoryHistoryBackend::readSamples(Context& c,
+                                                    size_t startIndex,
+                                                    size_t n,
+                                                    UA_DateTime* times,
+                                                    UA_Double* values,
+                                                    UA_Byte* good)
+{
+    RingPtr r = ring(c.nodeId);
+    if (!r)
+        return 0;
+    ReadLock l(r->mutex);
+    if ((startIndex < r->first) || (startIndex >= r->end()))
+        return 0;
+    n = std::min(n, size_t(r->end() - startIndex));
+    for (size_t j = 0; j < n; j++) {
+        size_t s  = r->slot(startIndex + j);
+        times[j]  = r->times[s];
+        values[j] = 0.0;
+        good[j]   = ((r->flags[s] & FileHistoryRecord::HasValue) &&
+                   !((r->flags[s] & FileHistoryRecord::HasStatus) && (r->status[s] & 0xC0000000)) &&
+                   HistoryAggregate::toDouble(r->types[s], &r->values[s], values[j]))
+                      ? 1
+                      : 0;
+    }
+    return n;
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::appendRecords
+    \param n
+    \param records
+    \param count
+    \return records stored
+*/
+size_t Open62541::MemoryHistoryBackend::appendRecords(const NodeId& n, const FileHistoryRecord* records, size_t count)
+{
+    RingPtr r = ring(n, true);
+    if (!r) {
+        _rejected += count;
+        return 0;
+    }
+    WriteLock l(r->mutex);
+    size_t done = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (push(*r, records[i]) == UA_STATUSCODE_GOOD)
+            done++;
+    }
+    return done;
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::readRecords
+    Records are gathered from the ring columns a block at a time
+    \param n
+    \param start
+    \param end
+    \param f
+    \return true on success
+*/
+bool Open62541::MemoryHistoryBackend::readRecords(const NodeId& n,
+                                                  UA_DateTime start,
+                                                  UA_DateTime end,
+                                                  const std::function<bool(const FileHistoryRecord*, size_t)>& f)
+{
+    RingPtr r = ring(n);
+    if (!r)
+        return true;  // no history
+    ReadLock l(r->mutex);
+    FileHistoryRecord block[256];
+    UA_UInt64 last = lowerBound(*r, end, false);
+    for (UA_UInt64 i = lowerBound(*r, start, false); i < last;) {
+        size_t k = size_t(std::min<UA_UInt64>(last - i, sizeof(block) / sizeof(block[0])));
+        for (size_t j = 0; j < k; j++)
+            toRecord(*r, i + j, block[j]);
+        if (!f(block, k))
+            break;
+        i += k;
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::insertDataValue
+    Only appending is supported
+    \param c
+    \param value
+    \return UA_STATUSCODE_GOOD on success
+*/
+UA_StatusCode Open62541::MemoryHistoryBackend::insertDataValue(Context& c, const UA_DataValue* value)
+{
+    return value ? add(c.nodeId, *value) : UA_STATUSCODE_BADINVALIDARGUMENT;
+}
+
+/*!
+    \brief Open62541::MemoryHistoryBackend::removeDataValue
+    Values can only leave a ring from the oldest end - the oldest values lying inside the range are removed
+    \param c
+    \param startTimestamp
+    \param endTimestamp
+    \return UA_STATUSCODE_GOOD on success
+*/
+UA_StatusCode Open62541::MemoryHistoryBackend::removeDataValue(Context& c,
+                                                               UA_DateTime startTimestamp,
+                                                               UA_DateTime endTimestamp)
+{
+    RingPtr r = ring(c.nodeId);
+    if (!r)
+        return UA_STATUSCODE_GOOD;
+    WriteLock l(r->mutex);
+    while (r->count && (r->times[r->slot(r->first)] >= startTimestamp) &&
+           (r->times[r->slot(r->first)] <= endTimestamp)) {
+        r->first++;
+        r->count--;
+    }
+    // give memory back to the budget once the ring is mostly empty
+    size_t capacity = r->capacity();
+    while ((capacity > _initialCapacity) && (r->count <= capacity / 4))
+        capacity /= 2;
+    if (capacity < r->capacity())
+        resize(*r, capacity);
+    return UA_STATUSCODE_GOOD;
+}
@@ -12,13 +12,15 @@
 #include <open62541cpp/monitoreditem.h>
 #include <open62541cpp/open62541client.h>
 #include <open62541cpp/clientsubscription.h>
+#include <open62541cpp/notificationdispatcher.h>
+#include <algorithm>
 
 /*!
     \brief Open62541::MonitoredItem::MonitoredItem
     \param s
 */
 Open62541::MonitoredItem::MonitoredItem(ClientSubscription& s)
-    : _sub(s)
+    : _sub(&s)
 {
 }
 
@@ -35,7 +37,7 @@ Open62541::MonitoredItem::MonitoredItem(ClientSubscription& s)
 void Open62541::MonitoredItem::deleteMonitoredItemCallback(UA_Client* client,
                                                            UA_UInt32 subId,
                                                            void* /*subContext*/,
-                                                           UA_UInt32 /*monId*/,
+                                                           UA_UInt32 monId,
                                                            void* monContext)
 {
     //
@@ -45,7 +47,7 @@ void Open62541::MonitoredItem::deleteMonitoredItemCallback(UA_Client* client,
         ClientSubscription* c = cl->subscription(subId);
         if (c) {
             Open62541::MonitoredItem* m = (Open62541::MonitoredItem*)(monContext);
-            if (m) {
+            if (m && (m->_sub == c) && (m->id() == monId)) {  // not a server item the object has moved from
                 m->deleteMonitoredItem();
             }
         }
@@ -75,7 +77,19 @@ void Open62541::MonitoredItem::dataChangeNotificationCallback(UA_Client* client,
         if (c) {
             Open62541::MonitoredItem* m = (Open62541::MonitoredItem*)(monContext);
             if (m) {
-                m->dataChangeNotification(value);
+                c->noteDataChange(value);
+                if (c->dispatcher()) {
+                    c->dispatcher()->postDataChange(m, value);
+                }
+                else if (cl->notificationExecutor() && value) {
+                    // the value is only valid during the callback
+                    std::shared_ptr<UA_DataValue> v(UA_DataValue_new(), UA_DataValue_delete);
+                    UA_DataValue_copy(value, v.get());
+                    cl->notificationExecutor()([m, v] { m->dataChangeNotification(v.get()); });
+                }
+                else {
+                    m->dataChangeNotification(value);
+                }
             }
         }
     }
@@ -106,12 +120,239 @@ void Open62541::MonitoredItem::eventNotificationCallback(UA_Client* client,
         if (c) {
             Open62541::MonitoredItem* m = (Open62541::MonitoredItem*)(monContext);
             if (m) {
-                m->eventNotification(nEventFields, eventFields);
+                c->noteEvent();
+                if (c->dispatcher()) {
+                    c->dispatcher()->postEvent(m, nEventFields, eventFields);
+                }
+                else if (cl->notificationExecutor()) {
+                    UA_Variant* f = nullptr;
+                    if (UA_Array_copy(eventFields, nEventFields, (void**)&f, &UA_TYPES[UA_TYPES_VARIANT]) !=
+                        UA_STATUSCODE_GOOD)
+                        return;
+                    std::shared_ptr<UA_Variant> v(f, [nEventFields](UA_Variant* p) {
+                        UA_Array_delete(p, nEventFields, &UA_TYPES[UA_TYPES_VARIANT]);
+                    });
+                    cl->notificationExecutor()([m, v, nEventFields] { m->eventNotification(nEventFields, v.get()); });
+                }
+                else {
+                    m->eventNotification(nEventFields, eventFields);
+                }
             }
         }
     }
 }
 
+namespace {
+// items of one recreate request - deleted when the response arrives
+struct RecreateBatch {
+    std::vector<Open62541::MonitoredItem*> items;
+    std::function<void(size_t)> done;
+};
+}  // namespace
+
+/*!
+    \brief Open62541::MonitoredItem::recreateCallback
+    \param userdata
+    \param response
+*/
+void Open62541::MonitoredItem::recreateCallback(UA_Client* /*client*/,
+                                                void* userdata,
+                                                UA_UInt32 /*requestId*/,
+                                                void* response)
+{
+    std::unique_ptr<RecreateBatch> b(static_cast<RecreateBatch*>(userdata));
+    UA_CreateMonitoredItemsResponse* r = static_cast<UA_CreateMonitoredItemsResponse*>(response);
+    size_t created                     = 0;
+    for (size_t i = 0; i < b->items.size(); i++) {
+        MonitoredItem* m = b->items[i];
+        if (r && (i < r->resultsSize)) {
+            m->_response.assignFrom(r->results[i]);
+            m->_lastError = r->results[i].statusCode;
+        }
+        else {
+            m->_response.null();
+            m->_lastError = (r && (r->responseHeader.serviceResult != UA_STATUSCODE_GOOD))
+                                ? r->responseHeader.serviceResult
+                                : UA_STATUSCODE_BADUNEXPECTEDERROR;
+        }
+        if (m->_lastError == UA_STATUSCODE_GOOD)
+            created++;
+    }
+    if (b->done)
+        b->done(created);
+}
+
+/*!
+    \brief Open62541::MonitoredItem::recreate
+    \param s
+    \param items
+    \param done
+    \return true if the request was sent
+*/
+bool Open62541::MonitoredItem::recreate(ClientSubscription& s,
+                                        const std::vector<MonitoredItem*>& items,
+                                        std::function<void(size_t created)> done)
+{
+    std::unique_ptr<RecreateBatch> b(new RecreateBatch);
+    b->done = done;
+    UA_CreateMonitoredItemsRequest request;
+    UA_CreateMonitoredItemsRequest_init(&request);
+    request.subscriptionId = s.id();
+    request.itemsToCreate  = static_cast<UA_MonitoredItemCreateRequest*>(
+        UA_Array_new(items.size(), &UA_TYPES[UA_TYPES_MONITOREDITEMCREATEREQUEST]));
+    std::vector<void*> contexts;
+    for (size_t i = 0; request.itemsToCreate && (i < items.size()); i++) {
+        MonitoredItemCreateRequest r;
+        if (!items[i]->createRequest(r))
+            continue;
+        UA_MonitoredItemCreateRequest_copy(r.constRef(), &request.itemsToCreate[request.itemsToCreateSize++]);
+        request.timestampsToReturn = items[i]->timestamps();
+        contexts.push_back(items[i]);
+        b->items.push_back(items[i]);
+    }
+    UA_StatusCode ret = UA_STATUSCODE_BADNOTHINGTODO;
+    if (request.itemsToCreateSize > 0) {
+        size_t n = request.itemsToCreateSize;
+        std::vector<UA_Client_DeleteMonitoredItemCallback> deleteCallbacks(n, deleteMonitoredItemCallback);
+        if (b->items[0]->isEvent()) {
+            std::vector<UA_Client_EventNotificationCallback> callbacks(n, eventNotificationCallback);
+            ret = UA_Client_MonitoredItems_createEvents_async(s.client().client(),
+                                                              request,
+                                                              contexts.data(),
+                                                              callbacks.data(),
+                                                              deleteCallbacks.data(),
+                                                              recreateCallback,
+                                                              b.get(),
+                                                              nullptr);
+        }
+        else {
+            std::vector<UA_Client_DataChangeNotificationCallback> callbacks(n, dataChangeNotificationCallback);
+            ret = UA_Client_MonitoredItems_createDataChanges_async(s.client().client(),
+                                                                   request,
+                                                                   contexts.data(),
+                                                                   callbacks.data(),
+                                                                   deleteCallbacks.data(),
+                                                                   recreateCallback,
+                                                                   b.get(),
+                                                                   nullptr);
+        }
+    }
+    UA_CreateMonitoredItemsRequest_clear(&request);
+    if (ret == UA_STATUSCODE_GOOD) {
+        b.release();  // owned by the response callback
+        return true;
+    }
+    for (auto m : b->items)
+        m->_lastError = ret;
+    if (done)
+        done(0);
+    return false;
+}
+
+namespace {
+// items of one move with the results they had on the subscription they leave
+struct MoveBatch {
+    Open62541::Client* client = nullptr;
+    UA_UInt32 from            = 0;
+    UA_UInt32 to              = 0;
+    std::vector<std::pair<Open62541::MonitoredItem*, Open62541::MonitoredItemCreateResult>> items;
+    size_t moved = 0;
+    std::function<void(size_t)> done;
+};
+}  // namespace
+
+/*!
+    \brief Open62541::MonitoredItem::moveCallback
+    \param userdata
+*/
+void Open62541::MonitoredItem::moveCallback(UA_Client* /*client*/,
+                                            void* userdata,
+                                            UA_UInt32 /*requestId*/,
+                                            void* /*response*/)
+{
+    std::unique_ptr<std::shared_ptr<MoveBatch>> b(static_cast<std::shared_ptr<MoveBatch>*>(userdata));
+    if ((*b)->done)
+        (*b)->done((*b)->moved);
+}
+
+/*!
+    \brief Open62541::MonitoredItem::move
+    \param from
+    \param to
+    \param items
+    \param done
+    \return true if the request was sent
+*/
+bool Open62541::MonitoredItem::move(ClientSubscription& from,
+                                    ClientSubscription& to,
+                                    const std::vector<MonitoredItem*>& items,
+                                    std::function<void(size_t moved)> done)
+{
+    auto b    = std::make_shared<MoveBatch>();
+    b->client = &from.client();
+    b->from   = from.id();
+    b->to     = to.id();
+    b->done   = done;
+    std::vector<MonitoredItem*> moving;
+    for (auto m : items) {
+        MonitoredItemCreateRequest r;
+        if ((m->_sub == &from) && (m->id() > 0) && m->createRequest(r)) {
+            moving.push_back(m);
+            b->items.emplace_back(m, m->_response);
+        }
+    }
+    if (moving.empty() || !b->from || !b->to || (&from == &to)) {
+        if (done)
+            done(0);
+        return false;
+    }
+    return recreate(to, moving, [b](size_t) {
+        ClientSubscription* f = b->client->subscription(b->from);
+        ClientSubscription* t = b->client->subscription(b->to);  // either may have been deleted meanwhile
+        if (!f) {
+            if (b->done)
+                b->done(0);
+            return;
+        }
+        std::vector<UA_UInt32> left;
+        for (auto& i : b->items) {
+            MonitoredItem* m = i.first;
+            if (!t || (m->_lastError != UA_STATUSCODE_GOOD)) {
+                m->_response = i.second;  // still on the old server item
+                continue;
+            }
+            MonitoredItemMap& map = f->monitorItems();
+            auto k = std::find_if(map.begin(), map.end(), [m](const MonitoredItemMap::value_type& e) {
+                return e.second.get() == m;
+            });
+            if (k != map.end()) {
+                MonitoredItemRef r = k->second;
+                map.erase(k);
+                t->addMonitorItem(r);
+            }
+            m->_sub = t;
+            left.push_back(i.second.get().monitoredItemId);
+            b->moved++;
+        }
+        if (left.empty()) {
+            if (b->done)
+                b->done(0);
+            return;
+        }
+        UA_DeleteMonitoredItemsRequest request;
+        UA_DeleteMonitoredItemsRequest_init(&request);
+        request.subscriptionId       = b->from;
+        request.monitoredItemIds     = left.data();
+        request.monitoredItemIdsSize = left.size();
+        std::unique_ptr<std::shared_ptr<MoveBatch>> u(new std::shared_ptr<MoveBatch>(b));
+        if (UA_Client_MonitoredItems_delete_async(b->client->client(), request, moveCallback, u.get(), nullptr) ==
+            UA_STATUSCODE_GOOD)
+            u.release();  // owned by the response callback
+        else if (b->done)
+            b->done(b->moved);  // the old server items go with their subscription
+    });
+}
+
 /*!
     \brief Open62541::MonitoredItem::remove
     \return
@@ -119,8 +360,8 @@ void Open62541::MonitoredItem::eventNotificationCallback(UA_Client* client,
 bool Open62541::MonitoredItem::remove()
 {
     bool ret = false;
-    if ((id() > 0) && _sub.client().client()) {
-        ret = UA_Client_MonitoredItems_deleteSingle(_sub.client().client(), _sub.id(), id()) == UA_STATUSCODE_GOOD;
+    if ((id() > 0) && _sub->client().client()) {
+        ret = UA_Client_MonitoredItems_deleteSingle(_sub->client().client(), _sub->id(), id()) == UA_STATUSCODE_GOOD;
         _response.null();
     }
     return ret;
@@ -158,8 +399,22 @@ bool Open62541::MonitoredItem::setTriggering(const SetTriggeringRequest& request
 */
 bool Open62541::MonitoredItemDataChange::addDataChange(NodeId& n, UA_TimestampsToReturn ts)
 {
-    MonitoredItemCreateRequest monRequest;
-    monRequest      = UA_MonitoredItemCreateRequest_default(n);
+    return addDataChange(n, MonitoringParameters(), ts);
+}
+
+/*!
+    \brief Open62541::MonitoredItemDataChange::addDataChange
+    \param n
+    \param p
+    \param ts
+    \return true on success
+*/
+bool Open62541::MonitoredItemDataChange::addDataChange(NodeId& n,
+                                                       const MonitoringParameters& p,
+                                                       UA_TimestampsToReturn ts)
+{
+    MonitoredItemCreateRequest monRequest = p.request(n);
+
     _response.get() = UA_Client_MonitoredItems_createDataChange(subscription().client().client(),
                                                                 subscription().id(),
                                                                 ts,
@@ -167,7 +422,114 @@ bool Open62541::MonitoredItemDataChange::addDataChange(NodeId& n, UA_TimestampsT
                                                                 this,
                                                                 dataChangeNotificationCallback,
                                                                 deleteMonitoredItemCallback);
-    return _response.get().statusCode == UA_STATUSCODE_GOOD;
+    _lastError      = _response.get().statusCode;
+    if (_lastError == UA_STATUSCODE_GOOD) {
+        _nodeId     = n;
+        _parameters = p;
+        _timestamps = ts;
+    }
+    return _lastError == UA_STATUSCODE_GOOD;
+}
+
+/*!
+    \brief Open62541::MonitoredItemDataChange::addDataChanges
+    \param s
+    \param items
+    \param nodes
+    \param p
+    \param ts
+    \return number created
+*/
+size_t Open62541::MonitoredItemDataChange::addDataChanges(ClientSubscription& s,
+                                                          const std::vector<MonitoredItemDataChange*>& items,
+                                                          const std::vector<NodeId>& nodes,
+                                                          const MonitoringParameters& p,
+                                                          UA_TimestampsToReturn ts)
+{
+    size_t n = std::min(items.size(), nodes.size());
+    if (n == 0)
+        return 0;
+    UA_CreateMonitoredItemsRequest request;
+    UA_CreateMonitoredItemsRequest_init(&request);
+    request.subscriptionId     = s.id();
+    request.timestampsToReturn = ts;
+    request.itemsToCreate      = static_cast<UA_MonitoredItemCreateRequest*>(
+        UA_Array_new(n, &UA_TYPES[UA_TYPES_MONITOREDITEMCREATEREQUEST]));
+    if (!request.itemsToCreate)
+        return 0;
+    request.itemsToCreateSize = n;
+    std::vector<void*> contexts(n);
+    std::vector<UA_Client_DataChangeNotificationCallback> callbacks(n, dataChangeNotificationCallback);
+    std::vector<UA_Client_DeleteMonitoredItemCallback> deleteCallbacks(n, deleteMonitoredItemCallback);
+    for (size_t i = 0; i < n; i++) {
+        UA_MonitoredItemCreateRequest& r = request.itemsToCreate[i];
+        r.itemToMonitor.attributeId      = UA_ATTRIBUTEID_VALUE;
+        UA_NodeId_copy(nodes[i].constRef(), &r.itemToMonitor.nodeId);
+        p.apply(r);
+        contexts[i] = items[i];
+    }
+    UA_CreateMonitoredItemsResponse response = UA_Client_MonitoredItems_createDataChanges(
+        s.client().client(), request, contexts.data(), callbacks.data(), deleteCallbacks.data());
+    size_t created = 0;
+    for (size_t i = 0; i < n; i++) {
+        MonitoredItemDataChange* m = items[i];
+        if (i < response.resultsSize) {
+            m->_response.assignFrom(response.results[i]);
+            m->_lastError = response.results[i].statusCode;
+        }
+        else {
+            m->_response.null();
+            m->_lastError = (response.responseHeader.serviceResult != UA_STATUSCODE_GOOD)
+                                ? response.responseHeader.serviceResult
+                                : UA_STATUSCODE_BADUNEXPECTEDERROR;
+        }
+        if (m->_lastError == UA_STATUSCODE_GOOD) {
+            m->_nodeId     = nodes[i];
+            m->_parameters = p;
+            m->_timestamps = ts;
+            created++;
+        }
+    }
+    UA_CreateMonitoredItemsResponse_clear(&response);
+    UA_CreateMonitoredItemsRequest_clear(&request);
+    return created;
+}
+
+/*!
+    \brief Open62541::MonitoringParameters::apply
+    \param r
+*/
+void Open62541::MonitoringParameters::apply(UA_MonitoredItemCreateRequest& r) const
+{
+    r.monitoringMode                       = _mode;
+    r.requestedParameters.samplingInterval = _samplingInterval;
+    r.requestedParameters.queueSize        = _queueSize;
+    r.requestedParameters.discardOldest    = _discardOldest;
+    UA_ExtensionObject_clear(&r.requestedParameters.filter);
+    if (hasFilter()) {
+        UA_DataChangeFilter* f = UA_DataChangeFilter_new();
+        f->trigger             = _trigger;
+        f->deadbandType        = _deadbandType;
+        f->deadbandValue       = _deadbandValue;
+        // owned by the request
+        r.requestedParameters.filter.encoding             = UA_EXTENSIONOBJECT_DECODED;
+        r.requestedParameters.filter.content.decoded.data = f;
+        r.requestedParameters.filter.content.decoded.type = &UA_TYPES[UA_TYPES_DATACHANGEFILTER];
+    }
+}
+
+/*!
+    \brief Open62541::MonitoringParameters::request
+    \param n
+    \return request
+*/
+Open62541::MonitoredItemCreateRequest Open62541::MonitoringParameters::request(const NodeId& n) const
+{
+    MonitoredItemCreateRequest r;
+    UA_NodeId_copy(n.constRef(), &r.get().itemToMonitor.nodeId);
+    r.get().itemToMonitor.attributeId = UA_ATTRIBUTEID_VALUE;
+    apply(r.get());
+    return r;
 }
 
 /*!
@@ -187,5 +549,6 @@ bool Open62541::MonitoredItemEvent::addEvent(NodeId& n, UA_TimestampsToReturn ts
                                                      this,
                                                      eventNotificationCallback,
                                                      deleteMonitoredItemCallback);
+    _timestamps = ts;
     return _response.get().statusCode == UA_STATUSCODE_GOOD;
 }
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/notificationdispatcher.h>
+#include <open62541cpp/monitoreditem.h>
+
+/*!
+    \brief Open62541::NotificationDispatcher::Notification::clear
+    Release the payload - the slot itself is kept
+*/
+void Open62541::NotificationDispatcher::Notification::clear()
+{
+    UA_DataValue_clear(&value);
+    if (fields) {
+        UA_Array_delete(fields, nFields, &UA_TYPES[UA_TYPES_VARIANT]);
+        fields = nullptr;
+    }
+    nFields = 0;
+    item    = nullptr;
+    event   = false;
+}
+
+/*!
+    \brief Open62541::NotificationDispatcher::NotificationDispatcher
+    \param threads
+    \param depth
+*/
+Open62541::NotificationDispatcher::NotificationDispatcher(size_t threads, size_t depth)
+{
+    threads = std::max<size_t>(1, threads);
+    for (size_t i = 0; i < threads; i++)
+        _workers.emplace_back(new Worker(depth));
+    _running = true;
+    for (auto& w : _workers) {
+        Worker* p = w.get();
+        p->thread = std::thread([this, p] { run(*p); });
+    }
+}
+
+/*!
+    \brief Open62541::NotificationDispatcher::stop
+*/
+void Open62541::NotificationDispatcher::stop()
+{
+    if (!_running.exchange(false))
+        return;
+    for (auto& w : _workers) {
+        {
+            std::lock_guard<std::mutex> l(w->mutex);
+        }
+        w->wake.notify_all();
+    }
+    for (auto& w : _workers) {
+        if (w->thread.joinable())
+            w->thread.join();
+    }
+}
+
+/*!
+    \brief Open62541::NotificationDispatcher::run
+    Worker thread - handle notifications until stopped and the ring is empty
+    \param w
+*/
+void Open62541::NotificationDispatcher::run(Worker& w)
+{
+    auto take = [this](Notification& n) {
+        if (n.item) {
+            if (n.event)
+                n.item->eventNotification(n.nFields, n.fields);
+            else
+                n.item->dataChangeNotification(&n.value);
+            _dispatched++;
+        }
+        n.clear();
+        _done++;
+    };
+    for (;;) {
+        while (w.ring.pop(take))
+            ;
+        if (!_running)
+            break;
+        std::unique_lock<std::mutex> l(w.mutex);
+        w.waiting = true;
+        if (w.ring.size() == 0)  // posts after this see waiting set and notify
+            w.wake.wait_for(l, std::chrono::milliseconds(50));
+        w.waiting = false;
+    }
+    while (w.ring.pop(take))  // posted during the stop
+        ;
+}
+
+/*!
+    \brief Open62541::NotificationDispatcher::post
+    \param m
+    \param fill copies the payload into the slot
+    \return false if dropped
+*/
+bool Open62541::NotificationDispatcher::post(MonitoredItem* m, const std::function<bool(Notification&)>& fill)
+{
+    if (!m || !_running) {
+        _dropped++;
+        return false;
+    }
+    Worker& w = workerFor(m);
+    bool ok   = false;
+    if (!w.ring.push([&](Notification& n) {
+            ok     = fill(n);
+            n.item = ok ? m : nullptr;  // a slot that could not be filled is skipped
+        })) {
+        _dropped++;
+        return false;
+    }
+    _posted++;
+    if (!ok)
+        _dropped++;
+    size_t depth = w.ring.size();
+    size_t high  = _maxQueued;
+    while ((depth > high) && !_maxQueued.compare_exchange_weak(high, depth))
+        ;
+    if (w.waiting) {
+        std::lock_guard<std::mutex> l(w.mutex);
+        w.wake.notify_one();
+    }
+    return ok;
+}
+
+/*!
+    \brief Open62541::NotificationDispatcher::postDataChange
+    \param m
+    \param value
+    \return false if dropped
+*/
+bool Open62541::NotificationDispatcher::postDataChange(MonitoredItem* m, const UA_DataValue* value)
+{
+    return post(m, [value](Notification& n) {
+        return !value || (UA_DataValue_copy(value, &n.value) == UA_STATUSCODE_GOOD);
+    });
+}
+
+/*!
+    \brief Open62541::NotificationDispatcher::postEvent
+    \param m
+    \param nFields
+    \param fields
+    \return false if dropped
+*/
+bool Open62541::NotificationDispatcher::postEvent(MonitoredItem* m, size_t nFields, const UA_Variant* fields)
+{
+    return post(m, [nFields, fields](Notification& n) {
+        if (UA_Array_copy(fields, nFields, (void**)&n.fields, &UA_TYPES[UA_TYPES_VARIANT]) != UA_STATUSCODE_GOOD)
+            return false;
+        n.nFields = nFields;
+        n.event   = true;
+        return true;
+    });
+}
+
+/*!
+    \brief Open62541::NotificationDispatcher::flush
+*/
+void Open62541::NotificationDispatcher::flush()
+{
+    size_t target = _posted;
+    while (_running && (_done < target))
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+/*!
+    \brief Open62541::NotificationDispatcher::queued
+    \return total queue depth
+*/
+size_t Open62541::NotificationDispatcher::queued() const
+{
+    size_t n = 0;
+    for (auto& w : _workers)
+        n += w->ring.size();
+    return n;
+}
@@ -12,6 +12,9 @@
 #include <open62541cpp/open62541client.h>
 #include <open62541cpp/clientbrowser.h>
 
+// the client whose I/O thread this is
+static thread_local Open62541::Client* ioThreadClient = nullptr;
+
 /*!
  * \brief subscriptionInactivityCallback
  * \param client
@@ -427,6 +430,8 @@ void Open62541::Client::stateChange(UA_SecureChannelState channelState,
 
     if (!connectStatus) {
         if (_lastSessionState != sessionState) {
+            if (_recoverSubscriptions)
+                recoveryTransition(sessionState);  // before the handlers, which clear the subscriptions
             switch (sessionState) {
                 case UA_SESSIONSTATE_CLOSED:
                     SessionStateClosed();
@@ -493,3 +498,574 @@ void Open62541::Client::stateChange(UA_SecureChannelState channelState,
         connectFail();
     }
 }
+
+/*!
+    \brief Open62541::Client::recoveryTransition
+    \param sessionState
+*/
+void Open62541::Client::recoveryTransition(UA_SessionState sessionState)
+{
+    if ((_lastSessionState == UA_SESSIONSTATE_ACTIVATED) && !_subscriptions.empty() && !_lostAt)
+        _lostAt = UA_DateTime_now();
+    switch (sessionState) {
+        case UA_SESSIONSTATE_CLOSING:
+        case UA_SESSIONSTATE_CLOSED:
+            detachSubscriptions();  // the client library has dropped them
+            break;
+        case UA_SESSIONSTATE_ACTIVATED:
+            recoverSubscriptions();
+            break;
+        default:
+            break;
+    }
+}
+
+/*!
+    \brief Open62541::Client::detachSubscriptions
+*/
+void Open62541::Client::detachSubscriptions()
+{
+    if (!_recoverSubscriptions)
+        return;
+    if (!_subscriptions.empty() && !_lostAt)
+        _lostAt = UA_DateTime_now();
+    for (auto& i : _subscriptions) {
+        i.second->detach();
+        _lostSubscriptions.push_back(i.second);
+    }
+    _subscriptions.clear();
+}
+
+/*!
+    \brief Open62541::Client::recoverSubscriptions
+    Called when a session is activated
+*/
+void Open62541::Client::recoverSubscriptions()
+{
+    if (_recovering)
+        return;
+    _activatedAt    = UA_DateTime_now();
+    _recoveryReport = RecoveryReport();
+    auto finish     = [this]() {
+        UA_DateTime now          = UA_DateTime_now();
+        _recoveryReport.recovery = UA_Double(now - _activatedAt) / UA_DATETIME_MSEC;
+        _recoveryReport.outage   = _lostAt ? (UA_Double(now - _lostAt) / UA_DATETIME_MSEC) : 0;
+        _lostAt                  = 0;
+        subscriptionsRecovered(_recoveryReport);
+    };
+    if (_lostSubscriptions.empty()) {
+        if (_lostAt && !_subscriptions.empty()) {
+            // the session was reactivated - its subscriptions carried on
+            _recoveryReport.resumed       = true;
+            _recoveryReport.subscriptions = _subscriptions.size();
+            for (auto& i : _subscriptions)
+                _recoveryReport.items += i.second->monitorItems().size();
+            finish();
+        }
+        _lostAt = 0;
+        return;
+    }
+    std::vector<ClientSubscriptionRef> lost;
+    lost.swap(_lostSubscriptions);
+    _recovering = lost.size() + 1;  // released after all are sent
+    auto done   = [this, finish]() {
+        if (--_recovering == 0)
+            finish();
+    };
+    for (auto& s : lost) {
+        ClientSubscriptionRef ref = s;
+        bool sent                 = s->recreate(
+            _recoveryBatch,
+            [this, ref](UA_StatusCode status) {
+                if (status == UA_STATUSCODE_GOOD) {
+                    _subscriptions[ref->id()] = ref;  // notifications are routed by the new id
+                    _recoveryReport.subscriptions++;
+                }
+                else {
+                    _lostSubscriptions.push_back(ref);  // try again on the next session
+                    _recoveryReport.failed++;
+                }
+            },
+            [this, done](size_t items, size_t failed) {
+                _recoveryReport.items += items;
+                _recoveryReport.failed += failed;
+                done();
+            });
+        if (!sent) {
+            _lostSubscriptions.push_back(ref);
+            _recoveryReport.failed++;
+            done();
+        }
+    }
+    done();
+}
+
+/*!
+    \brief Open62541::Client::asyncRequestCallback
+    \param client
+    \param userdata the request
+    \param requestId
+    \param response
+*/
+void Open62541::Client::asyncRequestCallback(UA_Client* /*client*/,
+                                             void* userdata,
+                                             UA_UInt32 /*requestId*/,
+                                             void* response)
+{
+    AsyncRequestPtr r(static_cast<AsyncRequest*>(userdata));
+    if (!r)
+        return;
+    // every response starts with the response header
+    UA_StatusCode status =
+        response ? static_cast<UA_ResponseHeader*>(response)->serviceResult : UA_STATUSCODE_BADUNEXPECTEDERROR;
+    if (r->done)
+        r->done(status, response);
+    Client* c = r->client;
+    r.reset();
+    c->releaseSlot();
+}
+
+/*!
+    \brief Open62541::Client::sendRequest
+    If the request cannot be sent it is completed with the error
+    \param r request - released if sent
+    \return true if sent
+*/
+bool Open62541::Client::sendRequest(AsyncRequestPtr& r)
+{
+    UA_StatusCode status = UA_STATUSCODE_BADSERVERNOTCONNECTED;
+    if (_client) {
+        status = __UA_Client_AsyncService(_client,
+                                          r->request,
+                                          r->requestType,
+                                          asyncRequestCallback,
+                                          r->responseType,
+                                          r.get(),
+                                          nullptr);
+    }
+    if (status == UA_STATUSCODE_GOOD) {
+        r.release();  // owned by the client until the callback
+        return true;
+    }
+    if (r->done)
+        r->done(status, nullptr);
+    r.reset();
+    return false;
+}
+
+/*!
+    \brief Open62541::Client::releaseSlot
+    A request has completed - send the next queued requests
+*/
+void Open62541::Client::releaseSlot()
+{
+    {
+        std::lock_guard<std::mutex> l(_asyncMutex);
+        if (_outstanding > 0)
+            _outstanding--;
+    }
+    pumpQueue();
+}
+
+/*!
+    \brief Open62541::Client::pumpQueue
+    Send queued requests while there is room in the window. The lock is not held while sending
+*/
+void Open62541::Client::pumpQueue()
+{
+    std::unique_lock<std::mutex> l(_asyncMutex);
+    while (!_asyncQueue.empty() && (_outstanding < _maxOutstanding)) {
+        AsyncRequestPtr r = std::move(_asyncQueue.front());
+        _asyncQueue.pop_front();
+        _outstanding++;
+        l.unlock();
+        bool sent = sendRequest(r);
+        l.lock();
+        if (!sent)
+            _outstanding--;
+    }
+}
+
+/*!
+    \brief Open62541::Client::failQueued
+    Complete the requests that have not been sent
+    \param status
+*/
+void Open62541::Client::failQueued(UA_StatusCode status)
+{
+    std::deque<AsyncRequestPtr> q;
+    {
+        std::lock_guard<std::mutex> l(_asyncMutex);
+        q.swap(_asyncQueue);
+    }
+    for (auto& r : q) {
+        if (r->done)
+            r->done(status, nullptr);
+    }
+}
+
+/*!
+    \brief Open62541::Client::asyncRequest
+    \param request
+    \param requestType
+    \param responseType
+    \param done
+*/
+void Open62541::Client::asyncRequest(void* request,
+                                     const UA_DataType* requestType,
+                                     const UA_DataType* responseType,
+                                     AsyncServiceCallback done)
+{
+    AsyncRequestPtr r(new AsyncRequest);
+    r->client       = this;
+    r->request      = request;
+    r->requestType  = requestType;
+    r->responseType = responseType;
+    r->done         = std::move(done);
+    {
+        // checked and pushed under the lock stopIoThread takes to clear the flag - nothing is pushed after its drain
+        std::lock_guard<std::mutex> l(_submitMutex);
+        if (_ioRunning && (ioThreadClient != this)) {
+            _submitted.push(std::move(r));  // sent by the I/O thread
+            return;
+        }
+    }
+    submit(std::move(r));
+}
+
+/*!
+    \brief Open62541::Client::submit
+    Send a request if there is room in the window otherwise queue it
+    \param r
+*/
+void Open62541::Client::submit(AsyncRequestPtr r)
+{
+    {
+        std::lock_guard<std::mutex> l(_asyncMutex);
+        if (!_asyncQueue.empty() || (_outstanding >= _maxOutstanding)) {
+            _asyncQueue.push_back(std::move(r));  // keeps the requests in order
+            return;
+        }
+        _outstanding++;
+    }
+    if (!sendRequest(r))
+        releaseSlot();
+}
+
+/*!
+    \brief Open62541::Client::drainSubmitted
+    Move the requests handed over by other threads to the window - on the I/O thread or once it has stopped. The
+    client lock must be held as the requests are sent
+*/
+void Open62541::Client::drainSubmitted()
+{
+    AsyncRequestPtr r;
+    while (_submitted.pop(r))
+        submit(std::move(r));
+}
+
+/*!
+    \brief Open62541::Client::ioLoop
+*/
+void Open62541::Client::ioLoop()
+{
+    ioThreadClient = this;
+    while (_ioRunning) {
+        bool ok = false;
+        {
+            WriteLock l(_mutex);
+            drainSubmitted();
+            ok = runIterate(_ioInterval);
+        }
+        if (!ok)
+            std::this_thread::sleep_for(std::chrono::milliseconds(_ioInterval));  // not connected
+    }
+    ioThreadClient = nullptr;
+}
+
+/*!
+    \brief Open62541::Client::startIoThread
+    \param interval
+    \return true on success
+*/
+bool Open62541::Client::startIoThread(uint32_t interval)
+{
+    if (_ioRunning || !_client)
+        return false;
+    if (_ioThread.joinable())
+        _ioThread.join();
+    _ioInterval = std::max<uint32_t>(1, interval);
+    try {
+        _ioRunning = true;
+        _ioThread  = std::thread([this] { ioLoop(); });
+    }
+    catch (...) {
+        _ioRunning = false;
+        return false;
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::Client::stopIoThread
+*/
+void Open62541::Client::stopIoThread()
+{
+    {
+        std::lock_guard<std::mutex> l(_submitMutex);
+        _ioRunning = false;
+    }
+    if (_ioThread.joinable())
+        _ioThread.join();
+    WriteLock l(_mutex);
+    drainSubmitted();
+}
+
+/*!
+    \brief Open62541::Client::failSubmitted
+    Complete the requests handed over by other threads without sending them
+    \param status
+*/
+void Open62541::Client::failSubmitted(UA_StatusCode status)
+{
+    AsyncRequestPtr r;
+    while (_submitted.pop(r)) {
+        if (r->done)
+            r->done(status, nullptr);
+        r.reset();
+    }
+}
+
+/*!
+    \brief Open62541::Client::setMaxOutstanding
+    \param n
+*/
+void Open62541::Client::setMaxOutstanding(size_t n)
+{
+    {
+        std::lock_guard<std::mutex> l(_asyncMutex);
+        _maxOutstanding = std::max<size_t>(1, n);
+    }
+    pumpQueue();
+}
+
+/*!
+    \brief Open62541::Client::readAsync
+    \param nodeId
+    \param done
+    \param attributeId
+*/
+void Open62541::Client::readAsync(const NodeId& nodeId, ReadCallback done, UA_UInt32 attributeId)
+{
+    UA_ReadRequest* q           = UA_ReadRequest_new();
+    q->timestampsToReturn       = UA_TIMESTAMPSTORETURN_BOTH;
+    q->nodesToRead              = UA_ReadValueId_new();
+    q->nodesToReadSize          = 1;
+    q->nodesToRead->attributeId = attributeId;
+    UA_NodeId_copy(nodeId.constRef(), &q->nodesToRead->nodeId);
+    asyncRequest(q,
+                 &UA_TYPES[UA_TYPES_READREQUEST],
+                 &UA_TYPES[UA_TYPES_READRESPONSE],
+                 [done](UA_StatusCode status, void* response) {
+                     UA_DataValue empty;
+                     UA_DataValue_init(&empty);
+                     const UA_DataValue* v = &empty;
+                     if (status == UA_STATUSCODE_GOOD) {
+                         UA_ReadResponse* a = static_cast<UA_ReadResponse*>(response);
+                         if (a->resultsSize == 1) {
+                             v = a->results;
+                             if (v->hasStatus)
+                                 status = v->status;
+                         }
+                         else {
+                             status = UA_STATUSCODE_BADUNEXPECTEDERROR;
+                         }
+                     }
+                     if (done)
+                         done(status, *v);
+                 });
+}
+
+/*!
+    \brief Open62541::Client::readAsync
+    \param nodeId
+    \return future
+*/
+std::future<Open62541::AsyncResult<Open62541::Variant>> Open62541::Client::readAsync(const NodeId& nodeId)
+{
+    auto p = std::make_shared<std::promise<AsyncResult<Variant>>>();
+    auto f = p->get_future();
+    readAsync(nodeId, [p](UA_StatusCode status, const UA_DataValue& v) {
+        AsyncResult<Variant> r;
+        r.status = status;
+        if (v.hasValue)
+            r.value.assignFrom(v.value);
+        p->set_value(r);
+    });
+    return f;
+}
+
+/*!
+    \brief Open62541::Client::writeAsync
+    \param nodeId
+    \param value
+    \param done
+*/
+void Open62541::Client::writeAsync(const NodeId& nodeId, const Variant& value, WriteCallback done)
+{
+    UA_WriteRequest* q  = UA_WriteRequest_new();
+    q->nodesToWrite     = UA_WriteValue_new();
+    q->nodesToWriteSize = 1;
+    UA_WriteValue* w    = q->nodesToWrite;
+    w->attributeId      = UA_ATTRIBUTEID_VALUE;
+    w->value.hasValue   = true;
+    UA_NodeId_copy(nodeId.constRef(), &w->nodeId);
+    UA_Variant_copy(value.constRef(), &w->value.value);
+    asyncRequest(q,
+                 &UA_TYPES[UA_TYPES_WRITEREQUEST],
+                 &UA_TYPES[UA_TYPES_WRITERESPONSE],
+                 [done](UA_StatusCode status, void* response) {
+                     if (status == UA_STATUSCODE_GOOD) {
+                         UA_WriteResponse* a = static_cast<UA_WriteResponse*>(response);
+                         status = (a->resultsSize == 1) ? a->results[0] : UA_STATUSCODE_BADUNEXPECTEDERROR;
+                     }
+                     if (done)
+                         done(status);
+                 });
+}
+
+/*!
+    \brief Open62541::Client::writeAsync
+    \param nodeId
+    \param value
+    \return future
+*/
+std::future<UA_StatusCode> Open62541::Client::writeAsync(const NodeId& nodeId, const Variant& value)
+{
+    auto p = std::make_shared<std::promise<UA_StatusCode>>();
+    auto f = p->get_future();
+    writeAsync(nodeId, value, [p](UA_StatusCode status) { p->set_value(status); });
+    return f;
+}
+
+/*!
+    \brief Open62541::Client::callAsync
+    \param objectId
+    \param methodId
+    \param in
+    \param done
+*/
+void Open62541::Client::callAsync(const NodeId& objectId,
+                                  const NodeId& methodId,
+                                  const VariantList& in,
+                                  CallCallback done)
+{
+    UA_CallRequest* q       = UA_CallRequest_new();
+    q->methodsToCall        = UA_CallMethodRequest_new();
+    q->methodsToCallSize    = 1;
+    UA_CallMethodRequest* m = q->methodsToCall;
+    UA_NodeId_copy(objectId.constRef(), &m->objectId);
+    UA_NodeId_copy(methodId.constRef(), &m->methodId);
+    if (!in.empty() &&
+        (UA_Array_copy(in.data(), in.size(), (void**)&m->inputArguments, &UA_TYPES[UA_TYPES_VARIANT]) ==
+         UA_STATUSCODE_GOOD)) {
+        m->inputArgumentsSize = in.size();
+    }
+    asyncRequest(q,
+                 &UA_TYPES[UA_TYPES_CALLREQUEST],
+                 &UA_TYPES[UA_TYPES_CALLRESPONSE],
+                 [done](UA_StatusCode status, void* response) {
+                     UA_CallMethodResult empty;
+                     UA_CallMethodResult_init(&empty);
+                     const UA_CallMethodResult* r = &empty;
+                     if (status == UA_STATUSCODE_GOOD) {
+                         UA_CallResponse* a = static_cast<UA_CallResponse*>(response);
+                         if (a->resultsSize == 1) {
+                             r      = a->results;
+                             status = r->statusCode;
+                         }
+                         else {
+                             status = UA_STATUSCODE_BADUNEXPECTEDERROR;
+                         }
+                     }
+                     if (done)
+                         done(status, *r);
+                 });
+}
+
+/*!
+    \brief Open62541::Client::callAsync
+    \param objectId
+    \param methodId
+    \param in
+    \return future
+*/
+std::future<Open62541::AsyncResult<Open62541::CallMethodResult>>
+Open62541::Client::callAsync(const NodeId& objectId, const NodeId& methodId, const VariantList& in)
+{
+    auto p = std::make_shared<std::promise<AsyncResult<CallMethodResult>>>();
+    auto f = p->get_future();
+    callAsync(objectId, methodId, in, [p](UA_StatusCode status, const UA_CallMethodResult& m) {
+        AsyncResult<CallMethodResult> r;
+        r.status = status;
+        r.value.assignFrom(m);
+        p->set_value(r);
+    });
+    return f;
+}
+
+/*!
+    \brief Open62541::Client::browseAsync
+    \param nodeId
+    \param done
+*/
+void Open62541::Client::browseAsync(const NodeId& nodeId, BrowseCallback done)
+{
+    UA_BrowseRequest* q     = UA_BrowseRequest_new();
+    q->nodesToBrowse        = UA_BrowseDescription_new();
+    q->nodesToBrowseSize    = 1;
+    UA_BrowseDescription* d = q->nodesToBrowse;
+    d->referenceTypeId      = UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+    d->includeSubtypes      = true;
+    d->browseDirection      = UA_BROWSEDIRECTION_BOTH;
+    d->resultMask           = UA_BROWSERESULTMASK_ALL;
+    UA_NodeId_copy(nodeId.constRef(), &d->nodeId);
+    asyncRequest(q,
+                 &UA_TYPES[UA_TYPES_BROWSEREQUEST],
+                 &UA_TYPES[UA_TYPES_BROWSERESPONSE],
+                 [done](UA_StatusCode status, void* response) {
+                     UA_BrowseResult empty;
+                     UA_BrowseResult_init(&empty);
+                     const UA_BrowseResult* r = &empty;
+                     if (status == UA_STATUSCODE_GOOD) {
+                         UA_BrowseResponse* a = static_cast<UA_BrowseResponse*>(response);
+                         if (a->resultsSize == 1) {
+                             r      = a->results;
+                             status = r->statusCode;
+                         }
+                         else {
+                             status = UA_STATUSCODE_BADUNEXPECTEDERROR;
+                         }
+                     }
+                     if (done)
+                         done(status, *r);
+                 });
+}
+
+/*!
+    \brief Open62541::Client::browseAsync
+    \param nodeId
+    \return future
+*/
+std::future<Open62541::AsyncResult<Open62541::BrowseResult>> Open62541::Client::browseAsync(const NodeId& nodeId)
+{
+    auto p = std::make_shared<std::promise<AsyncResult<BrowseResult>>>();
+    auto f = p->get_future();
+    browseAsync(nodeId, [p](UA_StatusCode status, const UA_BrowseResult& b) {
+        AsyncResult<BrowseResult> r;
+        r.status = status;
+        r.value.assignFrom(b);
+        p->set_value(r);
+    });
+    return f;
+}
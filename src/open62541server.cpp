@@ -552,6 +552,9 @@ void Open62541::Server::start()
                 }
                 process();  // called from time to time - Only safe places to access server are in process() and
                 // callbacks
+                for (auto& i : _processMap) {
+                    i.second(*this);
+                }
             }
             terminate();
         }
@@ -0,0 +1,414 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/sessioncontext.h>
+
+/*!
+    \brief Open62541::AccessDecisionCache::evict
+    Drop least recently used entries until within capacity - call with the lock held
+*/
+void Open62541::AccessDecisionCache::evict()
+{
+    while (_list.size() > _capacity) {
+        auto i = _map.find(_list.back().key);
+        if ((i != _map.end()) && (i->second == std::prev(_list.end()))) {
+            _map.erase(i);
+        }
+        _list.pop_back();
+    }
+}
+
+/*!
+    \brief Open62541::AccessDecisionCache::find
+    \param s
+    \param node
+    \param what
+    \param d
+    \return true on hit
+*/
+bool Open62541::AccessDecisionCache::find(const SessionContext& s, const UA_NodeId* node, UA_Byte what, AccessDecision& d)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    auto i = _map.find(makeKey(s.serial(), node));
+    if (i != _map.end()) {
+        Entry& e = *(i->second);
+        if ((e.session == s.serial()) && UA_NodeId_equal(e.node.constRef(), node)) {
+            if ((e.generation == s.generation()) && (e.epoch == _epoch)) {
+                if ((e.decision.valid & what) == what) {
+                    _list.splice(_list.begin(), _list, i->second);  // most recently used
+                    d = e.decision;
+                    _hits++;
+                    return true;
+                }
+            }
+            else {
+                // stale - roles or policy changed since it was evaluated
+                _list.erase(i->second);
+                _map.erase(i);
+            }
+        }
+    }
+    _misses++;
+    return false;
+}
+
+/*!
+    \brief Open62541::AccessDecisionCache::update
+    \param s
+    \param node
+    \param d
+*/
+void Open62541::AccessDecisionCache::update(const SessionContext& s, const UA_NodeId* node, const AccessDecision& d)
+{
+    if (_capacity == 0)
+        return;
+    std::lock_guard<std::mutex> l(_mutex);
+    UA_UInt64 key = makeKey(s.serial(), node);
+    auto i        = _map.find(key);
+    if (i != _map.end()) {
+        Entry& e = *(i->second);
+        if ((e.session == s.serial()) && (e.generation == s.generation()) && (e.epoch == _epoch) &&
+            UA_NodeId_equal(e.node.constRef(), node)) {
+            // merge with the decisions already held
+            if (d.valid & AccessDecision::RightsMask)
+                e.decision.rightsMask = d.rightsMask;
+            if (d.valid & AccessDecision::AccessLevel)
+                e.decision.accessLevel = d.accessLevel;
+            if (d.valid & AccessDecision::Browse)
+                e.decision.browse = d.browse;
+            e.decision.valid |= d.valid;
+            _list.splice(_list.begin(), _list, i->second);
+            return;
+        }
+        // stale or a hash collision - replace
+        _list.erase(i->second);
+        _map.erase(i);
+    }
+    Entry e;
+    e.key        = key;
+    e.session    = s.serial();
+    e.generation = s.generation();
+    e.epoch      = _epoch;
+    e.node       = *node;
+    e.decision   = d;
+    _list.push_front(e);
+    _map[key] = _list.begin();
+    evict();
+}
+
+/*!
+    \brief Open62541::AccessDecisionCache::invalidateNode
+    \param node
+*/
+void Open62541::AccessDecisionCache::invalidateNode(const NodeId& node)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    for (auto i = _list.begin(); i != _list.end();) {
+        if (UA_NodeId_equal(i->node.constRef(), node.constRef())) {
+            _map.erase(i->key);
+            i = _list.erase(i);
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+/*!
+    \brief Open62541::AccessDecisionCache::setCapacity
+    \param n
+*/
+void Open62541::AccessDecisionCache::setCapacity(size_t n)
+{
+    std::lock_guard<std::mutex> l(_mutex);
+    _capacity = n;
+    evict();
+}
+
+/*!
+    \brief Open62541::SessionAccessServer::~SessionAccessServer
+*/
+Open62541::SessionAccessServer::~SessionAccessServer()
+{
+    UA_Server* s = *this;
+    if (s) {
+        // abnormal exit - the base class closes the sessions after this object has gone
+        UA_Server_getConfig(s)->accessControl.context = nullptr;
+    }
+    std::lock_guard<std::mutex> l(_sessionMutex);
+    for (auto& i : _sessions) {
+        delete i.second;
+    }
+    _sessions.clear();
+}
+
+/*!
+    \brief Open62541::SessionAccessServer::getUserRightsMaskCached
+    \return user rights mask
+*/
+UA_UInt32 Open62541::SessionAccessServer::getUserRightsMaskCached(UA_Server* /*server*/,
+        UA_AccessControl* ac,
+        const UA_NodeId* /*sessionId*/,
+        void* sessionContext,
+        const UA_NodeId* nodeId,
+        void* nodeContext)
+{
+    SessionAccessServer* p = fromAccessControl(ac);
+    SessionContext* c      = static_cast<SessionContext*>(sessionContext);
+    if (!p || !c || !nodeId)
+        return 0xFFFFFFFF;  // admin session
+    AccessDecision d;
+    if (!p->_cache.find(*c, nodeId, AccessDecision::RightsMask, d)) {
+        d.valid      = AccessDecision::RightsMask;
+        d.rightsMask = p->evaluateUserRightsMask(*c, nodeId, nodeContext);
+        p->_cache.update(*c, nodeId, d);
+    }
+    return d.rightsMask;
+}
+
+/*!
+    \brief Open62541::SessionAccessServer::getUserAccessLevelCached
+    \return user access level
+*/
+UA_Byte Open62541::SessionAccessServer::getUserAccessLevelCached(UA_Server* /*server*/,
+        UA_AccessControl* ac,
+        const UA_NodeId* /*sessionId*/,
+        void* sessionContext,
+        const UA_NodeId* nodeId,
+        void* nodeContext)
+{
+    SessionAccessServer* p = fromAccessControl(ac);
+    SessionContext* c      = static_cast<SessionContext*>(sessionContext);
+    if (!p || !c || !nodeId)
+        return 0xFF;
+    AccessDecision d;
+    if (!p->_cache.find(*c, nodeId, AccessDecision::AccessLevel, d)) {
+        d.valid       = AccessDecision::AccessLevel;
+        d.accessLevel = p->evaluateUserAccessLevel(*c, nodeId, nodeContext);
+        p->_cache.update(*c, nodeId, d);
+    }
+    return d.accessLevel;
+}
+
+/*!
+    \brief Open62541::SessionAccessServer::allowBrowseNodeCached
+    \return true if the node may be browsed
+*/
+UA_Boolean Open62541::SessionAccessServer::allowBrowseNodeCached(UA_Server* /*server*/,
+        UA_AccessControl* ac,
+        const UA_NodeId* /*sessionId*/,
+        void* sessionContext,
+        const UA_NodeId* nodeId,
+        void* nodeContext)
+{
+    SessionAccessServer* p = fromAccessControl(ac);
+    SessionContext* c      = static_cast<SessionContext*>(sessionContext);
+    if (!p || !c || !nodeId)
+        return UA_TRUE;
+    AccessDecision d;
+    if (!p->_cache.find(*c, nodeId, AccessDecision::Browse, d)) {
+        d.valid  = AccessDecision::Browse;
+        d.browse = p->evaluateBrowseNode(*c, nodeId, nodeContext);
+        p->_cache.update(*c, nodeId, d);
+    }
+    return d.browse ? UA_TRUE : UA_FALSE;
+}
+
+/*!
+    \brief Open62541::SessionAccessServer::closeSessionCached
+*/
+void Open62541::SessionAccessServer::closeSessionCached(UA_Server* /*server*/,
+        UA_AccessControl* ac,
+        const UA_NodeId* sessionId,
+        void* sessionContext)
+{
+    SessionAccessServer* p = fromAccessControl(ac);
+    if (p && sessionId) {
+        p->closeSession(ac, sessionId, sessionContext);
+        // cached decisions for the session age out of the cache - the serial number is never reused
+        std::lock_guard<std::mutex> l(p->_sessionMutex);
+        auto i = p->_sessions.find(NodeId(*sessionId));
+        if (i != p->_sessions.end()) {
+            delete i->second;
+            p->_sessions.erase(i);
+        }
+    }
+}
+
+/*!
+    \brief Open62541::SessionAccessServer::activateSession
+    \return error code
+*/
+UA_StatusCode Open62541::SessionAccessServer::activateSession(UA_AccessControl* /*ac*/,
+        const UA_EndpointDescription* /*endpointDescription*/,
+        const UA_ByteString* /*secureChannelRemoteCertificate*/,
+        const UA_NodeId* sessionId,
+        const UA_ExtensionObject* userIdentityToken,
+        void** sessionContext)
+{
+    if (!sessionId || !sessionContext)
+        return UA_STATUSCODE_BADSESSIONIDINVALID;
+    std::string user;
+    UA_StatusCode ret = authenticate(userIdentityToken, user);
+    if (ret != UA_STATUSCODE_GOOD)
+        return ret;
+    NodeId id(*sessionId);
+    SessionContext* c = new SessionContext(id, user, userRoles(user), ++_serial);
+    {
+        // a session can be activated again - eg to change user - so replace any previous context
+        std::lock_guard<std::mutex> l(_sessionMutex);
+        auto i = _sessions.find(id);
+        if (i != _sessions.end()) {
+            delete i->second;
+            i->second = c;
+        }
+        else {
+            _sessions[id] = c;
+        }
+    }
+    *sessionContext = c;
+    return UA_STATUSCODE_GOOD;
+}
+
+/*!
+    \brief Open62541::SessionAccessServer::authenticate
+    \param token
+    \param user
+    \return error code
+*/
+UA_StatusCode Open62541::SessionAccessServer::authenticate(const UA_ExtensionObject* token, std::string& user)
+{
+    user.clear();
+    if (!token || (token->encoding == UA_EXTENSIONOBJECT_ENCODED_NOBODY) ||
+        ((token->encoding >= UA_EXTENSIONOBJECT_DECODED) &&
+         (token->content.decoded.type == &UA_TYPES[UA_TYPES_ANONYMOUSIDENTITYTOKEN]))) {
+        return _allowAnonymous ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADIDENTITYTOKENINVALID;
+    }
+    if ((token->encoding >= UA_EXTENSIONOBJECT_DECODED) &&
+        (token->content.decoded.type == &UA_TYPES[UA_TYPES_USERNAMEIDENTITYTOKEN])) {
+        const UA_UserNameIdentityToken* t = static_cast<const UA_UserNameIdentityToken*>(token->content.decoded.data);
+        if (!t || (t->userName.length == 0))
+            return UA_STATUSCODE_BADIDENTITYTOKENINVALID;
+        if (_credentials) {
+            if (!_credentials->verify(t->userName, t->password))
+                return UA_STATUSCODE_BADUSERACCESSDENIED;
+            user.assign((const char*)(t->userName.data), t->userName.length);
+            return UA_STATUSCODE_GOOD;
+        }
+        for (auto& l : logins()) {
+            if (UA_String_equal(&l.username, &t->userName) && UA_String_equal(&l.password, &t->password)) {
+                user.assign((const char*)(t->userName.data), t->userName.length);
+                return UA_STATUSCODE_GOOD;
+            }
+        }
+        return UA_STATUSCODE_BADUSERACCESSDENIED;
+    }
+    return UA_STATUSCODE_BADIDENTITYTOKENINVALID;
+}
+
+/*!
+    \brief Open62541::SessionAccessServer::loginCallback
+    Only used if the default access control activateSession is restored - activateSession() normally authenticates
+    \return error code
+*/
+UA_StatusCode Open62541::SessionAccessServer::loginCallback(const UA_String* userName,
+        const UA_ByteString* password,
+        size_t /*usernamePasswordLoginSize*/,
+        const UA_UsernamePasswordLogin* /*usernamePasswordLogin*/,
+        void** /*sessionContext*/,
+        void* loginContext)
+{
+    SessionAccessServer* p = static_cast<SessionAccessServer*>(loginContext);
+    if (p && p->_credentials && userName && password && p->_credentials->verify(*userName, *password))
+        return UA_STATUSCODE_GOOD;
+    return UA_STATUSCODE_BADUSERACCESSDENIED;
+}
+
+/*!
+    \brief Open62541::SessionAccessServer::enableSessionAccess
+    \param allowAnonymous
+    \return true on success
+*/
+bool Open62541::SessionAccessServer::enableSessionAccess(bool allowAnonymous)
+{
+    _allowAnonymous = allowAnonymous;
+    if (!_credentials)
+        return enableSimpleLogin(allowAnonymous);
+    // the default plugin sets up the user token policies advertised by the endpoints
+    UA_ServerConfig& c = serverConfig();
+    _lastError         = UA_AccessControl_defaultWithLoginCallback(&c,
+                         allowAnonymous,
+                         &c.securityPolicies[c.securityPoliciesSize - 1].policyUri,
+                         0,
+                         nullptr,
+                         loginCallback,
+                         this);
+    if (_lastError != UA_STATUSCODE_GOOD)
+        return false;
+    setAccessControl(&c.accessControl);
+    return true;
+}
+
+/*!
+    \brief Open62541::SessionAccessServer::userRoles
+    \param user
+    \return role bitmask
+*/
+UA_UInt64 Open62541::SessionAccessServer::userRoles(const std::string& user)
+{
+    Credential c;
+    if (_credentials && !user.empty() && _credentials->find(user, c))
+        return c.roles;
+    return 0;
+}
+
+/*!
+    \brief Open62541::SessionAccessServer::setSessionRoles
+    \param sessionId
+    \param roles
+    \return true if found
+*/
+bool Open62541::SessionAccessServer::setSessionRoles(const NodeId& sessionId, UA_UInt64 roles)
+{
+    std::lock_guard<std::mutex> l(_sessionMutex);
+    auto i = _sessions.find(sessionId);
+    if (i != _sessions.end()) {
+        i->second->setRoles(roles);
+        return true;
+    }
+    return false;
+}
+
+/*!
+    \brief Open62541::SessionAccessServer::rolesChanged
+*/
+void Open62541::SessionAccessServer::rolesChanged()
+{
+    {
+        std::lock_guard<std::mutex> l(_sessionMutex);
+        for (auto& i : _sessions) {
+            i.second->setRoles(userRoles(i.second->user()));
+        }
+    }
+    _cache.invalidateAll();
+}
+
+/*!
+    \brief Open62541::SessionAccessServer::findSession
+    \param sessionId
+    \return session context or null
+*/
+Open62541::SessionContext* Open62541::SessionAccessServer::findSession(const NodeId& sessionId)
+{
+    std::lock_guard<std::mutex> l(_sessionMutex);
+    auto i = _sessions.find(sessionId);
+    return (i != _sessions.end()) ? i->second : nullptr;
+}
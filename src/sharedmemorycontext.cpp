@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/sharedmemorycontext.h>
+#include <open62541cpp/open62541server.h>
+#include <thread>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// readers spin this many times on a record being written before yielding
+static const int SPIN_LIMIT = 64;
+// give up on a record after this many attempts - the writer has probably died mid write
+static const int RETRY_LIMIT = 10000;
+
+/*!
+    \brief Open62541::SharedMemoryTagTable::map
+    \param create
+    \param capacity
+    \return true on success
+*/
+bool Open62541::SharedMemoryTagTable::map(bool create, UA_UInt32 capacity)
+{
+    if (create) {
+        _size = sizeof(SharedMemoryTableHeader) + size_t(capacity) * sizeof(SharedMemoryRecord);
+        if (::ftruncate(_fd, off_t(_size)) != 0)
+            return false;
+    }
+    else {
+        struct stat st;
+        if ((::fstat(_fd, &st) != 0) || (size_t(st.st_size) < sizeof(SharedMemoryTableHeader)))
+            return false;
+        _size = size_t(st.st_size);
+    }
+    _base = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (_base == MAP_FAILED) {
+        _base = nullptr;
+        return false;
+    }
+    _header  = static_cast<SharedMemoryTableHeader*>(_base);
+    _records = reinterpret_cast<SharedMemoryRecord*>(static_cast<char*>(_base) + sizeof(SharedMemoryTableHeader));
+    if (create) {
+        memset(_base, 0, _size);
+        _header->magic      = SHARED_MEMORY_MAGIC;
+        _header->version    = SHARED_MEMORY_VERSION;
+        _header->capacity   = capacity;
+        _header->recordSize = sizeof(SharedMemoryRecord);
+        _header->count.store(0, std::memory_order_release);
+    }
+    else if ((_header->magic != SHARED_MEMORY_MAGIC) || (_header->version != SHARED_MEMORY_VERSION) ||
+             (_header->recordSize != sizeof(SharedMemoryRecord)) ||
+             (_size < sizeof(SharedMemoryTableHeader) + size_t(_header->capacity) * sizeof(SharedMemoryRecord))) {
+        return false;  // not a tag table or built with a different layout
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::SharedMemoryTagTable::create
+    \param name
+    \param capacity
+    \return true on success
+*/
+bool Open62541::SharedMemoryTagTable::create(const std::string& name, UA_UInt32 capacity)
+{
+    close();
+    _name = name;
+    _fd   = ::shm_open(name.c_str(), O_CREAT | O_RDWR, 0660);
+    if ((_fd < 0) || !map(true, capacity)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::SharedMemoryTagTable::open
+    \param name
+    \return true on success
+*/
+bool Open62541::SharedMemoryTagTable::open(const std::string& name)
+{
+    close();
+    _name = name;
+    _fd   = ::shm_open(name.c_str(), O_RDWR, 0660);
+    if ((_fd < 0) || !map(false, 0)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+/*!
+    \brief Open62541::SharedMemoryTagTable::close
+*/
+void Open62541::SharedMemoryTagTable::close()
+{
+    if (_base) {
+        ::munmap(_base, _size);
+        _base = nullptr;
+    }
+    if (_fd >= 0) {
+        ::close(_fd);
+        _fd = -1;
+    }
+    _header  = nullptr;
+    _records = nullptr;
+    _size    = 0;
+}
+
+/*!
+    \brief Open62541::SharedMemoryTagTable::unlink
+    \param name
+    \return true on success
+*/
+bool Open62541::SharedMemoryTagTable::unlink(const std::string& name)
+{
+    return ::shm_unlink(name.c_str()) == 0;
+}
+
+/*!
+    \brief Open62541::SharedMemoryTagTable::define
+    \param name
+    \param typeIndex
+    \return record index or -1
+*/
+int Open62541::SharedMemoryTagTable::define(const std::string& name, UA_UInt32 typeIndex)
+{
+    if (!isOpen() || (typeIndex >= UA_TYPES_COUNT) || (name.size() >= SHARED_MEMORY_TAG_NAME_SIZE))
+        return -1;
+    UA_UInt32 i = _header->count.fetch_add(1, std::memory_order_acq_rel);
+    if (i >= _header->capacity) {
+        _header->count.fetch_sub(1, std::memory_order_acq_rel);
+        return -1;
+    }
+    SharedMemoryRecord& r = _records[i];
+    UA_UInt32 s           = r.sequence.load(std::memory_order_relaxed);
+    r.sequence.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memset(r.name, 0, SHARED_MEMORY_TAG_NAME_SIZE);
+    memcpy(r.name, name.c_str(), name.size());
+    r.typeIndex       = typeIndex;
+    r.status          = UA_STATUSCODE_BADDATAUNAVAILABLE;  // nothing written yet
+    r.sourceTimestamp = 0;
+    memset(r.value, 0, SHARED_MEMORY_VALUE_SIZE);
+    r.sequence.store(s + 2, std::memory_order_release);
+    return int(i);
+}
+
+/*!
+    \brief Open62541::SharedMemoryTagTable::find
+    \param name
+    \return record index or -1
+*/
+int Open62541::SharedMemoryTagTable::find(const std::string& name) const
+{
+    UA_UInt32 n = count();
+    for (UA_UInt32 i = 0; (i < n) && (i < capacity()); i++) {
+        if (strncmp(_records[i].name, name.c_str(), SHARED_MEMORY_TAG_NAME_SIZE) == 0)
+            return int(i);
+    }
+    return -1;
+}
+
+/*!
+    \brief Open62541::SharedMemoryTagTable::write
+    \param index
+    \param data
+    \param size
+    \param typeIndex
+    \param sourceTimestamp
+    \param status
+    \return true on success
+*/
+bool Open62541::SharedMemoryTagTable::write(unsigned index,
+                                            const void* data,
+                                            size_t size,
+                                            UA_UInt32 typeIndex,
+                                            UA_DateTime sourceTimestamp,
+                                            UA_StatusCode status)
+{
+    if ((index >= capacity()) || (size > SHARED_MEMORY_VALUE_SIZE) || (typeIndex >= UA_TYPES_COUNT))
+        return false;
+    SharedMemoryRecord& r = _records[index];
+    UA_UInt32 s           = r.sequence.load(std::memory_order_relaxed);
+    r.sequence.store(s + 1, std::memory_order_relaxed);  // odd - write in progress
+    std::atomic_thread_fence(std::memory_order_release);
+    r.typeIndex       = typeIndex;
+    r.status          = status;
+    r.sourceTimestamp = sourceTimestamp;
+    memset(r.value, 0, SHARED_MEMORY_VALUE_SIZE);
+    memcpy(r.value, data, size);
+    r.sequence.store(s + 2, std::memory_order_release);  // even - stable
+    return true;
+}
+
+/*!
+    \brief Open62541::SharedMemoryTagTable::read
+    \param index
+    \param v
+    \return true on success
+*/
+bool Open62541::SharedMemoryTagTable::read(unsigned index, SharedMemoryValue& v) const
+{
+    if (index >= capacity())
+        return false;
+    const SharedMemoryRecord& r = _records[index];
+    for (int n = 0; n < RETRY_LIMIT; n++) {
+        UA_UInt32 s = r.sequence.load(std::memory_order_acquire);
+        if (s & 1) {
+            if (n > SPIN_LIMIT)
+                std::this_thread::yield();
+            continue;
+        }
+        v.typeIndex       = r.typeIndex;
+        v.status          = r.status;
+        v.sourceTimestamp = r.sourceTimestamp;
+        memcpy(v.value, r.value, SHARED_MEMORY_VALUE_SIZE);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (r.sequence.load(std::memory_order_relaxed) == s) {
+            v.sequence = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*!
+    \brief Open62541::SharedMemoryTagTable::toDataValue
+    \param v
+    \param d
+    \return true on success
+*/
+bool Open62541::SharedMemoryTagTable::toDataValue(const SharedMemoryValue& v, UA_DataValue& d)
+{
+    if ((v.typeIndex >= UA_TYPES_COUNT) || (UA_TYPES[v.typeIndex].memSize > SHARED_MEMORY_VALUE_SIZE) ||
+        !UA_TYPES[v.typeIndex].pointerFree)
+        return false;
+    UA_DataValue_clear(&d);
+    if (UA_Variant_setScalarCopy(&d.value, v.value, &UA_TYPES[v.typeIndex]) != UA_STATUSCODE_GOOD)
+        return false;
+    d.hasValue           = true;
+    d.status             = v.status;
+    d.hasStatus          = (v.status != UA_STATUSCODE_GOOD);
+    d.sourceTimestamp    = v.sourceTimestamp;
+    d.hasSourceTimestamp = (v.sourceTimestamp != 0);
+    return true;
+}
+
+/*!
+    \brief Open62541::SharedMemoryContext::bind
+    \param server
+    \param node
+    \param index
+    \return true on success
+*/
+bool Open62541::SharedMemoryContext::bind(Server& server, NodeId& node, unsigned index)
+{
+    if (index >= _table.capacity())
+        return false;
+    _map[node] = index;
+    if (!server.setNodeContext(node, this)) {
+        _lastError = server.lastError();
+        return false;
+    }
+    return setAsDataSource(server, node);
+}
+
+/*!
+    \brief Open62541::SharedMemoryContext::readData
+    \param node
+    \param range
+    \param value
+    \return true on success
+*/
+bool Open62541::SharedMemoryContext::readData(Server& /*server*/,
+                                              NodeId& node,
+                                              const UA_NumericRange* range,
+                                              UA_DataValue& value)
+{
+    if (range && range->dimensionsSize)
+        return false;  // records hold scalars
+    auto i = _map.find(node);
+    if (i == _map.end())
+        return false;
+    SharedMemoryValue v;
+    return _table.read(i->second, v) && SharedMemoryTagTable::toDataValue(v, value);
+}
+
+/*!
+    \brief Open62541::SharedMemoryPoller::add
+    \param node
+    \param index
+*/
+void Open62541::SharedMemoryPoller::add(const NodeId& node, unsigned index)
+{
+    Binding b;
+    b.node         = node;
+    b.index        = index;
+    b.lastSequence = 0;  // first poll writes whatever is there
+    _bindings.push_back(b);
+}
+
+/*!
+    \brief Open62541::SharedMemoryPoller::poll
+    \param server
+    \return number of values written
+*/
+size_t Open62541::SharedMemoryPoller::poll(Server& server)
+{
+    size_t n = 0;
+    if (!_table.isOpen())
+        return n;
+    UA_DataValue d;
+    UA_DataValue_init(&d);
+    for (auto& b : _bindings) {
+        if (!b.checked) {
+            // a data source node is read from the record on demand - writing it as well would fight the source
+            // the context may not be a NodeContext
+            NodeContext* c = nullptr;
+            b.checked      = true;
+            b.dataSource   = server.getNodeContext(b.node, c) && NodeContext::contains(c) &&
+                           dynamic_cast<SharedMemoryContext*>(c);
+        }
+        if (b.dataSource)
+            continue;
+        // cheap check first - only records that changed are read and written
+        if (_table.sequence(b.index) == b.lastSequence)
+            continue;
+        SharedMemoryValue v;
+        if (_table.read(b.index, v)) {
+            b.lastSequence = v.sequence;
+            if (SharedMemoryTagTable::toDataValue(v, d) && server.writeDataValue(b.node, d)) {
+                n++;
+            }
+        }
+    }
+    UA_DataValue_clear(&d);
+    _updates += n;
+    return n;
+}
+
+/*!
+    \brief Open62541::SharedMemoryPoller::attach
+    \param server
+*/
+void Open62541::SharedMemoryPoller::attach(Server& server)
+{
+    server.addProcessHandler(_name, [this](Server& s) { poll(s); });
+}
+
+/*!
+    \brief Open62541::SharedMemoryPoller::detach
+    \param server
+*/
+void Open62541::SharedMemoryPoller::detach(Server& server)
+{
+    server.removeProcessHandler(_name);
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2017 -  B. J. Hill
+ *
+ * This file is part of open62541 C++ classes. open62541 C++ classes are free software: you can
+ * redistribute it and/or modify it under the terms of the Mozilla Public
+ * License v2.0 as stated in the LICENSE file provided with open62541.
+ *
+ * open62541 C++ classes are distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.
+ */
+#include <open62541cpp/subscriptiontuner.h>
+#include <cmath>
+
+/*!
+    \brief Open62541::SubscriptionTuner::add
+    \param s
+    \return true on success
+*/
+bool Open62541::SubscriptionTuner::add(ClientSubscription& s)
+{
+    if (!s.id())
+        return false;
+    s.setStatistics(true);
+    _subscriptions[s.id()] = Load();
+    return true;
+}
+
+/*!
+    \brief Open62541::SubscriptionTuner::remove
+    \param s
+*/
+void Open62541::SubscriptionTuner::remove(ClientSubscription& s)
+{
+    s.setStatistics(false);
+    _subscriptions.erase(s.id());
+}
+
+/*!
+    \brief Open62541::SubscriptionTuner::start
+    \param period
+    \return true on success
+*/
+bool Open62541::SubscriptionTuner::start(UA_Double period)
+{
+    stop();
+    return _client.addRepeatedTimerEvent(period, _timerId, [this](Client::Timer&) { tune(); });
+}
+
+/*!
+    \brief Open62541::SubscriptionTuner::stop
+*/
+void Open62541::SubscriptionTuner::stop()
+{
+    if (_timerId) {
+        _client.removeTimerEvent(_timerId);
+        _timerId = 0;
+    }
+}
+
+/*!
+    \brief Open62541::SubscriptionTuner::tune
+    \return number of subscriptions changed
+*/
+size_t Open62541::SubscriptionTuner::tune()
+{
+    size_t ret = 0;
+    for (auto i = _subscriptions.begin(); i != _subscriptions.end();) {
+        ClientSubscription* s = _client.subscription(i->first);
+        if (!s) {
+            i = _subscriptions.erase(i);  // deleted
+            continue;
+        }
+        UA_Double interval = s->response().revisedPublishingInterval;
+        UA_Double elapsed  = UA_Double(UA_DateTime_now() - s->statistics().start) / UA_DATETIME_MSEC;
+        if (s->modifying() || _moving->count(i->first) || (interval <= 0) || (elapsed < 2 * interval)) {
+            ++i;  // wait for the change in flight or for enough publishing cycles
+            continue;
+        }
+        ClientSubscription::Statistics w = s->takeStatistics();
+        Load& l                          = i->second;
+        l.rate                           = w.notifications * 1000.0 / elapsed;
+        l.perPublish                     = w.notifications * interval / elapsed;
+        l.latency                        = w.meanLatency();
+        l.overflows                      = w.overflows;
+        //
+        UA_Double newInterval = interval;
+        UA_UInt32 newLimit    = s->settings().maxNotificationsPerPublish;
+        adjust(*s, l, newInterval, newLimit);
+        UA_Double wanted = newInterval;
+        newInterval      = std::min(std::max(wanted, _target.minPublishingInterval), _target.maxPublishingInterval);
+        if ((std::abs(newInterval - interval) >= 1.0) || (newLimit != s->settings().maxNotificationsPerPublish)) {
+            if (s->modify(newInterval, newLimit)) {
+                _changes++;
+                ret++;
+            }
+        }
+        else if (std::abs(wanted - interval) >= 1.0) {
+            _moved += rebalance(*s, l);  // held at a bound
+        }
+        ++i;
+    }
+    return ret;
+}
+
+/*!
+    \brief Open62541::SubscriptionTuner::leastLoaded
+    \return subscription or null
+*/
+Open62541::ClientSubscription* Open62541::SubscriptionTuner::leastLoaded()
+{
+    ClientSubscription* ret = nullptr;
+    UA_Double rate          = 0;
+    for (auto& i : _subscriptions) {
+        ClientSubscription* s = _client.subscription(i.first);
+        if (s && (!ret || (i.second.rate < rate))) {
+            ret  = s;
+            rate = i.second.rate;
+        }
+    }
+    return ret;
+}
+
+/*!
+    \brief Open62541::SubscriptionTuner::rebalance
+    \param s
+    \param l
+    \return number of items being moved
+*/
+size_t Open62541::SubscriptionTuner::rebalance(ClientSubscription& s, const Load& l)
+{
+    if (!_target.maxItemsMoved || (l.rate <= 0) || _moving->count(s.id()))
+        return 0;
+    ClientSubscription* t = leastLoaded();
+    if (!t || (t == &s) || t->modifying() || _moving->count(t->id()))
+        return 0;
+    UA_Double rate = _subscriptions[t->id()].rate;
+    if (2 * rate >= l.rate)
+        return 0;  // not worth the churn
+    //
+    // items of one kind and timestamps can be moved with one request
+    std::vector<MonitoredItem*> items;
+    MonitoredItem* first = nullptr;
+    for (auto& i : s.monitorItems()) {
+        MonitoredItem* m = i.second.get();
+        MonitoredItemCreateRequest r;
+        if (!m->id() || !m->createRequest(r))
+            continue;
+        if (!first)
+            first = m;
+        if ((m->isEvent() == first->isEvent()) && (m->timestamps() == first->timestamps()))
+            items.push_back(m);
+    }
+    size_t n = size_t(s.monitorItems().size() * (l.rate - rate) / (2 * l.rate));  // evens out the two rates
+    n        = std::min(std::min(n, _target.maxItemsMoved), items.size());
+    if (n == 0)
+        return 0;
+    items.resize(n);
+    //
+    auto moving    = _moving;  // the tuner may have gone by the time the move completes
+    Client* cl     = &_client;
+    UA_UInt32 from = s.id();
+    UA_UInt32 to   = t->id();
+    moving->insert(from);
+    moving->insert(to);
+    bool sent      = MonitoredItem::move(s, *t, items, [moving, cl, from, to](size_t) {
+        moving->erase(from);
+        moving->erase(to);
+        for (UA_UInt32 id : {from, to}) {
+            ClientSubscription* c = cl->subscription(id);
+            if (c)
+                c->takeStatistics();  // the window measured the old split
+        }
+    });
+    return sent ? n : 0;
+}
+
+/*!
+    \brief Open62541::SubscriptionTuner::adjust
+    \param s
+    \param l
+    \param publishingInterval
+    \param maxNotificationsPerPublish
+*/
+void Open62541::SubscriptionTuner::adjust(ClientSubscription& /*s*/,
+                                          const Load& l,
+                                          UA_Double& publishingInterval,
+                                          UA_UInt32& maxNotificationsPerPublish)
+{
+    // doubling the interval adds about half of it to the mean latency - only widen with that much headroom
+    bool headroom = (l.latency + publishingInterval / 2) < (_target.maxLatency / 2);
+    if ((l.overflows > 0) || (l.latency > _target.maxLatency)) {
+        publishingInterval /= 2;
+    }
+    else if ((l.rate > 0) && headroom) {
+        bool widen = (_target.maxRate > 0) ? (l.rate > _target.maxRate) : (l.perPublish < 2);
+        if (widen)
+            publishingInterval *= 2;
+    }
+    // publishes are being cut at the limit
+    if (maxNotificationsPerPublish && (l.perPublish > 0.75 * maxNotificationsPerPublish)) {
+        maxNotificationsPerPublish =
+            std::min<UA_UInt32>(2 * maxNotificationsPerPublish, _target.maxNotificationsPerPublish);
+    }
+}